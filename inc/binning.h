@@ -0,0 +1,63 @@
+/*
+ * BINNING.H: 1D, 2D and 3D histograms with weights and per bin moments
+ *	      of a value, see binning.c
+ *
+ *	An axis is either linear, from min to max (max<min for a reversed
+ *	axis), or has n+1 given edges. Bins include their lower edge; with
+ *	closed set the upper edge of the last bin is included as well.
+ *	Bins are numbered with the first axis running fastest:
+ *	    i = ix + n[0]*(iy + n[1]*iz)
+ *	Per bin the count, the sum of the weights and, depending on nmom,
+ *	the weighted mean and central sums of order 2..4 of a value
+ *	are kept.
+ */
+
+#ifndef _binning_h
+#define _binning_h
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define BIN_MAXDIM  3
+
+typedef struct {
+    int     n;			/* number of bins */
+    double  min, max;		/* outer edges */
+    double  scale;		/* n/(max-min) for a linear axis */
+    double *edge;		/* n+1 edges, or NULL if linear */
+} bin_axis;
+
+typedef struct {
+    int      ndim;		/* 1, 2 or 3 */
+    bin_axis ax[BIN_MAXDIM];
+    long     nbin;		/* total number of bins */
+    int      nmom;		/* 0: weights only, 1: mean, 2..4: central sums */
+    bool     closed;		/* last bin includes its upper edge */
+    long    *count;		/* number of points per bin */
+    double  *w;			/* sum of weights */
+    double  *mean;		/* weighted mean of the value       (nmom>0) */
+    double  *m2, *m3, *m4;	/* weighted central sums of order k (nmom>=k) */
+    long     nout;		/* points outside all bins */
+    double   wout;		/* and their weight */
+} bin_table;
+
+extern bin_table *bin_create(int ndim, int *n, double *min, double *max, int nmom);
+extern void       bin_edges(bin_table *b, int axis, double *edge);
+extern void       bin_clear(bin_table *b);
+extern void       bin_free(bin_table *b);
+
+extern void       bin_index_n(bin_table *b, int n, real *x, real *y, real *z, long *idx);
+extern void       bin_accum_n(bin_table *b, int n, long *idx, real *w, real *v);
+extern void       bin_add_n(bin_table *b, int n, real *x, real *y, real *z, real *w, real *v);
+extern void       bin_merge(bin_table *b, bin_table *p);
+
+extern double     bin_sigma(bin_table *b, long i);
+extern double     bin_skewness(bin_table *b, long i);
+extern double     bin_kurtosis(bin_table *b, long i);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
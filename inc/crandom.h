@@ -0,0 +1,39 @@
+/*
+ * CRANDOM.H: counter-based random numbers (Philox4x32-10), see crandom.c
+ *
+ *	Unlike xrandom(), which advances one global sequence, a number
+ *	here is a pure function of (seed, stream, counter). Giving each body
+ *	(or any other unit of work) its own stream thus makes the result
+ *	independent of the order, and of the number of threads, in which
+ *	they are done.
+ */
+
+#ifndef _crandom_h
+#define _crandom_h
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct {
+    unsigned int        key[2];		/* the seed */
+    unsigned int        stream[2];	/* stream number */
+    unsigned long long  counter;	/* uniforms drawn so far */
+    double              ubuf[2];	/* uniforms of the current block */
+    double              gbuf;		/* second gaussian of a pair */
+    int                 ngbuf;		/* 1 if gbuf is valid */
+} crandom_state;
+
+extern void   philox4x32(unsigned int ctr[4], unsigned int key[2], unsigned int out[4]);
+extern void   init_crandom(crandom_state *cr, unsigned long long seed, unsigned long long stream);
+extern double crandom(crandom_state *cr, double a, double b);
+extern double cgrandom(crandom_state *cr, double m, double s);
+extern void   crandom_n(crandom_state *cr, double *x, int n, double a, double b);
+extern void   cgrandom_n(crandom_state *cr, double *x, int n, double m, double s);
+extern double crandom_at(unsigned long long seed, unsigned long long stream, unsigned long long counter);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
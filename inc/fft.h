@@ -0,0 +1,20 @@
+/*
+ * FFT.H: simple in-place complex FFT's, see fft.c
+ */
+
+#ifndef _fft_h
+#define _fft_h
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+extern int  fft_next2(int n);
+extern void fft_cplx(double *data, int n, int isign);
+extern void fft_ndim(double *data, int ndim, int *nn, int isign);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -14,6 +14,7 @@
  *   18-dec-01  renamed this file from fitsio.h to fitsio_nemo.h
  *              and added optional CFITSIO wrapper stuff
  *   23-jul-02  add fitresize
+ *   19-oct-26  add fitmap, fitrdpix, fitwrpix for (parallel) whole plane I/O
  */
 
 #ifndef _fitsio_nemo_h
@@ -104,6 +105,8 @@ typedef struct {
     int ispipe;            /* is the stream a pipe ? */
     stream fd;
     FLOAT bscale, bzero;   /* scaling factors for BITPIX > 0 maps */
+    char *map;             /* mmap()'d file, see fitmap(), or NULL */
+    size_t maplen;         /* length of the mapped file */
 } FITS;
 
 #endif
@@ -116,6 +119,8 @@ void fitclose (FITS *),
      fitsetpl (FITS *, int, int *),
      fitread  (FITS *, int, FLOAT *),
      fitwrite (FITS *, int, FLOAT *),
+     fitrdpix (FITS *, size_t, size_t, FLOAT *),
+     fitwrpix (FITS *, size_t, size_t, FLOAT *),
      fitrdhdr (FITS *, string, FLOAT *, FLOAT),
      fitrdhdi (FITS *, string, int *, int),
      fitrdhda (FITS *, string, string, string),
@@ -129,5 +134,6 @@ void fitclose (FITS *),
 void fit_setbitpix (int),
      fit_setscale  (FLOAT, FLOAT),
      fit_setblocksize (int);
-int  fitexhd (FITS *, string);
+int  fitexhd (FITS *, string),
+     fitmap  (FITS *);
 #endif
@@ -30,6 +30,7 @@
  *  22-may-21         added Object
  *  13-dec-22         added various frequently used FITS header items for fitsccd-ccdfits conversions
  *  14-sep-22         Also allow more common names in FITS (CDELTi,CRVALi,CRPIXi)
+ *  19-oct-26         added prototypes for xcorr.c
  */
 #ifndef _h_image
 #define _h_image
@@ -326,6 +327,10 @@ void wcs_f2i(int ndim, double *crpix, double *crval, double *cdelt,            i
 void wcs_i2f(image *iptr, 	     int ndim, double *crpix, double *crval, double *cdelt);
 
 
+/* xcorr.c */
+void xcorr_image(imageptr *iptr, int nimage, int *center, int box, real *clip, imageptr cptr);
+real xpeak_image(imageptr cptr, int iz, int n, int *ipeak, real *shift, real *moment);
+
 /* get_nan.c */
 void get_nanf(float *x);
 void get_nand(double *x);
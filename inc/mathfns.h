@@ -153,6 +153,7 @@ double xrandom(double, double);
 double grandom(double, double);
 double erandom(double);
 double frandom(double, double, real_proc);
+double frandom_inv(double, double, double, real_proc);
 
 #ifdef NEMO
 
@@ -15,11 +15,17 @@ typedef struct moment {
     real datamin, datamax;  /* min & max of data */
     real sumn, sump;        /* separate sum of negative and positive numbers */
     bool slow;              /* slow recompute from the mean, avoiding potential roundoff */
+    real wsum, wmean;       /* running weight and mean (if ndat=0) */
+    real wm2, wm3, wm4;     /* running sums of w*(x-mean)^{2,3,4} (if ndat=0) */
+    struct tdigest *td;     /* optional quantile sketch, see sketch_moment() */
 } Moment, *MomentPtr; 
 
 void ini_moment   (Moment *, int, int);		/* allocates */
 void slow_moment  (Moment *, bool);             /* set slowness */
 void accum_moment (Moment *, real, real);	/* accumulates */
+void accum_moment_n (Moment *, int, real *, real *);  /* accumulates an array */
+void merge_moment (Moment *, Moment *);         /* adds a partial moment */
+void sketch_moment(Moment *, int);              /* keep a quantile sketch */
 void decr_moment  (Moment *, real, real);	/* decrements (dangerous) */
 void reset_moment (Moment *);       	        /* resets */
 void free_moment  (Moment *);                   /* frees allocs from ini_ */
@@ -29,7 +35,8 @@ real show_moment  (Moment *, int);     /* general case to peek at (special) valu
 int  n_moment     (Moment *);	/* number of moments */
 real sum_moment   (Moment *);	/* computes sum0 */
 real mean_moment  (Moment *);	/* computes mean (mom=-1) */
-real median_moment(Moment *);   /* only works if ndat > 0 */
+real median_moment(Moment *);   /* only works if ndat > 0, or with a sketch */
+real quantile_moment(Moment *, real);  /* idem, for any quantile */
 real sigma_moment (Moment *);	/* computes weighted dispersion around mean (mom=-2) */
 real rms_moment   (Moment *);	/* computes rms */
 real mad_moment   (Moment *);   /* MAD  = median absolute deviation */
@@ -0,0 +1,19 @@
+/*
+ * NAFF.H: Laskar's Numerical Analysis of Fundamental Frequencies, see naff.c
+ */
+
+#ifndef _naff_h
+#define _naff_h
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+extern int naff(int n, double dt, double *re, double *im,
+                int nfreq, double *freq, double *ampr, double *ampi);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * PERF.H: per phase timers and counters, enabled with the perf= system
+ *	   keyword, see perf.c
+ *
+ *	Named regions nest, and give a tree of calls, wall clock and cpu
+ *	time, and the counters accumulated inside each region. A report in
+ *	JSON is written by finiparam().
+ */
+
+#ifndef _perf_h
+#define _perf_h
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* counters maintained by the library; perf_counter() adds more */
+#define PERF_READ_ITEMS    0	/* filesecret: items (or elements) read */
+#define PERF_READ_BYTES    1	/* filesecret: bytes read */
+#define PERF_WRITE_ITEMS   2	/* filesecret: items (or elements) written */
+#define PERF_WRITE_BYTES   3	/* filesecret: bytes written */
+#define PERF_ALLOC_CALLS   4	/* allocate() and reallocate() calls */
+#define PERF_ALLOC_BYTES   5	/* bytes requested from them */
+#define PERF_NSYS          6
+#define PERF_MAXCOUNT     32
+
+extern int perf_level;		/* 0 if perf= was not given */
+
+extern void perf_init(string file);
+extern void perf_start(string name);
+extern void perf_stop(string name);
+extern int  perf_counter(string name);
+extern void perf_add(int counter, long long n);
+extern void perf_report(string prog, string version);
+
+/* the cheap form for hot spots: nothing but a test if not enabled */
+#define PERF_ADD(counter,n)  { if (perf_level) perf_add(counter,(long long)(n)); }
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
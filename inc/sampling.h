@@ -0,0 +1,66 @@
+/*
+ * SAMPLING.H: tables to draw random numbers from tabulated distributions
+ *	       without rejection, see sampling.c
+ *
+ *	icdf_table:  inverse cumulative distribution x(u), as a monotone
+ *		     cubic through a table of (x, cumulative fraction)
+ *	alias_table: Walker's alias method for a discrete distribution
+ *	cdist_table: a variable x in [0,1] whose distribution depends on a
+ *		     parameter y (e.g. speed/escape speed given the potential),
+ *		     as alias tables of piecewise linear pdf's on a grid of y
+ *
+ *	All are built once, and are only read when drawing, so the draws can
+ *	be made in parallel. The uniform numbers are supplied by the caller,
+ *	e.g. from xrandom() or crandom().
+ */
+
+#ifndef _sampling_h
+#define _sampling_h
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct {
+    int     n;			/* number of table points */
+    double *x;			/* abscissae, increasing */
+    double *c;			/* cumulative fraction, c[0]=0 .. c[n-1]=1 */
+    double *d;			/* dx/dc, keeping x(c) monotone */
+    int    *g;			/* guide: g[k] is the interval of u=k/n */
+} icdf_table;
+
+typedef struct {
+    int     n;			/* number of outcomes */
+    double *prob;		/* probability to keep outcome i */
+    int    *alias;		/* the other outcome in the column of i */
+} alias_table;
+
+typedef struct {
+    int     ny, nx;		/* number of rows and of x points per row */
+    double *y;			/* parameter of each row, increasing */
+    double *x;			/* x grid in [0,1] */
+    double *p;			/* normalised pdf of row j at x[i]: p[j*nx+i] */
+    alias_table **row;		/* picks the x interval of a row */
+} cdist_table;
+
+typedef double (*cdist_proc)(double x, double y, void *arg);
+
+extern icdf_table  *icdf_create(int n, double *x, double *y, bool cumulative);
+extern double       icdf_eval(icdf_table *t, double u);
+extern void         icdf_eval_n(icdf_table *t, int n, double *u, double *x);
+extern void         icdf_free(icdf_table *t);
+
+extern alias_table *alias_create(int n, double *w);
+extern int          alias_eval(alias_table *t, double u);
+extern void         alias_free(alias_table *t);
+
+extern cdist_table *cdist_create(int ny, double *y, int nx, cdist_proc pdf, void *arg);
+extern double       cdist_eval(cdist_table *t, double y, double *u);
+extern void         cdist_eval_n(cdist_table *t, int n, double *y, double *u, double *x);
+extern void         cdist_free(cdist_table *t);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
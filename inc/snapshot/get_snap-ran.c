@@ -476,11 +476,13 @@ int *ifptr;			/* pointer to input bit flags */
     }
 #endif
     if (get_tag_ok(instr, SnapShotTag)) {
+	perf_start("get_snap");
 	get_set(instr, SnapShotTag);
 	get_snap_parameters(instr, btptr, nbptr, tsptr, ifptr);
 	get_snap_particles(instr, btptr, nbptr, ifptr);
 	get_snap_diagnostics(instr, ifptr);
 	get_tes(instr, SnapShotTag);
+	perf_stop("get_snap");
 	return 1;
     } else
 	return 0;
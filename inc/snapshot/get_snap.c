@@ -1,4 +1,5 @@
 #include <history.h>
+#include <perf.h>
 #ifdef NEWIO
 #include <snapshot/get_snap-ran.c>
 #else
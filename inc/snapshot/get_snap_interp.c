@@ -0,0 +1,263 @@
+/*
+ * GET_SNAP_INTERP.C: snapshot input at arbitrary times, interpolated
+ *	between the two snapshots in the stream that bracket each time.
+ *	Like get_snap.c this file is to be included at the source level,
+ *	after get_snap.c:
+ *
+ *	#include <snapshot/snapshot.h>
+ *	#include <snapshot/body.h>
+ *	#include <snapshot/get_snap.c>
+ *	#include <snapshot/get_snap_interp.c>
+ *
+ *	for (i=0; i<ntimes; i++)
+ *	    if (get_snap_interp(instr, &btab, &nbody, times[i], &bits) == 0)
+ *	        break;
+ *
+ * The requested times must not decrease. Each snapshot is read (with
+ * get_snap) only once, and kept as long as it brackets the requested
+ * times. Positions and velocities follow the cubic Hermite polynomial in
+ * time through the positions and velocities at both ends, or the quintic
+ * one if both snapshots also have accelerations. Bodies are paired by Key
+ * if both snapshots have keys, else by their index. Phi and Acc are
+ * linearly interpolated, all other body data are from the earlier
+ * snapshot. A body without partner drifts from the earlier snapshot.
+ *
+ * Returns 1 if the body table was filled for time tsnap, -1 if tsnap is
+ * before the first snapshot, and 0 if it is beyond the last one.
+ * *btptr is allocated if NULL, and reallocated if nbody grows.
+ *
+ *	19-oct-26  created                                  PJT
+ */
+
+#ifndef get_snap_interp
+
+#define get_snap_interp  _get_snap_interp
+
+local struct {
+    stream instr;		/* the stream being interpolated */
+    int    nframe;		/* number of snapshots in btab[] */
+    Body  *btab[2];		/* the bracketing snapshots */
+    int    nbody[2];
+    int    bits[2];
+    real   tsnap[2];
+    int   *pair;		/* [nbody[0]] partner in btab[1], or -1 */
+    bool   paired;		/* pair[] is for the current btab[] */
+} _gsi = { NULL, 0 };
+
+/*
+ * _GSI_READ: read the next snapshot with particles into _gsi.btab[1]
+ */
+
+local bool _gsi_read(void)
+{
+    Body *btab;
+    int nbody = 0, bits;
+    real tsnap;
+
+    for (;;) {
+	get_history(_gsi.instr);
+	if (!get_tag_ok(_gsi.instr, SnapShotTag))
+	    return FALSE;
+	btab = NULL;
+	get_snap(_gsi.instr, &btab, &nbody, &tsnap, &bits);
+	if ((bits & PhaseSpaceBit) == 0) {	/* diagnostics only */
+	    if (btab) free(btab);
+	    continue;
+	}
+	if ((bits & TimeBit) == 0)
+	    error("get_snap_interp: snapshot without time");
+	if (_gsi.nframe > 0 && tsnap <= _gsi.tsnap[1]) {
+	    warning("get_snap_interp: skipping snapshot at time %g", tsnap);
+	    free(btab);
+	    continue;
+	}
+	break;
+    }
+    if (_gsi.nframe == 2)
+	free(_gsi.btab[0]);
+    if (_gsi.nframe > 0) {
+	_gsi.btab[0]  = _gsi.btab[1];
+	_gsi.nbody[0] = _gsi.nbody[1];
+	_gsi.bits[0]  = _gsi.bits[1];
+	_gsi.tsnap[0] = _gsi.tsnap[1];
+    }
+    _gsi.btab[1]  = btab;
+    _gsi.nbody[1] = nbody;
+    _gsi.bits[1]  = bits;
+    _gsi.tsnap[1] = tsnap;
+    _gsi.nframe = MIN(_gsi.nframe+1, 2);
+    _gsi.paired = FALSE;
+    dprintf(1,"get_snap_interp: read snapshot at time %g\n", tsnap);
+    return TRUE;
+}
+
+#ifdef Key
+local int _gsi_cmpkey(const void *a, const void *b)
+{
+    int ka = ((int *)a)[0], kb = ((int *)b)[0];
+
+    return ka < kb ? -1 : (ka > kb ? 1 : ((int *)a)[1] - ((int *)b)[1]);
+}
+#endif
+
+/*
+ * _GSI_PAIR: pair the bodies of the two snapshots, by Key or by index
+ */
+
+local void _gsi_pair(void)
+{
+    int i, n0 = _gsi.nbody[0], n1 = _gsi.nbody[1];
+
+    _gsi.pair = (int *) reallocate(_gsi.pair, (size_t)n0 * sizeof(int));
+#ifdef Key
+    if (_gsi.bits[0] & _gsi.bits[1] & KeyBit) {
+	int *kb = (int *) allocate((size_t)n1 * 2 * sizeof(int));
+	int lo, hi, mid, k, nlost = 0;
+
+	for (i=0; i<n1; i++) {			/* (key,index) of snapshot 1 */
+	    kb[2*i]   = Key(_gsi.btab[1]+i);
+	    kb[2*i+1] = i;
+	}
+	qsort(kb, n1, 2*sizeof(int), _gsi_cmpkey);
+	for (i=0; i<n0; i++) {
+	    k = Key(_gsi.btab[0]+i);
+	    for (lo=0, hi=n1; lo < hi; ) {	/* first with key >= k */
+		mid = (lo+hi)/2;
+		if (kb[2*mid] < k) lo = mid+1; else hi = mid;
+	    }
+	    _gsi.pair[i] = (lo < n1 && kb[2*lo] == k) ? kb[2*lo+1] : -1;
+	    if (_gsi.pair[i] < 0) nlost++;
+	}
+	free(kb);
+	if (nlost)
+	    dprintf(1,"get_snap_interp: %d bodies at %g not found at %g\n",
+		    nlost, _gsi.tsnap[0], _gsi.tsnap[1]);
+	return;
+    }
+#endif
+    if (n0 != n1)
+	error("get_snap_interp: nbody changes from %d to %d, and no keys",
+	      n0, n1);
+    for (i=0; i<n0; i++)
+	_gsi.pair[i] = i;
+}
+
+local int _get_snap_interp(
+    stream instr,		/* input stream, of course */
+    Body **btptr,		/* pointer to body array */
+    int *nbptr,			/* pointer to number of bodies */
+    real tsnap,			/* time wanted */
+    int *ifptr)			/* pointer to output bit flags */
+{
+    Body *b0;
+    int  i, nbody;
+    bool hasacc = FALSE;
+    real h, s, dt;
+    real c0, c1, c2, c3, c4, c5;	/* x = c0 x0 + c1 h v0 + ... */
+    real d0, d1, d2, d3, d4, d5;	/* v = (d0 x0 + d1 h v0 + ...)/h */
+
+    if (instr != _gsi.instr) {		/* new stream: start over */
+	if (_gsi.nframe > 0) free(_gsi.btab[1]);
+	if (_gsi.nframe > 1) free(_gsi.btab[0]);
+	_gsi.instr = instr;
+	_gsi.nframe = 0;
+    }
+    if (_gsi.nframe == 0 && !_gsi_read())
+	return 0;
+    if (tsnap < _gsi.tsnap[_gsi.nframe == 2 ? 0 : 1])
+	return -1;
+    while (_gsi.nframe < 2 || tsnap > _gsi.tsnap[1]) {
+	if (_gsi.nframe == 1 && tsnap == _gsi.tsnap[1])
+	    break;			/* exactly the first (or only) one */
+	if (!_gsi_read())
+	    return 0;
+    }
+    if (_gsi.nframe == 1) {		/* no interval yet: just copy */
+	b0 = _gsi.btab[1];
+	nbody = _gsi.nbody[1];
+	if (*btptr == NULL || nbody > *nbptr)
+	    *btptr = (Body *) reallocate(*btptr, (size_t)nbody * sizeof(Body));
+	memcpy(*btptr, b0, (size_t)nbody * sizeof(Body));
+	*nbptr = nbody;
+	*ifptr = _gsi.bits[1];
+	return 1;
+    }
+    if (!_gsi.paired) {
+	_gsi_pair();
+	_gsi.paired = TRUE;
+    }
+
+    nbody = _gsi.nbody[0];
+    if (*btptr == NULL || nbody > *nbptr)
+	*btptr = (Body *) reallocate(*btptr, (size_t)nbody * sizeof(Body));
+    *nbptr = nbody;
+
+    h  = _gsi.tsnap[1] - _gsi.tsnap[0];
+    dt = tsnap - _gsi.tsnap[0];
+    s  = dt / h;
+#ifdef Acc
+    hasacc = (_gsi.bits[0] & _gsi.bits[1] & AccelerationBit) != 0;
+#endif
+    if (hasacc) {			/* quintic Hermite */
+	c0 = 1 + s*s*s*(-10 + s*(15 - 6*s));
+	c1 = s + s*s*s*(-6 + s*(8 - 3*s));
+	c2 = s*s*(0.5 + s*(-1.5 + s*(1.5 - 0.5*s)));
+	c3 = s*s*s*(0.5 + s*(-1 + 0.5*s));
+	c4 = s*s*s*(-4 + s*(7 - 3*s));
+	c5 = 1 - c0;
+	d0 = s*s*(-30 + s*(60 - 30*s));
+	d1 = 1 + s*s*(-18 + s*(32 - 15*s));
+	d2 = s*(1 + s*(-4.5 + s*(6 - 2.5*s)));
+	d3 = s*s*(1.5 + s*(-4 + 2.5*s));
+	d4 = s*s*(-12 + s*(28 - 15*s));
+	d5 = -d0;
+    } else {				/* cubic Hermite */
+	c0 = 1 + s*s*(-3 + 2*s);
+	c1 = s + s*s*(-2 + s);
+	c4 = s*s*(-1 + s);
+	c5 = 1 - c0;
+	d0 = s*(-6 + 6*s);
+	d1 = 1 + s*(-4 + 3*s);
+	d4 = s*(-2 + 3*s);
+	d5 = -d0;
+	c2 = c3 = d2 = d3 = 0.0;
+    }
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (i=0; i<nbody; i++) {
+	Body *bp = *btptr + i, *p0 = _gsi.btab[0] + i, *p1;
+	int  k;
+
+	*bp = *p0;
+	if (_gsi.pair[i] < 0) {		/* lost: drift */
+	    for (k=0; k<NDIM; k++)
+		Pos(bp)[k] += dt * Vel(p0)[k];
+	    continue;
+	}
+	p1 = _gsi.btab[1] + _gsi.pair[i];
+	for (k=0; k<NDIM; k++) {
+	    Pos(bp)[k] = c0*Pos(p0)[k] + c5*Pos(p1)[k]
+		       + h*(c1*Vel(p0)[k] + c4*Vel(p1)[k]);
+	    Vel(bp)[k] = (d0*Pos(p0)[k] + d5*Pos(p1)[k]) / h
+		       + d1*Vel(p0)[k] + d4*Vel(p1)[k];
+#ifdef Acc
+	    if (hasacc) {
+		Pos(bp)[k] += h*h*(c2*Acc(p0)[k] + c3*Acc(p1)[k]);
+		Vel(bp)[k] += h*(d2*Acc(p0)[k] + d3*Acc(p1)[k]);
+		Acc(bp)[k] = (1-s)*Acc(p0)[k] + s*Acc(p1)[k];
+	    }
+#endif
+	}
+#ifdef Phi
+	if (_gsi.bits[0] & _gsi.bits[1] & PotentialBit)
+	    Phi(bp) = (1-s)*Phi(p0) + s*Phi(p1);
+#endif
+    }
+    *ifptr = TimeBit | (_gsi.bits[0] & ~(PotentialBit|AccelerationBit))
+		     | (_gsi.bits[0] & _gsi.bits[1] & (PotentialBit|AccelerationBit));
+    return 1;
+}
+
+#endif
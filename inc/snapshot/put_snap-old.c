@@ -442,12 +442,14 @@ real *tsptr;			/* pointer to time of output */
 int *ofptr;			/* pointer to output bit flags */
 {
     if (ofptr) {
+	perf_start("put_snap");
 	put_set(outstr, SnapShotTag);
 	put_snap_param(outstr, btptr, nbptr, tsptr, ofptr);
 	put_snap_body(outstr, btptr, nbptr, ofptr);
 	put_snap_diagnostics(outstr, ofptr);
 	put_tes(outstr, SnapShotTag);
 	fflush(outstr);
+	perf_stop("put_snap");
     }
 }
 
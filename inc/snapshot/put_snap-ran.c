@@ -454,12 +454,14 @@ int *ofptr;			/* pointer to output bit flags */
         first_io_put = 0;
     }
 #endif
+	perf_start("put_snap");
 	put_set(outstr, SnapShotTag);
 	put_snap_param(outstr, btptr, nbptr, tsptr, ofptr);
 	put_snap_body(outstr, btptr, nbptr, ofptr);
 	put_snap_diagnostics(outstr, ofptr);
 	put_tes(outstr, SnapShotTag);
 	fflush(outstr);
+	perf_stop("put_snap");
     }
 }
 
@@ -1,4 +1,4 @@
-
+#include <perf.h>
 #ifdef NEWIO
 #include <snapshot/put_snap-ran.c>
 #else
@@ -0,0 +1,79 @@
+/*
+ * SNAPCOL.H: columnar (structure of arrays) snapshot in memory,
+ *            an alternative to the Body array of get_snap/put_snap.
+ *            Each quantity is kept as its own contiguous column, and only
+ *            columns actually present (or asked for) are allocated.
+ *            See snapcol.c and snapcol(3NEMO).
+ *
+ *	19-oct-2026	created					PJT
+ */
+
+#ifndef _snapcol_h
+#define _snapcol_h
+
+#include <snapshot/snapshot.h>
+#include <snapshot/body.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * as in body.h the members have a leading underscore, since <bodytrans.h>
+ * claims names like pos and phi; use the accessor macros below
+ */
+
+typedef struct _snapcol {
+    int   nbody;        /* number of bodies                          */
+    int   maxbody;      /* allocated length of the columns           */
+    int   bits;         /* columns present, the usual snapshot bits  */
+    real  time;         /* time of snapshot (TimeBit)                */
+    real *_mass;        /* [nbody]                    MassBit        */
+    real *_pos;         /* [nbody][NDIM]              PosBit         */
+    real *_vel;         /* [nbody][NDIM]              VelBit         */
+    real *_phi;         /* [nbody]                    PotentialBit   */
+    real *_acc;         /* [nbody][NDIM]              AccelerationBit*/
+    real *_aux;         /* [nbody]                    AuxBit         */
+    int  *_key;         /* [nbody]                    KeyBit         */
+    real *_dens;        /* [nbody]                    DensBit        */
+    real *_eps;         /* [nbody]                    EpsBit         */
+} snapcol, *snapcolptr;
+
+/* whole columns */
+
+#define SCMassCol(sc)  ((sc)->_mass)
+#define SCPosCol(sc)   ((sc)->_pos)
+#define SCVelCol(sc)   ((sc)->_vel)
+#define SCPhiCol(sc)   ((sc)->_phi)
+#define SCAccCol(sc)   ((sc)->_acc)
+#define SCAuxCol(sc)   ((sc)->_aux)
+#define SCKeyCol(sc)   ((sc)->_key)
+#define SCDensCol(sc)  ((sc)->_dens)
+#define SCEpsCol(sc)   ((sc)->_eps)
+
+/* single bodies, i is the body index; the vectors are real[NDIM] */
+
+#define SCMass(sc,i)   ((sc)->_mass[i])
+#define SCPos(sc,i)    ((sc)->_pos + NDIM*(size_t)(i))
+#define SCVel(sc,i)    ((sc)->_vel + NDIM*(size_t)(i))
+#define SCPhi(sc,i)    ((sc)->_phi[i])
+#define SCAcc(sc,i)    ((sc)->_acc + NDIM*(size_t)(i))
+#define SCAux(sc,i)    ((sc)->_aux[i])
+#define SCKey(sc,i)    ((sc)->_key[i])
+#define SCDens(sc,i)   ((sc)->_dens[i])
+#define SCEps(sc,i)    ((sc)->_eps[i])
+
+extern void  snapcol_init(snapcolptr sc);
+extern void  snapcol_free(snapcolptr sc);
+extern void  snapcol_alloc(snapcolptr sc, int nbody, int bits);
+extern int   get_snapcol(stream instr, snapcolptr sc, int want);
+extern void  put_snapcol(stream outstr, snapcolptr sc);
+extern void  snapcol_body(snapcolptr sc, int i, Body *bp);
+extern void  snapcol_bodytrans(snapcolptr sc, btrproc f, real *out);
+extern void  snapcol_bodytrans_int(snapcolptr sc, btiproc f, int *out);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -640,6 +640,14 @@ extern void bswap_bigend(void *vdat, int len, int cnt);
 #define bswapi(p,cnt)  bswap(p,sizeof(int),cnt)
 #define bswaps(p,cnt)  bswap(p,sizeof(short),cnt)
 
+  /* io/convert.c */
+extern int convert_d2f(size_t n, double *from, float  *to);
+extern int convert_f2d(size_t n, float  *from, double *to);
+extern int convert_h2f(size_t n, halfp  *from, float  *to);
+extern int convert_h2d(size_t n, halfp  *from, double *to);
+extern int convert_f2h(size_t n, float  *from, halfp  *to);
+extern int convert_d2h(size_t n, double *from, halfp  *to);
+
   /* misc/within.c */
 extern bool within(double val, string range, double fuzz);
 
@@ -0,0 +1,328 @@
+#
+# NEMO structured binary files, read directly in python
+#       19-oct-2026   numeric items are numpy arrays backed by a memory map   PJT
+#
+# The file format is written by src/kernel/io/filesecret.c: a sequence of
+# items, each with a header
+#       short      magic         SingMagic or PlurMagic (writer's byte order)
+#       char[]     type          0-terminated, e.g. "d" or "(" for a set
+#       char[]     tag           0-terminated, absent for a tes ")"
+#       int[]      dims          0-terminated, only for PlurMagic
+# followed by the data, unless it is a set "(" ... tes ")" of other items.
+#
+# Example:
+#       from nemopy import filestruct
+#       for s in filestruct.snapshots("run1.snap"):
+#           print(s.time, s.nbody, s.pos.mean(axis=0))
+#
+# things to think about:
+#   - pipes (e.g. "-") cannot be memory mapped, save them to a file first
+#   - arrays keep the map alive, so the file stays open until they are gone
+
+import mmap
+import os
+import struct
+import sys
+
+import numpy as np
+
+SingMagic = (0o11 << 8) + 0o222      # singular items
+PlurMagic = (0o13 << 8) + 0o222      # plural items
+
+SetType = '('
+TesType = ')'
+
+# filestruct type -> numpy type code, see tl_tab[] in filesecret.c
+_dtypes = {
+    'a': 'u1',        # AnyType
+    'c': 'S1',        # CharType
+    'b': 'u1',        # ByteType
+    's': 'i2',        # ShortType
+    'i': 'i4',        # IntType
+    'l': 'i8',        # LongType
+    'h': 'f2',        # HalfpType
+    'f': 'f4',        # FloatType
+    'd': 'f8',        # DoubleType
+}
+
+
+class Item(object):
+    """
+    One item of a structured file. A set (type "(") has its items in
+    .items, all others have their data, a numpy view of the file, in .data
+    """
+    def __init__(self, sf, typ, tag, dims, offset, endian):
+        self._sf = sf
+        self.type = typ
+        self.tag = tag
+        self.dims = dims              # None for a singular item
+        self.offset = offset          # byte offset of the data in the file
+        self.endian = endian          # '<' or '>'
+        self.items = []
+
+    def is_set(self):
+        return self.type == SetType
+
+    @property
+    def size(self):
+        """number of elements"""
+        if self.is_set():
+            return 0
+        n = 1
+        for d in self.dims or []:
+            n = n * d
+        return n
+
+    @property
+    def nbytes(self):
+        if self.is_set():
+            return 0
+        return self.size * np.dtype(_dtypes[self.type]).itemsize
+
+    @property
+    def data(self):
+        """numpy array (no copy) of the item, in C order as in the file"""
+        if self.is_set():
+            raise TypeError("set %s has no data, see .items" % self.tag)
+        dt = np.dtype(_dtypes[self.type]).newbyteorder(self.endian)
+        a = np.frombuffer(self._sf._mm, dtype=dt, count=self.size, offset=self.offset)
+        if self.dims is None:
+            return a.reshape(())
+        return a.reshape(self.dims)
+
+    @property
+    def value(self):
+        """python value: a string for characters, a scalar for singular items, else .data"""
+        if self.type == 'c':
+            return self.data.tobytes().split(b'\0')[0].decode('latin-1')
+        if self.dims is None:
+            return self.data.item()
+        return self.data
+
+    def tags(self):
+        return [i.tag for i in self.items]
+
+    def get(self, tag, default=None):
+        for i in self.items:
+            if i.tag == tag:
+                return i
+        return default
+
+    def __getitem__(self, tag):
+        i = self.get(tag)
+        if i is None:
+            raise KeyError("%s not in %s" % (tag, self.tag))
+        return i
+
+    def __contains__(self, tag):
+        return self.get(tag) is not None
+
+    def __iter__(self):
+        return iter(self.items)
+
+    def __repr__(self):
+        if self.is_set():
+            return "Item(set %s, %d items)" % (self.tag, len(self.items))
+        return "Item(%s %s %s)" % (self.type, self.tag, self.dims)
+
+
+class StructFile(object):
+    """
+    A structured file, memory mapped. Iterating over it parses one top level
+    item at a time, so very long files (many snapshots) can be streamed.
+    """
+    def __init__(self, filename):
+        self.filename = filename
+        self._f = open(filename, 'rb')
+        self._len = os.fstat(self._f.fileno()).st_size
+        if self._len == 0:
+            raise ValueError("%s: empty file" % filename)
+        self._mm = mmap.mmap(self._f.fileno(), 0, access=mmap.ACCESS_READ)
+        self._items = None
+
+    def close(self):
+        try:
+            self._mm.close()
+        except BufferError:           # arrays still use it, leave it to them
+            pass
+        self._f.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def _xstr(self, pos, size, endian):
+        """0-terminated string of elements, as getxstr() in filesecret.c"""
+        if size == 1:
+            end = self._mm.find(b'\0', pos)
+            if end < 0:
+                raise EOFError("%s: EOF in header at %d" % (self.filename, pos))
+            return self._mm[pos:end].decode('latin-1'), end + 1
+        fmt = endian + 'i'
+        vals = []
+        while True:
+            if pos + size > self._len:
+                raise EOFError("%s: EOF in dimensions at %d" % (self.filename, pos))
+            v = struct.unpack_from(fmt, self._mm, pos)[0]
+            pos = pos + size
+            if v == 0:
+                return vals, pos
+            vals.append(v)
+
+    def _read_item(self, pos):
+        """parse the item at pos, returns (item, next pos), item is None for a tes"""
+        if pos + 2 > self._len:
+            return None, -1
+        for endian in '<>':
+            magic = struct.unpack_from(endian + 'h', self._mm, pos)[0]
+            if magic in (SingMagic, PlurMagic):
+                break
+        else:
+            raise ValueError("%s: bad magic at %d" % (self.filename, pos))
+        typ, pos = self._xstr(pos + 2, 1, endian)
+        if typ == TesType:
+            return None, pos
+        if typ != SetType and typ not in _dtypes:
+            raise ValueError("%s: unknown type %s at %d" % (self.filename, typ, pos))
+        tag, pos = self._xstr(pos, 1, endian)
+        dims = None
+        if magic == PlurMagic:
+            dims, pos = self._xstr(pos, 4, endian)
+        item = Item(self, typ, tag, dims, pos, endian)
+        if typ == SetType:
+            while True:
+                sub, pos = self._read_item(pos)
+                if sub is None:
+                    if pos < 0:
+                        raise EOFError("%s: EOF in set %s" % (self.filename, tag))
+                    break
+                item.items.append(sub)
+        else:
+            pos = pos + item.nbytes
+            if pos > self._len:
+                raise EOFError("%s: item %s truncated" % (self.filename, tag))
+        return item, pos
+
+    def __iter__(self):
+        if self._items is not None:
+            for i in self._items:
+                yield i
+            return
+        pos = 0
+        while pos < self._len:
+            item, pos = self._read_item(pos)
+            if item is None:
+                break
+            yield item
+
+    @property
+    def items(self):
+        """all top level items"""
+        if self._items is None:
+            self._items = list(iter(self))
+        return self._items
+
+    def tags(self):
+        return [i.tag for i in self.items]
+
+    def __getitem__(self, tag):
+        for i in self.items:
+            if i.tag == tag:
+                return i
+        raise KeyError("%s not in %s" % (tag, self.filename))
+
+    def frames(self, tag='SnapShot'):
+        """iterate over the top level items with this tag"""
+        for i in self:
+            if i.tag == tag:
+                yield i
+
+    def list(self, out=sys.stdout):
+        """an overview, somewhat like tsf(1NEMO)"""
+        def _list(item, indent):
+            if item.is_set():
+                out.write("%sset %s\n" % (indent, item.tag))
+                for i in item.items:
+                    _list(i, indent + "  ")
+                out.write("%stes\n" % indent)
+            elif item.type == 'c':
+                out.write("%schar %s \"%s\"\n" % (indent, item.tag, item.value))
+            else:
+                out.write("%s%s %s %s\n" % (indent, _dtypes[item.type], item.tag,
+                                            item.dims if item.dims else item.value))
+        for i in self:
+            _list(i, "")
+
+
+class Snapshot(object):
+    """
+    Convenience access to a SnapShot set, see snapshot.h. The particle
+    arrays are views of the file; absent ones are None.
+    """
+    def __init__(self, item):
+        self.item = item
+        p = item.get('Parameters')
+        self.nbody = p['Nobj'].value if p is not None and 'Nobj' in p else 0
+        self.time = p['Time'].value if p is not None and 'Time' in p else None
+        self.particles = item.get('Particles')
+
+    def _get(self, tag):
+        if self.particles is None or tag not in self.particles:
+            return None
+        return self.particles[tag].data
+
+    @property
+    def mass(self):
+        return self._get('Mass')
+
+    @property
+    def pos(self):
+        if self.particles is not None and 'Position' in self.particles:
+            return self._get('Position')
+        ps = self._get('PhaseSpace')
+        return None if ps is None else ps[:, 0, :]
+
+    @property
+    def vel(self):
+        if self.particles is not None and 'Velocity' in self.particles:
+            return self._get('Velocity')
+        ps = self._get('PhaseSpace')
+        return None if ps is None else ps[:, 1, :]
+
+    @property
+    def phi(self):
+        return self._get('Potential')
+
+    @property
+    def acc(self):
+        return self._get('Acceleration')
+
+    @property
+    def aux(self):
+        return self._get('Aux')
+
+    @property
+    def key(self):
+        return self._get('Key')
+
+    @property
+    def dens(self):
+        return self._get('Density')
+
+    @property
+    def eps(self):
+        return self._get('Eps')
+
+
+def snapshots(filename):
+    """iterate over the snapshots in a file"""
+    sf = StructFile(filename)
+    for s in sf.frames('SnapShot'):
+        yield Snapshot(s)
+
+
+if __name__ == '__main__':
+    for f in sys.argv[1:]:
+        StructFile(f).list()
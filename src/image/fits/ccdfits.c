@@ -45,6 +45,7 @@
  *      14-jun-19   6.0a correct VSYS when in freq=t mode, fix cdelt1 in one common case
  *      19-jun-19   6.1  Output now in km/s
  *      27-dec-20   6.3  fitshead= header template keyword 
+ *      19-oct-26   6.7  planeio=: whole planes, converted in parallel
  *
  *  TODO:
  *      reference mapping has not been well tested, especially for 2D
@@ -94,7 +95,8 @@ string defv[] = {
 	"select=1\n      Which image (if more than 1 present, 1=first) to select",
 	"blank=\n        If set, use this is the BLANK value in FITS (usual NaN)",
 	"fitshead=\n     If used, the header of this file is used instead",
-        "VERSION=6.6\n   31-dec-2022 PJT",
+	"planeio=t\n      Convert and write whole planes in parallel, instead of row by row",
+        "VERSION=6.7\n   19-oct-2026 PJT",
         NULL,
 };
 
@@ -121,6 +123,7 @@ bool Qcrval, Qcdelt, Qcrpix;
 bool Qdummy;             /* write dummy axes ? */
 bool Qblank;
 bool Qfitshead; 
+bool Qplane;             /* whole plane I/O ? */
 real blankval;
 int  nrefaxis, refaxis[4];
 bool Qrefaxis[4];
@@ -137,6 +140,7 @@ real  equinox = 2000.0;
 
 void setparams(void);
 void write_fits(string,imageptr);
+void write_planes(FITS *, imageptr, int *, FLOAT);
 void stuffit(FITS *, string, string);
 void set_refmap(string);
 void permute(int *x ,int *idx, int n);
@@ -219,6 +223,10 @@ void setparams(void)
   Qblank    = hasvalue("blank");
   if (Qblank) blankval = getrparam("blank");
   Qfitshead = hasvalue("fitshead");
+  Qplane    = getbparam("planeio");
+#ifdef HAVE_LIBCFITSIO
+  Qplane    = FALSE;
+#endif
 
   
   Qrefmap = hasvalue("refmap");
@@ -567,6 +575,11 @@ void write_fits(string name, imageptr iptr)
     for(i=0; i<nfill; i++)   /* debugging header I/O */
         fitwra(fitsfile,"COMMENT","Dummy filler space");
 
+    if (Qplane) {
+      write_planes(fitsfile, iptr, nx_out, fnan);
+      fitclose(fitsfile);
+      return;
+    }
     buffer = (float *) allocate(nx[p[0]]*sizeof(float));
 
     for (k=0; k<nx_out[2]; k++) {          /* loop over all planes */
@@ -585,6 +598,38 @@ void write_fits(string name, imageptr iptr)
     fitclose(fitsfile);
 }
 
+/*
+ * WRITE_PLANES: the same as the row by row loop at the end of write_fits(),
+ *               but each plane is filled in parallel and written with a
+ *               single (parallel converted) fitwrpix()
+ */
+
+void write_planes(FITS *fitsfile, imageptr iptr, int *nx_out, FLOAT fnan)
+{
+    size_t nxy = (size_t)nx_out[0]*nx_out[1];
+    FLOAT *plane = (FLOAT *) allocate(nxy*sizeof(FLOAT));
+    int j, k;
+
+    for (k=0; k<nx_out[2]; k++) {
+        fitsetpl(fitsfile,1,&k);          /* header and plane bounds */
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+        for (j=0; j<nx_out[1]; j++) {
+	  FLOAT *bp = &plane[(size_t)j*nx_out[0]];
+	  int i;
+	  for (i=0; i<nx_out[0]; i++, bp++) {
+	    if (Qblank && CubeValue(iptr,i,j,k) == blankval)
+	      *bp = fnan;
+	    else
+	      *bp =  iscale[0] * CubeValue(iptr,i,j,k) + iscale[1];
+	  }
+	}
+        fitwrpix(fitsfile, k*nxy, nxy, plane);
+    }
+    free(plane);
+}
+
 
 /*
 
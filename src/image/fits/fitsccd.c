@@ -40,6 +40,7 @@
  *      23-nov-04        4.9  deal with axistype 1 images, but forced keyword   pjt
  *       3-dec-2013      5.0  showcs option      pjt
  *      18-feb-2015      5.1  add box=           pjt
+ *      19-oct-2026      5.7  planeio=: mmap'd whole planes, converted in parallel  pjt
  */
 
 #include <stdinc.h>
@@ -69,7 +70,8 @@ string defv[] = {
     "relcoords=f\n      Use relative (to crpix) coordinates instead abs",
     "axistype=1\n       Force axistype 0 (old, crpix==1) or 1 (new, crpix as is)",
     "altr=f\n           Switch to ALTR wcs",
-    "VERSION=5.6\n	22-jul-2024 PJT",
+    "planeio=t\n        Convert whole (mmap'd) planes in parallel, instead of row by row",
+    "VERSION=5.7\n	19-oct-2026 PJT",
     NULL,
 };
 
@@ -82,6 +84,8 @@ void make_rawheader(FITS *fitsfile, imageptr iptr, bool Qrel);
 FITS *rawopen(string name, string status, int naxis, int *nsize);
 void print_axis(int axis, int naxis, real crpix, real crval, real cdelt);
 int is_feq(int *a, int *b);
+local int planeio_fits(FITS *fitsfile, imageptr iptr, int npl, int *planes, int nbox, int *box,
+		       FLOAT bval_in, real bval_out, real *rmin, real *rmax);
 
 void nemo_main()
 {
@@ -97,7 +101,7 @@ void nemo_main()
     int mir_nan = -1;    /* MIRIAD's FITS NaN */
     imageptr iptr;
     string mode, blankval;
-    bool   Qblank, Qrel, Qout, Qaltr;
+    bool   Qblank, Qrel, Qout, Qaltr, Qplane;
     int axistype = getiparam("axistype");
 
     Qout = hasvalue("out");
@@ -119,6 +123,10 @@ void nemo_main()
     Qblank = (*blankval != 0);
     Qrel = getbparam("relcoords");
     Qaltr = getbparam("altr");
+    Qplane = getbparam("planeio");
+#ifdef HAVE_LIBCFITSIO
+    Qplane = FALSE;
+#endif
     get_nanf(&fnan);
 #if 1
     memcpy(&fnan,&mir_nan,sizeof(int));    /* PORTABILITY ! */
@@ -171,45 +179,49 @@ void nemo_main()
 	bval_in = (FLOAT) getdparam("blank");
       dprintf(0,"Substituting blank=%g [%s] with %g\n",
 	      bval_in,blankval,bval_out);
-    }
-
-
-    buffer = (FLOAT *) allocate(naxis[0]*sizeof(FLOAT));
+    } else
+      bval_in = fnan;
 
     rmin = HUGE;
     rmax = -HUGE;
-    for (k=0; k<nz; k++) {          /* loop over all/selected planes */
-      p = (npl>0) ? planes[k] : k;        /* select plane number */
-      dprintf(2,"Reading plane %d\n",p);
-      fitsetpl(fitsfile,1,&p);
-      for (j=0; j<ny; j++) {      /* loop over all rows */
-	j0 = (nbox == 0 ? j : j+box[1]-1);
-	fitread(fitsfile,j0,buffer);     /* read it from fits file */
-	i0 = (nbox == 0 ? 0 : box[0]-1);
-	for (i=0, bp=&buffer[i0]; i<nx; i++, bp++) {   /* stuff it in memory */
-	  if (Qblank) {
-	    if (is_feq((int *)bp,(int *)&bval_in)) {
-	      nbval++;
-	      *bp = bval_out;
-	    } else if (isnan(*bp)) {
-	      nbval++;
-	      *bp = bval_out;
-	    }
-	  } else {
-	    if (is_feq((int *)bp,(int *)&fnan)) {
-	      nbval++;
-	      *bp = bval_out;
-	    } else if (isnan(*bp)) {
-	      nbval++;
-	      *bp = bval_out;
+    if (Qplane)
+      nbval = planeio_fits(fitsfile,iptr,npl,planes,nbox,box,bval_in,bval_out,&rmin,&rmax);
+    else {
+      buffer = (FLOAT *) allocate(naxis[0]*sizeof(FLOAT));
+      for (k=0; k<nz; k++) {          /* loop over all/selected planes */
+	p = (npl>0) ? planes[k] : k;        /* select plane number */
+	dprintf(2,"Reading plane %d\n",p);
+	fitsetpl(fitsfile,1,&p);
+	for (j=0; j<ny; j++) {      /* loop over all rows */
+	  j0 = (nbox == 0 ? j : j+box[1]-1);
+	  fitread(fitsfile,j0,buffer);     /* read it from fits file */
+	  i0 = (nbox == 0 ? 0 : box[0]-1);
+	  for (i=0, bp=&buffer[i0]; i<nx; i++, bp++) {   /* stuff it in memory */
+	    if (Qblank) {
+	      if (is_feq((int *)bp,(int *)&bval_in)) {
+		nbval++;
+		*bp = bval_out;
+	      } else if (isnan(*bp)) {
+		nbval++;
+		*bp = bval_out;
+	      }
+	    } else {
+	      if (is_feq((int *)bp,(int *)&fnan)) {
+		nbval++;
+		*bp = bval_out;
+	      } else if (isnan(*bp)) {
+		nbval++;
+		*bp = bval_out;
+	      }
+	      dprintf(2,"%g %g %g %g, %d\n",*bp,fdata_min, fdata_max,fnan,nbval); 
 	    }
-	    dprintf(2,"%g %g %g %g, %d\n",*bp,fdata_min, fdata_max,fnan,nbval); 
+	    tmp = CubeValue(iptr,i,j,k) = *bp;
+	    rmin=MIN(rmin,tmp);
+	    rmax=MAX(rmax,tmp);
 	  }
-	  tmp = CubeValue(iptr,i,j,k) = *bp;
-	  rmin=MIN(rmin,tmp);
-	  rmax=MAX(rmax,tmp);
 	}
       }
+      free(buffer);
     }
     if (rmin != MapMin(iptr)) {
       warning("Setting map minimum from %g to %g",MapMin(iptr),rmin);
@@ -224,12 +236,73 @@ void nemo_main()
     if (nbval==0)
       dprintf(0,"There were no blank values set in the image\n");
     else {
-      fbval = (1.0*nbval)/(nx*ny*nz);
+      fbval = (1.0*nbval)/((double)nx*ny*nz);
       dprintf(0,"There were %d blank values in the image (%f %%)\n",nbval,fbval*100);
     }
-    free(buffer);
 }
 
+/*
+ * PLANEIO_FITS: read whole planes (directly from the mmap'd file if possible)
+ *               and convert them in parallel into the image, with the same
+ *               blank substitution as the row by row loop in nemo_main().
+ *               Returns the number of blanks, and updates rmin/rmax.
+ */
+
+#ifdef HAVE_LIBCFITSIO
+local int planeio_fits(FITS *fitsfile, imageptr iptr, int npl, int *planes, int nbox, int *box,
+		       FLOAT bval_in, real bval_out, real *rmin, real *rmax)
+{
+  error("planeio not implemented for CFITSIO");
+  return 0;
+}
+#else
+local int planeio_fits(FITS *fitsfile, imageptr iptr, int npl, int *planes, int nbox, int *box,
+		       FLOAT bval_in, real bval_out, real *rmin, real *rmax)
+{
+    int j, k, p, nx = Nx(iptr), ny = Ny(iptr), nz = Nz(iptr);
+    int nx_in = fitsfile->axes[0], i0, j0, nbval = 0;
+    size_t nxy_in = (size_t)nx_in * fitsfile->axes[1];
+    real dmin = *rmin, dmax = *rmax;
+    FLOAT *plane;
+
+    if (fitmap(fitsfile))
+      dprintf(1,"planeio: reading from mmap'd file\n");
+    i0 = (nbox == 0 ? 0 : box[0]-1);
+    j0 = (nbox == 0 ? 0 : box[1]-1);
+    if (i0 < 0 || j0 < 0 || i0+nx > nx_in || j0+ny > fitsfile->axes[1])
+      error("box=%d,%d,%d,%d outside the image",i0+1,j0+1,i0+nx,j0+ny);
+    plane = (FLOAT *) allocate(nxy_in*sizeof(FLOAT));
+    for (k=0; k<nz; k++) {
+      p = (npl>0) ? planes[k] : k;
+      if (p < 0 || p >= fitsfile->axes[2]) error("plane %d not in cube",p);
+      dprintf(2,"Reading plane %d\n",p);
+      fitrdpix(fitsfile, p*nxy_in, nxy_in, plane);
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(+:nbval) reduction(min:dmin) reduction(max:dmax)
+#endif
+      for (j=0; j<ny; j++) {            /* 'private' is a macro in fitsio_nemo.h */
+	FLOAT *bp = &plane[(size_t)(j+j0)*nx_in + i0];
+	real tmp;
+	int i;
+	for (i=0; i<nx; i++, bp++) {
+	  if (is_feq((int *)bp,(int *)&bval_in) || isnan(*bp)) {
+	    nbval++;
+	    tmp = bval_out;
+	  } else
+	    tmp = *bp;
+	  CubeValue(iptr,i,j,k) = tmp;
+	  dmin = MIN(dmin,tmp);
+	  dmax = MAX(dmax,tmp);
+	}
+      }
+    }
+    free(plane);
+    *rmin = dmin;
+    *rmax = dmax;
+    return nbval;
+}
+#endif
+
 #ifdef HAVE_LIBCFITSIO
 FITS *rawopen(string name, string status, int naxis, int *nsize)
 {
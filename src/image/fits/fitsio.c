@@ -59,6 +59,8 @@
 /*    11-dec-06 store cvsID in output                                   */
 /*     7-nov-22 CFITSIO version in fitsio_nemo.c is now the default     */
 /*    10-feb-24 fixed types of offset,length for large images           */
+/*    19-oct-26 added fitmap/fitrdpix/fitwrpix: mmap'd, parallel        */
+/*              conversion of whole planes                              */
 /* ToDo:                                                                */
 /*  - BLANK substitution                                                */
 /*  - deal with pipes                                                   */
@@ -67,6 +69,9 @@
 #include <stdinc.h>
 #include <ctype.h>
 #include <fitsio_nemo.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 /* 
  * this next #def's obviously needs to be refined. 
@@ -320,6 +325,7 @@ void fitclose(FITS *file)
     offset += blocksize*((80*f->ncards + (blocksize-1))/blocksize);
     fitpad(f,offset,0);
   }
+  if (f->map) munmap(f->map, f->maplen);
   strclose(f->fd);
   free((char *)f);
 }
@@ -508,6 +514,260 @@ void fitwrite(FITS *file, int j, FLOAT *data)
     error("I/O write error in fitwrite");
 }
 /**********************************************************************/
+int fitmap(FITS *file)
+/*
+  This maps an old FITS file into memory, after which fitrdpix reads
+  directly from the mapped data segment instead of via fread.
+
+  Input:
+    file        The pointer returned by fitopen.
+  Output:
+    fitmap      1 if the file was mapped, 0 if not (e.g. a pipe), in which
+                case fitrdpix falls back to normal reads.
+----------------------------------------------------------------------*/
+{
+  FITS *f = file;
+  struct stat st;
+  size_t need;
+  int i;
+  void *p;
+
+  if (f->map) return 1;
+  if (f->status != STATUS_OLD) return 0;
+  if (fstat(fileno(f->fd),&st) < 0 || !S_ISREG(st.st_mode)) return 0;
+  need = f->bytepix;
+  for(i=0; i < f->naxis; i++) need *= f->axes[i];
+  need += f->skip;
+  if ((size_t)st.st_size < need) {
+    warning("fitmap: file too small (%ld < %ld)",(long)st.st_size,(long)need);
+    return 0;
+  }
+  p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fileno(f->fd), 0);
+  if (p == MAP_FAILED) {
+    dprintf(1,"fitmap: mmap failed, using fread\n");
+    return 0;
+  }
+#ifdef MADV_SEQUENTIAL
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+#endif
+  f->map = (char *) p;
+  f->maplen = st.st_size;
+  dprintf(1,"fitmap: mapped %ld bytes\n",(long)f->maplen);
+  return 1;
+}
+/**********************************************************************/
+/* big endian (FITS) to host, independent of the host byte order      */
+
+#define FIT_GET16(p) ((short int)(((p)[0]<<8) | (p)[1]))
+#define FIT_GET32(p) ((int)(((unsigned int)(p)[0]<<24) | ((unsigned int)(p)[1]<<16) | \
+                            ((unsigned int)(p)[2]<<8)  |  (unsigned int)(p)[3]))
+
+local inline unsigned long long fit_get64(const byte *p)
+{
+  unsigned long long u = 0;
+  int k;
+  for (k=0; k<8; k++) u = (u<<8) | p[k];
+  return u;
+}
+
+local inline void fit_put32(byte *p, unsigned int u)
+{
+  p[0] = u>>24;  p[1] = u>>16;  p[2] = u>>8;  p[3] = u;
+}
+
+local inline void fit_put64(byte *p, unsigned long long u)
+{
+  int k;
+  for (k=7; k>=0; k--) { p[k] = u & 0xff; u >>= 8; }
+}
+
+local char  *rawbuf = NULL;             /* fread/fwrite buffer for the pix routines */
+local size_t rawlen = 0;
+
+local char *fitrawbuf(size_t len)
+{
+  if (len > rawlen) {
+    rawbuf = (char *) reallocate(rawbuf, len);
+    rawlen = len;
+  }
+  return rawbuf;
+}
+/**********************************************************************/
+void fitrdpix(FITS *file, size_t offset, size_t n, FLOAT *data)
+/*
+  This reads n consecutive pixels, e.g. a whole plane, of an old FITS
+  file. The conversion (byte swap, BSCALE/BZERO) is done in parallel
+  if compiled with OpenMP, and gives the same values as fitread.
+
+  Input:
+    file        The pointer returned by fitopen (and optionally fitmap).
+    offset      The first pixel, counted from the start of the data.
+    n           Number of pixels to read.
+  Output:
+    data        A FLOAT array of n elements.
+----------------------------------------------------------------------*/
+{
+  FITS *f = file;
+  FLOAT bscale = f->bscale, bzero = f->bzero;
+  const byte *raw;
+  size_t i, len = n * f->bytepix;
+  off_t pos = f->skip + (off_t)offset * f->bytepix;
+
+  if (f->status != STATUS_OLD)
+    error("Attempt to read from a new file, in fitrdpix");
+  if (f->map) {
+    if (pos + len > f->maplen)
+      error("Attempt to read beyond image boundaries, in fitrdpix");
+    raw = (const byte *) (f->map + pos);
+  } else {
+    raw = (const byte *) fitrawbuf(len);
+    if (fseeko(f->fd,pos,0) < 0 || len != fread((char *)raw,1,len,f->fd))
+      error("I/O read error in fitrdpix");
+  }
+
+  switch (f->type) {
+  case TYPE_8INT:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) data[i] = bscale * raw[i] + bzero;
+    break;
+  case TYPE_16INT:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) data[i] = bscale * FIT_GET16(raw+2*i) + bzero;
+    break;
+  case TYPE_32INT:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) data[i] = bscale * FIT_GET32(raw+4*i) + bzero;
+    break;
+  case TYPE_64INT:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) data[i] = bscale * (int8) fit_get64(raw+8*i) + bzero;
+    break;
+  case TYPE_FLOAT:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) {
+      unsigned int u4 = FIT_GET32(raw+4*i);
+      float fv;
+      memcpy(&fv,&u4,4);
+      data[i] = (bscale != 1 || bzero != 0) ? bscale * fv + bzero : fv;
+    }
+    break;
+  case TYPE_DOUBLE:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) {
+      unsigned long long u8 = fit_get64(raw+8*i);
+      double dv;
+      memcpy(&dv,&u8,8);
+      data[i] = bscale * dv + bzero;
+    }
+    break;
+  default:
+    error("fitrdpix: Illegal datatype %d",f->type);
+  }
+}
+/**********************************************************************/
+void fitwrpix(FITS *file, size_t offset, size_t n, FLOAT *data)
+/*
+  This writes n consecutive pixels, e.g. a whole plane, of a new FITS
+  file, the counterpart of fitrdpix. As with fitwrite, the header
+  is finished on the first call. Unlike fitwrite, data is not modified.
+
+  Inputs:
+    file        The pointer returned by fitopen.
+    offset      The first pixel, counted from the start of the data.
+    n           Number of pixels to write.
+    data        A FLOAT array of n elements.
+----------------------------------------------------------------------*/
+{
+  FITS *f = file;
+  FLOAT bscale = f->bscale, bzero = f->bzero;
+  byte *raw;
+  size_t i, len = n * f->bytepix;
+  off_t pos;
+
+  if(f->status == STATUS_NEW){
+    fitput(f,"END");
+    fitpad(f,80*f->ncards,' ');
+    f->skip = f->offset = blocksize*((80*f->ncards + (blocksize-1))/blocksize);
+    f->status = STATUS_NEW_WRITE;
+  } else if(f->status != STATUS_NEW_WRITE)
+    error("Illegal operation, in fitwrpix");
+  pos = f->skip + (off_t)offset * f->bytepix;
+  raw = (byte *) fitrawbuf(len);
+
+  switch (f->type) {
+  case TYPE_8INT:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) raw[i] = (byte) ((data[i] - bzero) / bscale);
+    break;
+  case TYPE_16INT:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) {
+      short int iv = (short int) ((data[i] - bzero) / bscale);
+      raw[2*i]   = ((unsigned short)iv) >> 8;
+      raw[2*i+1] = ((unsigned short)iv) & 0xff;
+    }
+    break;
+  case TYPE_32INT:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) fit_put32(raw+4*i, (unsigned int)(int) ((data[i] - bzero) / bscale));
+    break;
+  case TYPE_64INT:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) {
+      int8 kv = (int8) ((data[i] - bzero) / bscale);
+      fit_put64(raw+8*i, (unsigned long long) kv);
+    }
+    break;
+  case TYPE_FLOAT:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) {
+      FLOAT fs = (bscale != 1 || bzero != 0) ? (data[i] - bzero) / bscale : data[i];
+      float fv = fs;
+      unsigned int u4;
+      memcpy(&u4,&fv,4);
+      fit_put32(raw+4*i, u4);
+    }
+    break;
+  case TYPE_DOUBLE:
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i=0; i<n; i++) {
+      double dv = (double) ((data[i] - bzero) / bscale);
+      unsigned long long u8;
+      memcpy(&u8,&dv,8);
+      fit_put64(raw+8*i, u8);
+    }
+    break;
+  default:
+    error("fitwrpix: Illegal datatype %d",f->type);
+  }
+  if (fseeko(f->fd,pos,0) < 0 || len != fwrite(raw,1,len,f->fd))
+    error("I/O write error in fitwrpix");
+}
+/**********************************************************************/
 void fitsetpl(FITS *file, int n, int *nsize)
 /*
   This sets the plane to be accessed in a FITS file which has more than
@@ -0,0 +1,180 @@
+/*
+ * XCORR.C: cross-correlation and registration of images against a
+ *          reference image, used by ccdcross and ccdstack
+ *
+ *      xcorr_image()   correlation planes of images 1..n-1 against image 0
+ *      xpeak_image()   sub-pixel peak of a correlation plane
+ *
+ *   The correlation is done with FFTs: the reference box of (2*box+1)^2
+ *   pixels and the (4*box+1)^2 pixels of an image it can reach for
+ *   shifts up to box are zero padded to a power of 2 >= 4*box+1, which
+ *   is enough to avoid any wrap-around. The result is thus the same as
+ *   the direct O(box^4) sum, for O(box^2 log box) work.
+ *   The reference is transformed once, the images are done in parallel.
+ *
+ *   19-oct-2026   created, from the direct loop in ccdcross    PJT
+ */
+
+#include <stdinc.h>
+#include <image.h>
+#include <fft.h>
+
+/*
+ * LOADBOX: copy the part [lo,hi] in both x and y, relative to the
+ *	    lower left corner (cx-2*box,cy-2*box), of plane 0 of an image
+ *	    into a zeroed complex array of mxm; pixels outside the image
+ *	    or below the clip level are left at 0.
+ */
+
+local void loadbox(imageptr iptr, int cx, int cy, int box, int lo, int hi,
+		   real *clip, double *data, int m)
+{
+    int u, v, ix, iy;
+    real val;
+
+    for (u=lo; u<=hi; u++) {
+	ix = cx - 2*box + u;
+	if (ix < 0 || ix >= Nx(iptr)) continue;
+	for (v=lo; v<=hi; v++) {
+	    iy = cy - 2*box + v;
+	    if (iy < 0 || iy >= Ny(iptr)) continue;
+	    val = CubeValue(iptr,ix,iy,0);
+	    if (clip && val < *clip) continue;
+	    data[2*(u*m+v)] = val;
+	}
+    }
+}
+
+/*
+ * XCORR_IMAGE: cross-correlate images iptr[1..nimage-1] with iptr[0]
+ *	imageptr *iptr	    input images, only the first plane is used
+ *	int nimage	    number of images, including the reference
+ *	int *center	    reference pixel (0-based) around which to correlate
+ *	int box		    half size of the correlation box
+ *	real *clip	    if not NULL, ignore pixels below *clip
+ *	imageptr cptr	    output: plane l-1 of this (2*box+1)^2 x (nimage-1)
+ *			    cube is the correlation of image l, with the
+ *			    zero shift at pixel (box,box)
+ */
+
+void xcorr_image(imageptr *iptr, int nimage, int *center, int box,
+		 real *clip, imageptr cptr)
+{
+    int     m, nn[2], cx = center[0], cy = center[1], l;
+    long    ntot, k;
+    double  *ref;
+
+    if (Nx(cptr) != 2*box+1 || Ny(cptr) != 2*box+1 || Nz(cptr) < nimage-1)
+	error("xcorr_image: correlation cube %d x %d x %d too small",
+	      Nx(cptr), Ny(cptr), Nz(cptr));
+    nn[0] = nn[1] = m = fft_next2(4*box+1);
+    ntot = (long)m*m;
+    dprintf(1,"xcorr_image: box=%d padded to %d x %d\n",box,m,m);
+
+    ref = (double *) allocate(2*ntot*sizeof(double));
+    loadbox(iptr[0], cx, cy, box, box, 3*box, clip, ref, m);
+    fft_ndim(ref, 2, nn, -1);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (l=1; l<nimage; l++) {
+	double *img = (double *) allocate(2*ntot*sizeof(double));
+	double re, im;
+	int i, j;
+	long n;
+
+	loadbox(iptr[l], cx, cy, box, 0, 4*box, clip, img, m);
+	fft_ndim(img, 2, nn, -1);
+	for (n=0; n<ntot; n++) {	/* conj(ref) * img */
+	    re = ref[2*n]*img[2*n]   + ref[2*n+1]*img[2*n+1];
+	    im = ref[2*n]*img[2*n+1] - ref[2*n+1]*img[2*n];
+	    img[2*n]   = re/ntot;
+	    img[2*n+1] = im/ntot;
+	}
+	fft_ndim(img, 2, nn, 1);
+	for (i=-box; i<=box; i++)
+	    for (j=-box; j<=box; j++) {
+		n = (long)((i+m)%m)*m + (j+m)%m;
+		CubeValue(cptr,i+box,j+box,l-1) = img[2*n];
+	    }
+	free(img);
+    }
+    free(ref);
+    for (k=0; k<(long)Nx(cptr)*Ny(cptr)*(nimage-1); k++) {
+	if (k==0 || Frame(cptr)[k] < MapMin(cptr)) MapMin(cptr) = Frame(cptr)[k];
+	if (k==0 || Frame(cptr)[k] > MapMax(cptr)) MapMax(cptr) = Frame(cptr)[k];
+    }
+}
+
+/*
+ * PEAK3: sub-pixel offset of the peak through 3 points at -1,0,1;
+ *	  a parabola through their log, which is exact for a gaussian,
+ *	  or through the values themselves if they are not all positive.
+ */
+
+local real peak3(real vm, real v0, real vp)
+{
+    real d;
+
+    if (vm > 0 && v0 > 0 && vp > 0) {
+	vm = log(vm);  v0 = log(v0);  vp = log(vp);
+    }
+    d = vm - 2*v0 + vp;
+    if (d >= 0.0) return 0.0;		/* not a maximum */
+    return 0.5*(vm - vp)/d;
+}
+
+/*
+ * XPEAK_IMAGE: find the peak of plane iz of a correlation cube, and refine
+ *	it to sub-pixel precision
+ *	int  ipeak[2]	    output: pixel of the peak
+ *	real shift[2]	    output: shift of the image w.r.t. the reference,
+ *			    from a 3 point (log) parabola in x and y
+ *	real moment[2]      output: if not NULL, the offsets of the centroid
+ *			    of the (2n+1)^2 pixels around the peak
+ *	returns the peak value
+ */
+
+real xpeak_image(imageptr cptr, int iz, int n, int *ipeak, real *shift,
+		 real *moment)
+{
+    int  ix, iy, dx, dy, box = Nx(cptr)/2;
+    real val, vmax = 0.0, sum = 0.0, sumx = 0.0, sumy = 0.0;
+
+    ipeak[0] = ipeak[1] = 0;
+    for (iy=0; iy<Ny(cptr); iy++)
+	for (ix=0; ix<Nx(cptr); ix++) {
+	    val = CubeValue(cptr,ix,iy,iz);
+	    if ((ix==0 && iy==0) || val >= vmax) {
+		vmax = val;
+		ipeak[0] = ix;
+		ipeak[1] = iy;
+	    }
+	}
+    ix = ipeak[0];
+    iy = ipeak[1];
+    shift[0] = ix - box;
+    shift[1] = iy - box;
+    if (ix > 0 && ix < Nx(cptr)-1)
+	shift[0] += peak3(CubeValue(cptr,ix-1,iy,iz), vmax, CubeValue(cptr,ix+1,iy,iz));
+    if (iy > 0 && iy < Ny(cptr)-1)
+	shift[1] += peak3(CubeValue(cptr,ix,iy-1,iz), vmax, CubeValue(cptr,ix,iy+1,iz));
+    if (moment == NULL) return vmax;
+
+    for (dy=-n; dy<=n; dy++) {
+	iy = ipeak[1] + dy;
+	if (iy < 0 || iy >= Ny(cptr)) continue;
+	for (dx=-n; dx<=n; dx++) {
+	    ix = ipeak[0] + dx;
+	    if (ix < 0 || ix >= Nx(cptr)) continue;
+	    val = CubeValue(cptr,ix,iy,iz);
+	    sum  += val;
+	    sumx += val * dx;
+	    sumy += val * dy;
+	}
+    }
+    moment[0] = sum != 0.0 ? sumx/sum : 0.0;
+    moment[1] = sum != 0.0 ? sumy/sum : 0.0;
+    return vmax;
+}
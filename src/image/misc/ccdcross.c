@@ -2,6 +2,8 @@
  * CCDSTACK: cross-correlate images, first one in the reference image
  *
  *   11-apr-2022:    derived from ccdstack
+ *   19-oct-2026:    method=fft (default), images are correlated in parallel,
+ *                   out= is a cube with one plane per image    PJT
  *
  * @todo   gaussian fit to peak in corr image?
  */
@@ -17,13 +19,14 @@
 
 string defv[] = {
   "in=???\n       Input image files, first image sets the WCS",
-  "out=???\n      Output cross correlated image",
+  "out=???\n      Output cross correlated image(s)",
   "center=\n      X-Y Reference center (0-based pixels)",
   "box=\n         Half size of correlation box",
-  "n=3\n          Half size of box inside correlation box to find center",
+  "n=3\n          Half size of box around the peak for its centroid",
   "clip=\n        Only use values above this clip level",
   "bad=0\n        bad value to ignore",
-  "VERSION=0.3\n  18-oct-2024 PJT",
+  "method=fft\n   fft, or direct (the slow box^4 way)",
+  "VERSION=0.4\n  19-oct-2026 PJT",
   NULL,
 };
 
@@ -34,7 +37,7 @@ string usage = "cross correlate images to find the offset";
 # define HUGE 1.0e35
 #endif
 
-#define MAXIMAGE 100
+#define MAXIMAGE 1024
 
 imageptr iptr[MAXIMAGE];	/* pointers to (input) images */
 imageptr optr = NULL;           /* could do array */
@@ -47,34 +50,40 @@ bool     Qclip;
 real     clip;
 
 
-local void do_cross(int l0, int l, int n);
+local void do_cross(int l0, int l);
 
 extern int minmax_image (imageptr iptr);
-
+
 void nemo_main()
 {
-    string *fnames;
+    string *fnames, method = getparam("method");
     stream  instr;                      /* input files */
     stream  outstr;                     /* output file */
     int     nx, ny, nc;
-    int     ll, n;
+    int     ll, n, ipeak[2];
+    real    shift[2], cen[2], peak;
     
     badval = getrparam("bad");
     Qclip = hasvalue("clip");
     if (Qclip) clip = getrparam("clip");
     n = getiparam("n");
+    if (!streq(method,"fft") && !streq(method,"direct"))
+      error("Bad method=%s, use fft or direct",method);
  
     fnames = burststring(getparam("in"), ", ");  /* input file names */
     nimage = xstrlen(fnames, sizeof(string)) - 1;
     if (nimage > MAXIMAGE) error("Too many images %d > %d", nimage, MAXIMAGE);
+    if (nimage < 2) error("Need at least 2 images");
     dprintf(0,"Using %d images\n",nimage);
 
-    instr   = stropen(fnames[0],"r");    /* open file */
-    iptr[0] = NULL;        /* make sure to init it right */
-    read_image (instr, &iptr[0]);
-    dprintf(0,"Image %d: pixel size %g %g   minmax %g %g [%s]\n",
-	    0, Dx(iptr[0]),Dy(iptr[0]),MapMin(iptr[0]),MapMax(iptr[0]),fnames[0]);
-    strclose(instr);
+    for (ll=0; ll<nimage; ll++) {
+        instr   = stropen(fnames[ll],"r");    /* open file */
+        iptr[ll] = NULL;        /* make sure to init it right */
+        read_image (instr, &iptr[ll]);
+	dprintf(0,"Image %d: pixel size %g %g   minmax %g %g [%s]\n",
+		ll, Dx(iptr[ll]),Dy(iptr[ll]),MapMin(iptr[ll]),MapMax(iptr[ll]),fnames[ll]);
+        strclose(instr);        /* close input file */
+    }
 
     if (hasvalue("center")) {
       nc = nemoinpi(getparam("center"),center,2);
@@ -94,38 +103,43 @@ void nemo_main()
       
 
     optr = NULL;
-    create_cube(&optr, nx, ny, 1);
+    create_cube(&optr, nx, ny, nimage-1);
     outstr = stropen (getparam("out"),"w");  /* open output file first ... */
 
+    if (streq(method,"fft"))
+      xcorr_image(iptr, nimage, center, box, Qclip ? &clip : NULL, optr);
+    else {
+      for (ll=1; ll<nimage; ll++)
+	do_cross(0,ll);
+      minmax_image(optr);
+    }
+    dprintf(0,"New min and max in correlation image are: %f %f\n",MapMin(optr) ,MapMax(optr) );
+
     for (ll=1; ll<nimage; ll++) {
-        instr   = stropen(fnames[ll],"r");    /* open file */
-        iptr[ll] = NULL;        /* make sure to init it right */
-        read_image (instr, &iptr[ll]);
-	dprintf(0,"Image %d: pixel size %g %g   minmax %g %g [%s]\n",
-		ll, Dx(iptr[ll]),Dy(iptr[ll]),MapMin(iptr[ll]),MapMax(iptr[ll]),fnames[ll]);
-        strclose(instr);        /* close input file */
-	do_cross(0,ll,n);
+      peak = xpeak_image(optr, ll-1, n, ipeak, shift, cen);
+      dprintf(0,"Max cross %g @ %d %d\n",peak,ipeak[0],ipeak[1]);
+      dprintf(0,"Center at: %g %g\n",shift[0],shift[1]);
+      // @todo (ix0-xcen-box, iy0-ycen-box) is a value expected to be around (0,0) for no offsets
+      printf("%g %g  %g %g  %d %d  %g\n",shift[0],shift[1],cen[0],cen[1],
+	     ipeak[0],ipeak[1],peak);
     }
 
     write_image(outstr,optr); 
     strclose(outstr);
 
 }
-
+
 
 /* 
- *  combine input maps into an output map  --
+ *  direct cross correlation of image l with l0, into plane l-1 of optr
  *
  */
-local void do_cross(int l0, int l, int n)
+local void do_cross(int l0, int l)
 {
     real   sum;
     int    i, j, ix, iy, nx, ny;
     int    ix1,iy1,ix2,iy2;
     int    cx,cy;
-    int    badvalues;
-    
-    badvalues = 0;		/* count number of bad operations */
 
     nx = Nx(iptr[l0]);
     ny = Ny(iptr[l0]);
@@ -140,11 +154,11 @@ local void do_cross(int l0, int l, int n)
 	for (iy=-box; iy<=box; iy++) {
 	  iy1 = cy + iy;
 	  iy2 = iy1 + j;
-	  if (iy1 < 0 || iy2 < 0 || iy1 >= ny || iy2 >= ny) continue;	  
+	  if (iy1 < 0 || iy2 < 0 || iy1 >= ny || iy2 >= Ny(iptr[l])) continue;
 	  for (ix=-box; ix<=box; ix++) {
 	    ix1 = cx + ix;;
 	    ix2 = ix1 + i;
-	    if (ix1 < 0 || ix2 < 0 || ix1 >= nx || ix2 >= nx) continue;
+	    if (ix1 < 0 || ix2 < 0 || ix1 >= nx || ix2 >= Nx(iptr[l])) continue;
 	    // @todo   handle bad values
 	    if (Qclip) {
 	      if (CubeValue(iptr[l0],ix1,iy1,0) < clip) continue;
@@ -153,51 +167,7 @@ local void do_cross(int l0, int l, int n)
 	    sum += CubeValue(iptr[l0],ix1,iy1,0) * CubeValue(iptr[l],ix2,iy2,0);
 	  }
 	}
-	CubeValue(optr,i+box,j+box,0) = sum;
-      }
-    }
-
-    int ix0=0, iy0=0;
-    minmax_image(optr);
-    dprintf(0,"New min and max in correlation image are: %f %f\n",MapMin(optr) ,MapMax(optr) );
-    for (iy=0; iy<Ny(optr); iy++)
-      for (ix=0; ix<Nx(optr); ix++)
-	if (CubeValue(optr,ix,iy,0) == MapMax(optr)) {
-	  ix0 = ix;
-	  iy0 = iy;
-	  dprintf(0,"Max cross %g @ %d %d\n",MapMax(optr),ix,iy);
-	}
-    
-    real sumx=0, sumy=0, sumxx=0, sumxy=0, sumyy=0;
-    int dx, dy;
-    sum = 0;
-    for (dy=-n; dy<=n; dy++) {        // look around (ix0,iy0) by just a few pixels 
-      iy = iy0+dy;  
-      for (dx=-n; dx<=n; dx++) {      // to find the 
-	ix = ix0+dx;
-	sum   = sum   + CubeValue(optr,ix,iy,0);
-	sumx  = sumx  + CubeValue(optr,ix,iy,0) * dx;
-	sumy  = sumy  + CubeValue(optr,ix,iy,0) * dy;
-	sumxx = sumxx + CubeValue(optr,ix,iy,0) * dx*dx;
-	sumxy = sumxy + CubeValue(optr,ix,iy,0) * dx*dy;
-	sumyy = sumyy + CubeValue(optr,ix,iy,0) * dy*dy;
+	CubeValue(optr,i+box,j+box,l-1) = sum;
       }
     }
-    sumx /= sum;   sumy /= sum;
-    sumxx = sqrt(sumxx/sum - sumx*sumx);
-    sumyy = sqrt(sumyy/sum - sumy*sumy);    
-    dprintf(0,"X,Y mean: %g %g\n", sumx,  sumy);
-    dprintf(0,"X,Y sig:  %g %g\n", sumxx, sumyy);    
-    real xcen = ix0-box+sumx;
-    real ycen = iy0-box+sumy;
-    dprintf(0,"Center at: %g %g\n",xcen,ycen);
-    // @todo (ix0-xcen-box, iy0-ycen-box) is a value expected to be around (0,0) for no offsets
-    // 
-    printf("%g %g  %g %g  %d %d  %g\n",xcen,ycen,sumx,sumy, ix0,iy0, MapMax(optr));	   
-    
-    if (badvalues)
-    	warning("There were %d bad operations in dofie",badvalues);
 }
-
-
-
@@ -0,0 +1,390 @@
+/*
+ * CCDFITSPEC: fit a function to every spectrum (along the 3rd axis) of a cube
+ *
+ *	Uses the same fitters (nllsqfit, mrqfit, mpfit) and the same loadable
+ *	fit functions (func_NAME/derv_NAME, see $NEMO/src/kernel/tab/fit)
+ *	as tabnllsqfit. Rows of the cube are fitted in parallel (if compiled
+ *	with OpenMP), each thread with its own workspace; along a row the
+ *	fit of the previous pixel seeds the next one.
+ *
+ *      19-oct-2026   V1.0  created                                   PJT
+ */
+
+#include <stdinc.h>
+#include <getparam.h>
+#include <vectmath.h>
+#include <filestruct.h>
+#include <image.h>
+#include <loadobj.h>
+#include <filefn.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+string defv[] = {
+  "in=???\n       Input image cube",
+  "out=???\n      Output cube with the fitted parameters, one plane per parameter",
+  "eout=\n        Optional output cube with the errors in the fitted parameters",
+  "rms=\n         Optional output map with the rms of the residuals",
+  "fit=gauss1d\n  Built-in gauss1d, or the function name in a load= object",
+  "load=\n        Dynamic object with func_<fit> and derv_<fit>, e.g. $NEMOOBJ/fit/gaussn.so",
+  "par=\n         Initial estimates (p0,p1,..) [gauss1d: estimated from each spectrum]",
+  "free=\n        Free(1) or fixed(0) parameters [1,1,1,....]",
+  "seed=t\n       Seed each fit with the fit of its neighbour along the row?",
+  "refit=t\n      Refit failed spectra, seeded from a successful neighbour?",
+  "clip=\n        Only fit spectra with a peak above this value",
+  "tol=\n         Tolerance for convergence of nllsqfit",
+  "lab=\n         Mixing parameter for nllsqfit",
+  "itmax=50\n     Maximum number of allowed nllsqfit iterations",
+  "method=gipsy\n method:   Gipsy(nllsqfit), Numrec(mrqfit), MINPACK(mpfit)",
+  "VERSION=1.0\n  19-oct-2026 PJT",
+  NULL,
+};
+
+string usage = "fit a function to every spectrum of a cube";
+
+#define MAXPAR 32
+
+typedef real (*my_proc1)(real *, real *, int);
+typedef void (*my_proc2)(real *, real *, real *, int);
+typedef int  (*my_proc3)(real *, int, real *, real *, real *, int, real *, real *, int *,
+			 int, real, int, real, my_proc1, my_proc2);
+
+extern int nr_nllsqfit(real *, int, real *, real *, real *, int, real *, real *, int *,
+		       int, real, int, real, my_proc1, my_proc2);
+extern int mp_nllsqfit(real *, int, real *, real *, real *, int, real *, real *, int *,
+	 	       int, real, int, real, my_proc1, my_proc2);
+extern int    nllsqfit(real *, int, real *, real *, real *, int, real *, real *, int *,
+		       int, real, int, real, my_proc1, my_proc2);
+
+local my_proc1 fitfunc;
+local my_proc2 fitderv;
+local my_proc3 my_nllsqfit;
+
+local int  npar, mask[MAXPAR], itmax;
+local real par[MAXPAR], tol, lab;
+local bool Qest;                /* estimate initial gauss1d parameters */
+
+local real func_gauss1d(real *x, real *p, int np);
+local void derv_gauss1d(real *x, real *p, real *e, int np);
+local void load_function(string fname, string method);
+local void estimate_gauss1d(int n, real *x, real *y, real *p);
+local int  fit_spectrum(int n, real *x, real *y, real *d, real *p0, real *fpar, real *epar, real *rms);
+local imageptr like_cube(imageptr iptr, int nz);
+
+
+void nemo_main()
+{
+  stream   instr, outstr;
+  imageptr iptr = NULL, optr, eptr = NULL, rptr = NULL;
+  int      nx, ny, nz, i, k, nfit = 0, nfail = 0, nskip = 0, nrefit = 0;
+  string   method = getparam("method"), fit = getparam("fit");
+  real     *x, clip;
+  signed char *ok, *ok1;           /* 0=skipped 1=fitted -1=failed */
+  bool     Qseed = getbparam("seed");
+  bool     Qrefit = getbparam("refit");
+  bool     Qclip = hasvalue("clip");
+  bool     Qpar = TRUE;             /* fitter is reentrant */
+
+  switch (*method) {
+  case 'g':
+  case 'G':
+    my_nllsqfit = nllsqfit;
+    break;
+  case 'n':
+  case 'N':
+    my_nllsqfit = nr_nllsqfit;
+    Qpar = FALSE;
+    break;
+  case 'm':
+  case 'M':
+    my_nllsqfit = mp_nllsqfit;
+    Qpar = FALSE;
+    break;
+  default:
+    error("method=%s not supported, try Gipsy, Numrec, MINPACK",method);
+  }
+  if (!Qpar) dprintf(0,"method=%s is not thread safe, fitting serially\n",method);
+
+  if (hasvalue("load"))
+    load_function(getparam("load"),fit);
+  else if (streq(fit,"gauss1d")) {
+    fitfunc = func_gauss1d;
+    fitderv = derv_gauss1d;
+  } else
+    error("fit=%s not built in, need load=",fit);
+
+  npar = hasvalue("par") ? nemoinpr(getparam("par"),par,MAXPAR) : 0;
+  if (npar < 0) error("bad par=");
+  Qest = (npar == 0 && !hasvalue("load"));
+  if (Qest)
+    npar = 4;
+  else if (npar == 0)
+    error("You must specify initial conditions for all parameters, par=");
+  for (i=0; i<MAXPAR; i++)
+    mask[i] = 1;
+  if (hasvalue("free"))
+    if (nemoinpi(getparam("free"),mask,MAXPAR) < 0) error("bad free=");
+  tol = hasvalue("tol") ? getrparam("tol") : 0.0;
+  lab = hasvalue("lab") ? getrparam("lab") : 0.01;
+  itmax = getiparam("itmax");
+  clip = Qclip ? getrparam("clip") : 0.0;
+
+  instr = stropen(getparam("in"), "r");
+  read_image(instr, &iptr);
+  strclose(instr);
+  nx = Nx(iptr);
+  ny = Ny(iptr);
+  nz = Nz(iptr);
+  if (nz <= npar) error("Not enough channels (%d) to fit %d parameters",nz,npar);
+
+  x = (real *) allocate(nz*sizeof(real));
+  for (k=0; k<nz; k++)
+    x[k] = Zmin(iptr) + (k-Zref(iptr))*Dz(iptr);
+
+  optr = like_cube(iptr, npar);
+  if (hasvalue("eout")) eptr = like_cube(iptr, npar);
+  if (hasvalue("rms"))  rptr = like_cube(iptr, 1);
+  ok  = (signed char *) allocate(nx*ny);
+  ok1 = (signed char *) allocate(nx*ny);
+#ifdef _OPENMP
+  dprintf(1,"Using %d threads\n",Qpar ? omp_get_max_threads() : 1);
+#endif
+
+  /* pass 1: rows in parallel, seeded along the row */
+
+#if defined(_OPENMP)
+#pragma omp parallel if(Qpar) reduction(+:nfit,nfail,nskip)
+#endif
+  {
+    real *y = (real *) allocate(nz*sizeof(real));      /* per thread workspace */
+    real *d = (real *) allocate(nz*sizeof(real));
+    real fpar[MAXPAR], epar[MAXPAR], p0[MAXPAR], rms, ymax;
+    int  ii, jj, kk, pp, nrt;
+    bool Qprev;
+
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic)
+#endif
+    for (jj=0; jj<ny; jj++) {
+      Qprev = FALSE;
+      for (ii=0; ii<nx; ii++) {
+	for (kk=0; kk<nz; kk++)
+	  y[kk] = CubeValue(iptr,ii,jj,kk);
+	for (pp=0; pp<npar; pp++) {
+	  CubeValue(optr,ii,jj,pp) = 0.0;
+	  if (eptr) CubeValue(eptr,ii,jj,pp) = 0.0;
+	}
+	if (rptr) CubeValue(rptr,ii,jj,0) = 0.0;
+	if (Qclip) {
+	  for (kk=1, ymax=y[0]; kk<nz; kk++)
+	    ymax = MAX(ymax,y[kk]);
+	  if (ymax < clip) {
+	    ok[ii+nx*jj] = 0;
+	    nskip++;
+	    Qprev = FALSE;
+	    continue;
+	  }
+	}
+	if (Qseed && Qprev)
+	  for (pp=0; pp<npar; pp++) p0[pp] = fpar[pp];
+	else if (Qest)
+	  estimate_gauss1d(nz, x, y, p0);
+	else
+	  for (pp=0; pp<npar; pp++) p0[pp] = par[pp];
+	nrt = fit_spectrum(nz, x, y, d, p0, fpar, epar, &rms);
+	if (nrt < 0 && Qseed && Qprev) {                 /* retry without the seed */
+	  if (Qest)
+	    estimate_gauss1d(nz, x, y, p0);
+	  else
+	    for (pp=0; pp<npar; pp++) p0[pp] = par[pp];
+	  nrt = fit_spectrum(nz, x, y, d, p0, fpar, epar, &rms);
+	}
+	Qprev = (nrt >= 0);
+	ok[ii+nx*jj] = Qprev ? 1 : -1;
+	if (!Qprev) {
+	  nfail++;
+	  continue;
+	}
+	nfit++;
+	for (pp=0; pp<npar; pp++) {
+	  CubeValue(optr,ii,jj,pp) = fpar[pp];
+	  if (eptr) CubeValue(eptr,ii,jj,pp) = epar[pp];
+	}
+	if (rptr) CubeValue(rptr,ii,jj,0) = rms;
+      }
+    }
+    free(y);
+    free(d);
+  }
+  dprintf(0,"Fitted %d, failed %d, skipped %d spectra\n",nfit,nfail,nskip);
+
+  /* pass 2: failed fits seeded from a neighbour that succeeded in pass 1 */
+
+  if (Qrefit && nfail > 0) {
+    memcpy(ok1, ok, nx*ny);
+#if defined(_OPENMP)
+#pragma omp parallel if(Qpar) reduction(+:nrefit)
+#endif
+    {
+      real *y = (real *) allocate(nz*sizeof(real));
+      real *d = (real *) allocate(nz*sizeof(real));
+      real fpar[MAXPAR], epar[MAXPAR], p0[MAXPAR], rms;
+      int  ii, jj, kk, n, i1, j1, pp, nrt;
+      int  di[4] = { -1, 1, 0, 0 }, dj[4] = { 0, 0, -1, 1 };
+
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic)
+#endif
+      for (jj=0; jj<ny; jj++) {
+	for (ii=0; ii<nx; ii++) {
+	  if (ok1[ii+nx*jj] >= 0) continue;
+	  for (kk=0; kk<nz; kk++)
+	    y[kk] = CubeValue(iptr,ii,jj,kk);
+	  for (n=0; n<4; n++) {
+	    i1 = ii + di[n];
+	    j1 = jj + dj[n];
+	    if (i1<0 || i1>=nx || j1<0 || j1>=ny || ok1[i1+nx*j1] != 1) continue;
+	    for (pp=0; pp<npar; pp++) p0[pp] = CubeValue(optr,i1,j1,pp);
+	    nrt = fit_spectrum(nz, x, y, d, p0, fpar, epar, &rms);
+	    if (nrt < 0) continue;
+	    nrefit++;
+	    ok[ii+nx*jj] = 1;
+	    for (pp=0; pp<npar; pp++) {
+	      CubeValue(optr,ii,jj,pp) = fpar[pp];
+	      if (eptr) CubeValue(eptr,ii,jj,pp) = epar[pp];
+	    }
+	    if (rptr) CubeValue(rptr,ii,jj,0) = rms;
+	    break;
+	  }
+	}
+      }
+      free(y);
+      free(d);
+    }
+    dprintf(0,"Refitted %d/%d failed spectra\n",nrefit,nfail);
+  }
+
+  minmax_image(optr);
+  outstr = stropen(getparam("out"), "w");
+  write_image(outstr, optr);
+  strclose(outstr);
+  if (eptr) {
+    minmax_image(eptr);
+    outstr = stropen(getparam("eout"), "w");
+    write_image(outstr, eptr);
+    strclose(outstr);
+  }
+  if (rptr) {
+    minmax_image(rptr);
+    outstr = stropen(getparam("rms"), "w");
+    write_image(outstr, rptr);
+    strclose(outstr);
+  }
+}
+
+/*
+ * fit one spectrum, starting from p0; returns the nllsqfit return code
+ */
+
+local int fit_spectrum(int n, real *x, real *y, real *d, real *p0, real *fpar, real *epar, real *rms)
+{
+  int i, nrt, mpar[MAXPAR];
+  real sum;
+
+  for (i=0; i<npar; i++) {
+    fpar[i] = p0[i];
+    mpar[i] = mask[i];
+  }
+  nrt = (*my_nllsqfit)(x,1,y,NULL,d,n, fpar,epar,mpar,npar, tol,itmax,lab, fitfunc,fitderv);
+  if (nrt == -2) nrt = 0;                 /* no free parameters is not a failure */
+  if (nrt < 0) return nrt;
+  for (i=0, sum=0.0; i<n; i++)
+    sum += sqr(y[i] - (*fitfunc)(&x[i],fpar,npar));
+  *rms = sqrt(sum/n);
+  return nrt;
+}
+
+/*
+ * initial gauss1d parameters from the spectrum: baseline from the end points,
+ * peak, its location and the width from the integral
+ */
+
+local void estimate_gauss1d(int n, real *x, real *y, real *p)
+{
+  int k, kmax = 0;
+  real base = 0.5*(y[0]+y[n-1]), sum = 0.0;
+
+  for (k=0; k<n; k++) {
+    if (y[k] > y[kmax]) kmax = k;
+    sum += y[k]-base;
+  }
+  p[0] = base;
+  p[1] = y[kmax]-base;
+  p[2] = x[kmax];
+  p[3] = (p[1] != 0 ? ABS(sum/p[1]) : 1.0) * ABS(x[1]-x[0]) / sqrt(TWO_PI);
+  if (p[3] == 0) p[3] = ABS(x[1]-x[0]);
+}
+
+/*
+ * gauss1d:   p0 + p1*exp(-(x-p2)^2/(2*p3^2)), as in tabnllsqfit
+ */
+
+local real func_gauss1d(real *x, real *p, int np)
+{
+  real a = (x[0]-p[2])/p[3];
+
+  return p[0] + p[1]*exp(-0.5*a*a);
+}
+
+local void derv_gauss1d(real *x, real *p, real *e, int np)
+{
+  real a = (x[0]-p[2])/p[3];
+  real arg = exp(-0.5*a*a);
+
+  e[0] = 1.0;
+  e[1] = arg;
+  e[2] = p[1]*arg*a/p[3];
+  e[3] = p[1]*arg*a*a/p[3];
+}
+
+/*
+ * load func_<method> and derv_<method>, as in tabnllsqfit
+ */
+
+local void load_function(string fname, string method)
+{
+  char func_name[80], derv_name[80];
+  string path;
+
+  mysymbols(getargv0());
+  path = pathfind(".",fname);
+  if (path == NULL) error("Cannot open %s",fname);
+  sprintf(func_name,"func_%s",method);
+  sprintf(derv_name,"derv_%s",method);
+  dprintf(1,"load_function: %s with %s\n",path,func_name);
+  loadobj(path);
+  fitfunc = (my_proc1) findfn(func_name);
+  fitderv = (my_proc2) findfn(derv_name);
+  if (fitfunc==NULL) error("Could not find %s in %s",func_name,fname);
+  if (fitderv==NULL) error("Could not find %s in %s",derv_name,fname);
+}
+
+local imageptr like_cube(imageptr iptr, int nz)
+{
+  imageptr optr = NULL;
+
+  create_cube(&optr, Nx(iptr), Ny(iptr), nz);
+  Dx(optr) = Dx(iptr);
+  Dy(optr) = Dy(iptr);
+  Dz(optr) = 1.0;
+  Xmin(optr) = Xmin(iptr);
+  Ymin(optr) = Ymin(iptr);
+  Zmin(optr) = 0.0;
+  Xref(optr) = Xref(iptr);
+  Yref(optr) = Yref(iptr);
+  Zref(optr) = 0.0;
+  Axis(optr) = Axis(iptr);
+  return optr;
+}
@@ -3,6 +3,7 @@
  *          
  *
  *	 8-feb-2011 V1.0 :  cloned off tabhist, finally         PJT
+ *	19-oct-2026 V1.2 :  histogram with the binning library  PJT
  * 
  * TODO:
  *     option to do dual-pass to subtract the mean before computing
@@ -18,6 +19,7 @@
 #include <getparam.h>
 #include <image.h>
 #include <moment.h>
+#include <binning.h>
 #include <yapp.h>
 #include <axis.h>
 #include <mdarray.h>
@@ -46,7 +48,7 @@ string defv[] = {
     "dual=f\n             Dual pass for large number",
     "blankval=\n          if used, use this as blankval",
     "scale=1\n            Scale factor for data",
-    "VERSION=1.1b\n	  29-aug-2024 PJT",
+    "VERSION=1.2\n	  19-oct-2026 PJT",
     NULL
 };
 
@@ -102,7 +104,7 @@ local iproc  mysort, getsort();
 local real  xtrans(real), ytrans(real);
 local void  setparams(void), read_data(void), histogram(void);
 local iproc getsort(string name);
-local int   ring_index(int n, real *r, real rad);
+local int   bin_count(real *count);
 
 extern int minmax(int n, real *array, real *amin, real *amax);
 
@@ -268,30 +270,10 @@ local void histogram(void)
     dprintf (0,"min and max value in range : [%g : %g]\n",lmin,lmax);
   } 
   
-  for (k=0; k<nsteps; k++)
-    count[k] = 0;		/* init histogram */
-  under = over = 0;
-  
   ini_moment(&m,4,0);
-  for (i=0; i<npt; i++) {
-    if (Qbin) {
-      k=ring_index(nsteps,bins,x[i]);
-    } else {
-      if (xmax != xmin)
-	k = (int) floor((x[i]-xmin)/(xmax-xmin)*nsteps);
-      else
-	k = 0;
-      dprintf(1,"%d k=%d %g\n",i,k,x[i]);
-    }
-    if (k==nsteps && x[i]==xmax) k--;     /* include upper edge */
-    if (k<0)       { under++; continue; }
-    if (k>=nsteps) { over++;  continue; }
-    count[k] = count[k] + (Qint ? x[i] : 1);
-    dprintf (4,"%d : %f %d\n",i,x[i],k);
+  for (i=0; i<npt; i++)
     accum_moment(&m,x[i],1.0);
-  }
-  if (under > 0) error("bug: under = %d",under);
-  if (over  > 0) error("bug: over = %d",over);
+  if ((k = bin_count(count)) > 0) error("bug: %d points outside the histogram",k);
   under = Nunder;
   over  = Nover;
 
@@ -389,21 +371,7 @@ local void histogram(void)
   if (lcount > 0) {
     warning("Recompute histogram because of outlier removals");
     /* recompute histogram if we've lost some outliers */
-    for (k=0; k<nsteps; k++)
-      count[k] = 0;		/* init histogram */
-    under = over = 0;
-    for (i=0; i<npt; i++) {
-      if (xmax != xmin)
-	k = (int) floor((x[i]-xmin)/(xmax-xmin)*nsteps);
-      else
-	k = 0;
-      if (k==nsteps && x[i]==xmax) k--;     /* include upper edge */
-      if (k<0)       { under++; continue; }
-      if (k>=nsteps) { over++;  continue; }
-      count[k] = count[k] + (Qint ? x[i] : 1);
-      dprintf (4,"%d : %f %d\n",i,x[i],k);
-    }
-    if (under > 0 || over > 0) error("under=%d over=%d in recomputed histo",under,over);
+    if ((k = bin_count(count)) > 0) error("%d points outside the recomputed histo",k);
   }
   
   dprintf (3,"Histogram values : \n");
@@ -612,25 +580,35 @@ local iproc getsort(string name)
 }
 
 
-/* index into an array --- stolen from velfit.c */
+/*
+ * BIN_COUNT: histogram of x[] in count[], in the linear bins from xmin
+ *	      to xmax or the edges bins[]; upper edge included.
+ *	      With integrate=t the values are summed instead of counted.
+ *	      Returns the number of points outside.
+ */
 
-local
-int ring_index(int n, real *r, real rad)
+local int bin_count(real *count)
 {
-  int i;
-  
-  if (r[0] < r[1]) {
-    if (rad < r[0]) return -1;
-    if (rad > r[n-1]) return -2;
-    for (i=0;i<n;i++)
-      if (rad >= r[i] && rad < r[i+1]) return i;
-    error("ring_index: should never gotten here %g in [%g : %g]",
-	  rad,r[0],r[n-1]);
-  } else {
-    error("reverse indexing not yet implemented");
-    //Must return a value in this path.
-  }
+  bin_table *b;
+  double lo = xmin, hi = xmax;
+  int i, k, nout;
 
+  if (!Qbin && xmax == xmin) {		/* all in the first bin */
+    for (k=0; k<nsteps; k++)
+      count[k] = 0;
+    for (i=0; i<npt; i++)
+      count[0] += Qint ? x[i] : 1;
+    return 0;
+  }
+  b = bin_create(1, &nsteps, &lo, &hi, 0);
+  if (Qbin) bin_edges(b, 0, bins);
+  b->closed = TRUE;
+  bin_add_n(b, npt, x, NULL, NULL, Qint ? x : NULL, NULL);
+  for (k=0; k<nsteps; k++)
+    count[k] = b->w[k];
+  nout = b->nout;
+  bin_free(b);
+  return nout;
 }
 
 void nemo_main()
@@ -2,6 +2,8 @@
  * CCDSTACK: stack images, with simple gridding option
  *
  *   21-may-2021:    derived from ccdmoms, but should not need to allocate MAXIMAGE, just use 2
+ *   19-oct-2026:    register= to shift images by their cross-correlation peak with
+ *                   the first image; rows are stacked in parallel           PJT
  *
  *  @todo    for wcs=t, each source pixel should have an option to be convolved  and spread
  *           into the destination image. See fwhm= keyword
@@ -25,7 +27,11 @@ string defv[] = {
   "wcs=t\n        Use WCS to sample",
   "fwhm=\n        FWHM of the convolution filter in each dimension",
   "flux=\n        Conserve flux (1) or not (0) in each dimension",
-  "VERSION=0.3a\n 23-may-2021 PJT",
+  "register=f\n   Register images on the first by cross-correlation",
+  "center=\n      X-Y center (0-based pixels) of the registration box",
+  "box=\n         Half size of the registration box",
+  "clip=\n        Only use values above this clip level to register",
+  "VERSION=0.4\n  19-oct-2026 PJT",
   NULL,
 };
 
@@ -37,15 +43,18 @@ string cvsid = "$Id$";
 # define HUGE 1.0e35
 #endif
 
-#define MAXIMAGE 100
+#define MAXIMAGE 1024
 
 imageptr iptr[MAXIMAGE];	/* pointers to (input) images */
 real iwt[MAXIMAGE];             /* scalar weight per image */
+real shift[MAXIMAGE][2];        /* pixel shift of each image, if registered */
 real     badval;
 int      nimage;                /* actual number of input images */
 bool     Qsigma;
 bool     Qwcs;
+bool     Qreg;
 
+local void do_register(void);
 local void do_combine(void);
 
 
@@ -68,6 +77,7 @@ void nemo_main ()
 
     Qsigma = getbparam("sigma");
     Qwcs   = getbparam("wcs");
+    Qreg   = getbparam("register");
     badval = getrparam("bad");
 
     
@@ -99,6 +109,7 @@ void nemo_main ()
 		l, Dx(iptr[l]),Dy(iptr[l]),MapMin(iptr[l]),MapMax(iptr[l]));
         strclose(instr);        /* close input file */
     }
+    if (Qreg) do_register();
     do_combine();
 
     write_image(outstr,iptr[0]);         /* write image to file */
@@ -106,6 +117,57 @@ void nemo_main ()
 }
 
 
+/*
+ *  find the shift of each image w.r.t. the first one, from the peak
+ *  of their (FFT) cross-correlation; only the first plane is used
+ */
+local void do_register(void)
+{
+    imageptr cptr = NULL;
+    int    center[2], box, ipeak[2], l, nc;
+    real   clip;
+
+    if (hasvalue("center")) {
+      nc = nemoinpi(getparam("center"),center,2);
+      if (nc != 2) error("center= needs 2 values");
+    } else {
+      center[0] = Nx(iptr[0])/2;
+      center[1] = Ny(iptr[0])/2;
+    }
+    box = hasvalue("box") ? getiparam("box") : MIN(Nx(iptr[0]),Ny(iptr[0]))/2;
+    if (hasvalue("clip")) clip = getrparam("clip");
+
+    create_cube(&cptr, 2*box+1, 2*box+1, nimage-1);
+    xcorr_image(iptr, nimage, center, box, hasvalue("clip") ? &clip : NULL, cptr);
+    shift[0][0] = shift[0][1] = 0.0;
+    for (l=1; l<nimage; l++) {
+      (void) xpeak_image(cptr, l-1, 0, ipeak, shift[l], NULL);
+      dprintf(0,"Image %d: shift %g %g\n",l,shift[l][0],shift[l][1]);
+    }
+    free_image(cptr);
+}
+
+/*
+ *  map the pixels along one axis of an input image to the output image;
+ *  this linear map is monotonic, which makes the stacking of rows safe
+ *  to do in parallel. A registered image is mapped in pixel space, since
+ *  its measured shift s already is the full offset to the first image.
+ */
+local void axis_map(int *map, int n, bool reg, real s, real ref, real d, real min,
+		    real ref0, real d0, real min0)
+{
+    int  i;
+    real v;
+
+    for (i=0; i<n; i++) {
+      if (Qwcs && !reg)    //  x = (ix - xref) * dx + xmin,  ix = (x-xmin) / dx + xref
+	v = ((i - ref) * d + min - min0)/d0 + ref0;
+      else
+	v = i - s;
+      map[i] = reg ? (int) floor(v+0.5) : (int) v;
+    }
+}
+
 /* 
  *  combine input maps into an output map  --
  *
@@ -113,14 +175,14 @@ void nemo_main ()
 local void do_combine()
 {
     double m_min, m_max;
-    real  *fin, *win, fout;
-    real   x,xmin,xref,dx;
-    real   y,ymin,yref,dy;
-    real   z,zmin,zref,dz;
-    int    k, l, ix, iy, iz, nx, ny, nz, offset;
-    int    ix1,iy1,iz1;
+    real   xmin,xref,dx;
+    real   ymin,yref,dy;
+    real   zmin,zref,dz;
+    int    l, ix, iy, iz, nx, ny, nz;
+    int    iz1, g, ng;
+    int    *xmap, *ymap, *zmap, *grp;
     int    badvalues;
-    imageptr wptr;
+    imageptr wptr = NULL;
     
     m_min = HUGE; m_max = -HUGE;
     badvalues = 0;		/* count number of bad operations */
@@ -132,65 +194,73 @@ local void do_combine()
     xmin = Xmin(iptr[0]);  xref = Xref(iptr[0]);  dx = Dx(iptr[0]);
     ymin = Ymin(iptr[0]);  yref = Yref(iptr[0]);  dy = Dy(iptr[0]);
     zmin = Zmin(iptr[0]);  zref = Zref(iptr[0]);  dz = Dz(iptr[0]);    
-    //  x = (ix - xref) * dx + xmin
-    // ix = (x-xmin) / dx    + xref
-    if (Qwcs)
+    if (Qreg)
+      dprintf(0,"Images stacked in image index, shifted by their registration\n");
+    else if (Qwcs)
       dprintf(0,"Images stacked in the WCS of the first image\n");
     else
       dprintf(0,"Images stacked in image index\n");
     
-    create_cube(&wptr, nx, ny, nx);   // weight cube
+    create_cube(&wptr, nx, ny, nz);   // weight cube
         
-    for (l=1; l<nimage; l++) {        // The fir
+    for (l=1; l<nimage; l++) {        // The first image is the output
       dprintf(0,"Adding image %d\n",l);
+      xmap = (int *) allocate(Nx(iptr[l])*sizeof(int));
+      ymap = (int *) allocate(Ny(iptr[l])*sizeof(int));
+      zmap = (int *) allocate(Nz(iptr[l])*sizeof(int));
+      grp  = (int *) allocate((Ny(iptr[l])+1)*sizeof(int));
+      axis_map(xmap, Nx(iptr[l]), Qreg,  shift[l][0], Xref(iptr[l]), Dx(iptr[l]), Xmin(iptr[l]), xref, dx, xmin);
+      axis_map(ymap, Ny(iptr[l]), Qreg,  shift[l][1], Yref(iptr[l]), Dy(iptr[l]), Ymin(iptr[l]), yref, dy, ymin);
+      axis_map(zmap, Nz(iptr[l]), FALSE, 0.0,         Zref(iptr[l]), Dz(iptr[l]), Zmin(iptr[l]), zref, dz, zmin);
+      for (iy=0, ng=0; iy<Ny(iptr[l]); iy++)   // groups of input rows landing on the same output row
+	if (iy==0 || ymap[iy] != ymap[iy-1])
+	  grp[ng++] = iy;
+      grp[ng] = Ny(iptr[l]);
       for (iz=0; iz<Nz(iptr[l]); iz++) {
-	if (Qwcs) {
-	  z = (iz-Zref(iptr[l])) * Dz(iptr[l]) + Zmin(iptr[l]);
-	  iz1 = (int) ((z-zmin)/dz + zref);
-	  dprintf(0,"z %d %d\n",iz,iz1);	   	   
-	} else
-	  iz1 = iz;
+	iz1 = zmap[iz];
+	if (Qwcs) dprintf(0,"z %d %d\n",iz,iz1);
 	if (iz1<0 || iz1>=nz) continue;
-	for (iy=0; iy<Ny(iptr[l]); iy++) {
-	  if (Qwcs) {
-	    y = (iy-Yref(iptr[l])) * Dy(iptr[l]) + Ymin(iptr[l]);
-	    iy1 = (int) ((y-ymin)/dy + yref);
-	    //dprintf(0,"y %d %d\n",iy,iy1);	    
-	  } else
-	    iy1 = iy;
-	  if (iy1<0 || iy1>=ny) continue;	  
-	  for (ix=0; ix<Nx(iptr[l]); ix++) {
-	    if (Qwcs) {
-	      x = (ix-Xref(iptr[l])) * Dx(iptr[l]) + Xmin(iptr[l]);	      
-	      ix1 = (int) ((x-xmin)/dx + xref);
-	      //dprintf(0,"x %d %d\n",ix,ix1);
-	    } else
-	      ix1 = ix;
-	    if (ix1<0 || ix1>=nx) continue;	    
-	    if (l==1) {  // initialize first time around
-	      if (CubeValue(iptr[0],ix1,iy1,iz1) == badval)
-		CubeValue(wptr,ix1,iy1,iz1) = 0.0;
-	      else
-		CubeValue(wptr,ix1,iy1,iz1) = 1.0;		
-	    } // accumulate
-	    if (CubeValue(iptr[l],ix,iy,iz) != badval) {
-	      CubeValue(iptr[0],ix1,iy1,iz1) += CubeValue(iptr[l],ix,iy,iz);
-	      CubeValue(wptr,ix1,iy1,iz1) += 1.0;
-	    } 
-	  } // ix
-	} // iy
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic) private(iy,ix)
+#endif
+	for (g=0; g<ng; g++) {        // each group writes its own output row
+	  int ix1, iy1 = ymap[grp[g]];
+	  if (iy1<0 || iy1>=ny) continue;
+	  for (iy=grp[g]; iy<grp[g+1]; iy++) {
+	    for (ix=0; ix<Nx(iptr[l]); ix++) {
+	      ix1 = xmap[ix];
+	      if (ix1<0 || ix1>=nx) continue;
+	      if (l==1) {  // initialize first time around
+		if (CubeValue(iptr[0],ix1,iy1,iz1) == badval)
+		  CubeValue(wptr,ix1,iy1,iz1) = 0.0;
+		else
+		  CubeValue(wptr,ix1,iy1,iz1) = 1.0;		
+	      } // accumulate
+	      if (CubeValue(iptr[l],ix,iy,iz) != badval) {
+		CubeValue(iptr[0],ix1,iy1,iz1) += CubeValue(iptr[l],ix,iy,iz);
+		CubeValue(wptr,ix1,iy1,iz1) += 1.0;
+	      } 
+	    } // ix
+	  } // iy
+	} // g
       } // iz
+      free(xmap);  free(ymap);  free(zmap);  free(grp);
     }
+#if defined(_OPENMP)
+#pragma omp parallel for private(iy,ix)
+#endif
     for (iz=0; iz<nz; iz++)
       for (iy=0; iy<ny; iy++)
-	for (ix=0; ix<nx; ix++) {
+	for (ix=0; ix<nx; ix++)
 	  if (CubeValue(wptr,ix,iy,iz) > 0)
 	    CubeValue(iptr[0],ix,iy,iz) /= CubeValue(wptr,ix,iy,iz);
-	  // CubeValue(iptr[0],ix,iy,iz) = CubeValue(wptr,ix,iy,iz);	  
+    for (iz=0; iz<nz; iz++)
+      for (iy=0; iy<ny; iy++)
+	for (ix=0; ix<nx; ix++) {
 	  if (CubeValue(iptr[0],ix,iy,iz) > m_max) m_max = CubeValue(iptr[0],ix,iy,iz);
 	  if (CubeValue(iptr[0],ix,iy,iz) < m_min) m_min = CubeValue(iptr[0],ix,iy,iz);
 	}
-    
+    free_image(wptr);
 	
     MapMin(iptr[0]) = m_min;
     MapMax(iptr[0]) = m_max;
@@ -200,6 +270,3 @@ local void do_combine()
     	warning("There were %d bad operations in dofie",badvalues);
     
 }
-
-
-
@@ -22,6 +22,7 @@
  *    11-oct-2020   3.7 optimized memory usage, speed up median computation
  *     4-dec-2020   3.8 qac mode
  *     1-dec-2022   3.12 qac mode when planes >= 0
+ *    19-oct-2026   3.14 parallel whole cube moments via merge_moment(), sketch= for median
  */
  
 #include <stdinc.h>
@@ -30,6 +31,8 @@
 #include <image.h>
 #include <moment.h> 
 
+#define NPART  256            /* number of partial moments merged for the whole cube */
+
 string defv[] = {
     "in=???\n       Input image filename",
     "min=\n         Minimum overrride",
@@ -39,6 +42,7 @@ string defv[] = {
     "npar=0\n       Number of fitting parameters assumed for chi2 calc (full data only)",
     "nppb=1\n       Optional correction 'number of points per beam' for chi2 calc",
     "median=f\n     Optional display of the median value",
+    "sketch=0\n     If > 0, compression of a quantile sketch used for median=",
     "torben=f\n     Use torben method for median instead",
     "robust=f\n     Compute robust median",
     "sratio=f\n     Optional display of the signed fluxes (FP-FN)/(FP+FN) ratio",
@@ -53,7 +57,7 @@ string defv[] = {
     "qac=f\n        QAC mode listing mean,rms,min,max",
     "fmt=%g\n       QAC format of floating point values",
     "label=\n       QAC label",
-    "VERSION=3.13a\n 19-jun-2023 PJT",
+    "VERSION=3.14\n 19-oct-2026 PJT",
     NULL,
 };
 
@@ -83,7 +87,7 @@ extern real median_torben(int n, real *x, real xmin, real xmax);
 void nemo_main(void)
 {
     int  i, j, k, ki;
-    real x, y, z, xmin, xmax, mean, sigma, skew, kurt,  bad, w, *data;
+    real x, y, z, xmin, xmax, mean, sigma, skew, kurt,  bad, w, *data = NULL;
     real dmin, dmax;
     real sum, sov, q1, q2, q3, tm;
     Moment m;
@@ -101,6 +105,7 @@ void nemo_main(void)
     int nplanes;
     int min_count, max_count;
     int maxmom = getiparam("maxmom");
+    int nsketch = getiparam("sketch");
     int maxpos[2];
     char slabel[32];
 
@@ -167,7 +172,9 @@ void nemo_main(void)
     Qtorben = getbparam("torben");
     Qmmcount = getbparam("mmcount");    
     if (Qtorben) Qmedian = TRUE;
-    if (Qmedian || Qrobust || Qtorben) {
+    if (Qtorben || Qrobust) nsketch = 0;
+    if (!Qmedian) nsketch = 0;
+    if ((Qmedian && nsketch==0) || Qrobust || Qtorben) {
       ndat = nx*ny*nz;
       dprintf(1,"Need spare array size %d\n",ndat);
       data = (real *) allocate(ndat*sizeof(real));
@@ -196,14 +203,49 @@ void nemo_main(void)
     if (Qall) {                 /* treat cube as one data block */
 
       ini_moment(&m,maxmom,ndat);
+      if (nsketch > 0) sketch_moment(&m,nsketch);
       ngood = 0;
-#if 0
-      // not working yet
-      #pragma omp parallel \
-	shared(ngood, nx,ny,nz, iptr,wptr,m, xmin,xmax,bad,Qhalf,Qmin,Qmax,Qbad,Qw,data,tabstr,Qmedian) \
-        private(i,j,k,x,w)
-      #pragma omp for
-#endif      
+      if (ndat == 0 && tabstr == NULL) {
+	/* rows in NPART fixed parts, merged in order, independent of the number of threads */
+	int ip, npart = MIN(ny*nz, NPART);
+	Moment *mp = (Moment *) allocate(npart*sizeof(Moment));
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic) private(i,j,k,x,w)
+#endif
+	for (ip=0; ip<npart; ip++) {
+	  real *xb = (real *) allocate(2*nx*sizeof(real));
+	  real *wb = (real *) allocate(2*nx*sizeof(real));
+	  long r, rmin = (long)ip*ny*nz/npart, rmax = (long)(ip+1)*ny*nz/npart;
+	  int nb;
+
+	  ini_moment(&mp[ip],maxmom,0);
+	  if (nsketch > 0) sketch_moment(&mp[ip],nsketch);
+	  for (r=rmin; r<rmax; r++) {
+	    j = r % ny;
+	    k = r / ny;
+	    for (i=0, nb=0; i<nx; i++) {
+	      x =  CubeValue(iptr,i,j,k);
+	      if (isnan(x)) continue;
+	      if (Qhalf && x>=0.0) continue;
+	      if (Qmin  && x<xmin) continue;
+	      if (Qmax  && x>xmax) continue;
+	      if (Qbad  && x==bad) continue;
+	      w = Qw ? CubeValue(wptr,i,j,k) : 1.0;
+	      xb[nb] = x;    wb[nb++] = w;
+	      if (Qhalf) { xb[nb] = -x;   wb[nb++] = w; }
+	    }
+	    accum_moment_n(&mp[ip],nb,xb,wb);
+	  }
+	  free(xb);
+	  free(wb);
+	}
+	for (ip=0; ip<npart; ip++) {
+	  merge_moment(&m,&mp[ip]);
+	  free_moment(&mp[ip]);
+	}
+	free(mp);
+      } else
       for (k=0; k<nz; k++) {
 	for (j=0; j<ny; j++) {
 	  for (i=0; i<nx; i++) {
@@ -216,7 +258,7 @@ void nemo_main(void)
 	    w = Qw ? CubeValue(wptr,i,j,k) : 1.0;
             accum_moment(&m,x,w);
 	    if (Qhalf && x<0) accum_moment(&m,-x,w);
-	    if (Qmedian) data[ngood++] = x;
+	    if (data) data[ngood++] = x;
 	    if (tabstr) fprintf(tabstr,"%g\n",x);
 	  }
 	}
@@ -263,7 +305,15 @@ void nemo_main(void)
 	printf ("Skewness and kurtosis  : %f %f\n",skew,kurt);
 	printf ("Sum and Sum%s  : %f %f\n",slabel,sum,sum*sov);   /* align trick */
 	printf ("Points per beam (map)  : %g\n",nppb0);
-	if (Qmedian) {
+	if (Qmedian && nsketch > 0) {
+	  q1 = quantile_moment(&m,0.25);
+	  q2 = median_moment(&m);
+	  q3 = quantile_moment(&m,0.75);
+	  tm = (q1 + 2*q2 + q3 ) / 4.0;
+	  printf ("Median (sketch)        : %f\n",q2);
+	  printf ("Q1,Q2,Q3               : %f %f %f\n",q1,q2,q3);
+	  printf ("TriMean                : %f\n",tm);
+	} else if (Qmedian) {
 	  if (Qtorben) {
 	    printf ("Median Torben          : %f (%d)\n",median_torben(ngood,data,min_moment(&m),max_moment(&m)),ngood);
 	  } else {
@@ -320,6 +370,7 @@ void nemo_main(void)
       printf("\n");
 
       ini_moment(&m,maxmom,ndat);
+      if (nsketch > 0) sketch_moment(&m,nsketch);
       for (ki=0; ki<nplanes; ki++) {
 	reset_moment(&m);
 	k = planes[ki];
@@ -338,7 +389,7 @@ void nemo_main(void)
 	    }
 	    w = Qw ? CubeValue(wptr,i,j,k) : 1.0;
             accum_moment(&m,x,w);
-	    if (Qmedian) data[ngood++] = x;
+	    if (data) data[ngood++] = x;
 	  }
 	}
 
@@ -364,7 +415,9 @@ void nemo_main(void)
 	if (Qsratio) {
 	  printf ("   %f",sratio_moment(&m));
 	}
-	if (Qmedian) {
+	if (Qmedian && nsketch > 0) {
+	  printf ("   %f",median_moment(&m));
+	} else if (Qmedian) {
 	  printf ("   %f",get_median(ngood,data));
 	  if (ndat>0) printf (" %f",median_moment(&m));
 	}
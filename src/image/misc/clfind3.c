@@ -1,6 +1,6 @@
 /*
  *
- * CLFIND3 : 
+ * CLFIND3 :
  *    Find clumps in a x-y-v data cube
  *    based on the algorithm described in
  *    Williams, de Geus, & Blitz 1994, ApJ, 428, 693
@@ -10,26 +10,33 @@
  *  Converted from fortran to IDL:          11 Nov 1995  jpw
  *  Complete rewrite using search3d:        29 Mar 2004  jpw
  *  Converted to C in NEMO as CLFIND3:      28 Feb 2013  pjt
- * 
+ *  V1.0: the IDL version (method=classic) finished, and a one pass
+ *        union-find version with the same assignment   19 Oct 2026  pjt
  *
+ *  The union-find method buckets the pixels by contour level once, and
+ *  going down the levels adds them to a disjoint-set forest of the
+ *  (26-connected) regions above the current level.  A region is then
+ *  classified by the clumps whose peak it contains, just like defclump
+ *  below does: none (new clump), one (extend it) or more (merger, pixels
+ *  go to the nearest peak).  Unions are done in parallel in slabs of
+ *  planes, and stitched serially across the slab boundaries.
  */
 
 #include <stdinc.h>
 #include <strlib.h>
 #include <getparam.h>
 #include <image.h>
-#include <moment.h>
-#include <axis.h>
-#include <mdarray.h>
 
 string defv[] = {
   "in=???\n             Input file name",
   "out=???\n            Output clump identification file name",
   "step=0.05\n          Contour step",
-  "start=1\n            Starting step",
+  "start=1\n            Lowest contour level",
+  "npixmin=5\n          Reject clumps with this many pixels or less",
+  "method=unionfind\n   unionfind, or classic (level by level, slow)",
   "levmin=\n            Test one level: min",
   "levmax=\n            Test one level: max",
-  "VERSION=0.1\n	28-feb-2013 PJT",
+  "VERSION=1.0\n	19-oct-2026 PJT",
   NULL,
 };
 
@@ -38,30 +45,50 @@ string usage = "ClumpFind in 2D or 3D";
 string cvsid = "$Id$";
 
 
-/* 
+/*
  * common clfindblk1,     infile,levs0,dlevs,ncl,clump_peak
  * common clfindblk2,     data,assign,nx,ny,nv,bx,by,bv
  */
 
+#define NCHUNK  64          /* chunks for the parallel bucket sort */
+#define MAXTILE 64          /* slabs for the parallel unions */
 
+#define LEV(k)  (levs0 + (k)*dlevs)
 
 local string  infile;      /* input data filename */
 local string  outfile;     /* output clump filename */
-local imageptr iptr=NULL;	
+local imageptr iptr=NULL;
+local imageptr optr=NULL;
 local int nx,ny,nz;        /* size of data cube */
+local int nvox;            /* nx*ny*nz */
 local real levs0;          /* starting level */
 local real dlevs;          /* delta contours */
+local int nlev;            /* number of levels */
+local real *data;          /* input data */
+local real *assign;        /* output clump id's, 0 is none */
 
-local int *idx, *idy, *idz; /* index into X,Y,Z coordinates */
-local int nid;              /* active number in index array */
+local int ncl = 0;         /* number of clumps so far */
+local int maxcl = 0;
+local int *cpeak = NULL;   /* [1..ncl] pixel index of the peak of a clump */
 
+local void read_data(void);
+local void defreg(real dmin, real dmax);
+local void clfind_classic(void);
+local void clfind_uf(void);
+local void testbad(int npixmin);
 
-nemo_main()
+void nemo_main()
 {
+  string method = getparam("method");
+  stream outstr;
+  real dmax;
+  int i;
+
   infile = getparam("in");
   outfile = getparam("out");
-  levs0 = getiparam("start");
+  levs0 = getrparam("start");
   dlevs = getrparam("step");
+  if (dlevs <= 0) error("step=%g must be positive",dlevs);
 
   read_data();
 
@@ -69,11 +96,34 @@ nemo_main()
     real levmin = getrparam("levmin");
     real levmax = getrparam("levmax");
     defreg(levmin,levmax);
+    return;
   }
+
+  dmax = levs0 - dlevs;
+  for (i=0; i<nvox; i++)
+    if (!isnan(data[i]) && data[i] > dmax) dmax = data[i];
+  nlev = dmax < levs0 ? 0 : 1 + (int)((dmax-levs0)/dlevs);
+  dprintf(0,"%d contour levels from %g in steps of %g\n",nlev,levs0,dlevs);
+
+  outstr = stropen(outfile,"w");
+  copy_image(iptr,&optr);
+  assign = Frame(optr);
+
+  if (streq(method,"classic"))
+    clfind_classic();
+  else if (streq(method,"unionfind"))
+    clfind_uf();
+  else
+    error("Unknown method=%s, use unionfind or classic",method);
+  testbad(getiparam("npixmin"));
+
+  minmax_image(optr);
+  write_image(outstr,optr);
+  strclose(outstr);
 }
 
 
-void read_data()
+local void read_data()
 {
   stream instr;
 
@@ -84,36 +134,513 @@ void read_data()
   nx = Nx(iptr);
   ny = Ny(iptr);
   nz = Nz(iptr);
-
-  idx = (int *) allocate(sizeof(int)*nx*ny*nz);
-  idy = (int *) allocate(sizeof(int)*nx*ny*nz);
-  idz = (int *) allocate(sizeof(int)*nx*ny*nx);
+  if ((double)nx*ny*nz >= INT_MAX)
+    error("Cube too large: %d x %d x %d",nx,ny,nz);
+  nvox = nx*ny*nz;
+  data = Frame(iptr);
 
   dprintf(0,"Read %s : [%d x %d x %d]\n",infile, nx,ny,nz);
 }
 
 
-void defreg(real dmin, real dmax)
+local void defreg(real dmin, real dmax)
+{
+  /* find all pixels between levmin and levmax */
+  int i, nid = 0;
+
+  for (i=0; i<nvox; i++)
+    if (dmin <= data[i]  && data[i] < dmax)
+      nid++;
+  dprintf(0,"defreq %g %g found %d pixels (%g%%)\n",dmin,dmax,nid,nid*100.0/nvox);
+}
+
+/*
+ * BAND: contour level a value belongs to, LEV(k) <= d < LEV(k+1),
+ *       -1 if below the lowest level (or NaN)
+ */
+
+local int band(real d)
+{
+  int k;
+
+  if (isnan(d) || d < levs0) return -1;
+  k = (int) floor((d-levs0)/dlevs);
+  while (k > 0 && d < LEV(k)) k--;
+  while (d >= LEV(k+1)) k++;
+  return MIN(k,nlev-1);
+}
+
+/*
+ * NEIGHBORS: the (up to) 26 neighbors of pixel p, returns their number
+ */
+
+local int neighbors(int p, int *q)
+{
+  int ix = p%nx, iy = (p/nx)%ny, iz = p/(nx*ny);
+  int dx, dy, dz, n = 0;
+
+  for (dz=-1; dz<=1; dz++) {
+    if (iz+dz < 0 || iz+dz >= nz) continue;
+    for (dy=-1; dy<=1; dy++) {
+      if (iy+dy < 0 || iy+dy >= ny) continue;
+      for (dx=-1; dx<=1; dx++) {
+	if (ix+dx < 0 || ix+dx >= nx) continue;
+	if (dx==0 && dy==0 && dz==0) continue;
+	q[n++] = p + dx + nx*(dy + ny*dz);
+      }
+    }
+  }
+  return n;
+}
+
+/*
+ * NEAREST: the clump (of n, in increasing order) with its peak nearest
+ *          to pixel p; on a tie the first one, as in defclump
+ */
+
+local int nearest(int p, int *ids, int n)
+{
+  int i, q, best = ids[0];
+  int ix = p%nx, iy = (p/nx)%ny, iz = p/(nx*ny);
+  long dx, dy, dz, d2, dmin = -1;
+
+  for (i=0; i<n; i++) {
+    q = cpeak[ids[i]];
+    dx = ix - q%nx;
+    dy = iy - (q/nx)%ny;
+    dz = iz - q/(nx*ny);
+    d2 = dx*dx + dy*dy + dz*dz;
+    if (dmin < 0 || d2 < dmin) {
+      dmin = d2;
+      best = ids[i];
+    }
+  }
+  return best;
+}
+
+local int newclump(int p)
 {
-  /* first find all pixels between levmin and levmax */
-  int ix, iy, iz;
-  real d;
-
-
-  nid = 0;
-  for (ix=0; ix<nx; ix++)
-    for (iy=0; iy<ny; iy++)
-      for (iz=0; iz<nz; iz++) {
-	d = CubeValue(iptr,ix,iy,iz);
-	if (dmin <= d  && d < dmax) {
-	  idx[nid]   = ix;
-	  idy[nid]   = iy;
-	  idz[nid++] = iz;
+  ncl++;
+  if (ncl >= maxcl) {
+    maxcl = 2*maxcl + 1024;
+    cpeak = (int *) reallocate(cpeak, maxcl*sizeof(int));
+  }
+  cpeak[ncl] = p;
+  return ncl;
+}
+
+local int cmp_int(const void *a, const void *b)
+{
+  return *(int *)a - *(int *)b;
+}
+
+local int cmp_peak(const void *a, const void *b)   /* high to low, then index */
+{
+  int pa = *(int *)a, pb = *(int *)b;
+
+  if (data[pa] > data[pb]) return -1;
+  if (data[pa] < data[pb]) return  1;
+  return pa - pb;
+}
+
+/*
+ * CLFIND_CLASSIC: defreg + defclump for each level, as the IDL code below
+ */
+
+local void clfind_classic(void)
+{
+  int *reg, *mark, *list, *rpix, *roff, *pix2, *ids, *q;
+  int i, j, k, m, n, p, nreg, nr, npix2, nids, nnew, nzero, stamp = 0;
+
+  reg  = (int *) allocate(nvox*sizeof(int));
+  mark = (int *) allocate(nvox*sizeof(int));
+  list = (int *) allocate(nvox*sizeof(int));
+  rpix = (int *) allocate(nvox*sizeof(int));
+  roff = (int *) allocate((nvox+2)*sizeof(int));
+  pix2 = (int *) allocate(nvox*sizeof(int));
+  ids  = (int *) allocate(nvox*sizeof(int));
+  q    = (int *) allocate(26*sizeof(int));
+
+  for (k=nlev-1; k>=0; k--) {
+    /* defreg: band pixels, regions in order of their peak */
+    for (i=0, n=0; i<nvox; i++) {
+      reg[i] = band(data[i])==k ? 0 : -1;
+      if (reg[i]==0) list[n++] = i;
+    }
+    qsort(list, n, sizeof(int), cmp_peak);
+    nreg = 0;
+    roff[1] = 0;
+    for (i=0, m=0; i<n; i++) {
+      if (reg[list[i]] != 0) continue;
+      nreg++;
+      reg[list[i]] = nreg;
+      rpix[m++] = list[i];
+      for (j=roff[nreg]; j<m; j++) {       /* flood fill in the band */
+	int l, nq = neighbors(rpix[j],q);
+	for (l=0; l<nq; l++)
+	  if (reg[q[l]]==0) {
+	    reg[q[l]] = nreg;
+	    rpix[m++] = q[l];
+	  }
+      }
+      roff[nreg+1] = m;
+    }
+
+    /* defclump: extend each region upwards */
+    nnew = 0;
+    for (nr=1; nr<=nreg; nr++) {
+      stamp++;
+      pix2[0] = rpix[roff[nr]];            /* the peak of the region */
+      mark[pix2[0]] = stamp;
+      for (j=0, npix2=1; j<npix2; j++) {
+	int l, nq = neighbors(pix2[j],q);
+	for (l=0; l<nq; l++)
+	  if (mark[q[l]] != stamp && band(data[q[l]]) >= k) {
+	    mark[q[l]] = stamp;
+	    pix2[npix2++] = q[l];
+	  }
+      }
+      for (j=0, nids=0, nzero=0; j<npix2; j++)
+	if (assign[pix2[j]] == 0)
+	  nzero++;
+	else
+	  ids[nids++] = (int) assign[pix2[j]];
+      if (nids == 0) {                    /* new clump */
+	qsort(pix2, npix2, sizeof(int), cmp_peak);
+	p = newclump(pix2[0]);
+	nnew++;
+	for (j=0; j<npix2; j++)
+	  assign[pix2[j]] = p;
+      } else if (nzero > 0) {
+	qsort(ids, nids, sizeof(int), cmp_int);
+	for (j=1, m=1; j<nids; j++)          /* uniq */
+	  if (ids[j] != ids[m-1]) ids[m++] = ids[j];
+	if (m == 1) {                       /* extend */
+	  for (j=0; j<npix2; j++)
+	    assign[pix2[j]] = ids[0];
+	} else {                            /* merge: nearest peak */
+	  for (j=roff[nr]; j<roff[nr+1]; j++)
+	    assign[rpix[j]] = nearest(rpix[j], ids, m);
 	}
       }
-  dprintf(0,"defreq %g %g found %d pixels (%g%%)\n",dmin,dmax,nid,nid*100.0/(nx*ny*nz));
+    }
+    dprintf(1,"Contour level %g: %d pixels %d regions %d new clumps\n",
+	    LEV(k), n, nreg, nnew);
+  }
+  free(reg);  free(mark);  free(list);  free(rpix);
+  free(roff); free(pix2);  free(ids);   free(q);
+}
+
+/*
+ *  Disjoint-set forest. During the parallel phase a slab [lo,hi) only
+ *  follows and changes links inside the slab; a root of the slab may
+ *  point outside it, which is the link to the rest of its set.
+ */
+
+local int *parent;         /* [nvox] the forest */
+local int *bnd;            /* [nvox] band() of each pixel */
 
+local int find_local(int p, int lo, int hi)
+{
+  int q;
+
+  for (;;) {
+    q = parent[p];
+    if (q == p || q < lo || q >= hi) return p;
+    if (parent[q] >= lo && parent[q] < hi)
+      parent[p] = parent[q];               /* path halving */
+    p = q;
+  }
 }
+
+local int find_global(int p)
+{
+  while (parent[p] != p) {
+    parent[p] = parent[parent[p]];
+    p = parent[p];
+  }
+  return p;
+}
+
+local int find_readonly(int p)
+{
+  while (parent[p] != p)
+    p = parent[p];
+  return p;
+}
+
+local void union_global(int a, int b)
+{
+  a = find_global(a);
+  b = find_global(b);
+  if (a < b)
+    parent[b] = a;
+  else if (b < a)
+    parent[a] = b;
+}
+
+typedef struct tile {
+  int lo, hi;              /* pixel index range of the slab */
+  int n, max;              /* pending cross-slab unions */
+  int *pair;
+} tile;
+
+local void union_local(tile *t, int a, int b)
+{
+  int pa;
+
+  a = find_local(a, t->lo, t->hi);
+  b = find_local(b, t->lo, t->hi);
+  if (a == b) return;
+  if (a < b) { pa = a; a = b; b = pa; }    /* link a under b */
+  pa = parent[a];
+  if (pa != a) {                           /* keep a's link outside */
+    if (parent[b] == b)
+      parent[b] = pa;
+    else {
+      if (t->n == t->max) {
+	t->max = 2*t->max + 256;
+	t->pair = (int *) reallocate(t->pair, 2*t->max*sizeof(int));
+      }
+      t->pair[2*t->n]   = pa;
+      t->pair[2*t->n+1] = b;
+      t->n++;
+    }
+  }
+  parent[a] = b;
+}
+
+local int lower_bound(int *a, int n, int v)   /* first i with a[i] >= v */
+{
+  int lo = 0, hi = n, mid;
+
+  while (lo < hi) {
+    mid = (lo+hi)/2;
+    if (a[mid] < v) lo = mid+1; else hi = mid;
+  }
+  return lo;
+}
+
+local int hslot(int *hash, int nhash, int *slot, int r)  /* open addressing */
+{
+  int h = ((unsigned)r*2654435761u) & (nhash-1);
+
+  while (hash[h] >= 0 && slot[hash[h]] != r)
+    h = (h+1) & (nhash-1);
+  return h;
+}
+
+local int *croot;          /* root of the clump peaks, for sorting */
+
+local int cmp_root(const void *a, const void *b)
+{
+  int ra = croot[*(int *)a], rb = croot[*(int *)b];
+
+  if (ra != rb) return ra < rb ? -1 : 1;
+  return *(int *)a - *(int *)b;
+}
+
+/*
+ * CLFIND_UF: one pass over the levels with a disjoint-set forest
+ */
+
+local void clfind_uf(void)
+{
+  int *order, *start, *hist, *cidx, *rkey, *hash, *slot, *speak, *sid;
+  int plane, nplane, ntile, nhash, nslot, i, j, k, c, n, p, h, nnew;
+  int *lst;
+  tile *tiles;
+
+  parent = (int *) allocate(nvox*sizeof(int));
+  bnd    = (int *) allocate(nvox*sizeof(int));
+  order  = (int *) allocate(nvox*sizeof(int));
+  start  = (int *) allocate((nlev+1)*sizeof(int));
+  hist   = (int *) allocate(NCHUNK*(nlev+1)*sizeof(int));
+
+  /* bucket sort the pixels by level, keeping them in index order */
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+  for (c=0; c<NCHUNK; c++) {
+    int i, k, *hc = hist + c*(nlev+1);
+    for (i=(long)nvox*c/NCHUNK; i<(long)nvox*(c+1)/NCHUNK; i++)
+      if ((k = bnd[i] = band(data[i])) >= 0) hc[k]++;
+  }
+  for (k=0, n=0; k<nlev; k++) {
+    start[k] = n;
+    for (c=0; c<NCHUNK; c++) {
+      i = hist[c*(nlev+1)+k];
+      hist[c*(nlev+1)+k] = n;
+      n += i;
+    }
+  }
+  start[nlev] = n;
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+  for (c=0; c<NCHUNK; c++) {
+    int i, k, *hc = hist + c*(nlev+1);
+    for (i=(long)nvox*c/NCHUNK; i<(long)nvox*(c+1)/NCHUNK; i++)
+      if ((k = bnd[i]) >= 0) order[hc[k]++] = i;
+  }
+  free(hist);
+  dprintf(1,"%d pixels above %g\n",n,levs0);
+
+  /* slabs of planes along the slowest axis */
+  plane  = nz > 1 ? nx*ny : nx;
+  nplane = nz > 1 ? nz : ny;
+  ntile  = MIN(nplane, MAXTILE);
+  tiles  = (tile *) allocate(ntile*sizeof(tile));
+  for (j=0; j<ntile; j++) {
+    tiles[j].lo = (int)((long)nplane*j/ntile) * plane;
+    tiles[j].hi = (int)((long)nplane*(j+1)/ntile) * plane;
+  }
+
+  for (k=nlev-1; k>=0; k--) {
+    lst = order + start[k];
+    n = start[k+1] - start[k];
+    if (n == 0) continue;
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (i=0; i<n; i++)
+      parent[lst[i]] = lst[i];
+
+    /* unions inside each slab */
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (j=0; j<ntile; j++) {
+      tile *t = tiles + j;
+      int i, l, nq, q[26];
+      int i0 = lower_bound(lst, n, t->lo), i1 = lower_bound(lst, n, t->hi);
+      t->n = 0;
+      for (i=i0; i<i1; i++) {
+	nq = neighbors(lst[i], q);
+	for (l=0; l<nq; l++) {
+	  if (q[l] < t->lo || q[l] >= t->hi) continue;
+	  if (bnd[q[l]] < k) continue;
+	  if (q[l] < lst[i] && bnd[q[l]] == k) continue;    /* done from q */
+	  union_local(t, lst[i], q[l]);
+	}
+      }
+    }
+
+    /* stitch the slabs */
+    for (j=0; j<ntile; j++)
+      for (i=0; i<tiles[j].n; i++)
+	union_global(tiles[j].pair[2*i], tiles[j].pair[2*i+1]);
+    for (j=1; j<ntile; j++) {
+      int l, nq, q[26], lo = tiles[j].lo;
+      for (i=lower_bound(lst,n,lo-plane); i<lower_bound(lst,n,lo+plane); i++) {
+	nq = neighbors(lst[i], q);
+	for (l=0; l<nq; l++) {
+	  if ((lst[i] < lo) == (q[l] < lo)) continue;    /* same side */
+	  if (bnd[q[l]] < k) continue;
+	  union_global(lst[i], q[l]);
+	}
+      }
+    }
+
+    /* sort the clumps by the root of their region */
+    croot = (int *) allocate((ncl+1)*sizeof(int));
+    cidx  = (int *) allocate((ncl+1)*sizeof(int));
+    rkey  = (int *) allocate((ncl+1)*sizeof(int));
+    for (c=1; c<=ncl; c++) {
+      croot[c] = find_global(cpeak[c]);
+      cidx[c-1] = c;
+    }
+    qsort(cidx, ncl, sizeof(int), cmp_root);
+    for (c=0; c<ncl; c++)
+      rkey[c] = croot[cidx[c]];
+
+    /* assign: extend, merge, or mark for a new clump */
+    nnew = 0;
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic,4096) reduction(+:nnew)
+#endif
+    for (i=0; i<n; i++) {
+      int p = lst[i], r = find_readonly(p);
+      int a = lower_bound(rkey, ncl, r), b = lower_bound(rkey, ncl, r+1);
+      if (b == a) {
+	assign[p] = -1;
+	nnew++;
+      } else if (b == a+1)
+	assign[p] = cidx[a];
+      else
+	assign[p] = nearest(p, cidx+a, b-a);
+    }
+    free(croot);  free(cidx);  free(rkey);
+
+    /* new clumps: peak of each new region, numbered from high to low */
+    nslot = 0;
+    if (nnew > 0) {
+      for (nhash=1024; nhash < 2*nnew; nhash *= 2)
+	continue;
+      hash  = (int *) allocate(nhash*sizeof(int));
+      slot  = (int *) allocate(nnew*sizeof(int));
+      speak = (int *) allocate(nnew*sizeof(int));
+      sid   = (int *) allocate(nnew*sizeof(int));
+      for (h=0; h<nhash; h++) hash[h] = -1;
+      for (i=0; i<n; i++) {
+	p = lst[i];
+	if (assign[p] != -1) continue;
+	h = hslot(hash, nhash, slot, find_global(p));
+	if (hash[h] < 0) {
+	  hash[h] = nslot;
+	  slot[nslot] = find_global(p);
+	  speak[nslot++] = p;
+	} else if (data[p] > data[speak[hash[h]]])
+	  speak[hash[h]] = p;
+      }
+      memcpy(sid, speak, nslot*sizeof(int));
+      qsort(sid, nslot, sizeof(int), cmp_peak);
+      for (j=0; j<nslot; j++) {            /* peaks become the slot's clump id */
+	h = hslot(hash, nhash, slot, find_global(sid[j]));
+	speak[hash[h]] = newclump(sid[j]);
+      }
+      for (i=0; i<n; i++) {
+	p = lst[i];
+	if (assign[p] == -1)
+	  assign[p] = speak[hash[hslot(hash, nhash, slot, find_global(p))]];
+      }
+      free(hash);  free(slot);  free(speak);  free(sid);
+    }
+    dprintf(1,"Contour level %g: %d pixels %d new clumps\n",LEV(k),n,nslot);
+  }
+  for (j=0; j<ntile; j++)
+    if (tiles[j].pair) free(tiles[j].pair);
+  free(tiles);
+  free(parent);  free(bnd);  free(order);  free(start);
+}
+
+/*
+ * TESTBAD: reject clumps with npixmin pixels or less, and renumber the
+ *          others in order of their peak value
+ */
+
+local void testbad(int npixmin)
+{
+  int *npix, *ids, *newid;
+  int i, c, nok = 0;
+
+  npix  = (int *) allocate((ncl+1)*sizeof(int));
+  ids   = (int *) allocate((ncl+1)*sizeof(int));
+  newid = (int *) allocate((ncl+1)*sizeof(int));
+  for (i=0; i<nvox; i++)
+    npix[(int)assign[i]]++;
+  for (c=1; c<=ncl; c++)
+    if (npix[c] > npixmin) ids[nok++] = cpeak[c];
+  qsort(ids, nok, sizeof(int), cmp_peak);
+  for (i=0; i<nok; i++)
+    newid[(int)assign[ids[i]]] = i+1;
+  for (i=0; i<nvox; i++)
+    assign[i] = newid[(int)assign[i]];
+  printf("%d clumps found (%d rejected)\n",nok,ncl-nok);
+  free(npix);  free(ids);  free(newid);
+}
+
 #if 0
 
 ;...................... START DEFREG ......................
@@ -18,10 +18,12 @@
  *      12-jun-08       removed tests for size_t < 0            WD
  *      03-oct-08       debugged error in debug_info reporting  WD
  *       4-jan-11       add local/static arrays to show where they go in the TESTBED version
+ *      19-oct-26       count calls and bytes for perf=                 pjt
  */
 
 #include <stdinc.h>
 #include <errno.h>
+#include <perf.h>
 
 /*   _FL are versions that report File and Line ; see WD notes in stdinc.h   */
 /*  @todo    consider mm_malloc() for efficiency ?    */
@@ -48,6 +50,10 @@ void *allocate_FL(size_t nb, const_string file, int line)
 	nemo_dprintfN(8,"[%s:%d]: allocated %lu bytes @ %p\n",file,line,nb,mem);
     else
 	nemo_dprintfN(8,"allocated %lu bytes @ %p\n",nb,mem);
+    if (perf_level) {
+        perf_add(PERF_ALLOC_CALLS, 1);
+        perf_add(PERF_ALLOC_BYTES, nb);
+    }
 
     return mem;
 }
@@ -71,6 +77,10 @@ void *reallocate_FL(void *bp, size_t nb, const_string file, int line)
 	nemo_dprintfN(8,"[%s:%d]: reallocated %lu bytes @ %p\n",file,line,nb,mem);
     else
 	nemo_dprintfN(8,"reallocated %lu bytes @ %p\n",nb,mem);
+    if (perf_level) {
+        perf_add(PERF_ALLOC_CALLS, 1);
+        perf_add(PERF_ALLOC_BYTES, nb);
+    }
 
     return mem;
 }
@@ -30,16 +30,88 @@
  *      30-sep-03  testing memcpy, and improved the testing
  *      20-sep-05  little and big endian versions
  *      14-may-12  optionally use the ffswapX routines from cfitsio
+ *      19-oct-26  2, 4 and 8 byte swaps in loops the compiler vectorises,
+ *                 with AVX-512/AVX2/x86_64 versions picked at run time
  */
 
 //#define HAVE_CFITSIO
 //#define HAVE_FFSWAP
 
 #include <stdinc.h>
+#include <stdint.h>
 #if defined(HAVE_CFITSIO)
 #include "fitsio2.h"
 #endif
 
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define SIMD_CLONES __attribute__((target_clones("avx512f","avx2","default")))
+#else
+#define SIMD_CLONES
+#endif
+
+#if defined(__GNUC__)
+/*
+ * the data need not be aligned, memcpy() of a word is a plain load/store;
+ * blocks of a fixed length are vectorised also at -O2
+ */
+
+#define SWAPBLK 32
+
+SIMD_CLONES local void bswap2(char *dat, size_t cnt)
+{
+    uint16_t v;
+    size_t i, k;
+
+    for (i = 0; i + SWAPBLK <= cnt; i += SWAPBLK, dat += 2*SWAPBLK)
+	for (k = 0; k < SWAPBLK; k++) {
+	    memcpy(&v, dat+2*k, 2);
+	    v = __builtin_bswap16(v);
+	    memcpy(dat+2*k, &v, 2);
+	}
+    for (k = 0; k < cnt - i; k++) {
+	memcpy(&v, dat+2*k, 2);
+	v = __builtin_bswap16(v);
+	memcpy(dat+2*k, &v, 2);
+    }
+}
+
+SIMD_CLONES local void bswap4(char *dat, size_t cnt)
+{
+    uint32_t v;
+    size_t i, k;
+
+    for (i = 0; i + SWAPBLK <= cnt; i += SWAPBLK, dat += 4*SWAPBLK)
+	for (k = 0; k < SWAPBLK; k++) {
+	    memcpy(&v, dat+4*k, 4);
+	    v = __builtin_bswap32(v);
+	    memcpy(dat+4*k, &v, 4);
+	}
+    for (k = 0; k < cnt - i; k++) {
+	memcpy(&v, dat+4*k, 4);
+	v = __builtin_bswap32(v);
+	memcpy(dat+4*k, &v, 4);
+    }
+}
+
+SIMD_CLONES local void bswap8(char *dat, size_t cnt)
+{
+    uint64_t v;
+    size_t i, k;
+
+    for (i = 0; i + SWAPBLK <= cnt; i += SWAPBLK, dat += 8*SWAPBLK)
+	for (k = 0; k < SWAPBLK; k++) {
+	    memcpy(&v, dat+8*k, 8);
+	    v = __builtin_bswap64(v);
+	    memcpy(dat+8*k, &v, 8);
+	}
+    for (k = 0; k < cnt - i; k++) {
+	memcpy(&v, dat+8*k, 8);
+	v = __builtin_bswap64(v);
+	memcpy(dat+8*k, &v, 8);
+    }
+}
+#endif
+
 void bswap(void *vdat, int len, int cnt)
 {
     char tmp, *dat = (char *) vdat;
@@ -60,6 +132,24 @@ void bswap(void *vdat, int len, int cnt)
             dat[len-1-k] = tmp;
         }
     }
+#elif defined(__GNUC__)
+    if (len==1)
+	return;
+    else if (len==2)
+        bswap2(dat,cnt);
+    else if (len==4)
+        bswap4(dat,cnt);
+    else if (len==8)
+        bswap8(dat,cnt);
+    else    /* the general SLOOOOOOOOOWE case */
+        while (cnt--) {
+            for(k=0; k<len/2; k++) {
+                tmp = dat[k];
+                dat[k] = dat[len-1-k];
+                dat[len-1-k] = tmp;
+            }
+            dat += len;
+        }
 #else
     if (len==1)
 	return;
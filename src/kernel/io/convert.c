@@ -2,72 +2,458 @@
  *  in situ data conversion routines:
  *      convert_d2f     double to float, loss of precision of course
  *      convert_f2d     float to double, random info added of course
+ *	convert_h2f, convert_h2d, convert_f2h, convert_d2h   same for halfp
  *
  *  work done IN SITU; either starting from the bottom upwards, or
  *  top downwards.
  *
+ *  The work is done in chunks by kernels on separate arrays, which the
+ *  compiler vectorises; with gcc on x86_64 they are compiled for AVX-512,
+ *  AVX2 and plain x86_64, and the best one is picked at run time. Halfp
+ *  uses the F16C instructions if the CPU has them, else a scalar version
+ *  that gives the same bits: round to nearest even, overflow to Inf,
+ *  NaN stays a (quiet) NaN. d2h rounds via float, which differs from a
+ *  direct conversion only for the rare doubles that round to a tie in float.
  *
  *     25-may-91  written for some new code?     PJT
- *     25-feb-92  amazing, had to make gcc2.0 happy PJT 
+ *     25-feb-92  amazing, had to make gcc2.0 happy PJT
  *     19-aug-92  added illegal address protection, <nemoinc>
  *                added convert_f2d but never tested...      PJT
  *     20-jun-01  gcc3
  *     11-dec-09  half-precision code added   PJT
+ *     19-oct-26  vectorised kernels with run time dispatch, size_t counts,
+ *                own halfp code (ieeehalfprecision.c did nothing on LP64)  PJT
  */
 
 #include <stdinc.h>
+#include <stdint.h>
 
-int convert_d2f(int n,double *from, float *to)
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define SIMD_CLONES __attribute__((target_clones("avx512f","avx2","default")))
+#define HAVE_F16C
+#include <immintrin.h>
+#else
+#define SIMD_CLONES
+#endif
+
+#define CHUNK  1024		/* elements per in situ chunk */
+
+/*
+ * kernels: n elements, source and destination do not overlap;
+ * blocks of a fixed length are vectorised also at -O2
+ */
+
+#define KBLK   32
+
+SIMD_CLONES local void d2f_n(size_t n, const double *restrict d, float *restrict f)
+{
+    size_t i, k;
+
+    for (i = 0; i + KBLK <= n; i += KBLK)
+	for (k = 0; k < KBLK; k++)
+	    f[i+k] = (float) d[i+k];
+    for (; i < n; i++)
+	f[i] = (float) d[i];
+}
+
+SIMD_CLONES local void f2d_n(size_t n, const float *restrict f, double *restrict d)
+{
+    size_t i, k;
+
+    for (i = 0; i + KBLK <= n; i += KBLK)
+	for (k = 0; k < KBLK; k++)
+	    d[i+k] = (double) f[i+k];
+    for (; i < n; i++)
+	d[i] = (double) f[i];
+}
+
+/*
+ * scalar halfp, bit for bit the same as F16C in round to nearest mode
+ */
+
+local uint16_t f2h_one(float f)
+{
+    uint32_t x, ax, m, r, rem, half;
+    uint16_t sign;
+    int shift;
+
+    memcpy(&x, &f, sizeof(x));
+    sign = (x >> 16) & 0x8000;
+    ax = x & 0x7fffffff;
+    if (ax >= 0x7f800000)			/* Inf or NaN */
+	return sign | 0x7c00 | (ax > 0x7f800000 ? 0x0200 | ((ax >> 13) & 0x03ff) : 0);
+    if (ax >= 0x477ff000)			/* rounds to 65536 or more */
+	return sign | 0x7c00;
+    if (ax >= 0x38800000) {			/* normal halfp */
+	r = (ax >> 13) - ((127 - 15) << 10);
+	rem = ax & 0x1fff;
+	if (rem > 0x1000 || (rem == 0x1000 && (r & 1))) r++;
+	return sign | r;
+    }
+    if (ax < 0x33000000)			/* 2^-25 or less: zero */
+	return sign;
+    m = (ax & 0x007fffff) | 0x00800000;		/* denormal halfp */
+    shift = 126 - (int)(ax >> 23);
+    r = m >> shift;
+    rem = m & ((1u << shift) - 1);
+    half = 1u << (shift - 1);
+    if (rem > half || (rem == half && (r & 1))) r++;
+    return sign | r;
+}
+
+local float h2f_one(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16, e = (h >> 10) & 0x1f, m = h & 0x03ff, x;
+    float f;
+
+    if (e == 0x1f)				/* Inf or NaN (made quiet) */
+	x = sign | 0x7f800000 | (m << 13) | (m ? 0x00400000 : 0);
+    else if (e > 0)
+	x = sign | ((e + 127 - 15) << 23) | (m << 13);
+    else if (m == 0)
+	x = sign;
+    else {					/* denormal: normalise */
+	e = 127 - 14;
+	while ((m & 0x0400) == 0) {
+	    m <<= 1;
+	    e--;
+	}
+	x = sign | (e << 23) | ((m & 0x03ff) << 13);
+    }
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+local void f2h_scalar(size_t n, const float *restrict f, uint16_t *restrict h)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+	h[i] = f2h_one(f[i]);
+}
+
+local void h2f_scalar(size_t n, const uint16_t *restrict h, float *restrict f)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+	f[i] = h2f_one(h[i]);
+}
+
+#if defined(HAVE_F16C)
+
+__attribute__((target("avx,f16c")))
+local void f2h_f16c(size_t n, const float *restrict f, uint16_t *restrict h)
+{
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+	_mm_storeu_si128((__m128i *)(h+i),
+			 _mm256_cvtps_ph(_mm256_loadu_ps(f+i), _MM_FROUND_TO_NEAREST_INT));
+    f2h_scalar(n-i, f+i, h+i);
+}
+
+__attribute__((target("avx,f16c")))
+local void h2f_f16c(size_t n, const uint16_t *restrict h, float *restrict f)
+{
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(f+i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(h+i))));
+    h2f_scalar(n-i, h+i, f+i);
+}
+
+#endif
+
+typedef void (*f2h_proc)(size_t, const float *restrict, uint16_t *restrict);
+typedef void (*h2f_proc)(size_t, const uint16_t *restrict, float *restrict);
+
+local f2h_proc f2h_n = NULL;
+local h2f_proc h2f_n = NULL;
+
+local void pick_halfp(void)
+{
+    f2h_n = f2h_scalar;
+    h2f_n = h2f_scalar;
+#if defined(HAVE_F16C)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("f16c")) {
+	f2h_n = f2h_f16c;
+	h2f_n = h2f_f16c;
+    }
+#endif
+}
+
+/*
+ * do the source and destination of n elements overlap?
+ */
+
+local bool overlap(const void *from, size_t flen, const void *to, size_t tlen, size_t n)
+{
+    const char *f = (const char *) from, *t = (const char *) to;
+
+    return t < f + n*flen && f < t + n*tlen;
+}
+
+int convert_d2f(size_t n, double *from, float *to)
 {
+    float tmp[CHUNK];
+    size_t i, m;
+
     if (from==NULL) error("convert_d2f: illegal from=NULL address");
     if (to==NULL)   error("convert_d2f: illegal to=NULL address");
     if (n<1) return 0;
 
-    while(n--)                     /* can be done in situ */
-	*to++ = *from++;
+    if (!overlap(from, sizeof(double), to, sizeof(float), n))
+	d2f_n(n, from, to);
+    else				/* in situ: bottom upwards */
+	for (i = 0; i < n; i += m) {
+	    m = MIN(CHUNK, n-i);
+	    d2f_n(m, from+i, tmp);
+	    memcpy(to+i, tmp, m*sizeof(float));
+	}
     return 1;
 }
 
-int convert_f2d(int n,float *from,double *to)
+int convert_f2d(size_t n, float *from, double *to)
 {
+    double tmp[CHUNK];
+    size_t i, m;
+
     if (from==NULL) error("convert_f2d: illegal from=NULL address");
     if (to==NULL)   error("convert_f2d: illegal to=NULL address");
     if (n<1) return 0;
 
-    from = from+n-1;               /* find the address at top */
-    to = to+n-1;
-
-    while(n--)                     /* can be done in situ */
-      *to-- = *from--;             /* assumer user didn't cheat */
+    if (!overlap(from, sizeof(float), to, sizeof(double), n))
+	f2d_n(n, from, to);
+    else				/* in situ: top downwards */
+	for (i = n; i > 0; i -= m) {
+	    m = MIN(CHUNK, i);
+	    f2d_n(m, from+i-m, tmp);
+	    memcpy(to+i-m, tmp, m*sizeof(double));
+	}
     return 1;
 }
 
-/* 
- * needs: ieeehalfprecision.c 
- * http://www.mathworks.com/matlabcentral/fileexchange/23173
- */
+int convert_h2f(size_t n, halfp *from, float *to)
+{
+    float tmp[CHUNK];
+    size_t i, m;
+
+    if (h2f_n == NULL) pick_halfp();
+    if (!overlap(from, sizeof(halfp), to, sizeof(float), n))
+	h2f_n(n, (uint16_t *) from, to);
+    else
+	for (i = n; i > 0; i -= m) {
+	    m = MIN(CHUNK, i);
+	    h2f_n(m, (uint16_t *) from+i-m, tmp);
+	    memcpy(to+i-m, tmp, m*sizeof(float));
+	}
+    return 0;
+}
+
+int convert_h2d(size_t n, halfp *from, double *to)
+{
+    float ftmp[CHUNK];
+    double dtmp[CHUNK];
+    size_t i, m;
+
+    if (h2f_n == NULL) pick_halfp();
+    for (i = n; i > 0; i -= m) {	/* top downwards, always via float */
+	m = MIN(CHUNK, i);
+	h2f_n(m, (uint16_t *) from+i-m, ftmp);
+	f2d_n(m, ftmp, dtmp);
+	memcpy(to+i-m, dtmp, m*sizeof(double));
+    }
+    return 0;
+}
 
-extern int singles2halfp(void *target, void *source, int numel);
-extern int doubles2halfp(void *target, void *source, int numel);
-extern int halfp2singles(void *target, void *source, int numel);
-extern int halfp2doubles(void *target, void *source, int numel);
+int convert_d2h(size_t n, double *from, halfp *to)
+{
+    float ftmp[CHUNK];
+    uint16_t htmp[CHUNK];
+    size_t i, m;
+
+    if (f2h_n == NULL) pick_halfp();
+    for (i = 0; i < n; i += m) {	/* bottom upwards, always via float */
+	m = MIN(CHUNK, n-i);
+	d2f_n(m, from+i, ftmp);
+	f2h_n(m, ftmp, htmp);
+	memcpy(to+i, htmp, m*sizeof(halfp));
+    }
+    return 0;
+}
+
+int convert_f2h(size_t n, float *from, halfp *to)
+{
+    uint16_t tmp[CHUNK];
+    size_t i, m;
+
+    if (f2h_n == NULL) pick_halfp();
+    if (!overlap(from, sizeof(float), to, sizeof(halfp), n))
+	f2h_n(n, from, (uint16_t *) to);
+    else
+	for (i = 0; i < n; i += m) {
+	    m = MIN(CHUNK, n-i);
+	    f2h_n(m, from+i, tmp);
+	    memcpy(to+i, tmp, m*sizeof(halfp));
+	}
+    return 0;
+}
+
+#if defined(TESTBED)
+
+#include <getparam.h>
+#include <time.h>
+
+string defv[] = {
+    "n=1000000\n    Number of elements per conversion",
+    "repeat=20\n    Number of times to repeat each for the timing",
+    "full=f\n       Check f2h on all 2^32 floats (else every 251st)",
+    "VERSION=1.0\n  19-oct-2026 PJT",
+    NULL,
+};
+
+string usage = "test and time the conversion and byte swap routines";
 
-int convert_h2f(int n,halfp *from,float *to)
+local double wall(void)
 {
-  return halfp2singles(to,from,n);
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
 }
 
-int convert_h2d(int n,halfp *from,double *to)
+/* the old element by element byte swap, as reference */
+
+local void bswap_old(void *vdat, int len, int cnt)
 {
-  return halfp2doubles(to,from,n);
+    char tmp, *dat = (char *) vdat;
+    int k;
+
+    while (cnt--) {
+	for (k = 0; k < len/2; k++) {
+	    tmp = dat[k];  dat[k] = dat[len-1-k];  dat[len-1-k] = tmp;
+	}
+	dat += len;
+    }
 }
 
-int convert_d2h(int n,double *from,halfp *to)
+typedef void (*swap_proc)(void *, int, int);
+
+local void time_swap(string name, swap_proc old, char *buf, int len, int n, int repeat)
 {
-  return doubles2halfp(to,from,n);  
+    double t0, t1, t2;
+    int r;
+
+    t0 = wall();
+    for (r = 0; r < repeat; r++) (old)(buf, len, n);
+    t1 = wall();
+    for (r = 0; r < repeat; r++) bswap(buf, len, n);
+    t2 = wall();
+    printf("%-10s %10.1f %10.1f %8.1f\n", name,
+	   (double)len*n*repeat/(t1-t0)/1048576.0,
+	   (double)len*n*repeat/(t2-t1)/1048576.0, (t1-t0)/(t2-t1));
 }
 
-int convert_f2h(int n,float *from,halfp *to)
+void nemo_main()
 {
-  return singles2halfp(to,from,n);  
+    size_t n = getiparam("n"), i, nbad;
+    int repeat = getiparam("repeat"), r;
+    bool Qfull = getbparam("full");
+    uint64_t x, step = Qfull ? 1 : 251;
+    double *d = (double *) allocate(n*sizeof(double));
+    float *f = (float *) allocate(n*sizeof(float)), *f1 = (float *) allocate(n*sizeof(float));
+    halfp *h = (halfp *) allocate(n*sizeof(halfp));
+    permanent uint16_t ha[65536], hb[65536];
+    permanent float fa[65536], fb[65536];
+    uint32_t u, v;
+    double t0, t1, t2;
+
+    if (f2h_n == NULL) pick_halfp();
+    dprintf(0,"halfp: %s\n", f2h_n == f2h_scalar ? "scalar" : "F16C");
+
+    /* halfp: all halfp to float, and the floats back */
+    for (u = 0; u < 65536; u++) ha[u] = u;
+    h2f_scalar(65536, ha, fa);
+    h2f_n(65536, ha, fb);
+    if (memcmp(fa, fb, sizeof(fa))) error("h2f: scalar and vector code differ");
+    f2h_n(65536, fa, hb);
+    for (u = 0, nbad = 0; u < 65536; u++)	/* NaNs come back quiet */
+	if (hb[u] != ha[u] && !((u & 0x7c00) == 0x7c00 && (u & 0x03ff) && hb[u] == (u | 0x0200)))
+	    nbad++;
+    if (nbad) error("h2f/f2h: %lu of 65536 do not come back", (unsigned long) nbad);
+    /* and (a sample of) all floats to halfp */
+    for (x = 0, nbad = 0; x < ((uint64_t)1 << 32); x += step*n) {
+	for (i = 0; i < n; i++) {
+	    v = (uint32_t)(x + i*step);
+	    memcpy(f+i, &v, sizeof(float));
+	}
+	f2h_n(n, f, (uint16_t *) h);
+	f2h_scalar(n, f, (uint16_t *) f1);
+	if (memcmp(h, f1, n*sizeof(halfp))) nbad++;
+    }
+    if (nbad) error("f2h: %lu differ between scalar and vector", (unsigned long) nbad);
+    dprintf(0,"halfp: scalar and vector code agree\n");
+
+    /* round trips, in situ */
+    for (i = 0; i < n; i++) d[i] = (double)i/n - 0.5;
+    convert_d2f(n, d, (float *) d);
+    convert_f2d(n, (float *) d, d);
+    for (i = 0; i < n; i++)
+	if (d[i] != (float)((double)i/n - 0.5)) error("d2f/f2d in situ: %lu", (unsigned long) i);
+    convert_d2h(n, d, (halfp *) d);
+    convert_h2d(n, (halfp *) d, d);
+    for (i = 0; i < n; i++)
+	if (ABS(d[i] - ((double)i/n - 0.5)) > 1.0/2048) error("d2h/h2d in situ: %lu", (unsigned long) i);
+    dprintf(0,"in situ conversions ok\n");
+
+    /* byte swaps, also unaligned and with a tail */
+    for (i = 0; i < 8*n; i++) ((char *) d)[i] = (char) (i*7 + i/13);
+    memcpy(f, d, 4*n);
+    for (r = 2; r <= 8; r *= 2) {		/* the old one undoes the new */
+	bswap((char *) d + 1, r, (4*n - 1)/r);
+	bswap_old((char *) d + 1, r, (4*n - 1)/r);
+	if (memcmp(d, f, 4*n)) error("bswap len=%d", r);
+    }
+    dprintf(0,"bswap ok\n");
+
+    /* timing, MB/s of the source; reference is the old or the scalar code */
+    printf("#          %10s %10s %8s\n", "ref MB/s", "new MB/s", "speedup");
+    for (i = 0; i < n; i++) d[i] = (double)i/n - 0.5;
+    t0 = wall();
+    for (r = 0; r < repeat; r++)
+	for (i = 0; i < n; i++) f[i] = d[i];
+    t1 = wall();
+    for (r = 0; r < repeat; r++) convert_d2f(n, d, f);
+    t2 = wall();
+    printf("%-10s %10.1f %10.1f %8.1f\n", "d2f", 8.0*n*repeat/(t1-t0)/1048576.0,
+	   8.0*n*repeat/(t2-t1)/1048576.0, (t1-t0)/(t2-t1));
+    t0 = wall();
+    for (r = 0; r < repeat; r++)
+	for (i = 0; i < n; i++) d[i] = f[i];
+    t1 = wall();
+    for (r = 0; r < repeat; r++) convert_f2d(n, f, d);
+    t2 = wall();
+    printf("%-10s %10.1f %10.1f %8.1f\n", "f2d", 4.0*n*repeat/(t1-t0)/1048576.0,
+	   4.0*n*repeat/(t2-t1)/1048576.0, (t1-t0)/(t2-t1));
+    t0 = wall();
+    for (r = 0; r < repeat; r++) f2h_scalar(n, f, (uint16_t *) h);
+    t1 = wall();
+    for (r = 0; r < repeat; r++) convert_f2h(n, f, h);
+    t2 = wall();
+    printf("%-10s %10.1f %10.1f %8.1f\n", "f2h", 4.0*n*repeat/(t1-t0)/1048576.0,
+	   4.0*n*repeat/(t2-t1)/1048576.0, (t1-t0)/(t2-t1));
+    t0 = wall();
+    for (r = 0; r < repeat; r++) h2f_scalar(n, (uint16_t *) h, f);
+    t1 = wall();
+    for (r = 0; r < repeat; r++) convert_h2f(n, h, f);
+    t2 = wall();
+    printf("%-10s %10.1f %10.1f %8.1f\n", "h2f", 2.0*n*repeat/(t1-t0)/1048576.0,
+	   2.0*n*repeat/(t2-t1)/1048576.0, (t1-t0)/(t2-t1));
+    time_swap("bswap2", bswap_old, (char *) d, 2, n, repeat);
+    time_swap("bswap4", bswap_old, (char *) d, 4, n, repeat);
+    time_swap("bswap8", bswap_old, (char *) d, 8, n, repeat);
 }
+
+#endif
@@ -45,6 +45,23 @@
  *   3.5   8-jun-13   pjt    eltcnt type fixed for 64bit so it handles > 2GB
  *   3.6   2-jan-24   pjt    subtle fix for items > 64bit; now using off_t and size_t
  *                           note that the removed while() loop can be 2-3 faster then for() when len > 1e5
+ *   3.7  19-oct-26   pjt    put_data_ran() with pwrite(), thread-safe on seekable streams
+ *        19-oct-26   pjt    count items and bytes for the perf= report
+ *   3.8  19-oct-26   pjt    large items through pipes in shared memory ($NEMOSHM)
+ *   3.9  19-oct-26   pjt    coerced reads convert in chunks with the vectorised
+ *                           convert.c kernels, also halfp to float/double
+ *
+ *  Pipes: with $NEMOSHM set to a size in bytes, plural items at least this
+ *  large that are written to a pipe (or fifo) are copied into a POSIX
+ *  shared memory object, and only a ShmMagic header with its name goes
+ *  through the pipe. The reader maps the object, and unlinks it right away,
+ *  so it disappears with the last mapping. This saves the kernel copies
+ *  and pipe buffer round trips of the byte stream, but the reader must be
+ *  a NEMO on the same host, so it is not the default. An object that cannot
+ *  be made (e.g. /dev/shm is full) falls back to the byte stream.
+ *  Objects are named /nemo.<pid>.<n> after the writer, which removes the
+ *  ones not read yet when it gets SIGPIPE, SIGTERM or SIGINT, and at exit
+ *  waits until the reader took them or closed the pipe.
  *
  *  Although the SWAP test is done on input for every item - for deferred
  *  input it may fail if in the mean time another file was read which was
@@ -57,19 +74,22 @@
 #include <stdinc.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <strlib.h>
 #include <filestruct.h>
 #include <extstring.h>
 #include "filesecret.h"
 #include <stdarg.h>
+#include <perf.h>
+#if defined(SHMPIPE)
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#endif
 
 
-extern int convert_d2f(int, double *, float  *);
-extern int convert_f2d(int, float  *, double *);
-extern int convert_h2f(int, halfp  *, float  *);
-extern int convert_h2d(int, halfp  *, double *);
-extern int convert_f2h(int, float  *, halfp  *);
-extern int convert_d2h(int, double *, halfp  *);
 #ifdef __MINGW32__
 #define fseeko fseek
 #define ftello ftell
@@ -336,6 +356,10 @@ void put_data_sub(
     ipt = makeitem(typ, tag, dat, dim);		/* make item wo/ copying    */
     if (! putitem(str, ipt)) 			/* output external rep.     */
 	error("put_data_sub: putitem failed");
+    if (perf_level) {
+	perf_add(PERF_WRITE_ITEMS, 1);
+	perf_add(PERF_WRITE_BYTES, datlen(ipt,0));
+    }
     freeitem(ipt, FALSE);			/* and reclaim storage      */
 }
 
@@ -369,11 +393,18 @@ void put_data_set(stream str, string tag, string typ, int dim1, ...)
     buf = (int *) copxstr(dim,sizeof(int));
     ipt = makeitem(typ,tag,NULL,buf);            /* make item but no copy */
     sspt->ss_ran = ipt;
-    puthdr(str,ipt);                           /* write the header right now */
+    puthdr(str,ipt,PlurMagic);                 /* write the header right now */
+    fflush(str);                            /* so pwrite() can bypass stdio */
 
     ItemPos(ipt) = ftello(str);                      /* begin of random data */
     ItemOff(ipt) = 0;                                   /* offset where I/O */
     sspt->ss_pos = ftello(str) + datlen(ipt,0);         /* end of random data */
+#if defined(__MINGW32__)
+    sspt->ss_pwrite = FALSE;
+#else
+    sspt->ss_pwrite = ItemPos(ipt) >= 0 &&       /* pipes can't seek/pwrite */
+                      lseek(fileno(str),0,SEEK_CUR) == ItemPos(ipt);
+#endif
 }
 
 /*
@@ -391,6 +422,13 @@ void put_data_tes(stream str, string tag)
     if (ipt == NULL) error("put_data_tes: item %s is not random",tag);
     ipt = sspt->ss_ran;
     if (!streq(tag,ItemTag(ipt))) error("put_data_tes: invalid tag name %s",tag);
+    if (sspt->ss_pwrite) {           /* reserve all of it, even if not written */
+        struct stat st;
+        if (fstat(fileno(str),&st) == 0 && st.st_size < sspt->ss_pos)
+            if (ftruncate(fileno(str),sspt->ss_pos) < 0)
+                error("put_data_tes: cannot extend file for tag %s",tag);
+        sspt->ss_pwrite = FALSE;
+    }
     fseeko(str,sspt->ss_pos,0);      /* go where we left off */
     sspt->ss_pos = 0L;              /* mark file i/o sequential again */
     sspt->ss_ran = NULL;            /* reset pointer to the random item */
@@ -400,6 +438,12 @@ void put_data_tes(stream str, string tag)
 /*
  * PUT_DATA_RAN: random acces output of data
  * Synopsis:   put_data_ran(str, tag, dat, offset, length)
+ *
+ * On a seekable stream the data are written with pwrite(2), which does
+ * not touch the stdio buffer or file position, and the stream table is
+ * only looked at, so different threads can write different parts of
+ * an item between put_data_set() and put_data_tes() without locking.
+ * On a pipe it falls back to fseeko/fwrite, and calls must be serial.
  */
 
 void put_data_ran(
@@ -411,17 +455,27 @@ void put_data_ran(
 {
     itemptr ipt;
     strstkptr sspt;
+    off_t pos;
+    size_t len;
 
-    sspt = findstream(str);
+    sspt = lookstream(str);
     ipt = sspt->ss_ran;
     if (ipt==NULL) error("put_data_ran: tag %s no random item",tag);
     if (!streq(tag,ItemTag(ipt))) error("put_data_ran: invalid tag name %s",tag);
-    offset *= ItemLen(ipt);     /* as input offset and length were  */
-    length *= ItemLen(ipt);     /* in units of itemlen !!! */
-    if (offset+length > datlen(ipt,0))
+    pos = (off_t) offset * ItemLen(ipt);     /* as input offset and length were  */
+    len = (size_t) length * ItemLen(ipt);    /* in units of itemlen !!! */
+    if (offset < 0 || length < 0 || pos+len > datlen(ipt,0))
         error("put_data_ran: tag %s cannot write beyond allocated boundary",tag);
-    fseeko(str,offset + ItemPos(ipt),0);
-    if (length != fwrite((char *)dat,sizeof(byte),length,str))
+    if (perf_level) {
+        perf_add(PERF_WRITE_ITEMS, length);
+        perf_add(PERF_WRITE_BYTES, len);
+    }
+    if (sspt->ss_pwrite) {
+        safepwrite(str, dat, len, ItemPos(ipt) + pos);
+        return;
+    }
+    fseeko(str,pos + ItemPos(ipt),0);
+    if (len != fwrite((char *)dat,sizeof(byte),len,str))
         error("put_data_ran: error writing tag %s",tag);
 }
 
@@ -438,21 +492,26 @@ void put_data_blocked(
 {
     itemptr ipt;
     strstkptr sspt;
-    int offset;
+    off_t offset;
+    size_t len;
 
     sspt = findstream(str);
     ipt = sspt->ss_ran;
     if (ipt==NULL) error("put_data_blocked: tag %s no random item",tag);
     if (!streq(tag,ItemTag(ipt))) error("put_data_blocked: invalid tag name %s",tag);
     offset = ItemOff(ipt);
-    length *= ItemLen(ipt);     /* in units of itemlen !!! */
-    if (offset+length > datlen(ipt,0))
+    len = (size_t) length * ItemLen(ipt);     /* in units of itemlen !!! */
+    if (offset+len > datlen(ipt,0))
         error("put_data_blocked: tag %s cannot write beyond allocated boundary",tag);
     // no fseek() needed in blocked() !!!!
     // fseeko(str,offset + ItemPos(ipt),0);
-    if (length != fwrite((char *)dat,sizeof(byte),length,str))
+    if (len != fwrite((char *)dat,sizeof(byte),len,str))
         error("put_data_blocked: error writing tag %s",tag);
-    ItemOff(ipt) += length;
+    ItemOff(ipt) += len;
+    if (perf_level) {
+        perf_add(PERF_WRITE_ITEMS, length);
+        perf_add(PERF_WRITE_BYTES, len);
+    }
 }
 
 #else
@@ -605,6 +664,10 @@ void get_data_sub(
     else if (dim != NULL && ItemDim(ipt) == NULL)
 	error("get_data_sub: item %s: can't copy scalar to plural", tag);
     (cop)(dat, 0, eltcnt(ipt,0), ipt, str);    	/* copy data from input     */ /*C++*/
+    if (perf_level) {
+	perf_add(PERF_READ_ITEMS, 1);
+	perf_add(PERF_READ_BYTES, datlen(ipt,0));
+    }
     if (sspt->ss_stp == -1)			/* was input at top level?  */
 	freeitem(ipt, TRUE);			/*   yes, free saved item   */
 }
@@ -684,6 +747,10 @@ void get_data_ran(
     if (ipt==NULL)
         error("get_data_ran: tag %s is not in random access mode",tag);
     copydata(dat,offset,length,ipt,str);
+    if (perf_level) {
+        perf_add(PERF_READ_ITEMS, length);
+        perf_add(PERF_READ_BYTES, (long long) length * ItemLen(ipt));
+    }
 }
 
 void get_data_blocked(
@@ -694,15 +761,19 @@ void get_data_blocked(
 ) {
     itemptr ipt;
     strstkptr sspt;
-    int offset;
+    off_t offset;
 
     sspt = findstream(str);
     ipt = sspt->ss_ran;
-    offset = ItemOff(ipt);
     if (ipt==NULL)
         error("get_data_blocked: tag %s is not in blocked access mode",tag);
+    offset = ItemOff(ipt);
     copydata(dat,offset,length,ipt,str);
     ItemOff(ipt) = offset+length;
+    if (perf_level) {
+        perf_add(PERF_READ_ITEMS, length);
+        perf_add(PERF_READ_BYTES, (long long) length * ItemLen(ipt));
+    }
 }
 
 #endif
@@ -911,8 +982,12 @@ local bool writeitem(stream str, itemptr ipt)
 
 local bool putitem(stream str, itemptr ipt)
 {
-    if (! puthdr(str, ipt))                     /* write item header        */
-        return FALSE;
+#if defined(SHMPIPE)
+    if (useshm(str, ipt) && putshm(str, ipt))	/* data in shared memory?   */
+	return TRUE;
+#endif
+    if (! puthdr(str, ipt, ItemDim(ipt) == NULL ? SingMagic : PlurMagic))
+        return FALSE;				/* write item header        */
     if (! streq(ItemTyp(ipt), SetType) && ! streq(ItemTyp(ipt), TesType))
 						/* an ordinary data item?   */
 	if (! putdat(str, ipt))                 /*   write item data        */
@@ -924,13 +999,8 @@ local bool putitem(stream str, itemptr ipt)
  * PUTHDR: write item header to stream.
  */
 
-local bool puthdr(stream str, itemptr ipt)
+local bool puthdr(stream str, itemptr ipt, short num)
 {
-    short num;
-
-    
-    num = (ItemDim(ipt) == NULL) ? SingMagic : PlurMagic;
-    						/* determine magic number   */
     if (fwrite((char *)&num, sizeof(short), 1, str) != 1)
 	return FALSE;				/* return FALSE on failure  */
     if (! putxstr(str, ItemTyp(ipt), sizeof(char)))
@@ -964,6 +1034,198 @@ local bool putdat(stream str, itemptr ipt)
     return fwrite((char*)ItemDat(ipt), sizeof(byte), len, str) == len;
 						/* write data to stream   */
 }
+
+#if defined(SHMPIPE)
+
+/*
+ * USESHM: should the data of this item go through shared memory?
+ */
+
+local bool useshm(stream str, itemptr ipt)
+{
+    permanent size_t shmmin = 0;
+    permanent bool firsttime = TRUE;
+    strstkptr sspt;
+    struct stat st;
+    string cp;
+
+    if (firsttime) {				/* $NEMOSHM: minimum bytes  */
+	cp = getenv("NEMOSHM");
+	shmmin = (cp != NULL && atol(cp) > 0) ? (size_t) atol(cp) : 0;
+	firsttime = FALSE;
+    }
+    if (shmmin == 0 || ItemDim(ipt) == NULL || ItemDat(ipt) == NULL)
+	return FALSE;
+    sspt = findstream(str);
+    if (sspt->ss_shm < 0)			/* only pipes and fifos     */
+	sspt->ss_shm = fstat(fileno(str), &st) == 0 && S_ISFIFO(st.st_mode);
+    return sspt->ss_shm && datlen(ipt, 0) >= shmmin;
+}
+
+/*
+ * Shared memory objects written, and perhaps not read yet; fd is their
+ * pipe, which tells (POLLERR) when the reader has gone.
+ */
+
+typedef struct {
+    char name[32];
+    int  fd;
+} shmobj;
+
+local shmobj *shmtab = NULL;
+local int nshm = 0, maxshm = 0;
+
+local bool shmexists(string name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd < 0) return FALSE;
+    close(fd);
+    return TRUE;
+}
+
+local bool shmreadergone(int fd)
+{
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = 0;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL));
+}
+
+local void addshm(string name, int fd)
+{
+    int i, n;
+
+    if (nshm == 0) {				/* first one: set handlers  */
+	int sigs[] = { SIGPIPE, SIGTERM, SIGINT };
+	struct sigaction sa, old;
+
+	if (shmtab == NULL) atexit(exitshm);
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sigshm;
+	sigemptyset(&sa.sa_mask);
+	for (i = 0; i < 3; i++)			/* but keep the program's   */
+	    if (sigaction(sigs[i], NULL, &old) == 0 && old.sa_handler == SIG_DFL)
+		sigaction(sigs[i], &sa, NULL);
+    }
+    if (nshm == maxshm) {			/* forget the ones read     */
+	for (i = n = 0; i < nshm; i++)
+	    if (shmexists(shmtab[i].name))
+		shmtab[n++] = shmtab[i];
+	nshm = n;
+	if (nshm >= maxshm/2) {
+	    maxshm = maxshm ? 2*maxshm : 16;
+	    shmtab = (shmobj *) reallocate(shmtab, maxshm*sizeof(shmobj));
+	}
+    }
+    strcpy(shmtab[nshm].name, name);
+    shmtab[nshm++].fd = fd;
+}
+
+/*
+ * UNLINKSHM: remove all objects not read (shm_unlink is just an unlink)
+ */
+
+local void unlinkshm(void)
+{
+    int i;
+
+    for (i = 0; i < nshm; i++)
+	shm_unlink(shmtab[i].name);
+    nshm = 0;
+}
+
+local void sigshm(int sig)
+{
+    unlinkshm();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/*
+ * WAITSHM: the reader may still want the objects sent down pipe fd (-1: all
+ * pipes), so wait until it has taken them (it unlinks them), or has closed
+ * the pipe.
+ */
+
+local void waitshm(int fd)
+{
+    struct timespec ts = { 0, 10000000 };	/* 10 ms */
+    bool wait;
+    int i, n;
+
+    do {
+	wait = FALSE;
+	for (i = n = 0; i < nshm; i++) {
+	    if (fd >= 0 && shmtab[i].fd != fd)
+		shmtab[n++] = shmtab[i];	/*   not ours: keep         */
+	    else if (!shmexists(shmtab[i].name))
+		continue;			/*   read: done with it     */
+	    else if (shmreadergone(shmtab[i].fd))
+		shm_unlink(shmtab[i].name);	/*   never will be          */
+	    else {
+		shmtab[n++] = shmtab[i];
+		wait = TRUE;
+	    }
+	}
+	nshm = n;
+	if (wait) nanosleep(&ts, NULL);
+    } while (wait);
+}
+
+local void exitshm(void)
+{
+    if (nshm == 0) return;
+    fflush(NULL);				/* headers must be sent     */
+    waitshm(-1);
+}
+
+/*
+ * PUTSHM: copy the data into a new shared memory object, and write a
+ * ShmMagic header with its name; FALSE if no object could be made.
+ */
+
+local bool putshm(stream str, itemptr ipt)
+{
+    permanent int seq = 0;
+    char name[32], *cp;
+    size_t len, n;
+    ssize_t k = 0;
+    int fd;
+
+    len = datlen(ipt, 0);
+    sprintf(name, "/nemo.%d.%d", (int) getpid(), seq++);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+	warning("putshm: cannot create %s, pipe falls back to bytes", name);
+	findstream(str)->ss_shm = 0;
+	return FALSE;
+    }
+    for (cp = (char *) ItemDat(ipt), n = len; n > 0; cp += k, n -= k)
+	if ((k = write(fd, cp, n)) <= 0)	/* unlike mmap(), write()   */
+	    break;				/* reports a full /dev/shm  */
+    close(fd);
+    if (n > 0) {
+	shm_unlink(name);
+	warning("putshm: cannot write %lu bytes to %s, pipe falls back to bytes",
+		(unsigned long) len, name);
+	findstream(str)->ss_shm = 0;
+	return FALSE;
+    }
+    dprintf(2, "putshm: %s %s %lu bytes\n", ItemTag(ipt), name, (unsigned long) len);
+    addshm(name, fileno(str));
+    if (perf_level)
+	perf_add(perf_counter("shm_bytes"), len);
+    if (! puthdr(str, ipt, ShmMagic) ||
+	  ! putxstr(str, name, sizeof(char)) ||
+	  fwrite((char *)&len, sizeof(size_t), 1, str) != 1)
+	error("putshm: cannot write header for %s", ItemTag(ipt));
+    return TRUE;
+}
+
+#endif
 
 /************************************************************************/
 /*                                 INPUT                                */
@@ -1079,11 +1341,13 @@ local itemptr gethdr(stream str)
     short num;
     string tag, typ = NULL;
     int *dim, *ip;  /* ISSWAP */
+    itemptr ipt;
     permanent bool firsttime = TRUE;
 
     if (fread(&num, sizeof(short), 1, str) != 1)/* read magic number*/
 	return NULL;				/*   return NULL on EOF     */
-    if (num == SingMagic || num == PlurMagic) {	/* new-style magic number?  */
+    if (num == SingMagic || num == PlurMagic || num == ShmMagic) {
+						/* new-style magic number?  */
 	typ = (string) getxstr(str, sizeof(char));
 						/*   read type string       */
 	if (typ == NULL)			/*   check for EOF          */
@@ -1118,7 +1382,7 @@ local itemptr gethdr(stream str)
 	    error("gethdr: EOF reading tag");
     } else
 	tag = NULL;				/*   item is not tagged     */
-    if (num == PlurMagic) {			/* are dimensions next?     */
+    if (num == PlurMagic || num == ShmMagic) {	/* are dimensions next?     */
 	dim = (int *) getxstr(str, sizeof(int));
 	if (dim == NULL)			/*   check for EOF          */
 	    error("gethdr: EOF reading dimensions");
@@ -1133,7 +1397,9 @@ local itemptr gethdr(stream str)
 #endif
     } else
 	dim = NULL;
-    return makeitem(typ, tag, NULL, dim);  	/* return item less data    */
+    ipt = makeitem(typ, tag, NULL, dim);	/* return item less data    */
+    ItemShm(ipt) = (num == ShmMagic);		/* with data to be mapped?  */
+    return ipt;
 } /* gethdr */
 /*
  * GETHDR: read a item header from a stream.
@@ -1148,8 +1414,8 @@ bool qsf(stream str)
 
     if (fread(&num, sizeof(short), 1, str) != 1)/* read magic number        */
 	return FALSE;				/*   return NULL on EOF     */
-    if (num == SingMagic || num == PlurMagic) {	/* new-style magic number?  */
-        return TRUE;
+    if (num == SingMagic || num == PlurMagic || num == ShmMagic) {
+        return TRUE;				/* new-style magic number?  */
     }
 #if defined(CHKSWAP)
     else {
@@ -1177,6 +1443,12 @@ local void getdat(itemptr ipt, stream str)
 {
     size_t dlen, elen;
 
+#if defined(SHMPIPE)
+    if (ItemShm(ipt)) {				/* data in shared memory?   */
+	getshm(ipt, str);			/*   then map it            */
+	return;
+    }
+#endif
     elen = eltcnt(ipt, 0);
     dlen = elen * ItemLen(ipt);                 /* count bytes of data	    */
 #if 0
@@ -1196,6 +1468,47 @@ local void getdat(itemptr ipt, stream str)
 	safeseek(str, dlen, 1);			/*   skip over data	    */
     }
 } /* getdat */
+
+#if defined(SHMPIPE)
+
+/*
+ * GETSHM: map the shared memory object named after a ShmMagic header, and
+ * unlink it, so it goes away with our mapping.
+ */
+
+local void getshm(itemptr ipt, stream str)
+{
+    string name;
+    size_t len;
+    void *dat;
+    int fd;
+
+    name = (string) getxstr(str, sizeof(char));
+    if (name == NULL)
+	error("getshm: EOF reading name for %s", ItemTag(ipt));
+    saferead(&len, sizeof(size_t), 1, str);
+    if (len != datlen(ipt, 0))
+	error("getshm: %s has %lu bytes, expected %lu", name,
+	      (unsigned long) len, (unsigned long) datlen(ipt, 0));
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+	error("getshm: cannot open %s for %s (not the same host as the writer?)",
+	      name, ItemTag(ipt));
+#if defined(MAP_POPULATE)
+    dat = mmap(NULL, len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+#else
+    dat = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+#endif
+    close(fd);
+    shm_unlink(name);
+    if (dat == MAP_FAILED)
+	error("getshm: cannot map %lu bytes of %s", (unsigned long) len, name);
+    dprintf(2, "getshm: %s %s %lu bytes\n", ItemTag(ipt), name, (unsigned long) len);
+    ItemDat(ipt) = dat;
+    free(name);
+}
+
+#endif
 
 /*
  * COPYFUN: select copy routine for given data types.
@@ -1209,6 +1522,10 @@ local copyproc copyfun(string srctyp, string destyp)
 	return (copyproc) copydata_f2d;
     if (streq(srctyp, DoubleType) && streq(destyp, FloatType))
 	return (copyproc) copydata_d2f;
+    if (streq(srctyp, HalfpType) && streq(destyp, FloatType))
+	return (copyproc) copydata_h2f;
+    if (streq(srctyp, HalfpType) && streq(destyp, DoubleType))
+	return (copyproc) copydata_h2d;
     return NULL;
 } /* copyfun */
 
@@ -1240,70 +1557,59 @@ local void copydata(
     }
 } /* copydata */
 
-local void copydata_f2d(
-    double *dat,
-    off_t off,
-    size_t len,
-    itemptr ipt,
-    stream str)
-{
-    float *src;
-    off_t oldpos;
-      
-    off *= ItemLen(ipt);
-    if (ItemDat(ipt) != NULL) {			/* data already in core?    */
-	src = (float *) ItemDat(ipt) + off;	/*   get pointer to source  */
-	/*    	len *= ItemLen(ipt);		==> BUG */
-	for (size_t i=0; i<len; i++)
-	    *dat++ = (double) *src++;		/*     float to double      */
-    } else {					/* time to read data in     */
-	oldpos = ftello(str);                   /*   save this position     */
-	safeseek(str, ItemPos(ipt) + off, 0);	/*   seek back to data      */
-	for (size_t i=0; i<len; i++)
-	    *dat++ = (double) getflt(str);	/*     float to double      */	  
-	safeseek(str, oldpos, 0);               /*   reset file pointer     */
-    }
-} /* copydata_f2d */
+/*
+ * COPYCVT - copy real or virtual data with a type conversion; data not
+ *	     in core is read and converted in chunks of CvtChunk elements.
+ */
+
+#define CvtChunk  4096
 
-local void copydata_d2f(
-    float *dat,
+local void copycvt(
+    char *dat,
     off_t off,
     size_t len,
     itemptr ipt,
-    stream str)
+    stream str,
+    cvtproc cvt,		/* conversion routine, see convert.c */
+    size_t dsiz)		/* size of a converted element */
 {
-    double *src;
+    double buf[CvtChunk];
+    size_t i, n;
     off_t oldpos;
-      
+
     off *= ItemLen(ipt);
     if (ItemDat(ipt) != NULL) {			/* data already in core?    */
-	src = (double *) ItemDat(ipt) + off;	/*   get pointer to source  */
-    	/* len *= ItemLen(ipt);		BUG <===	*/
-	for (size_t i=0; i<len; i++)
-	    *dat++ = (double) *src++;		/*     float to double      */	
+	(cvt)(len, (char *) ItemDat(ipt) + off, dat);
     } else {					/* time to read data in     */
 	oldpos = ftello(str);                   /*   save this position     */
 	safeseek(str, ItemPos(ipt) + off, 0);	/*   seek back to data      */
-	for (size_t i=0; i<len; i++)	
-	    *dat++ = (float) getdbl(str);	/*     double to float      */	
+	for (i = 0; i < len; i += n) {
+	    n = MIN(CvtChunk, len - i);
+	    saferead(buf, ItemLen(ipt), n, str);
+	    (cvt)(n, buf, dat + i*dsiz);
+	}
 	safeseek(str, oldpos, 0);               /*   reset file pointer     */
     }
-} /* copydata_d2f */
-
-local float getflt(stream str)
+} /* copycvt */
+
+local void copydata_f2d(double *dat, off_t off, size_t len, itemptr ipt, stream str)
 {
-    float x;
+    copycvt((char *) dat, off, len, ipt, str, (cvtproc) convert_f2d, sizeof(double));
+}
 
-    saferead((char *)&x, sizeof(float), 1, str);
-    return x; 
+local void copydata_d2f(float *dat, off_t off, size_t len, itemptr ipt, stream str)
+{
+    copycvt((char *) dat, off, len, ipt, str, (cvtproc) convert_d2f, sizeof(float));
 }
 
-local double getdbl(stream str)
+local void copydata_h2f(float *dat, off_t off, size_t len, itemptr ipt, stream str)
 {
-    double x;
+    copycvt((char *) dat, off, len, ipt, str, (cvtproc) convert_h2f, sizeof(float));
+}
 
-    saferead((char *)&x, sizeof(double), 1, str);
-    return x;
+local void copydata_h2d(double *dat, off_t off, size_t len, itemptr ipt, stream str)
+{
+    copycvt((char *) dat, off, len, ipt, str, (cvtproc) convert_h2d, sizeof(double));
 }
 
 local void saferead(
@@ -1329,6 +1635,31 @@ local void safeseek(
 	      offset, key);
 }
 
+#if defined(RANDOM)
+local void safepwrite(
+    stream str,
+    void *dat,
+    size_t len,
+    off_t pos)	      /* absolute position in the file */
+{
+#if defined(__MINGW32__)
+    error("safepwrite: not available");
+#else
+    ssize_t n;
+    char *cp = (char *) dat;
+
+    while (len > 0) {			/* pwrite may write less than asked */
+        n = pwrite(fileno(str), cp, len, pos);
+        if (n <= 0)
+            error("safepwrite: error writing %ld bytes at %ld",(long)len,(long)pos);
+        cp += n;
+        pos += n;
+        len -= n;
+    }
+#endif
+}
+#endif
+
 /************************************************************************/
 /*                               UTILITIES                              */
 /************************************************************************/
@@ -1400,6 +1731,12 @@ local void freeitem(
 {
     itemptr *ivp;
 
+#if defined(SHMPIPE)
+    if (flg && ItemShm(ipt) && ItemDat(ipt) != NULL) {
+	munmap(ItemDat(ipt), datlen(ipt, 0));	/* before dims are freed    */
+	ItemDat(ipt) = NULL;
+    }
+#endif
     if (flg && ItemTyp(ipt) != NULL) {		/* does item have a type?   */
 	if (streq(ItemTyp(ipt), SetType)) {	/*   free set recursively?  */
 	    ivp = (itemptr *) ItemDat(ipt);	/*     get vector of items  */
@@ -1514,11 +1851,31 @@ local strstkptr findstream(stream str)
 #if defined(RANDOM)
     stfree->ss_ran = NULL;                      /* mark as no item random   */
     stfree->ss_pos = 0L;                        /* set at start of file     */
+    stfree->ss_pwrite = FALSE;                  /* no pwrite() random I/O   */
+#endif
+#if defined(SHMPIPE)
+    stfree->ss_shm = -1;                        /* not checked for a pipe   */
 #endif
     last = stfree;                              /* mark for quick access    */
     return stfree;				/* return new slot	    */
 }
 
+/*
+ * LOOKSTREAM: as findstream(), for a stream known to be in the table,
+ * but without changing any state, so it can be called from threads.
+ */
+
+local strstkptr lookstream(stream str)
+{
+    strstkptr sspt;
+
+    for (sspt = strtable; sspt < strtable+StrTabLen; sspt++)
+	if (sspt->ss_str == str)
+	    return sspt;
+    error("lookstream: stream not in use");
+    return NULL;
+}
+
 local void ss_push(strstkptr sspt, itemptr ipt)
 {
     if (sspt->ss_stp++ == SetStkLen)		/* check stack overflow	    */
@@ -1553,6 +1910,12 @@ void strclose(stream str)
     sspt->ss_str = NULL;			/* remove from strtable	    */
     last = NULL;                                /* also removed quick access*/
     strdelete(str,FALSE);                       /* delete file if scratch   */
+#if defined(SHMPIPE)
+    if (nshm > 0) {				/* reader still to take our */
+	fflush(str);				/*   shared memory objects? */
+	waitshm(fileno(str));
+    }
+#endif
     fclose(str);				/* and close it up for sure */
 }
 
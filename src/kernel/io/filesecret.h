@@ -12,11 +12,17 @@
  *   3.5   8-jun-13   element counter type fixed to handle > 2B
  *   3.6  11-apr-19   increase StrTabLen from 64 to 1024 (Linux now handles 1024)
  *                    check with  'ulimit -n'
+ *   3.8  19-oct-26   ShmMagic: pipes can pass large items in shared memory
+ *   3.9  19-oct-26   halfp coercion, copycvt()
+ *        19-oct-26   writer removes the shared memory objects left unread
  */
  
 #define RANDOM  /* allow random access */
 #define CHKSWAP /* allow mixed endian datasets - 
                    this can be dangerous if you are multi-plexing them */
+#if !defined(__MINGW32__)
+#define SHMPIPE /* allow large items through pipes in shared memory */
+#endif
 
 /*
  * New-style magic numbers, for (bigendian) FITS type machines (like SUN)
@@ -26,6 +32,15 @@
 #define SingMagic  ((011<<8) + 0222)		/* singular items */
 #define PlurMagic  ((013<<8) + 0222)		/* plural items */
 
+/*
+ * A plural item whose data went into a POSIX shared memory object: the
+ * header is followed by the name of the object and its length (size_t)
+ * instead of the data. Only written to pipes, and only if $NEMOSHM is set,
+ * since the reader must run on the same host, with a NEMO that knows it.
+ */
+
+#define ShmMagic   ((015<<8) + 0222)		/* plural items, shared memory */
+
 /*
  * ITEM: structure representing data-token.
  */
@@ -38,6 +53,7 @@ typedef struct {
   void  *itemdat;		/* the real goodies, if any, or NULL */
   off_t  itempos;		/* where the item began in stream (i/o) */
   off_t  itemoff;               /* RAN/SEQ offset where the current data ptr is */
+  bool   itemshm;		/* itemdat is mmap()ed shared memory */
 } item, *itemptr;    
 
 #define ItemTyp(ip)  ((ip)->itemtyp)
@@ -47,6 +63,7 @@ typedef struct {
 #define ItemDat(ip)  ((ip)->itemdat)
 #define ItemPos(ip)  ((ip)->itempos)
 #define ItemOff(ip)  ((ip)->itemoff)
+#define ItemShm(ip)  ((ip)->itemshm)
 
 
 /*
@@ -65,6 +82,10 @@ typedef struct {
   int     ss_mode;                /* mode: 0=none 1=(still)sequential 2=random */
   off_t   ss_pos;                 /* tail of file, in case random access */
   itemptr ss_ran;                 /* pointer to random access item */
+  bool    ss_pwrite;              /* ss_ran is written with pwrite() */
+#endif
+#if defined(SHMPIPE)
+  int     ss_shm;                 /* -1=not known yet 0=bytes 1=shared memory */
 #endif
 } strstk, *strstkptr;
 
@@ -84,6 +105,7 @@ typedef struct {
 typedef void (*copyproc)  (void *,   off_t, size_t, itemptr, stream);
 typedef void (*copyproc_d)(double *, off_t, size_t, itemptr, stream);
 typedef void (*copyproc_f)(float *,  off_t, size_t, itemptr, stream);
+typedef int  (*cvtproc)   (size_t, void *, void *);	/* see convert.c */
 
 
 /*
@@ -94,8 +116,18 @@ typedef void (*copyproc_f)(float *,  off_t, size_t, itemptr, stream);
 
 local bool writeitem   ( stream str, itemptr ipt );
 local bool putitem     ( stream str, itemptr ipt );
-local bool puthdr      ( stream str, itemptr ipt );
+local bool puthdr      ( stream str, itemptr ipt, short num );
 local bool putdat      ( stream str, itemptr ipt );
+#if defined(SHMPIPE)
+local bool useshm      ( stream str, itemptr ipt );
+local bool putshm      ( stream str, itemptr ipt );
+local void addshm      ( string name, int fd );
+local void unlinkshm   ( void );
+local void sigshm      ( int sig );
+local void waitshm     ( int fd );
+local void exitshm     ( void );
+local void getshm      ( itemptr ipt, stream str );
+#endif
 local itemptr scantag  ( strstkptr sspt, string tag );
 local itemptr nextitem ( strstkptr sspt );
 local itemptr finditem ( strstkptr sspt, string tag );
@@ -105,18 +137,22 @@ local itemptr gethdr   ( stream str );
 local void getdat      ( itemptr ipt, stream str );
 local copyproc copyfun ( string srctyp, string destyp );
 local void copydata    ( void *dat,   off_t off, size_t len, itemptr ipt, stream str );
+local void copycvt     ( char *dat, off_t off, size_t len, itemptr ipt, stream str,
+			 cvtproc cvt, size_t dsiz );
 local void copydata_f2d( double *dat, off_t off, size_t len, itemptr ipt, stream str );
 local void copydata_d2f( float  *dat, off_t off, size_t len, itemptr ipt, stream str );
-local float getflt     ( stream str );
-local double getdbl    ( stream str );
+local void copydata_h2f( float  *dat, off_t off, size_t len, itemptr ipt, stream str );
+local void copydata_h2d( double *dat, off_t off, size_t len, itemptr ipt, stream str );
 local void saferead    ( void *dat, size_t siz, size_t cnt, stream str );
 local void safeseek    ( stream str, off_t offset, int key );
+local void safepwrite  ( stream str, void *dat, size_t len, off_t pos );
 local size_t eltcnt    ( itemptr ipt, int dimskp );
 local size_t datlen    ( itemptr ipt, int dimskp );
 local itemptr makeitem ( string typ, string tag, void *dat, int *dim );
 local void freeitem    ( itemptr ipt, bool flg);
 local size_t baselen   ( string typ );
 local strstkptr findstream ( stream str );
+local strstkptr lookstream ( stream str );
 local void ss_push     ( strstkptr sspt, itemptr ipt );
 local void ss_pop      ( strstkptr sspt );
 local string findtype  ( string *a, string type );
@@ -135,6 +135,7 @@
  * 20-Nov-10 WD    d  import environ on darwin (so allow dynamic lib)
  * 29-sep-11 PJT   e  new system keyword np= for OpenMP (and later others?)
  *  3-feb-14 PJT   f  fixed bug when using long filenames
+ * 19-oct-26 PJT 3.8   new system keyword perf= for a JSON timing/counter report
 
   TODO:
       - what if there is no VERSION=
@@ -178,7 +179,7 @@
 	opag      http://www.zero-based.org/software/opag/
  */
 
-#define GETPARAM_VERSION_ID  "3.7.1 30-jan-2024 PJT"
+#define GETPARAM_VERSION_ID  "3.8 19-oct-2026 PJT"
 
 /*************** BEGIN CONFIGURATION TABLE *********************/
 
@@ -215,6 +216,7 @@
 #include <stdlib.h>
 #include <strlib.h>
 #include <history.h>
+#include <perf.h>
 
 #ifndef __MINGW32__
 #include <sys/types.h>
@@ -420,6 +422,7 @@ local void set_tcl(string);
 local void set_yapp(string);
 local void set_outkeys(string);
 local void set_np(string);
+local void set_perf(string);
 local void local_error(string);
 local void local_exit(int);
 local void report(char);
@@ -609,6 +612,8 @@ void initparam(string argv[], string defv[])
 		set_outkeys(parvalue(argv[i]));
 	      else if (streq(name, "np"))      /*    number of processors? */
 		set_np(parvalue(argv[i]));
+	      else if (streq(name, "perf"))    /*    timing/counter report? */
+		set_perf(parvalue(argv[i]));
 	      else
 		error("Parameter \"%s\" unknown", name);
             } /* j>0 (i.e. program/system keyword) */
@@ -810,6 +815,10 @@ void finiparam()
     if (report_cpu) report('c');
     if (report_mem) report('m');
 #endif
+    if (perf_level) {
+      i = findkey("VERSION");
+      perf_report(progname, i > 0 ? keys[i].val : NULL);
+    }
     for (i=1; i<nkeys; i++)
         n += keys[i].upd ? 1 : 0;
 
@@ -980,6 +989,8 @@ local void scan_environment()
             set_error(parvalue(environ[i]));
         else if (streq("TCL", parname(environ[i])))
             set_tcl(parvalue(environ[i]));
+        else if (streq("PERF", parname(environ[i])))
+            set_perf(parvalue(environ[i]));
 	/* @TODO: should do OMP here as well */
     }
     dprintf(5, 
@@ -1345,6 +1356,7 @@ local void showsystem()
   printf("  argv=     addition cmdline arguments not parsed by NEMO\n");
   printf("  tcl=      go into tcl (deprecated)\n");
   printf("  np=       number of processors (OpenMP only currently) to use\n");
+  printf("  perf=     file (or - for stderr) for a JSON report of timers and counters\n");
 }
 /*
  * PRINTUSAGE: print out helpful usage info.
@@ -2994,6 +3006,11 @@ local void set_np(string arg)
     }
 }
 
+local void set_perf(string arg)
+{
+    perf_init(arg);
+}
+
 local void set_debug(string arg)
 {
     debug_level = atoi(arg);
@@ -0,0 +1,309 @@
+/*
+ * PERF: per phase timers and counters, enabled with the perf= system keyword
+ *
+ *	perf_start(name) ... perf_stop(name) bracket a named region, and
+ *	regions nest. The same name entered from a different parent is a
+ *	different node of the tree. Each node keeps its number of calls, the
+ *	wall clock and (process) cpu time spent in it, and by how much every
+ *	counter grew while it was active. The library counts structured
+ *	file I/O, allocations, and get_snap/put_snap regions; programs can add
+ *	their own regions and counters.
+ *
+ *	Regions are only recorded by the master thread outside of parallel
+ *	sections, so they may also be called from within; counters are
+ *	updated atomically from any thread. If perf= was not given, all
+ *	calls return immediately.
+ *
+ *	perf_report(), called by finiparam(), closes all regions and appends
+ *	the tree and the totals as one line of JSON to the perf= file ("-"
+ *	for stderr), so all programs of a pipeline (e.g. with $PERF set) can
+ *	share one file.
+ *
+ *	19-oct-2026	created			PJT
+ */
+
+#include <stdinc.h>
+#include <strlib.h>
+#include <perf.h>
+#include <time.h>
+#include <unistd.h>
+#if _OPENMP
+#include <omp.h>
+#endif
+
+int perf_level = 0;
+
+local string perf_file = NULL;
+
+local string cnames[PERF_MAXCOUNT] = {
+    "read_items", "read_bytes", "write_items", "write_bytes",
+    "alloc_calls", "alloc_bytes",
+};
+local int ncounters = PERF_NSYS;
+local long long counters[PERF_MAXCOUNT];
+
+typedef struct {
+    string name;
+    int    parent;		/* -1 for the root */
+    long   calls;
+    double wall, cpu;		/* accumulated */
+    double wall0, cpu0;		/* at the last perf_start */
+    long long cnt[PERF_MAXCOUNT];	/* accumulated */
+    long long cnt0[PERF_MAXCOUNT];	/* at the last perf_start */
+} pnode;
+
+local pnode *nodes = NULL;
+local int nnodes = 0, maxnodes = 0;
+local int current = -1;		/* the open region */
+
+local double wall_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+local double cpu_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+local bool master(void)
+{
+#if _OPENMP
+    return !omp_in_parallel();
+#else
+    return TRUE;
+#endif
+}
+
+local void open_node(int i)
+{
+    nodes[i].calls++;
+    nodes[i].wall0 = wall_time();
+    nodes[i].cpu0  = cpu_time();
+    memcpy(nodes[i].cnt0, counters, sizeof(counters));
+    current = i;
+}
+
+local void close_node(int i)
+{
+    int k;
+
+    nodes[i].wall += wall_time() - nodes[i].wall0;
+    nodes[i].cpu  += cpu_time()  - nodes[i].cpu0;
+    for (k=0; k<ncounters; k++)
+	nodes[i].cnt[k] += counters[k] - nodes[i].cnt0[k];
+    current = nodes[i].parent;
+}
+
+/*
+ * PERF_INIT: start recording, with the whole program as the root region
+ */
+
+void perf_init(string file)
+{
+    if (file == NULL || *file == 0) return;
+    if (perf_file) free(perf_file);		/* perf= overrides $PERF */
+    perf_file = scopy(file);
+    if (perf_level) return;
+    perf_level = 1;
+    perf_start("main");
+}
+
+void perf_start(string name)
+{
+    int i;
+
+    if (!perf_level || !master()) return;
+    for (i=0; i<nnodes; i++)
+	if (nodes[i].parent == current && streq(nodes[i].name, name))
+	    break;
+    if (i == nnodes) {
+	if (nnodes == maxnodes) {
+	    maxnodes = maxnodes ? 2*maxnodes : 32;
+	    nodes = (pnode *) reallocate(nodes, maxnodes*sizeof(pnode));
+	}
+	memset(&nodes[i], 0, sizeof(pnode));
+	nodes[i].name = scopy(name);
+	nodes[i].parent = current;
+	nnodes++;
+    }
+    open_node(i);
+}
+
+/*
+ * PERF_STOP: close the named region, and any still open inside it
+ */
+
+void perf_stop(string name)
+{
+    int i;
+
+    if (!perf_level || !master()) return;
+    for (i=current; i>0; i=nodes[i].parent)	/* never the root */
+	if (streq(nodes[i].name, name))
+	    break;
+    if (i <= 0) {
+	warning("perf_stop: region %s was not started", name);
+	return;
+    }
+    while (current != nodes[i].parent) {
+	if (current != i)
+	    warning("perf_stop: region %s closed by %s", nodes[current].name, name);
+	close_node(current);
+    }
+}
+
+/*
+ * PERF_COUNTER: the index of a (new) named counter, for perf_add()
+ */
+
+int perf_counter(string name)
+{
+    int i;
+
+    for (i=0; i<ncounters; i++)
+	if (streq(cnames[i], name)) return i;
+    if (ncounters == PERF_MAXCOUNT)
+	error("perf_counter: no room for counter %s", name);
+    cnames[ncounters] = scopy(name);
+    return ncounters++;
+}
+
+void perf_add(int counter, long long n)
+{
+    if (counter < 0 || counter >= ncounters) return;
+#if _OPENMP
+#pragma omp atomic
+#endif
+    counters[counter] += n;
+}
+
+/* JSON output */
+
+local void put_jstring(stream str, string s)
+{
+    fputc('"', str);
+    for (; *s; s++) {
+	if (*s == '"' || *s == '\\') fputc('\\', str);
+	if ((unsigned char) *s >= ' ') fputc(*s, str);
+    }
+    fputc('"', str);
+}
+
+local void put_counters(stream str, long long *cnt, bool all)
+{
+    int k, n = 0;
+
+    fprintf(str, "{");
+    for (k=0; k<ncounters; k++) {
+	if (!all && cnt[k] == 0) continue;
+	fprintf(str, "%s", n++ ? ", " : "");
+	put_jstring(str, cnames[k]);
+	fprintf(str, ": %lld", cnt[k]);
+    }
+    fprintf(str, "}");
+}
+
+local void put_node(stream str, int i)
+{
+    int j, n = 0;
+
+    fprintf(str, "{\"name\": ");
+    put_jstring(str, nodes[i].name);
+    fprintf(str, ", \"calls\": %ld, \"wall\": %.6f, \"cpu\": %.6f, \"counters\": ",
+	    nodes[i].calls, nodes[i].wall, nodes[i].cpu);
+    put_counters(str, nodes[i].cnt, FALSE);
+    for (j=i+1; j<nnodes; j++) {		/* children were made later */
+	if (nodes[j].parent != i) continue;
+	fprintf(str, n++ ? ", " : ", \"regions\": [");
+	put_node(str, j);
+    }
+    fprintf(str, n ? "]}" : "}");
+}
+
+/*
+ * PERF_REPORT: close all regions, and write the JSON report
+ */
+
+void perf_report(string prog, string version)
+{
+    stream str;
+    int nthreads = 1;
+
+    if (!perf_level) return;
+    while (current >= 0)
+	close_node(current);
+    if (streq(perf_file, "-"))
+	str = stderr;
+    else if ((str = fopen(perf_file, "a")) == NULL) {
+	warning("perf_report: cannot append to %s", perf_file);
+	return;
+    } else
+	setvbuf(str, NULL, _IOFBF, 1<<16);	/* one write(2) per report */
+#if _OPENMP
+    nthreads = omp_get_max_threads();
+#endif
+    fprintf(str, "{\"program\": ");
+    put_jstring(str, prog ? prog : "");
+    fprintf(str, ", \"version\": ");
+    put_jstring(str, version ? version : "");
+    fprintf(str, ", \"pid\": %d, \"threads\": %d", (int) getpid(), nthreads);
+    fprintf(str, ", \"wall\": %.6f, \"cpu\": %.6f, \"counters\": ",
+	    nodes[0].wall, nodes[0].cpu);
+    put_counters(str, counters, TRUE);
+    fprintf(str, ", \"regions\": [");
+    put_node(str, 0);
+    fprintf(str, "]}\n");
+    if (str != stderr) fclose(str);
+    perf_level = 0;
+}
+
+
+#ifdef TESTBED
+
+#include <getparam.h>
+
+string defv[] = {
+    "n=1000000\n    Number of loop iterations per region",
+    "VERSION=1.0\n  19-oct-2026 PJT",
+    NULL,
+};
+
+string usage = "testing perf regions, e.g. perftest perf=-";
+
+local double work(int n)
+{
+    double s = 0.0;
+    int i;
+
+    for (i=0; i<n; i++) s += sqrt((double) i);
+    return s;
+}
+
+void nemo_main()
+{
+    int i, n = getiparam("n"), cw = perf_counter("work_items");
+    double s = 0.0;
+    real *x;
+
+    perf_start("outer");
+    for (i=0; i<3; i++) {
+	perf_start("inner");
+	s += work(n);
+	PERF_ADD(cw, n);
+	perf_stop("inner");
+    }
+    x = (real *) allocate(n*sizeof(real));
+    perf_stop("outer");
+    perf_start("single");
+    s += work(n);
+    perf_stop("single");
+    free(x);
+    dprintf(1,"sum=%g\n", s);
+}
+
+#endif
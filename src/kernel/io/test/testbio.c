@@ -1,6 +1,7 @@
 /*
  * Test of Nemo's blocked i/o stuff
  *      2-jun-05   created       PJT
+ *     19-oct-26   ran=t: blocks written by put_data_ran() from threads  PJT
  *
  */
 
@@ -16,8 +17,9 @@ string defv[] = {
     "real=1.234\n  Real number to write (if out=)",
     "count=1\n     Number of reals/block to write",
     "blocks=1\n    Number of blocks to write",
-    "set=t\n       Wrap inside of a set/tes?"
-    "VERSION=1.4\n 7-jun-05 PJT",
+    "set=t\n       Wrap inside of a set/tes?",
+    "ran=f\n       Write blocks in parallel with put_data_ran()?",
+    "VERSION=1.5\n 19-oct-26 PJT",
     NULL,
 };
 
@@ -30,6 +32,7 @@ extern void get_nanf(float *);
 extern void get_nand(double *);
 
 static bool Qset;
+static bool Qran;
 static string setName = "TestingBlockIO";
 
 
@@ -87,6 +90,23 @@ void put_number(string name, real x, int n, int r)
     if (r==1) {
         put_data(str,"x",RealType,buf,n,0);
         put_data(str,"y",RealType,buf,n,0);
+    } else if (Qran) {
+        // each thread writes its own blocks, in any order
+        put_data_set(str,"x",RealType,nout,0);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (i=0;i<r;i++)
+            put_data_ran(str,"x",&buf[i*n],i*n,n);
+        put_data_tes(str,"x");
+
+        put_data_set(str,"y",RealType,nout,0);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (i=0;i<r;i++)
+            put_data_ran(str,"y",&buf[i*n],i*n,n);
+        put_data_tes(str,"y");
     } else {
 #if 1
       // the right way
@@ -125,7 +145,9 @@ void nemo_main()
     int count, random;
     string name;
     int work = 0;
-    bool Qset = getbparam("set");
+
+    Qset = getbparam("set");
+    Qran = getbparam("ran");
 
     x = getdparam("real");    
     count = getiparam("count");
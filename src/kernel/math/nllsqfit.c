@@ -127,6 +127,7 @@ Updates:      May  7, 1990: KGB, Document created.
               Jun 20, 2001: PJT  gcc3 prototpypes 
 	      Jul 12, 2002: PJT  allow wdat to be NULL, in which case all weights = 1 (deja vu???)
               Apr 18, 2004: PJT  fixed wdat normalization error for chi2 computation
+              Oct 19, 2026: PJT  reentrant: all state in a workspace on the stack
 
 */
 
@@ -159,26 +160,32 @@ Updates:      May  7, 1990: KGB, Document created.
 #define LABMIN  1.0e-10                         /* minimum value for labda */
 #define MAXPAR  32                              /* number of free parameters */
 
-static  real  chi1;                           /* old reduced chi-squared */
-static  real  chi2;                           /* new reduced chi-squared */
-static  real  labda;                          /* mixing parameter */
-static  real  tolerance;                      /* accuracy */
-static  real  vector[MAXPAR];                 /* correction vector */
-static  real  matrix1[MAXPAR][MAXPAR];        /* original matrix */
-static  real  matrix2[MAXPAR][MAXPAR];        /* inverse of matrix1 */
-static  int    itc;                            /* fate of fit */
-static  int    found;                          /* solution found ? */
-static  int    nfree;                          /* number of free parameters */
-static  int    nuse;                           /* number of useable data points */
-static  int    parptr[MAXPAR];                 /* parameter pointer */
+/*
+ * all state of a fit lives in a workspace on the stack of nllsqfit(),
+ * so different threads can fit at the same time (e.g. ccdfitspec)
+ */
 
 typedef real (*my_proc1)(real *, real *, int);
 typedef void (*my_proc2)(real *, real *, real *, int);
 
-static my_proc1 fitfunc_c;
-static my_proc2 fitderv_c;
-
-static int invmat()
+typedef struct nllsq_ws {
+   real  chi1;                             /* old reduced chi-squared */
+   real  chi2;                             /* new reduced chi-squared */
+   real  labda;                            /* mixing parameter */
+   real  tolerance;                        /* accuracy */
+   real  vector[MAXPAR];                   /* correction vector */
+   real  matrix1[MAXPAR][MAXPAR];          /* original matrix */
+   real  matrix2[MAXPAR][MAXPAR];          /* inverse of matrix1 */
+   int   itc;                              /* fate of fit */
+   int   found;                            /* solution found ? */
+   int   nfree;                            /* number of free parameters */
+   int   nuse;                             /* number of useable data points */
+   int   parptr[MAXPAR];                   /* parameter pointer */
+   my_proc1 fitfunc_c;
+   my_proc2 fitderv_c;
+} nllsq_ws;
+
+static int invmat(nllsq_ws *w)
 /*
  * invmat calculates the inverse of matrix2. The algorithm used is the
  * Gauss-Jordan algorithm described in Stoer, Numerische matematik, 1 Teil.
@@ -196,49 +203,49 @@ static int invmat()
    int   per[MAXPAR];
    int   row;
 
-   for (i = 0; i < nfree; i++) per[i] = i;      /* set permutation array */
-   for (j = 0; j < nfree; j++) {                /* in j-th column, ... */
-      rowmax = fabs( matrix2[j][j] );           /* determine row with ... */
+   for (i = 0; i < w->nfree; i++) per[i] = i;   /* set permutation array */
+   for (j = 0; j < w->nfree; j++) {             /* in j-th column, ... */
+      rowmax = fabs( w->matrix2[j][j] );        /* determine row with ... */
       row = j;                                  /* largest element. */
-      for (i = j + 1; i < nfree; i++) {
-         if (fabs( matrix2[i][j] ) > rowmax) {
-            rowmax = fabs( matrix2[i][j] );
+      for (i = j + 1; i < w->nfree; i++) {
+         if (fabs( w->matrix2[i][j] ) > rowmax) {
+            rowmax = fabs( w->matrix2[i][j] );
             row = i;
          }
       }
-      if (matrix2[row][j] == 0.0) return( -6 ); /* determinant is zero! */
+      if (w->matrix2[row][j] == 0.0) return( -6 ); /* determinant is zero! */
       if (row > j) {                            /* if largest element not ... */
-         for (k = 0; k < nfree; k++) {          /* on diagonal, then ... */
-            even = matrix2[j][k];               /* permutate rows. */
-            matrix2[j][k] = matrix2[row][k];
-            matrix2[row][k] = even;
+         for (k = 0; k < w->nfree; k++) {       /* on diagonal, then ... */
+            even = w->matrix2[j][k];            /* permutate rows. */
+            w->matrix2[j][k] = w->matrix2[row][k];
+            w->matrix2[row][k] = even;
          }
          evin = per[j];                         /* keep track of permutation */
          per[j] = per[row];
          per[row] = evin;
       }
-      even = 1.0 / matrix2[j][j];               /* modify column */
-      for (i = 0; i < nfree; i++) matrix2[i][j] *= even;
-      matrix2[j][j] = even;
+      even = 1.0 / w->matrix2[j][j];            /* modify column */
+      for (i = 0; i < w->nfree; i++) w->matrix2[i][j] *= even;
+      w->matrix2[j][j] = even;
       for (k = 0; k < j; k++) {
-         mjk = matrix2[j][k];
-         for (i = 0; i < j; i++) matrix2[i][k] -= matrix2[i][j] * mjk;
-         for (i = j + 1; i < nfree; i++) matrix2[i][k] -= matrix2[i][j] * mjk;
-         matrix2[j][k] = -even * mjk;
+         mjk = w->matrix2[j][k];
+         for (i = 0; i < j; i++) w->matrix2[i][k] -= w->matrix2[i][j] * mjk;
+         for (i = j + 1; i < w->nfree; i++) w->matrix2[i][k] -= w->matrix2[i][j] * mjk;
+         w->matrix2[j][k] = -even * mjk;
       }
-      for (k = j + 1; k < nfree; k++) {
-         mjk = matrix2[j][k];
-         for (i = 0; i < j; i++) matrix2[i][k] -= matrix2[i][j] * mjk;
-         for (i = j + 1; i < nfree; i++) matrix2[i][k] -= matrix2[i][j] * mjk;
-         matrix2[j][k] = -even * mjk;
+      for (k = j + 1; k < w->nfree; k++) {
+         mjk = w->matrix2[j][k];
+         for (i = 0; i < j; i++) w->matrix2[i][k] -= w->matrix2[i][j] * mjk;
+         for (i = j + 1; i < w->nfree; i++) w->matrix2[i][k] -= w->matrix2[i][j] * mjk;
+         w->matrix2[j][k] = -even * mjk;
       }
    }
-   for (i = 0; i < nfree; i++) {                /* finally, repermute the ... */
-      for (k = 0; k < nfree; k++) {             /* columns. */
-         hv[per[k]] = matrix2[i][k];
+   for (i = 0; i < w->nfree; i++) {             /* finally, repermute the ... */
+      for (k = 0; k < w->nfree; k++) {          /* columns. */
+         hv[per[k]] = w->matrix2[i][k];
       }
-      for (k = 0; k < nfree; k++) {
-         matrix2[i][k] = hv[k];
+      for (k = 0; k < w->nfree; k++) {
+         w->matrix2[i][k] = hv[k];
       }
    }
    return( 0 );                                 /* all is well */
@@ -246,6 +253,7 @@ static int invmat()
 
 
 static void getmat(                             /* build up the matrix */
+        nllsq_ws *w,
         real *xdat, int xdim, 
         real *ydat, real *wdat, real *ddat, int ndat,
         real *fpar, real *epar, int npar)
@@ -257,25 +265,25 @@ static void getmat(                             /* build up the matrix */
    int   j;
    int   n;
 
-   for (j = 0; j < nfree; j++) {
-      vector[j] = 0.0;                          /* zero vector ... */
+   for (j = 0; j < w->nfree; j++) {
+      w->vector[j] = 0.0;                       /* zero vector ... */
       for (i = 0; i <= j; i++) {                /* and matrix ... */
-         matrix1[j][i] = 0.0;                   /* only on and below diagonal */
+         w->matrix1[j][i] = 0.0;                /* only on and below diagonal */
       }
    }
-   chi2 = 0.0;                                  /* reset reduced chi-squared */
+   w->chi2 = 0.0;                               /* reset reduced chi-squared */
    for (n = 0; n < ndat; n++) {              /* loop trough data points */
       wn = wdat ? wdat[n] : 1.0;
       if (wn > 0.0) {                           /* legal weight ? */
-         (*fitderv_c)( &xdat[xdim * n], fpar, epar, npar );
-         yd = ydat[n] - (*fitfunc_c)( &xdat[xdim * n], fpar, npar );
+         (*w->fitderv_c)( &xdat[xdim * n], fpar, epar, npar );
+         yd = ydat[n] - (*w->fitfunc_c)( &xdat[xdim * n], fpar, npar );
          if (ddat) ddat[n] = yd;
-         chi2 += yd * yd * wn;                  /* add to chi-squared */
-         for (j = 0; j < nfree; j++) {
-            wd = epar[parptr[j]] * wn;          /* weighted derivative */
-            vector[j] += yd * wd;               /* fill vector */
+         w->chi2 += yd * yd * wn;               /* add to chi-squared */
+         for (j = 0; j < w->nfree; j++) {
+            wd = epar[w->parptr[j]] * wn;       /* weighted derivative */
+            w->vector[j] += yd * wd;            /* fill vector */
             for (i = 0; i <= j; i++) {          /* fill matrix */
-               matrix1[j][i] += epar[parptr[i]] * wd;
+               w->matrix1[j][i] += epar[w->parptr[i]] * wd;
             }
          }
       } 
@@ -283,6 +291,7 @@ static void getmat(                             /* build up the matrix */
 } /* getmat */
 
 static int getvec(
+    nllsq_ws *w,
     real *xdat, int xdim, 
     real *ydat, real *wdat, int ndat, 
     real *fpar, real *epar, int npar)
@@ -297,38 +306,38 @@ static int getvec(
    real dj, dy, mii, mjj, mji, wn;
    int   i, j, n, r;
 
-   for (j = 0; j < nfree; j++) {                /* loop to modify and ... */
-      mjj = matrix1[j][j];                      /* scale the matrix */
+   for (j = 0; j < w->nfree; j++) {             /* loop to modify and ... */
+      mjj = w->matrix1[j][j];                   /* scale the matrix */
       if (mjj <= 0.0) return( -5 );             /* diagonal element wrong! */ 
       mjj = sqrt( mjj );
       for (i = 0; i < j; i++) {                 /* scale it */
-         mji = matrix1[j][i] / mjj / sqrt( matrix1[i][i] );
-         matrix2[i][j] = mji;
-	 matrix2[j][i] = mji;
+         mji = w->matrix1[j][i] / mjj / sqrt( w->matrix1[i][i] );
+         w->matrix2[i][j] = mji;
+	 w->matrix2[j][i] = mji;
       }
-      matrix2[j][j] = 1.0 + labda;              /* scaled value on diagonal */
+      w->matrix2[j][j] = 1.0 + w->labda;        /* scaled value on diagonal */
    }
-   if ((r = invmat( ))) return( r );              /* invert matrix inplace */
+   if ((r = invmat( w ))) return( r );              /* invert matrix inplace */
    for (i = 0; i < npar; i++) epar[i] = fpar[i];
-   for (j = 0; j < nfree; j++) {                /* loop to calculate ... */
+   for (j = 0; j < w->nfree; j++) {             /* loop to calculate ... */
       dj = 0.0;                                 /* correction vector */
-      mjj = matrix1[j][j];
+      mjj = w->matrix1[j][j];
       if (mjj <= 0.0) return( -7 );             /* not allowed! */
       mjj = sqrt( mjj );
-      for (i = 0; i < nfree; i++) {
-         mii = matrix1[i][i];
+      for (i = 0; i < w->nfree; i++) {
+         mii = w->matrix1[i][i];
          if (mii <= 0.0) return( -7 );
          mii = sqrt( mii );
-         dj += vector[i] * matrix2[j][i] / mjj / mii;
+         dj += w->vector[i] * w->matrix2[j][i] / mjj / mii;
       }
-      epar[parptr[j]] += dj;                    /* new parameters */
+      epar[w->parptr[j]] += dj;                 /* new parameters */
    }
-   chi1 = 0.0;                                  /* reset reduced chi-squared */
+   w->chi1 = 0.0;                               /* reset reduced chi-squared */
    for (n = 0; n < ndat; n++) {                 /* loop through data points */
       wn = wdat ? wdat[n] : 1.0;                /* get weight */
       if (wn > 0.0) {                           /* legal weight */
-         dy = ydat[n] - (*fitfunc_c)( &xdat[xdim * n], epar, npar );
-         chi1 += wn * dy * dy;
+         dy = ydat[n] - (*w->fitfunc_c)( &xdat[xdim * n], epar, npar );
+         w->chi1 += wn * dy * dy;
       }
    }
    return( 0 );
@@ -352,57 +361,58 @@ int nllsqfit(
     my_proc2 df)
 {
    int   i, n, r;
-
-   fitfunc_c = f;                       /* save for local routines */
-   fitderv_c = df;
-   itc = 0;                             /* fate of fit */
-   found = 0;                           /* reset */
-   nfree = 0;                           /* number of free parameters */
-   nuse = 0;                            /* number of legal data points */
+   nllsq_ws ws, *w = &ws;
+
+   w->fitfunc_c = f;                    /* save for local routines */
+   w->fitderv_c = df;
+   w->itc = 0;                          /* fate of fit */
+   w->found = 0;                        /* reset */
+   w->nfree = 0;                        /* number of free parameters */
+   w->nuse = 0;                         /* number of legal data points */
    if (tol < (FLT_EPSILON * 10.0)) {
-      tolerance = FLT_EPSILON * 10.0;   /* default tolerance */
+      w->tolerance = FLT_EPSILON * 10.0; /* default tolerance */
    } else {
-      tolerance = tol;                 /* tolerance */
+      w->tolerance = tol;              /* tolerance */
    }
-   labda = fabs( lab ) * LABFAC;       /* start value for mixing parameter */
+   w->labda = fabs( lab ) * LABFAC;    /* start value for mixing parameter */
    for (i = 0; i < npar; i++) {
       epar[i] = 0.0;
       if (mpar[i]) {
-         if (nfree > MAXPAR) return( -1 );      /* too many free parameters */
-         parptr[nfree++] = i;           /* a free parameter */
+         if (w->nfree > MAXPAR) return( -1 );   /* too many free parameters */
+         w->parptr[w->nfree++] = i;     /* a free parameter */
       }
    }
-   if (nfree == 0) {
-     if (labda == 0.0) 
+   if (w->nfree == 0) {
+     if (w->labda == 0.0) 
        warning("Not computing differences properly");
-     getmat( xdat, xdim, ydat, wdat, ddat, ndat, fpar, epar, npar ); /* get diff */
+     getmat( w, xdat, xdim, ydat, wdat, ddat, ndat, fpar, epar, npar ); /* get diff */
      return -2;           /* no free parameters */
    }
    for (n = 0; n < ndat; n++) {
-     if (wdat && wdat[n] > 0.0) nuse++;        /* legal weight */
-     else nuse++;
+     if (wdat && wdat[n] > 0.0) w->nuse++;     /* legal weight */
+     else w->nuse++;
    }
-   if (nfree >= nuse) return( -3 );     /* no degrees of freedom */
+   if (w->nfree >= w->nuse) return( -3 ); /* no degrees of freedom */
 
-   if (labda == 0.0) {                  /* linear fit */
+   if (w->labda == 0.0) {               /* linear fit */
 
-      for (i = 0; i < nfree; fpar[parptr[i++]] = 0.0);
-      getmat( xdat, xdim, ydat, wdat, ddat, ndat, fpar, epar, npar );
-      r = getvec( xdat, xdim, ydat, wdat, ndat, fpar, epar, npar );
+      for (i = 0; i < w->nfree; fpar[w->parptr[i++]] = 0.0);
+      getmat( w, xdat, xdim, ydat, wdat, ddat, ndat, fpar, epar, npar );
+      r = getvec( w, xdat, xdim, ydat, wdat, ndat, fpar, epar, npar );
       if (r) return( r );               /* error */
       for (i = 0; i < npar; i++) {
          fpar[i] = epar[i];             /* save new parameters */
          epar[i] = 0.0;                 /* and set errors to zero */
       }
-      chi1 = sqrt( chi1 / (real) (nuse - nfree) );
-      for (i = 0; i < nfree; i++) {
-         if ((matrix1[i][i] <= 0.0) || (matrix2[i][i] <= 0.0)) return( -7 );
-         epar[parptr[i]] = chi1 * sqrt( matrix2[i][i] ) / sqrt( matrix1[i][i] );
+      w->chi1 = sqrt( w->chi1 / (real) (w->nuse - w->nfree) );
+      for (i = 0; i < w->nfree; i++) {
+         if ((w->matrix1[i][i] <= 0.0) || (w->matrix2[i][i] <= 0.0)) return( -7 );
+         epar[w->parptr[i]] = w->chi1 * sqrt( w->matrix2[i][i] ) / sqrt( w->matrix1[i][i] );
       }
       /* somehow ddat is not set in linear mode in getmat()..... */
       if (ddat) {
 	for (n = 0; n < ndat; n++) {
-	  ddat[n] = ydat[n] - (*fitfunc_c)( &xdat[xdim * n], fpar, npar );
+	  ddat[n] = ydat[n] - (*w->fitfunc_c)( &xdat[xdim * n], fpar, npar );
 	}
       }
 
@@ -422,17 +432,17 @@ int nllsqfit(
        * errors of the fitted parameters.
        */
 
-      while (!found) {                          /* iteration loop */
-         if (itc++ == its) return( -4 );     /* increase iteration counter */
-         getmat( xdat, xdim, ydat, wdat, ddat, ndat, fpar, epar, npar );
+      while (!w->found) {                       /* iteration loop */
+         if (w->itc++ == its) return( -4 );  /* increase iteration counter */
+         getmat( w, xdat, xdim, ydat, wdat, ddat, ndat, fpar, epar, npar );
          /*
           * here we decrease labda since we may assume that each iteration
           * brings us closer to the answer.
           */
-         if (labda > LABMIN) labda /= LABFAC;   /* decrease labda */
-         r = getvec( xdat, xdim, ydat, wdat, ndat, fpar, epar, npar );
+         if (w->labda > LABMIN) w->labda /= LABFAC; /* decrease labda */
+         r = getvec( w, xdat, xdim, ydat, wdat, ndat, fpar, epar, npar );
          if (r) return( r );            /* error */
-         while (chi1 >= chi2) {         /* interpolation loop */
+         while (w->chi1 >= w->chi2) {   /* interpolation loop */
             /*
              * The next statement is based on experience, not on the
              * mathematics of the problem although I (KGB) think that it
@@ -441,56 +451,56 @@ int nllsqfit(
              * a better solution. Think about this somewhat more, anyway,
              * as already stated, the next statement is based on experience.
              */
-            if (labda > LABMAX) break;  /* assume solution found */
-            labda *= LABFAC;            /* Increase mixing parameter */
-            r = getvec( xdat, xdim, ydat, wdat, ndat, fpar, epar, npar );
+            if (w->labda > LABMAX) break; /* assume solution found */
+            w->labda *= LABFAC;         /* Increase mixing parameter */
+            r = getvec( w, xdat, xdim, ydat, wdat, ndat, fpar, epar, npar );
             if (r) return( r );         /* error */
          }
-         if (labda <= LABMIN) {         /* save old parameters */
+         if (w->labda <= LABMIN) {      /* save old parameters */
             for (i = 0; i < npar; i++) fpar[i] = epar[i];
          }
-         if (fabs( chi2 - chi1 ) <= (tolerance * chi1) || (labda > LABMAX)) {
+         if (fabs( w->chi2 - w->chi1 ) <= (w->tolerance * w->chi1) || (w->labda > LABMAX)) {
             /*
              * We have a satisfying solution, so now we need to calculate
              * the correct errors of the fitted parameters. This we do
              * by using the pure Taylor method because we are very close
              * to the real solution.
              */
-            labda = 0.0;                /* for Taylor solution */
-            getmat( xdat, xdim, ydat, wdat, ddat, ndat, fpar, epar, npar );
-            r = getvec( xdat, xdim, ydat, wdat, ndat, fpar, epar, npar );
+            w->labda = 0.0;             /* for Taylor solution */
+            getmat( w, xdat, xdim, ydat, wdat, ddat, ndat, fpar, epar, npar );
+            r = getvec( w, xdat, xdim, ydat, wdat, ndat, fpar, epar, npar );
             if (r) return( r );         /* error */
             for (i = 0; i < npar; i++) {
                fpar[i] = epar[i];       /* save new parameters */
                epar[i] = 0.0;           /* and set error to zero */
             }
-            chi1 = sqrt( chi1 / (real) (nuse - nfree) );
-            for (i = 0; i < nfree; i++) {
-               if ((matrix1[i][i] <= 0.0) || (matrix2[i][i] <= 0.0)) return( -7);
+            w->chi1 = sqrt( w->chi1 / (real) (w->nuse - w->nfree) );
+            for (i = 0; i < w->nfree; i++) {
+               if ((w->matrix1[i][i] <= 0.0) || (w->matrix2[i][i] <= 0.0)) return( -7);
 #if 1
 	       /* original */
-               epar[parptr[i]] = chi1 * sqrt( matrix2[i][i] ) / sqrt( matrix1[i][i] );
+               epar[w->parptr[i]] = w->chi1 * sqrt( w->matrix2[i][i] ) / sqrt( w->matrix1[i][i] );
 #else
 	       /* somewhat like the nr_ version */
-               epar[parptr[i]] = sqrt( matrix2[i][i] ) / sqrt( matrix1[i][i] );
+               epar[w->parptr[i]] = sqrt( w->matrix2[i][i] ) / sqrt( w->matrix1[i][i] );
 	       if (wdat == NULL)
-		 epar[parptr[i]] *= chi1;
+		 epar[w->parptr[i]] *= w->chi1;
 #endif
             }
-            found = 1;                  /* we found a solution */
+            w->found = 1;               /* we found a solution */
          }
       }
    }
    if (ddat) {
      real chisq = 0.0;
-     real w;
+     real wt;
      for (n = 0; n < ndat; n++) {
-       w = wdat ? wdat[i] : 1.0;
-       chisq += sqr(ddat[i])*w;
+       wt = wdat ? wdat[n] : 1.0;
+       chisq += sqr(ddat[n])*wt;
      }
-     dprintf(1,"chisq=%g chi1,2=%g %g\n",chisq,chi1,chi2);
+     dprintf(1,"chisq=%g chi1,2=%g %g\n",chisq,w->chi1,w->chi2);
    }
-   return itc;                       /* return number of iterations (0 for linear) */
+   return w->itc;                    /* return number of iterations (0 for linear) */
 }
 
 #if     defined(TESTBED)
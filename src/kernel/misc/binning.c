@@ -0,0 +1,496 @@
+/*
+ * BINNING: 1D, 2D and 3D histograms, with weights and the weighted
+ *	    mean and central moments (up to 4th order) of a value per bin.
+ *
+ *	bin_index_n() turns coordinates into bin numbers; for a linear
+ *	axis this is a branchless loop the compiler can vectorise, an axis
+ *	with given edges uses a bisection. bin_accum_n() adds points with
+ *	known bin numbers (e.g. computed by the caller, as for the fibers
+ *	of snapifu), and bin_add_n() does both, in blocks. With OpenMP and
+ *	enough points per bin, bin_add_n() lets each thread fill a private
+ *	table for a fixed part of the points, and merges these in order
+ *	afterwards, so a histogram is never updated by two threads. The
+ *	moments are updated and merged with the recurrences of West (1979)
+ *	and Pebay (2008) for weighted data, which do not lose precision
+ *	when the mean is large compared to the dispersion.
+ *
+ *	19-oct-2026	created			PJT
+ */
+
+#include <stdinc.h>
+#include <binning.h>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#define NBLK  1024		/* points per block in bin_add_n */
+#define NPAR  16384		/* fewer points are always binned serially */
+
+/*
+ * BIN_CREATE: ndim linear axes with n[] bins from min[] to max[],
+ *	       keeping the moments of a value up to order nmom (0..4)
+ */
+
+bin_table *bin_create(int ndim, int *n, double *min, double *max, int nmom)
+{
+    bin_table *b;
+    int d;
+
+    if (ndim < 1 || ndim > BIN_MAXDIM) error("bin_create: bad ndim=%d", ndim);
+    if (nmom < 0 || nmom > 4) error("bin_create: bad nmom=%d", nmom);
+    b = (bin_table *) allocate(sizeof(bin_table));
+    b->ndim = ndim;
+    b->nmom = nmom;
+    b->closed = FALSE;
+    b->nbin = 1;
+    for (d=0; d<BIN_MAXDIM; d++) {
+	bin_axis *a = &b->ax[d];
+	a->edge = NULL;
+	if (d >= ndim) {
+	    a->n = 1;
+	    a->min = 0.0;
+	    a->max = a->scale = 1.0;
+	    continue;
+	}
+	if (n[d] < 1) error("bin_create: axis %d has n=%d", d+1, n[d]);
+	if (min[d] == max[d] || !isfinite(max[d]-min[d]))
+	    error("bin_create: axis %d has a bad range %g:%g", d+1, min[d], max[d]);
+	a->n = n[d];
+	a->min = min[d];
+	a->max = max[d];
+	a->scale = n[d]/(max[d]-min[d]);
+	b->nbin *= n[d];
+    }
+    b->count = (long *) allocate(b->nbin*sizeof(long));
+    b->w     = (double *) allocate(b->nbin*sizeof(double));
+    b->mean  = nmom > 0 ? (double *) allocate(b->nbin*sizeof(double)) : NULL;
+    b->m2    = nmom > 1 ? (double *) allocate(b->nbin*sizeof(double)) : NULL;
+    b->m3    = nmom > 2 ? (double *) allocate(b->nbin*sizeof(double)) : NULL;
+    b->m4    = nmom > 3 ? (double *) allocate(b->nbin*sizeof(double)) : NULL;
+    bin_clear(b);
+    return b;
+}
+
+/*
+ * BIN_EDGES: replace a linear axis by one with n+1 given edges,
+ *	      either increasing or decreasing
+ */
+
+void bin_edges(bin_table *b, int axis, double *edge)
+{
+    bin_axis *a;
+    int i, n;
+    bool up;
+
+    if (axis < 0 || axis >= b->ndim) error("bin_edges: bad axis %d", axis);
+    a = &b->ax[axis];
+    n = a->n;
+    up = edge[0] < edge[n];
+    for (i=0; i<n; i++)
+	if (up ? edge[i] >= edge[i+1] : edge[i] <= edge[i+1])
+	    error("bin_edges: edges not monotonic at %d: %g %g", i, edge[i], edge[i+1]);
+    if (a->edge == NULL)
+	a->edge = (double *) allocate((n+1)*sizeof(double));
+    for (i=0; i<=n; i++)
+	a->edge[i] = edge[i];
+    a->min = edge[0];
+    a->max = edge[n];
+    a->scale = n/(a->max - a->min);
+}
+
+void bin_clear(bin_table *b)
+{
+    long i;
+
+    for (i=0; i<b->nbin; i++) {
+	b->count[i] = 0;
+	b->w[i] = 0.0;
+	if (b->mean) b->mean[i] = 0.0;
+	if (b->m2) b->m2[i] = 0.0;
+	if (b->m3) b->m3[i] = 0.0;
+	if (b->m4) b->m4[i] = 0.0;
+    }
+    b->nout = 0;
+    b->wout = 0.0;
+}
+
+local void free_sums(bin_table *b)
+{
+    free(b->count);
+    free(b->w);
+    if (b->mean) free(b->mean);
+    if (b->m2) free(b->m2);
+    if (b->m3) free(b->m3);
+    if (b->m4) free(b->m4);
+}
+
+void bin_free(bin_table *b)
+{
+    int d;
+
+    for (d=0; d<BIN_MAXDIM; d++)
+	if (b->ax[d].edge) free(b->ax[d].edge);
+    free_sums(b);
+    free(b);
+}
+
+/*
+ * EDGE_INDEX: bin of x on an axis with edges, -1 if outside
+ */
+
+local long edge_index(bin_axis *a, bool closed, double x)
+{
+    double *e = a->edge;
+    int lo = 0, hi = a->n, mid;
+    bool up = e[0] < e[hi];
+
+    if (!(up ? x >= e[0] && x <= e[hi] : x <= e[0] && x >= e[hi]))
+	return -1;				/* also NaN */
+    if (x == e[hi])
+	return closed ? hi-1 : -1;
+    while (hi - lo > 1) {
+	mid = (lo + hi)/2;
+	if (up ? x >= e[mid] : x <= e[mid])
+	    lo = mid;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * AXIS_INDEX: add stride times the bin of x[] along one axis to idx[],
+ *	       or make it -1 if outside
+ */
+
+local void axis_index(bin_axis *a, bool closed, long stride, int n, real *x, long *idx)
+{
+    double min = a->min, max = a->max, scale = a->scale, nb = a->n;
+    long k;
+    int i;
+
+    if (a->edge) {
+	for (i=0; i<n; i++) {
+	    k = edge_index(a, closed, x[i]);
+	    idx[i] = idx[i] < 0 || k < 0 ? -1 : idx[i] + stride*k;
+	}
+	return;
+    }
+#if defined(_OPENMP)
+#pragma omp simd private(k)
+#endif
+    for (i=0; i<n; i++) {
+	double f = (x[i] - min)*scale;
+	bool in = (f >= 0 && f < nb) || (closed && x[i] == max);
+	k = in ? MIN((long) f, a->n - 1) : -1;
+	idx[i] = idx[i] < 0 || k < 0 ? -1 : idx[i] + stride*k;
+    }
+}
+
+/*
+ * BIN_INDEX_N: bin numbers idx[] of n points (x,y,z); -1 if outside.
+ *		y and z are only used for 2D and 3D tables.
+ */
+
+void bin_index_n(bin_table *b, int n, real *x, real *y, real *z, long *idx)
+{
+    real *c[BIN_MAXDIM];
+    long stride = 1;
+    int i, d;
+
+    c[0] = x;  c[1] = y;  c[2] = z;
+    for (i=0; i<n; i++)
+	idx[i] = 0;
+    for (d=0; d<b->ndim; d++) {
+	if (c[d] == NULL) error("bin_index_n: no coordinates for axis %d", d+1);
+	axis_index(&b->ax[d], b->closed, stride, n, c[d], idx);
+	stride *= b->ax[d].n;
+    }
+}
+
+/*
+ * MERGE1: combine weight wb, mean mb and central sums m2b..m4b into
+ *	   bin k; for a single point the central sums are zero.
+ *	   (Pebay 2008, eq. 3.1 and 3.2, with weights)
+ */
+
+local inline void merge1(bin_table *b, long k, double wb, double mb,
+			 double m2b, double m3b, double m4b)
+{
+    double wa = b->w[k], w = wa + wb, d, r, t;
+
+    b->w[k] = w;
+    if (b->nmom == 0 || wb == 0.0) return;
+    if (w == 0.0) {				/* negative weights cancel */
+	b->mean[k] = 0.0;
+	return;
+    }
+    d = mb - b->mean[k];
+    r = wb/w;
+    b->mean[k] += d*r;
+    if (b->nmom < 2) return;
+    t = d*d*wa*r;				/* d^2 wa wb / w */
+    if (b->nmom > 3)
+	b->m4[k] += m4b + t*d*d*(wa*wa - wa*wb + wb*wb)/(w*w)
+	    + 6.0*d*d*(wa*wa*m2b + wb*wb*b->m2[k])/(w*w)
+	    + 4.0*d*(wa*m3b - wb*b->m3[k])/w;
+    if (b->nmom > 2)
+	b->m3[k] += m3b + t*d*(wa - wb)/w + 3.0*d*(wa*m2b - wb*b->m2[k])/w;
+    b->m2[k] += m2b + t;
+}
+
+/*
+ * BIN_ACCUM_N: add n points with bin numbers idx[] (<0: outside),
+ *		weights w[] (NULL: 1) and values v[] (only with nmom>0)
+ */
+
+void bin_accum_n(bin_table *b, int n, long *idx, real *w, real *v)
+{
+    long k;
+    int i;
+
+    if (b->nmom > 0 && v == NULL) error("bin_accum_n: no values for nmom=%d", b->nmom);
+    for (i=0; i<n; i++) {
+	k = idx[i];
+	if (k < 0 || k >= b->nbin) {
+	    b->nout++;
+	    b->wout += w ? w[i] : 1.0;
+	    continue;
+	}
+	b->count[k]++;
+	if (b->nmom == 0)
+	    b->w[k] += w ? w[i] : 1.0;
+	else
+	    merge1(b, k, w ? w[i] : 1.0, v[i], 0.0, 0.0, 0.0);
+    }
+}
+
+/*
+ * BIN_MERGE: add the table p, with the same bins, to b
+ */
+
+void bin_merge(bin_table *b, bin_table *p)
+{
+    long k, nbin = b->nbin;
+
+    if (p->nbin != nbin || p->nmom != b->nmom)
+	error("bin_merge: tables differ (%ld,%d) (%ld,%d)", nbin, b->nmom, p->nbin, p->nmom);
+#if defined(_OPENMP)
+#pragma omp parallel for if (nbin > NPAR)
+#endif
+    for (k=0; k<nbin; k++) {
+	if (p->count[k] == 0) continue;
+	b->count[k] += p->count[k];
+	merge1(b, k, p->w[k], p->mean ? p->mean[k] : 0.0,
+	       p->m2 ? p->m2[k] : 0.0, p->m3 ? p->m3[k] : 0.0, p->m4 ? p->m4[k] : 0.0);
+    }
+    b->nout += p->nout;
+    b->wout += p->wout;
+}
+
+/*
+ * ADD_PART: bin points lo..hi-1, in blocks
+ */
+
+local void add_part(bin_table *b, long lo, long hi,
+		    real *x, real *y, real *z, real *w, real *v)
+{
+    long idx[NBLK], i;
+    int n;
+
+    for (i=lo; i<hi; i+=NBLK) {
+	n = MIN(NBLK, hi-i);
+	bin_index_n(b, n, x+i, y ? y+i : NULL, z ? z+i : NULL, idx);
+	bin_accum_n(b, n, idx, w ? w+i : NULL, v ? v+i : NULL);
+    }
+}
+
+/*
+ * BIN_ADD_N: add n points (x,y,z) with weights w[] and values v[]
+ */
+
+void bin_add_n(bin_table *b, int n, real *x, real *y, real *z, real *w, real *v)
+{
+    bin_table **part;
+    int t, ncopy = 1;
+
+#if defined(_OPENMP)
+    if (n >= NPAR)			/* private tables must pay off */
+	ncopy = MIN(omp_get_max_threads(), n/b->nbin);
+#endif
+    if (ncopy < 2) {
+	add_part(b, 0, n, x, y, z, w, v);
+	return;
+    }
+    part = (bin_table **) allocate(ncopy*sizeof(bin_table *));
+    for (t=0; t<ncopy; t++) {
+	part[t] = (bin_table *) allocate(sizeof(bin_table));
+	*part[t] = *b;			/* same axes, shares the edges */
+	part[t]->count = (long *) allocate(b->nbin*sizeof(long));
+	part[t]->w = (double *) allocate(b->nbin*sizeof(double));
+	part[t]->mean = b->mean ? (double *) allocate(b->nbin*sizeof(double)) : NULL;
+	part[t]->m2 = b->m2 ? (double *) allocate(b->nbin*sizeof(double)) : NULL;
+	part[t]->m3 = b->m3 ? (double *) allocate(b->nbin*sizeof(double)) : NULL;
+	part[t]->m4 = b->m4 ? (double *) allocate(b->nbin*sizeof(double)) : NULL;
+	bin_clear(part[t]);
+    }
+#if defined(_OPENMP)
+#pragma omp parallel for num_threads(ncopy) schedule(static,1)
+#endif
+    for (t=0; t<ncopy; t++)
+	add_part(part[t], (long)n*t/ncopy, (long)n*(t+1)/ncopy, x, y, z, w, v);
+    for (t=0; t<ncopy; t++) {		/* in order: same result every run */
+	bin_merge(b, part[t]);
+	free_sums(part[t]);
+	free(part[t]);
+    }
+    free(part);
+}
+
+/*
+ * BIN_SIGMA, BIN_SKEWNESS, BIN_KURTOSIS: of the value in bin i;
+ *	      0 for an empty bin, or one without dispersion
+ */
+
+double bin_sigma(bin_table *b, long i)
+{
+    if (b->nmom < 2) error("bin_sigma: needs nmom>=2, not %d", b->nmom);
+    if (b->w[i] <= 0 || b->m2[i] <= 0) return 0.0;
+    return sqrt(b->m2[i]/b->w[i]);
+}
+
+double bin_skewness(bin_table *b, long i)
+{
+    double s2;
+
+    if (b->nmom < 3) error("bin_skewness: needs nmom>=3, not %d", b->nmom);
+    if (b->w[i] <= 0 || b->m2[i] <= 0) return 0.0;
+    s2 = b->m2[i]/b->w[i];
+    return b->m3[i]/b->w[i]/(s2*sqrt(s2));
+}
+
+double bin_kurtosis(bin_table *b, long i)
+{
+    double s2;
+
+    if (b->nmom < 4) error("bin_kurtosis: needs nmom>=4, not %d", b->nmom);
+    if (b->w[i] <= 0 || b->m2[i] <= 0) return 0.0;
+    s2 = b->m2[i]/b->w[i];
+    return b->m4[i]/b->w[i]/(s2*s2) - 3.0;
+}
+
+
+#ifdef TESTBED
+
+#include <getparam.h>
+
+string defv[] = {
+    "n=100000\n     Number of points",
+    "nx=7\n         Bins along X",
+    "ny=5\n         Bins along Y",
+    "offset=1000\n  Offset of the values, to test the precision of the moments",
+    "seed=123\n     Random seed",
+    "VERSION=1.0\n  19-oct-2026 PJT",
+    NULL,
+};
+
+string usage="testing the binning routines against a direct two-pass computation";
+
+void nemo_main()
+{
+    int i, n = getiparam("n"), nx = getiparam("nx"), ny = getiparam("ny"), nbad = 0;
+    int nb[2], n1[1];
+    long k, nbin, *idx;
+    real *x, *y, *w, *v;
+    double min[2] = { -1.0, 2.0 }, max[2] = { 1.0, -2.0 };   /* y reversed */
+    double offset = getdparam("offset"), *s0, *s1, *s2, *s3, *s4, *e, err = 0.0;
+    bin_table *b, *c, *h;
+
+    init_xrandom(getparam("seed"));
+    x = (real *) allocate(n*sizeof(real));
+    y = (real *) allocate(n*sizeof(real));
+    w = (real *) allocate(n*sizeof(real));
+    v = (real *) allocate(n*sizeof(real));
+    for (i=0; i<n; i++) {
+	x[i] = xrandom(-1.1, 1.1);
+	y[i] = xrandom(-2.2, 2.2);
+	w[i] = xrandom(0.5, 2.0);
+	v[i] = offset + grandom(x[i], 1.0 + y[i]*y[i]);
+    }
+    nb[0] = nx;  nb[1] = ny;
+    b = bin_create(2, nb, min, max, 4);
+    bin_add_n(b, n, x, y, NULL, w, v);
+
+    /* direct: index the scalar way, two passes for the central sums */
+    nbin = b->nbin;
+    s0 = (double *) allocate(nbin*sizeof(double));
+    s1 = (double *) allocate(nbin*sizeof(double));
+    s2 = (double *) allocate(nbin*sizeof(double));
+    s3 = (double *) allocate(nbin*sizeof(double));
+    s4 = (double *) allocate(nbin*sizeof(double));
+    idx = (long *) allocate(n*sizeof(long));
+    for (k=0; k<nbin; k++)
+	s0[k] = s1[k] = s2[k] = s3[k] = s4[k] = 0.0;
+    for (i=0; i<n; i++) {
+	int ix = (int) floor((x[i]-min[0])/(max[0]-min[0])*nx);
+	int iy = (int) floor((y[i]-min[1])/(max[1]-min[1])*ny);
+	idx[i] = ix < 0 || ix >= nx || iy < 0 || iy >= ny ? -1 : ix + nx*iy;
+	if (idx[i] < 0) continue;
+	s0[idx[i]] += w[i];
+	s1[idx[i]] += w[i]*v[i];
+    }
+    for (i=0; i<n; i++) {
+	double d;
+	if ((k = idx[i]) < 0) continue;
+	d = v[i] - s1[k]/s0[k];
+	s2[k] += w[i]*d*d;
+	s3[k] += w[i]*d*d*d;
+	s4[k] += w[i]*d*d*d*d;
+    }
+    for (k=0; k<nbin; k++) {
+	double m = s1[k]/s0[k], sig = sqrt(s2[k]/s0[k]);
+	double skew = s3[k]/s0[k]/(sig*sig*sig), kurt = s4[k]/s0[k]/(sig*sig*sig*sig) - 3;
+	err = MAX(err, ABS(b->w[k] - s0[k])/s0[k]);
+	err = MAX(err, ABS(b->mean[k] - m)/sig);
+	err = MAX(err, ABS(bin_sigma(b,k) - sig)/sig);
+	err = MAX(err, ABS(bin_skewness(b,k) - skew));
+	err = MAX(err, ABS(bin_kurtosis(b,k) - kurt));
+	if (k == nbin/2)
+	    printf("bin %ld: n=%ld w=%g mean=%g sigma=%g skew=%g kurt=%g\n",
+		   k, b->count[k], b->w[k], b->mean[k], bin_sigma(b,k),
+		   bin_skewness(b,k), bin_kurtosis(b,k));
+    }
+    printf("max relative difference with two-pass sums: %g (%ld outside)\n", err, b->nout);
+    if (err > 1e-6) nbad++;			/* streaming vs. two-pass */
+
+    /* accumulate given bin numbers in two halves and merge */
+    c = bin_create(2, nb, min, max, 4);
+    h = bin_create(2, nb, min, max, 4);
+    bin_accum_n(c, n/2, idx, w, v);
+    bin_accum_n(h, n-n/2, idx+n/2, w+n/2, v+n/2);
+    bin_merge(c, h);
+    for (k=0, err=0.0; k<nbin; k++) {
+	if (c->count[k] != b->count[k]) nbad++;
+	err = MAX(err, ABS(c->mean[k] - b->mean[k]) + ABS(bin_sigma(c,k) - bin_sigma(b,k)));
+    }
+    printf("merged halves differ by %g\n", err);
+    if (err > 1e-6 || c->nout != b->nout) nbad++;
+
+    /* 1D histogram with edges, upper edge included */
+    n1[0] = 4;
+    e = (double *) allocate(5*sizeof(double));
+    e[0] = -1.0;  e[1] = -0.5;  e[2] = 0.0;  e[3] = 0.25;  e[4] = 1.0;
+    h = bin_create(1, n1, e, e+4, 0);
+    bin_edges(h, 0, e);
+    h->closed = TRUE;
+    for (i=0; i<5; i++) x[i] = e[i];
+    bin_add_n(h, 5, x, NULL, NULL, NULL, NULL);
+    printf("edges -1,-0.5,0,0.25,1 at the edges: %ld %ld %ld %ld\n",
+	   h->count[0], h->count[1], h->count[2], h->count[3]);
+    if (h->count[0] != 1 || h->count[1] != 1 || h->count[2] != 1 || h->count[3] != 2) nbad++;
+
+    if (nbad) error("binning: %d tests failed", nbad);
+    printf("all tests passed\n");
+}
+
+#endif
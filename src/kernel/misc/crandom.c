@@ -0,0 +1,326 @@
+/*
+ * CRANDOM: counter-based random numbers, for reproducible parallel use.
+ *
+ *	Each block of 4 32-bit random words is the Philox4x32-10 bijection
+ *	(Salmon et al. 2011, "Parallel Random Numbers: As Easy as 1, 2, 3")
+ *	of a 128-bit counter, made of the block number and a 64-bit stream
+ *	number, under a 64-bit key, the seed. Uniform number k of a stream
+ *	is thus a pure function of (seed, stream, k), which is crandom_at(),
+ *	and a crandom_state merely remembers the next k. Each block gives
+ *	two uniforms of 53 bits.
+ *
+ *	The batch versions crandom_n() and cgrandom_n() return exactly the
+ *	same numbers as the equivalent sequence of single calls, but do the
+ *	blocks in groups of NLANE, which the compiler can vectorise.
+ *
+ *	19-oct-2026	created			PJT
+ */
+
+#include <stdinc.h>
+#include <crandom.h>
+
+#define PHILOX_M0  0xD2511F53U
+#define PHILOX_M1  0xCD9E8D57U
+#define PHILOX_W0  0x9E3779B9U
+#define PHILOX_W1  0xBB67AE85U
+
+#define NLANE      8			/* blocks per group in the batch version */
+
+#define TWO26      67108864.0
+#define TWOM53     (1.0/9007199254740992.0)
+
+/* two 32 bit words to a uniform number in [0,1) of 53 bits */
+#define U53(hi,lo) ((((hi)>>5)*TWO26 + ((lo)>>6)) * TWOM53)
+
+/*
+ * PHILOX4X32: one block: out = Philox4x32-10(ctr, key)
+ */
+
+void philox4x32(unsigned int ctr[4], unsigned int key[2], unsigned int out[4])
+{
+    unsigned int c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+    unsigned int k0 = key[0], k1 = key[1];
+    unsigned long long p0, p1;
+    int r;
+
+    for (r=0; r<10; r++) {
+	p0 = (unsigned long long) PHILOX_M0 * c0;
+	p1 = (unsigned long long) PHILOX_M1 * c2;
+	c0 = (unsigned int)(p1>>32) ^ c1 ^ k0;
+	c2 = (unsigned int)(p0>>32) ^ c3 ^ k1;
+	c1 = (unsigned int) p1;
+	c3 = (unsigned int) p0;
+	k0 += PHILOX_W0;
+	k1 += PHILOX_W1;
+    }
+    out[0] = c0;  out[1] = c1;  out[2] = c2;  out[3] = c3;
+}
+
+/* the two uniforms of block j of a stream */
+
+local void block2(unsigned int *key, unsigned int *stream,
+		  unsigned long long j, double *u)
+{
+    unsigned int ctr[4], out[4];
+
+    ctr[0] = (unsigned int) j;
+    ctr[1] = (unsigned int) (j>>32);
+    ctr[2] = stream[0];
+    ctr[3] = stream[1];
+    philox4x32(ctr, key, out);
+    u[0] = U53(out[0], out[1]);
+    u[1] = U53(out[2], out[3]);
+}
+
+/*
+ * BLOCKS: the 2*nb uniforms of blocks j..j+nb-1 of a stream, NLANE at a time
+ */
+
+local void blocks(unsigned int *key, unsigned int *stream,
+		  unsigned long long j, int nb, double *u)
+{
+    unsigned int c0[NLANE], c1[NLANE], c2[NLANE], c3[NLANE];
+    unsigned int k0, k1, t0, t2;
+    unsigned long long p0, p1, jl;
+    int i, l, r, nl;
+
+    for (i=0; i<nb; i+=NLANE) {
+	nl = MIN(NLANE, nb-i);
+	for (l=0; l<NLANE; l++) {
+	    jl = j + i + l;
+	    c0[l] = (unsigned int) jl;
+	    c1[l] = (unsigned int) (jl>>32);
+	    c2[l] = stream[0];
+	    c3[l] = stream[1];
+	}
+	k0 = key[0];
+	k1 = key[1];
+	for (r=0; r<10; r++) {
+	    for (l=0; l<NLANE; l++) {
+		p0 = (unsigned long long) PHILOX_M0 * c0[l];
+		p1 = (unsigned long long) PHILOX_M1 * c2[l];
+		t0 = (unsigned int)(p1>>32) ^ c1[l] ^ k0;
+		t2 = (unsigned int)(p0>>32) ^ c3[l] ^ k1;
+		c1[l] = (unsigned int) p1;
+		c3[l] = (unsigned int) p0;
+		c0[l] = t0;
+		c2[l] = t2;
+	    }
+	    k0 += PHILOX_W0;
+	    k1 += PHILOX_W1;
+	}
+	for (l=0; l<nl; l++) {
+	    u[2*(i+l)]   = U53(c0[l], c1[l]);
+	    u[2*(i+l)+1] = U53(c2[l], c3[l]);
+	}
+    }
+}
+
+/*
+ * INIT_CRANDOM: start stream number 'stream' of seed 'seed' at counter 0
+ */
+
+void init_crandom(crandom_state *cr, unsigned long long seed, unsigned long long stream)
+{
+    cr->key[0] = (unsigned int) seed;
+    cr->key[1] = (unsigned int) (seed>>32);
+    cr->stream[0] = (unsigned int) stream;
+    cr->stream[1] = (unsigned int) (stream>>32);
+    cr->counter = 0;
+    cr->ngbuf = 0;
+}
+
+/*
+ * CRANDOM: uniform in [a,b)
+ */
+
+double crandom(crandom_state *cr, double a, double b)
+{
+    double u;
+
+    if ((cr->counter & 1) == 0)
+	block2(cr->key, cr->stream, cr->counter>>1, cr->ubuf);
+    u = cr->ubuf[cr->counter & 1];
+    cr->counter++;
+    return a + (b-a)*u;
+}
+
+/*
+ * CGRANDOM: gaussian with mean m and dispersion s; Box-Muller without
+ *	     rejection, so every pair costs exactly two uniforms.
+ */
+
+double cgrandom(crandom_state *cr, double m, double s)
+{
+    double u1, u2, r;
+
+    if (cr->ngbuf) {
+	cr->ngbuf = 0;
+	return m + s*cr->gbuf;
+    }
+    u1 = crandom(cr, 0.0, 1.0);
+    u2 = crandom(cr, 0.0, 1.0);
+    r = sqrt(-2.0*log(1.0-u1));
+    cr->gbuf = r*sin(TWO_PI*u2);
+    cr->ngbuf = 1;
+    return m + s*r*cos(TWO_PI*u2);
+}
+
+/*
+ * CRANDOM_N: n uniforms in [a,b), the same as n calls to crandom()
+ */
+
+void crandom_n(crandom_state *cr, double *x, int n, double a, double b)
+{
+    int i, nb;
+
+    if (n > 0 && (cr->counter & 1)) {		/* finish the current block */
+	*x++ = crandom(cr, a, b);
+	n--;
+    }
+    nb = n/2;
+    if (nb > 0) {
+	blocks(cr->key, cr->stream, cr->counter>>1, nb, x);
+	cr->counter += 2*nb;
+	if (a != 0.0 || b != 1.0)
+	    for (i=0; i<2*nb; i++)
+		x[i] = a + (b-a)*x[i];
+    }
+    if (n & 1)
+	x[n-1] = crandom(cr, a, b);
+}
+
+/*
+ * CGRANDOM_N: n gaussians, the same as n calls to cgrandom()
+ */
+
+void cgrandom_n(crandom_state *cr, double *x, int n, double m, double s)
+{
+    int i, np;
+    double r, phi;
+
+    if (n > 0 && cr->ngbuf) {
+	*x++ = cgrandom(cr, m, s);
+	n--;
+    }
+    np = n/2;
+    crandom_n(cr, x, 2*np, 0.0, 1.0);
+    for (i=0; i<np; i++) {
+	r   = sqrt(-2.0*log(1.0-x[2*i]));
+	phi = TWO_PI*x[2*i+1];
+	x[2*i]   = m + s*r*cos(phi);
+	x[2*i+1] = m + s*(r*sin(phi));
+    }
+    if (n & 1)
+	x[n-1] = cgrandom(cr, m, s);
+}
+
+/*
+ * CRANDOM_AT: uniform number 'counter' in [0,1) of a stream, directly
+ */
+
+double crandom_at(unsigned long long seed, unsigned long long stream,
+		  unsigned long long counter)
+{
+    unsigned int key[2], str[2];
+    double u[2];
+
+    key[0] = (unsigned int) seed;
+    key[1] = (unsigned int) (seed>>32);
+    str[0] = (unsigned int) stream;
+    str[1] = (unsigned int) (stream>>32);
+    block2(key, str, counter>>1, u);
+    return u[counter & 1];
+}
+
+
+#ifdef TESTBED
+
+#include <getparam.h>
+
+string defv[] = {
+    "seed=123\n     Seed",
+    "stream=0\n     Stream",
+    "n=10\n         Number of uniforms to show",
+    "nbench=0\n     If > 0, time this many uniforms and gaussians",
+    "VERSION=1.0\n  19-oct-2026 PJT",
+    NULL,
+};
+
+string usage="testing counter-based random numbers";
+
+/* known answers from the Random123 distribution */
+
+local unsigned int kat[3][10] = {
+    { 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 },
+    { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+      0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd },
+    { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0,
+      0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 },
+};
+
+void nemo_main()
+{
+    unsigned long long seed = getiparam("seed"), str = getiparam("stream");
+    int i, k, n = getiparam("n"), nbench = getiparam("nbench"), nbad = 0;
+    unsigned int out[4];
+    crandom_state cr, cr2;
+    double *x, *y, sum;
+
+    for (k=0; k<3; k++) {
+	philox4x32(kat[k], kat[k]+4, out);
+	for (i=0; i<4; i++)
+	    if (out[i] != kat[k][6+i]) nbad++;
+	printf("philox4x32 %08x %08x %08x %08x\n", out[0],out[1],out[2],out[3]);
+    }
+    if (nbad) error("philox4x32: %d words differ from the known answers", nbad);
+
+    init_crandom(&cr, seed, str);
+    for (i=0; i<n; i++)
+	printf("%d %.17g\n", i, crandom(&cr, 0.0, 1.0));
+
+    /* batch versions must follow the single calls, from any counter */
+    x = (double *) allocate(3*(n+2)*sizeof(double));
+    y = (double *) allocate(3*(n+2)*sizeof(double));
+    for (k=0; k<3; k++) {
+	init_crandom(&cr, seed, str);
+	init_crandom(&cr2, seed, str);
+	for (i=0; i<k; i++) {
+	    crandom(&cr, 0.0, 1.0);
+	    cgrandom(&cr2, 0.0, 1.0);
+	}
+	for (i=0; i<3*n+k; i++) x[i] = crandom(&cr, -1.0, 2.0);
+	init_crandom(&cr, seed, str);
+	for (i=0; i<k; i++) crandom(&cr, 0.0, 1.0);
+	crandom_n(&cr, y, 3*n+k, -1.0, 2.0);
+	for (i=0; i<3*n+k; i++)
+	    if (x[i] != y[i]) nbad++;
+	init_crandom(&cr, seed, str);
+	for (i=0; i<3*n+k; i++)
+	    if (crandom_at(seed, str, i) != crandom(&cr, 0.0, 1.0)) nbad++;
+	cr = cr2;
+	for (i=0; i<3*n+k; i++) x[i] = cgrandom(&cr, 1.0, 2.0);
+	cgrandom_n(&cr2, y, 3*n+k, 1.0, 2.0);
+	for (i=0; i<3*n+k; i++)
+	    if (x[i] != y[i]) nbad++;
+    }
+    if (nbad) error("crandom: %d batch values differ", nbad);
+    printf("batch and single calls agree\n");
+    free(x);
+    free(y);
+
+    if (nbench > 0) {
+	x = (double *) allocate(nbench*sizeof(double));
+	init_crandom(&cr, seed, str);
+	crandom_n(&cr, x, nbench, 0.0, 1.0);
+	for (i=0, sum=0.0; i<nbench; i++) sum += x[i];
+	printf("mean uniform:  %g\n", sum/nbench);
+	cgrandom_n(&cr, x, nbench, 0.0, 1.0);
+	for (i=0, sum=0.0; i<nbench; i++) sum += x[i]*x[i];
+	printf("gauss sigma^2: %g\n", sum/nbench);
+	free(x);
+    }
+}
+
+#endif
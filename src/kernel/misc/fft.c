@@ -0,0 +1,182 @@
+/*
+ * FFT.C: simple in-place complex Fast Fourier Transforms, for when
+ *        FFTW is not available or not worth the dependency.
+ *
+ *        fft_cplx()    1D complex, n a power of 2
+ *        fft_ndim()    N-dimensional complex, each dimension a power of 2
+ *        fft_next2()   next power of 2
+ *
+ *   Data are stored as interleaved (re,im) pairs, C (row major) order for
+ *   fft_ndim(), i.e. the last dimension varies fastest.
+ *   isign=-1 is the forward transform, isign=1 the inverse; as usual
+ *   neither is normalized, a forward+inverse pair multiplies by n.
+ *
+ *   19-oct-2026   V1.0  created for orbnaff, ccdpot and friends          PJT
+ */
+
+#include <stdinc.h>
+#include <fft.h>
+
+/*
+ * FFT_NEXT2: smallest power of 2 >= n
+ */
+
+int fft_next2(int n)
+{
+    int m = 1;
+
+    while (m < n) m <<= 1;
+    return m;
+}
+
+/*
+ * FFT_CPLX: 1D radix-2 Danielson-Lanczos transform
+ *	double data[2*n]      interleaved (re,im) data, replaced by transform
+ *	int n                 number of complex points, must be a power of 2
+ *	int isign             -1 forward, +1 inverse
+ */
+
+void fft_cplx(double *data, int n, int isign)
+{
+    int i, j, m, mmax, istep;
+    double wr, wi, wpr, wpi, wtemp, theta, tr, ti;
+
+    if (n < 2) return;
+    if (n & (n-1)) error("fft_cplx: n=%d not a power of 2",n);
+
+    for (i=0, j=0; i<n; i++) {                  /* bit reversal */
+        if (j > i) {
+            tr = data[2*j];   data[2*j]   = data[2*i];   data[2*i]   = tr;
+            ti = data[2*j+1]; data[2*j+1] = data[2*i+1]; data[2*i+1] = ti;
+        }
+        m = n >> 1;
+        while (m >= 1 && j >= m) {
+            j -= m;
+            m >>= 1;
+        }
+        j += m;
+    }
+    for (mmax=1; mmax<n; mmax=istep) {          /* butterflies */
+        istep = mmax << 1;
+        theta = isign*PI/mmax;
+        wtemp = sin(0.5*theta);
+        wpr = -2.0*wtemp*wtemp;
+        wpi = sin(theta);
+        wr = 1.0;
+        wi = 0.0;
+        for (m=0; m<mmax; m++) {
+            for (i=m; i<n; i+=istep) {
+                j = i + mmax;
+                tr = wr*data[2*j]   - wi*data[2*j+1];
+                ti = wr*data[2*j+1] + wi*data[2*j];
+                data[2*j]   = data[2*i]   - tr;
+                data[2*j+1] = data[2*i+1] - ti;
+                data[2*i]   += tr;
+                data[2*i+1] += ti;
+            }
+            wtemp = wr;
+            wr += wr*wpr - wi*wpi;
+            wi += wi*wpr + wtemp*wpi;
+        }
+    }
+}
+
+/*
+ * FFT_NDIM: N-dimensional transform, as a sequence of 1D transforms
+ *           along each axis. Lines along an axis are independent, and
+ *           are done in parallel if compiled with OpenMP.
+ *	double data[2*nn[0]*...*nn[ndim-1]]
+ *	int ndim              number of dimensions
+ *	int nn[ndim]          dimensions, slowest varying first
+ *	int isign             -1 forward, +1 inverse
+ */
+
+void fft_ndim(double *data, int ndim, int *nn, int isign)
+{
+    int idim, n, k;
+    long ntot, stride, nlines, line;
+
+    for (idim=0, ntot=1; idim<ndim; idim++)
+        ntot *= nn[idim];
+
+    for (idim=ndim-1, stride=1; idim>=0; stride *= nn[idim], idim--) {
+        n = nn[idim];
+        if (n < 2) continue;
+        nlines = ntot/n;
+        if (stride == 1) {                      /* contiguous lines */
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+            for (line=0; line<nlines; line++)
+                fft_cplx(data + 2*line*n, n, isign);
+        } else {                                /* gather, transform, scatter */
+#if defined(_OPENMP)
+#pragma omp parallel private(k,line)
+#endif
+          {
+            double *buf = (double *) allocate(2*n*sizeof(double));
+            long off;
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+            for (line=0; line<nlines; line++) {
+                off = (line/stride)*stride*n + line%stride;
+                for (k=0; k<n; k++) {
+                    buf[2*k]   = data[2*(off+k*stride)];
+                    buf[2*k+1] = data[2*(off+k*stride)+1];
+                }
+                fft_cplx(buf, n, isign);
+                for (k=0; k<n; k++) {
+                    data[2*(off+k*stride)]   = buf[2*k];
+                    data[2*(off+k*stride)+1] = buf[2*k+1];
+                }
+            }
+            free(buf);
+          }
+        }
+    }
+}
+
+
+#ifdef TESTBED
+
+#include <getparam.h>
+
+string defv[] = {
+    "n=16\n         Size of first dimension",
+    "m=8\n          Size of second dimension",
+    "VERSION=1.0\n  19-oct-2026 PJT",
+    NULL,
+};
+
+string usage="testing fft routines";
+
+void nemo_main(void)
+{
+    int i, j, k, l, n = getiparam("n"), m = getiparam("m"), nn[2];
+    double *d, *d0, sr, si, arg, err = 0.0;
+
+    d  = (double *) allocate(2*n*m*sizeof(double));
+    d0 = (double *) allocate(2*n*m*sizeof(double));
+    for (i=0; i<2*n*m; i++)
+        d0[i] = d[i] = sin(1.0+i*i*0.37);
+    nn[0] = n;  nn[1] = m;
+    fft_ndim(d, 2, nn, -1);
+    for (k=0; k<n; k++)                 /* compare with a slow DFT */
+        for (l=0; l<m; l++) {
+            sr = si = 0.0;
+            for (i=0; i<n; i++)
+                for (j=0; j<m; j++) {
+                    arg = -TWO_PI*((double)i*k/n + (double)j*l/m);
+                    sr += d0[2*(i*m+j)]*cos(arg) - d0[2*(i*m+j)+1]*sin(arg);
+                    si += d0[2*(i*m+j)]*sin(arg) + d0[2*(i*m+j)+1]*cos(arg);
+                }
+            err = MAX(err, ABS(sr-d[2*(k*m+l)]) + ABS(si-d[2*(k*m+l)+1]));
+        }
+    printf("max error forward  %g\n",err);
+    fft_ndim(d, 2, nn, 1);
+    for (i=0, err=0; i<2*n*m; i++)
+        err = MAX(err, ABS(d[i]/(n*m)-d0[i]));
+    printf("max error roundtrip %g\n",err);
+}
+#endif
@@ -42,11 +42,13 @@
  *             13-nov-03 make it understand NULL          pjt
  *              2-jan-21 squash some gcc warnings         pjt
  *              3-apr-23 add the range function           pjt
+ *             19-oct-26 inifie() remembers compiled expressions  pjt
  *
  */
 #include <stdinc.h>   /* stdinc is NEMO's stdio =- uses real{float/double} */
 #include <ctype.h>
 #include <math.h>
+#include <strlib.h>
 
 extern double xrandom(double,double);
 
@@ -280,16 +282,58 @@ static void fie_nextsym()
 	  }
 }
 
+/*
+ * Compiled expressions are remembered in a small hash table keyed on
+ * the expression text, so programs that re-initialize the same fie's
+ * many times (e.g. tabview/tabzoom on every redraw) skip the parsing.
+ * Only the generated code is kept, runtime state (errors, random
+ * numbers) is not, so evaluation is exactly as before.
+ */
+
+#define MAXMEMO  64		/* hash buckets of remembered fie's */
+
+static struct fie_memo {
+    char            *expr;
+    unsigned int     hash;
+    int              errorpos, npar, codeptr, opcodeptr;
+    bool             parused[MAXPAR];
+    char            *fiecode;
+    struct fie_memo *next;
+} *fie_memo[MAXMEMO];
+
+static unsigned int fie_hash(char *expr)	/* FNV-1a */
+{
+	unsigned int h = 2166136261u;
+
+	while (*expr) {
+		h ^= (unsigned char) *expr++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
 int inifie(char *expr)			/* PJT: now int instead of short */
 {
         int i, n = strlen(expr);
+	unsigned int h = fie_hash(expr);
+	struct fie_memo *m;
 	
+	oddran = 0;
+	errorlev = 0;
+	for (m = fie_memo[h%MAXMEMO]; m; m = m->next) {
+		if (m->hash != h || strcmp(m->expr,expr)) continue;
+		errorpos  = m->errorpos;	/* seen before: reload code */
+		npar      = m->npar;
+		codeptr   = m->codeptr;
+		opcodeptr = m->opcodeptr;
+		memcpy(parused,m->parused,sizeof(parused));
+		memcpy(fiecode,m->fiecode,bid*MIN(codeptr+1,maxfiecode));
+		return(errorpos);
+	}
 	for ( i=0 ; i<MAXPAR ; i++)
 	    parused[i] = false;
 	if (n > MAXLINE) error("inifie: No room (%d) to copy %s",n,expr);
 	strcpy(innline,expr);
-	oddran = 0;
-	errorlev = 0;
 	pos = 0;
 	errorpos = 0;
 	codeptr = 0;
@@ -305,6 +349,19 @@ int inifie(char *expr)			/* PJT: now int instead of short */
 		        if (!parused[i]) errorpos = 0; */
 		}
 	fie_gencode(hlt);
+
+	m = (struct fie_memo *) allocate(sizeof(struct fie_memo));
+	m->expr      = scopy(expr);
+	m->hash      = h;
+	m->errorpos  = errorpos;
+	m->npar      = npar;
+	m->codeptr   = codeptr;
+	m->opcodeptr = opcodeptr;
+	memcpy(m->parused,parused,sizeof(parused));
+	m->fiecode   = (char *) allocate(bid*MIN(codeptr+1,maxfiecode));
+	memcpy(m->fiecode,fiecode,bid*MIN(codeptr+1,maxfiecode));
+	m->next = fie_memo[h%MAXMEMO];
+	fie_memo[h%MAXMEMO] = m;
 	return(errorpos);
 }
 
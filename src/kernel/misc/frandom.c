@@ -18,6 +18,7 @@ libraries.  I find most of them at best fair.
  *	16-feb-97  pjt   fixed for SINGLEPREC 
  *	 8-sep-01  pjt   init_xrandom
  *      29-aug-06  pjt   fixing for prototypes in TESTBED
+ *      19-oct-26  pjt   frandom_inv() for a given uniform, e.g. from crandom()
  *
  */
 #include <stdinc.h>
@@ -31,7 +32,13 @@ local int n = 0;
 local real_proc lastfun=NULL;
 local real coeff[MAXN*3], t[MAXN], f[MAXN], cf[MAXN];
 
-double frandom(double a, double b, real_proc fun)
+/*
+ *  FRANDOM_INV: the inverse cumulative distribution at u in [0,1).
+ *    The table is only rebuilt for a new function, so after a first
+ *    call it can also be used in parallel code.
+ */
+
+double frandom_inv(double u, double a, double b, real_proc fun)
 {
    double x, dx;
    int i;
@@ -58,13 +65,18 @@ double frandom(double a, double b, real_proc fun)
 	 cf[i] /= cf[n-1];
       spline(coeff,cf,t,n);        /* get inverse spline coef for t(cf) */
    }
-   x = xrandom(0.0,1.0);
-   x = seval(x, cf,t,coeff, n);
+   x = seval(u, cf,t,coeff, n);
    if (x<a || x>b)
       dprintf(0,"Warning: frandom returns %f; not in [%f,%f]\n",
 		x,a,b);
    return x ;
 }
+
+double frandom(double a, double b, real_proc fun)
+{
+   if (b<=a) return a;
+   return frandom_inv(xrandom(0.0,1.0), a, b, fun);
+}
 
 
 #ifdef TESTBED
@@ -21,6 +21,8 @@
  *  10-oct-20   median improvement via inline sort
  *  14-nov-21   add sratio
  *     feb-25   implement slow mode
+ *  19-oct-26   stable running central moments, merge_moment(), accum_moment_n(),
+ *              and a t-digest quantile sketch for median/MAD without ndat
  *
  * @todo    iterative robust by using a mask
  *          ? robust factor, now hardcoded at 1.5
@@ -44,6 +46,171 @@ extern real pmedian(int,real*);
 extern real pmedian_q1(int,real*);
 extern real pmedian_q3(int,real*);
 
+/*
+ * A merging t-digest (Dunning & Ertl 2019) with the k1 (arcsine) scale:
+ * a bounded number of weighted centroids, small in the tails, which
+ * gives quantiles to a relative accuracy of order 1/compression, and
+ * which can be merged. Points are buffered and merged in bulk.
+ */
+
+struct tdigest {
+    int  comp;              /* compression */
+    int  nc, maxc;          /* number of centroids, and allocated */
+    int  nb, maxb;          /* number of buffered points, and allocated */
+    real *cm, *cw;          /* centroid means and weights, sorted by mean */
+    real *bx, *bw;          /* buffered points and weights */
+    real total;             /* total weight */
+    real dmin, dmax;        /* exact extremes */
+};
+
+local struct tdigest *td_new(int comp)
+{
+    struct tdigest *td = (struct tdigest *) allocate(sizeof(struct tdigest));
+
+    td->comp = comp;
+    td->maxc = 2*comp + 8;
+    td->maxb = 8*comp;
+    td->cm = (real *) allocate((td->maxc + td->maxb) * sizeof(real));
+    td->cw = (real *) allocate((td->maxc + td->maxb) * sizeof(real));
+    td->bx = (real *) allocate(td->maxb * sizeof(real));
+    td->bw = (real *) allocate(td->maxb * sizeof(real));
+    td->nc = td->nb = 0;
+    td->total = 0.0;
+    return td;
+}
+
+local void td_free(struct tdigest *td)
+{
+    free(td->cm);
+    free(td->cw);
+    free(td->bx);
+    free(td->bw);
+    free(td);
+}
+
+local int td_cmp(const void *va, const void *vb)
+{
+    real a = ((real *) va)[0], b = ((real *) vb)[0];
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+/* the largest q a centroid starting at q may reach: k1(q)+1, k1 = comp/2pi asin(2q-1) */
+
+local real td_qlimit(struct tdigest *td, real q)
+{
+    real k = td->comp/TWO_PI * asin(2*q-1) + 1;
+
+    if (k >= 0.25*td->comp) return 1.0;
+    return 0.5*(sin(k*TWO_PI/td->comp) + 1);
+}
+
+/* merge the buffer into the centroids */
+
+local void td_compress(struct tdigest *td)
+{
+    int i, n, nc;
+    real *pair, wsum, qlim, cm, cw;
+
+    if (td->nb == 0) return;
+    n = td->nc + td->nb;
+    pair = (real *) allocate(2 * n * sizeof(real));
+    for (i=0; i<td->nc; i++) {
+	pair[2*i]   = td->cm[i];
+	pair[2*i+1] = td->cw[i];
+    }
+    for (i=0; i<td->nb; i++) {
+	pair[2*(td->nc+i)]   = td->bx[i];
+	pair[2*(td->nc+i)+1] = td->bw[i];
+	td->total += td->bw[i];
+    }
+    qsort(pair, n, 2*sizeof(real), td_cmp);
+
+    nc = 0;
+    wsum = 0.0;
+    qlim = td_qlimit(td, 0.0);
+    cm = pair[0];
+    cw = pair[1];
+    for (i=1; i<n; i++) {
+	if ((wsum + cw + pair[2*i+1]) / td->total <= qlim) {
+	    cw += pair[2*i+1];
+	    cm += (pair[2*i] - cm) * pair[2*i+1] / cw;
+	} else {
+	    td->cm[nc] = cm;
+	    td->cw[nc] = cw;
+	    nc++;
+	    wsum += cw;
+	    qlim = td_qlimit(td, wsum/td->total);
+	    cm = pair[2*i];
+	    cw = pair[2*i+1];
+	}
+    }
+    td->cm[nc] = cm;
+    td->cw[nc] = cw;
+    td->nc = nc + 1;
+    td->nb = 0;
+    free(pair);
+    if (td->nc > td->maxc)
+	error("td_compress: %d centroids for compression %d", td->nc, td->comp);
+}
+
+local void td_add(struct tdigest *td, real x, real w)
+{
+    if (w <= 0.0) return;
+    if (td->nc == 0 && td->nb == 0)
+	td->dmin = td->dmax = x;
+    else {
+	td->dmin = MIN(x, td->dmin);
+	td->dmax = MAX(x, td->dmax);
+    }
+    if (td->nb == td->maxb) td_compress(td);
+    td->bx[td->nb] = x;
+    td->bw[td->nb] = w;
+    td->nb++;
+}
+
+/* add the centroids of b to a */
+
+local void td_merge(struct tdigest *a, struct tdigest *b)
+{
+    int i;
+    real dmin = b->dmin, dmax = b->dmax;
+
+    td_compress(b);
+    for (i=0; i<b->nc; i++)
+	td_add(a, b->cm[i], b->cw[i]);
+    if (b->nc > 0) {
+	a->dmin = MIN(a->dmin, dmin);
+	a->dmax = MAX(a->dmax, dmax);
+    }
+}
+
+/* interpolate between the centroid centers, and the extremes at the ends */
+
+local real td_quantile(struct tdigest *td, real q)
+{
+    int i;
+    real t, t0, t1;
+
+    td_compress(td);
+    if (td->nc == 0) return 0.0;
+    if (td->nc == 1) return td->cm[0];
+    t = q * td->total;
+    t0 = 0.5*td->cw[0];
+    if (t <= t0) {
+	if (td->cw[0] <= 1.0) return td->cm[0];
+	return td->dmin + (td->cm[0] - td->dmin) * t / t0;
+    }
+    for (i=0; i<td->nc-1; i++) {
+	t1 = t0 + 0.5*(td->cw[i] + td->cw[i+1]);
+	if (t <= t1)
+	    return td->cm[i] + (td->cm[i+1] - td->cm[i]) * (t - t0) / (t1 - t0);
+	t0 = t1;
+    }
+    if (td->cw[i] <= 1.0) return td->cm[i];
+    if (t >= td->total) return td->dmax;
+    return td->cm[i] + (td->dmax - td->cm[i]) * (t - t0) / (td->total - t0);
+}
+
 void ini_moment(Moment *m, int mom, int ndat)
 {
     int i;
@@ -67,10 +234,16 @@ void ini_moment(Moment *m, int mom, int ndat)
 
     m->sumn = m->sump = 0.0;
     m->slow = FALSE;    
+    m->wsum = m->wmean = m->wm2 = m->wm3 = m->wm4 = 0.0;
+    m->td = NULL;
 }
 
 void free_moment(Moment *m)
 {  
+   if (m->td) {
+     td_free(m->td);
+     m->td = NULL;
+   }
    if (m->ndat) {
      if (m->sum) free(m->sum);
      free(m->dat);
@@ -89,6 +262,34 @@ void slow_moment(Moment *m, bool slow)
   }
 }
 
+/*
+ * CENTRAL_MERGE: add a set with weight wb, mean mb and central sums m2b..m4b
+ *                to the running central moments of m (Chan et al. 1979,
+ *                Pebay 2008). A single point has m2b=m3b=m4b=0.
+ */
+
+local void central_merge(Moment *m, real wb, real mb, real m2b, real m3b, real m4b)
+{
+    real wa = m->wsum, w = wa + wb, d, dw, m2a = m->wm2, m3a = m->wm3;
+
+    if (w == 0.0) {
+      m->wsum = m->wmean = m->wm2 = m->wm3 = m->wm4 = 0.0;
+      return;
+    }
+    d = mb - m->wmean;
+    dw = d / w;
+    m->wsum = w;
+    m->wmean += wb * dw;
+    m->wm2 = m2a + m2b + d * dw * wa * wb;
+    if (m->mom < 3) return;
+    m->wm3 = m3a + m3b + d * dw * dw * wa * wb * (wa - wb)
+                       + 3 * dw * (wa * m2b - wb * m2a);
+    if (m->mom < 4) return;
+    m->wm4 += m4b + d * dw * dw * dw * wa * wb * (wa*wa - wa*wb + wb*wb)
+                  + 6 * dw * dw * (wa*wa * m2b + wb*wb * m2a)
+                  + 4 * dw * (wa * m3b - wb * m3a);
+}
+
 void accum_moment(Moment *m, real x, real w)
 {
     real xx, sum = w;
@@ -108,6 +309,9 @@ void accum_moment(Moment *m, real x, real w)
     }
     if (x<0) m->sumn += x;   /* formally should use diff from mean */
     if (x>0) m->sump += x;
+    if (m->td) td_add(m->td, x, w);
+    if (m->ndat == 0 && m->mom >= 2 && w != 0.0)
+      central_merge(m, w, x, 0.0, 0.0, 0.0);
     if (m->ndat > 0) {                   /* if moving moments .... */
       if (m->idat < 0)                        /* first time around */
 	m->idat=0;  
@@ -156,6 +360,140 @@ void decr_moment(Moment *m, real x, real w)
     }
     if (x<0) m->sumn -= x;
     if (x>0) m->sump -= x;
+    if (m->td)
+      error("decr_moment: cannot be used with a quantile sketch");
+    if (m->mom >= 2 && w != 0.0)        /* merging a negative weight undoes it */
+      central_merge(m, -w, x, 0.0, 0.0, 0.0);
+}
+
+/*
+ * ACCUM_MOMENT_N:  accumulate n values, w=NULL for unit weights.
+ *                  Equivalent to n calls to accum_moment(), but without
+ *                  moving moments the sums are done as vector reductions,
+ *                  and the variance of the batch is merged as in merge_moment()
+ */
+
+void accum_moment_n(Moment *m, int n, real *x, real *w)
+{
+    int i;
+    real s0=0, s1=0, s2=0, s3=0, s4=0, sn=0, sp=0, dmin, dmax;
+    real mean, m2=0, m3=0, m4=0;
+
+    if (n <= 0) return;
+    if (m->ndat > 0 || m->mom > 4) {
+      for (i=0; i<n; i++)
+	accum_moment(m, x[i], w ? w[i] : 1.0);
+      return;
+    }
+    dmin = dmax = x[0];
+    if (m->mom < 0) {
+#if defined(_OPENMP)
+#pragma omp simd reduction(min:dmin) reduction(max:dmax)
+#endif
+      for (i=0; i<n; i++) {
+	dmin = MIN(dmin, x[i]);
+	dmax = MAX(dmax, x[i]);
+      }
+    } else {
+#if defined(_OPENMP)
+#pragma omp simd reduction(+:s0,s1,s2,s3,s4,sn,sp) reduction(min:dmin) reduction(max:dmax)
+#endif
+      for (i=0; i<n; i++) {
+	real xi = x[i], wi = w ? w[i] : 1.0;
+	dmin = MIN(dmin, xi);
+	dmax = MAX(dmax, xi);
+	s0 += wi;
+	s1 += wi*xi;
+	s2 += wi*xi*xi;
+	s3 += wi*xi*xi*xi;
+	s4 += wi*xi*xi*xi*xi;
+	sn += xi < 0 ? xi : 0.0;
+	sp += xi > 0 ? xi : 0.0;
+      }
+    }
+    if (m->n == 0) {
+      m->datamin = dmin;
+      m->datamax = dmax;
+    } else {
+      m->datamin = MIN(dmin, m->datamin);
+      m->datamax = MAX(dmax, m->datamax);
+    }
+    m->n += n;
+    if (m->mom < 0) return;
+    m->sum[0] += s0;
+    if (m->mom > 0) m->sum[1] += s1;
+    if (m->mom > 1) m->sum[2] += s2;
+    if (m->mom > 2) m->sum[3] += s3;
+    if (m->mom > 3) m->sum[4] += s4;
+    m->sumn += sn;
+    m->sump += sp;
+    if (m->td)
+      for (i=0; i<n; i++)
+	td_add(m->td, x[i], w ? w[i] : 1.0);
+    if (m->mom >= 2 && s0 != 0.0) {          /* two-pass for the batch */
+      mean = s1/s0;
+#if defined(_OPENMP)
+#pragma omp simd reduction(+:m2,m3,m4)
+#endif
+      for (i=0; i<n; i++) {
+	real di = x[i] - mean, wd2 = (w ? w[i] : 1.0) * di * di;
+	m2 += wd2;
+	m3 += wd2 * di;
+	m4 += wd2 * di * di;
+      }
+      central_merge(m, s0, mean, m2, m3, m4);
+    }
+}
+
+/*
+ * MERGE_MOMENT:  add the partial moment o to m, e.g. from another thread.
+ *                Not for moving moments.
+ */
+
+void merge_moment(Moment *m, Moment *o)
+{
+    int i;
+
+    if (m->ndat > 0 || o->ndat > 0)
+      error("merge_moment: cannot merge moving moments");
+    if (m->mom != o->mom)
+      error("merge_moment: mom=%d and %d differ", m->mom, o->mom);
+    if (o->n == 0) return;
+    if (m->n == 0) {
+      m->datamin = o->datamin;
+      m->datamax = o->datamax;
+    } else {
+      m->datamin = MIN(o->datamin, m->datamin);
+      m->datamax = MAX(o->datamax, m->datamax);
+    }
+    m->n += o->n;
+    if (o->td) {
+      if (m->td == NULL) m->td = td_new(o->td->comp);
+      td_merge(m->td, o->td);
+    }
+    if (m->mom < 0) return;
+    for (i=0; i<=m->mom; i++)
+      m->sum[i] += o->sum[i];
+    m->sumn += o->sumn;
+    m->sump += o->sump;
+    if (m->mom >= 2 && o->wsum != 0.0)
+      central_merge(m, o->wsum, o->wmean, o->wm2, o->wm3, o->wm4);
+}
+
+/*
+ * SKETCH_MOMENT: keep a t-digest of the given compression (100 is a good
+ *                value, 0 removes it), so median, quantiles and MAD can
+ *                be estimated without moving moments
+ */
+
+void sketch_moment(Moment *m, int comp)
+{
+    if (m->ndat > 0)
+      error("sketch_moment: not needed with ndat=%d", m->ndat);
+    if (m->td) td_free(m->td);
+    m->td = comp > 0 ? td_new(comp) : NULL;
+    if (m->td && m->n > 0)
+      warning("sketch_moment: %d earlier data not in the sketch", m->n);
 }
 
 void reset_moment(Moment *m)
@@ -164,6 +502,11 @@ void reset_moment(Moment *m)
     
     m->n = 0;
     m->idat = -1;
+    if (m->td) {
+      m->td->nc = m->td->nb = 0;
+      m->td->total = 0.0;
+    }
+    m->wsum = m->wmean = m->wm2 = m->wm3 = m->wm4 = 0.0;
     if (m->mom < 0) return;
     for (i=0; i <= m->mom; i++)
         m->sum[i] = 0.0;
@@ -374,6 +717,8 @@ void robust_range(Moment *m, real *range)
 real median_moment(Moment *m)
 {
   int n;
+  if (m->ndat==0 && m->td)
+    return td_quantile(m->td, 0.5);
   if (m->ndat==0)
     error("median_moment cannot be computed with ndat=%d",m->ndat);
   dprintf(1,"median_moment: n=%d ndat=%d\n",m->n, m->ndat);
@@ -381,6 +726,36 @@ real median_moment(Moment *m)
   return smedian(n,m->dat);
 }
 
+/*
+ *  QUANTILE_MOMENT:   q in [0,1], interpolated in the sorted data,
+ *                     or estimated from the sketch
+ */
+
+real quantile_moment(Moment *m, real q)
+{
+  int n, i;
+  real *x, f, val;
+
+  if (q < 0.0 || q > 1.0)
+    error("quantile_moment: q=%g not in [0,1]", q);
+  if (m->ndat==0) {
+    if (m->td == NULL)
+      error("quantile_moment needs ndat>0 or sketch_moment()");
+    return td_quantile(m->td, q);
+  }
+  n = MIN(m->n, m->ndat);
+  if (n == 0) return 0.0;
+  x = (real *) allocate(n*sizeof(real));
+  memcpy(x, m->dat, n*sizeof(real));
+  qsort(x, n, sizeof(real), compar_real);
+  f = q*n - 0.5;                  /* as the sketch: x[i] is at q=(i+0.5)/n */
+  if (f < 0.0) f = 0.0;
+  i = (int) f;
+  val = i < n-1 ? x[i] + (f-i)*(x[i+1]-x[i]) : x[n-1];
+  free(x);
+  return val;
+}
+
 real sigma_moment(Moment *m)
 {
     real mean, tmp2;
@@ -398,7 +773,9 @@ real sigma_moment(Moment *m)
 	tmp2 += sqr(m->dat[i]-mean);
       }
       tmp2 = tmp2/sum0;
-    } else
+    } else if (m->ndat==0)
+      tmp2 = m->wsum > 0.0 ? m->wm2/m->wsum : 0.0;
+    else
       tmp2 = sum2/sum0 - mean*mean;
     if (tmp2 <= 0.0) return 0.0;
     return sqrt(tmp2);
@@ -440,6 +817,15 @@ real mad_moment(Moment *m)
   int i, n;
   Moment tmp;
 
+  if (m->ndat==0 && m->td) {        /* the sketch of |x-median| */
+    struct tdigest *td = td_new(m->td->comp);
+    median = td_quantile(m->td, 0.5);
+    for (i=0; i<m->td->nc; i++)
+      td_add(td, ABS(m->td->cm[i]-median), m->td->cw[i]);
+    median = td_quantile(td, 0.5);
+    td_free(td);
+    return median;
+  }
   if (m->ndat==0)
     error("mad_moment cannot be computed with ndat=%d",m->ndat);
   median = median_moment(m);
@@ -470,7 +856,10 @@ real rms_moment(Moment *m)
     if (m->n < 2) return 0;
     mean=sum1/sum0;
     if (m->datamin == m->datamax) return 0.0;
-    tmp = sum2 - mean*mean*sum0;
+    if (m->ndat==0)
+      tmp = m->wm2;
+    else
+      tmp = sum2 - mean*mean*sum0;
     if (tmp <= 0.0) return 0.0;
     tmp /= (m->n - 1);
     return sqrt(tmp);
@@ -495,6 +884,9 @@ real skewness_moment(Moment *m)
       if (sigma < 0.0) sigma = 0.0;
       sigma = sqrt(sigma);
       tmp = (tmp3/sum0 ) / (sigma*sigma*sigma);      
+    } else if (m->ndat==0) {
+      if (m->wm2 <= 0.0) return 0.0;
+      tmp = sqrt(m->wsum) * m->wm3 / pow(m->wm2, 1.5);
     } else {
       sigma = sum2/sum0 - mean*mean;
       if (sigma < 0.0) sigma = 0.0;
@@ -522,6 +914,9 @@ real kurtosis_moment(Moment *m)
       }
       sigma2 = tmp2/sum0;
       tmp = -3.0 + (tmp4/sum0 ) / (sigma2*sigma2);
+    } else if (m->ndat==0) {
+      if (m->wm2 <= 0.0) return 0.0;
+      tmp = -3.0 + m->wsum * m->wm4 / (m->wm2*m->wm2);
     } else {
       sigma2 = sum2/sum0 - mean*mean;
       tmp = -3.0 +
@@ -583,7 +978,9 @@ string defv[] = {
     "median=f\n     Show median ?",
     "robust=f\n     Show robust mean etc.?",
     "maxsize=0\n    If > 0, size for moving moments instead\n",
-    "VERSION=0.4\n  23-apr-2013 PJT",
+    "sketch=0\n     If > 0, compression of a quantile sketch for median",
+    "nsplit=0\n     If > 0, accumulate this many parts in batch, and merge them",
+    "VERSION=0.5\n  19-oct-2026 PJT",
     NULL,
 };
 
@@ -612,8 +1009,36 @@ void nemo_main(void)
     bool Qminmax = getbparam("minmax");
     bool Qmedian = getbparam("median");
     bool Qrobust = getbparam("robust");
+    int sketch = getiparam("sketch");
+    int nsplit = getiparam("nsplit");
 
     ini_moment(&m,ABS(mom),maxsize);
+    if (sketch > 0) sketch_moment(&m,sketch);
+    if (nsplit > 0) {            /* batches of the whole table, merged */
+      real *xdat;
+      int i, ip, n, ndata = 0, maxdata = 1024;
+      Moment mp;
+
+      if (maxsize > 0) error("nsplit= cannot be used with maxsize=");
+      xdat = (real *) allocate(maxdata*sizeof(real));
+      while (fgets(line,80,instr) != NULL) {
+	if (ndata == maxdata) {
+	  maxdata *= 2;
+	  xdat = (real *) reallocate(xdat, maxdata*sizeof(real));
+	}
+	xdat[ndata++] = atof(line);
+      }
+      for (ip=0, i=0; ip<nsplit; ip++, i+=n) {
+	n = (ndata - i)/(nsplit - ip);
+	ini_moment(&mp,ABS(mom),0);
+	if (sketch > 0) sketch_moment(&mp,sketch);
+	accum_moment_n(&mp,n,xdat+i,NULL);
+	merge_moment(&m,&mp);
+	free_moment(&mp);
+      }
+      x = ndata > 0 ? xdat[ndata-1] : 0.0;
+      free(xdat);
+    } else
     while (fgets(line,80,instr) != NULL) {
       x = atof(line);
       accum_moment(&m,x,1.0);
@@ -636,7 +1061,8 @@ void nemo_main(void)
       if (Qminmax)
         printf("%g %g\n",min_moment(&m), max_moment(&m));
       else if (Qmedian)
-	printf("%g\n",median_moment(&m));
+	printf("%g %g %g  %g\n",median_moment(&m),
+	       quantile_moment(&m,0.25), quantile_moment(&m,0.75), mad_moment(&m));
       else if (Qrobust)  {
 	compute_robust_moment(&m);
         printf("%g\n",mean_robust_moment(&m));
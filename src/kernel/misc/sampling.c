@@ -0,0 +1,482 @@
+/*
+ * SAMPLING: draw from tabulated distributions without rejection.
+ *
+ *	icdf_table:  the inverse of a cumulative distribution, given as a
+ *		     table of x and either the pdf or the cumulative
+ *		     distribution at x. x(c) is interpolated with a monotone
+ *		     cubic Hermite (Fritsch & Butland 1984), and the interval
+ *		     of a given u is found with a guide table (Chen & Asau
+ *		     1974), so a draw costs about one comparison.
+ *	alias_table: Walker's (1977) alias method, as built by Vose (1991):
+ *		     one uniform picks any of n outcomes in constant time.
+ *	cdist_table: a variable x in [0,1] with a pdf p(x|y) depending on a
+ *		     parameter y. For each row y[j] the pdf is linear between
+ *		     the nx grid points; an alias table picks the interval and
+ *		     the linear pdf inside it is inverted exactly. Between two
+ *		     rows one of them is picked with the linear weight, which
+ *		     samples the interpolated pdf. A draw takes 3 uniforms.
+ *
+ *	The batch versions first find the intervals, and then do the
+ *	arithmetic in a loop the compiler can vectorise.
+ *
+ *	19-oct-2026	created			PJT
+ */
+
+#include <stdinc.h>
+#include <sampling.h>
+
+#define NBLK  256		/* draws per block in the batch versions */
+
+/*
+ * ICDF_CREATE: from n points x[] (increasing) and y[], which is the pdf,
+ *		or the (not normalised) cumulative distribution at x.
+ */
+
+icdf_table *icdf_create(int n, double *x, double *y, bool cumulative)
+{
+    icdf_table *t;
+    double *c, *s, total, h0, h1;
+    int i, k, m, nt;
+
+    if (n < 2) error("icdf_create: need at least 2 points, n=%d", n);
+    c = (double *) allocate(n*sizeof(double));
+    c[0] = 0.0;
+    for (i=1; i<n; i++) {
+	if (x[i] <= x[i-1])
+	    error("icdf_create: x not increasing at %d: %g %g", i, x[i-1], x[i]);
+	if (cumulative) {
+	    c[i] = y[i] - y[0];
+	    if (c[i] < c[i-1])
+		error("icdf_create: cumulative distribution decreasing at %d", i);
+	} else {
+	    if (y[i] < 0 || y[i-1] < 0)
+		error("icdf_create: negative pdf at %d", y[i] < 0 ? i : i-1);
+	    c[i] = c[i-1] + 0.5*(y[i-1]+y[i])*(x[i]-x[i-1]);
+	}
+    }
+    total = c[n-1];
+    if (total <= 0) error("icdf_create: distribution has no weight");
+    for (i=0; i<n; i++)
+	c[i] /= total;
+
+    /* drop points inside flat parts: keep the last point of a leading  */
+    /* flat run, both ends of an interior one (x jumps over the gap at  */
+    /* the same c), and the first point reaching c=1                    */
+    for (m=0; c[m] < c[n-1]; m++)
+	;
+    t = (icdf_table *) allocate(sizeof(icdf_table));
+    t->x = (double *) allocate((m+1)*sizeof(double));
+    t->c = (double *) allocate((m+1)*sizeof(double));
+    for (i=0, nt=0; i<=m; i++) {
+	if (i < m && c[i] >= c[i+1] && (i == 0 || c[i-1] >= c[i])) continue;
+	t->x[nt] = x[i];
+	t->c[nt] = c[i];
+	nt++;
+    }
+    t->c[0] = 0.0;
+    t->c[nt-1] = 1.0;
+    t->n = nt;
+    free(c);
+    dprintf(1,"icdf_create: %d of %d points\n", nt, n);
+
+    /* monotone slopes dx/dc: weighted harmonic mean of the secants; */
+    /* a jump (h=0) is never interpolated, so its ends are one sided */
+    s = (double *) allocate((nt-1)*sizeof(double));
+    t->d = (double *) allocate(nt*sizeof(double));
+    for (i=0; i<nt-1; i++)
+	s[i] = t->c[i+1] > t->c[i] ? (t->x[i+1]-t->x[i]) / (t->c[i+1]-t->c[i]) : 0.0;
+    for (i=0; i<nt; i++) {
+	h0 = i > 0    ? t->c[i] - t->c[i-1] : 0.0;
+	h1 = i < nt-1 ? t->c[i+1] - t->c[i] : 0.0;
+	if (h0 > 0 && h1 > 0)
+	    t->d[i] = 3*(h0+h1) / ((2*h1+h0)/s[i-1] + (h1+2*h0)/s[i]);
+	else
+	    t->d[i] = h1 > 0 ? s[i] : s[i-1];
+    }
+    free(s);
+
+    /* guide table: g[k] is the last interval starting at or below k/nt; */
+    /* like icdf_index() it steps over jumps, which have c[i+1]=c[i]      */
+    t->g = (int *) allocate(nt*sizeof(int));
+    for (k=0, i=0; k<nt; k++) {
+	while (i < nt-2 && t->c[i+1] <= (double)k/nt)
+	    i++;
+	t->g[k] = i;
+    }
+    return t;
+}
+
+/* the interval of the table that holds u */
+
+local int icdf_index(icdf_table *t, double u)
+{
+    int i, k;
+
+    k = (int) (u * t->n);
+    if (k < 0) k = 0;
+    if (k >= t->n) k = t->n - 1;
+    i = t->g[k];
+    while (i < t->n-2 && t->c[i+1] <= u)
+	i++;
+    return i;
+}
+
+/* the cubic Hermite of interval i at u */
+
+#define HERMITE(t,i,u,xu) { \
+    double h_ = t->c[i+1] - t->c[i], s_ = ((u) - t->c[i]) / h_; \
+    double s2_ = s_*s_, s3_ = s2_*s_; \
+    xu = (2*s3_ - 3*s2_ + 1) * t->x[i] + (s3_ - 2*s2_ + s_) * h_ * t->d[i] + \
+	 (3*s2_ - 2*s3_) * t->x[i+1] + (s3_ - s2_) * h_ * t->d[i+1]; }
+
+/*
+ * ICDF_EVAL: x at cumulative fraction u in [0,1]
+ */
+
+double icdf_eval(icdf_table *t, double u)
+{
+    double x;
+    int i;
+
+    if (u <= 0.0) return t->x[0];
+    if (u >= 1.0) return t->x[t->n-1];
+    i = icdf_index(t, u);
+    HERMITE(t, i, u, x);
+    return x;
+}
+
+/*
+ * ICDF_EVAL_N: x[j] = icdf_eval(t,u[j]) for n values; x may be u
+ */
+
+void icdf_eval_n(icdf_table *t, int n, double *u, double *x)
+{
+    int idx[NBLK], b, j, nb;
+    double uj, xj;
+
+    for (b=0; b<n; b+=NBLK) {
+	nb = MIN(NBLK, n-b);
+	for (j=0; j<nb; j++)
+	    idx[j] = icdf_index(t, MAX(0.0, MIN(1.0, u[b+j])));
+#if defined(_OPENMP)
+#pragma omp simd private(uj,xj)
+#endif
+	for (j=0; j<nb; j++) {
+	    uj = MAX(0.0, MIN(1.0, u[b+j]));
+	    HERMITE(t, idx[j], uj, xj);
+	    x[b+j] = xj;
+	}
+    }
+}
+
+void icdf_free(icdf_table *t)
+{
+    free(t->x);
+    free(t->c);
+    free(t->d);
+    free(t->g);
+    free(t);
+}
+
+/*
+ * ALIAS_CREATE: alias table for outcomes 0..n-1 with weights w[]
+ */
+
+alias_table *alias_create(int n, double *w)
+{
+    alias_table *t;
+    double total, *p;
+    int i, l, s, *small, *large, ns, nl;
+
+    if (n < 1) error("alias_create: n=%d", n);
+    for (i=0, total=0.0; i<n; i++) {
+	if (w[i] < 0) error("alias_create: negative weight %g for %d", w[i], i);
+	total += w[i];
+    }
+    if (total <= 0) error("alias_create: no weight");
+    t = (alias_table *) allocate(sizeof(alias_table));
+    t->n = n;
+    t->prob = p = (double *) allocate(n*sizeof(double));
+    t->alias = (int *) allocate(n*sizeof(int));
+    small = (int *) allocate(n*sizeof(int));
+    large = (int *) allocate(n*sizeof(int));
+    for (i=0, ns=nl=0; i<n; i++) {
+	p[i] = w[i] * n / total;
+	t->alias[i] = i;
+	if (p[i] < 1.0)
+	    small[ns++] = i;
+	else
+	    large[nl++] = i;
+    }
+    while (ns > 0 && nl > 0) {		/* fill each small column from a large one */
+	s = small[--ns];
+	l = large[--nl];
+	t->alias[s] = l;
+	p[l] -= 1.0 - p[s];
+	if (p[l] < 1.0)
+	    small[ns++] = l;
+	else
+	    large[nl++] = l;
+    }
+    while (nl > 0) p[large[--nl]] = 1.0;	/* what is left is full, */
+    while (ns > 0) p[small[--ns]] = 1.0;	/* up to roundoff        */
+    free(small);
+    free(large);
+    return t;
+}
+
+/*
+ * ALIAS_EVAL: the outcome for a uniform u in [0,1): the integer part of
+ *	       u*n picks the column, the fraction decides about the alias
+ */
+
+int alias_eval(alias_table *t, double u)
+{
+    double v = u * t->n;
+    int i = (int) v;
+
+    if (i < 0) i = 0;
+    if (i >= t->n) i = t->n - 1;
+    return (v - i) < t->prob[i] ? i : t->alias[i];
+}
+
+void alias_free(alias_table *t)
+{
+    free(t->prob);
+    free(t->alias);
+    free(t);
+}
+
+/*
+ * CDIST_CREATE: tables of pdf(x,y,arg) for x in [0,1] on nx points, for
+ *		 each of the ny (increasing) y[]
+ */
+
+cdist_table *cdist_create(int ny, double *y, int nx, cdist_proc pdf, void *arg)
+{
+    cdist_table *t;
+    double *p, *w, dx, total;
+    int i, j;
+
+    if (ny < 1 || nx < 2) error("cdist_create: ny=%d nx=%d", ny, nx);
+    t = (cdist_table *) allocate(sizeof(cdist_table));
+    t->ny = ny;
+    t->nx = nx;
+    t->y = (double *) allocate(ny*sizeof(double));
+    t->x = (double *) allocate(nx*sizeof(double));
+    t->p = (double *) allocate(ny*nx*sizeof(double));
+    t->row = (alias_table **) allocate(ny*sizeof(alias_table *));
+    w = (double *) allocate((nx-1)*sizeof(double));
+    dx = 1.0/(nx-1);
+    for (i=0; i<nx; i++)
+	t->x[i] = i*dx;
+    for (j=0; j<ny; j++) {
+	if (j > 0 && y[j] <= y[j-1])
+	    error("cdist_create: y not increasing at %d", j);
+	t->y[j] = y[j];
+	p = t->p + j*nx;
+	for (i=0; i<nx; i++) {
+	    p[i] = (*pdf)(t->x[i], y[j], arg);
+	    if (p[i] < 0)
+		error("cdist_create: pdf(%g,%g)=%g < 0", t->x[i], y[j], p[i]);
+	}
+	for (i=0, total=0.0; i<nx-1; i++)
+	    total += (w[i] = 0.5*(p[i]+p[i+1])*dx);
+	if (total <= 0) {
+	    dprintf(1,"cdist_create: row %d (y=%g) has no weight, uniform\n", j, y[j]);
+	    for (i=0; i<nx; i++) p[i] = 1.0;
+	    for (i=0; i<nx-1; i++) w[i] = dx;
+	    total = 1.0;
+	}
+	for (i=0; i<nx; i++)
+	    p[i] /= total;
+	t->row[j] = alias_create(nx-1, w);
+    }
+    free(w);
+    return t;
+}
+
+/* row (picked by u0 between two rows) and x interval, for a given y */
+
+local int cdist_index(cdist_table *t, double y, double u0, double u1)
+{
+    int lo = 0, hi = t->ny-1, mid, j;
+
+    if (y <= t->y[0])
+	j = 0;
+    else if (y >= t->y[hi])
+	j = hi;
+    else {
+	while (hi - lo > 1) {			/* y[lo] <= y < y[hi] */
+	    mid = (lo+hi)/2;
+	    if (t->y[mid] <= y) lo = mid; else hi = mid;
+	}
+	j = (u0 < (y - t->y[lo])/(t->y[hi] - t->y[lo])) ? hi : lo;
+    }
+    return j*t->nx + alias_eval(t->row[j], u1);
+}
+
+/* invert the linear pdf from p0 to p1 over the unit interval at u2 */
+
+#define LININV(p0,p1,u2,s) { \
+    double den_ = p0 + sqrt(p0*p0 + (p1*p1-p0*p0)*u2); \
+    s = den_ > 0 ? (p0+p1)*u2/den_ : u2; }
+
+/*
+ * CDIST_EVAL: x for parameter y and 3 uniforms u[0..2] in [0,1)
+ */
+
+double cdist_eval(cdist_table *t, double y, double *u)
+{
+    int k = cdist_index(t, y, u[0], u[1]), i = k % t->nx;
+    double s;
+
+    LININV(t->p[k], t->p[k+1], u[2], s);
+    return (i + s) * (t->x[1]-t->x[0]);
+}
+
+/*
+ * CDIST_EVAL_N: x[j] = cdist_eval(t,y[j],&u[3*j]) for n values
+ */
+
+void cdist_eval_n(cdist_table *t, int n, double *y, double *u, double *x)
+{
+    int idx[NBLK], b, j, nb;
+    double dx = t->x[1]-t->x[0], p0, p1, s;
+
+    for (b=0; b<n; b+=NBLK) {
+	nb = MIN(NBLK, n-b);
+	for (j=0; j<nb; j++)
+	    idx[j] = cdist_index(t, y[b+j], u[3*(b+j)], u[3*(b+j)+1]);
+#if defined(_OPENMP)
+#pragma omp simd private(p0,p1,s)
+#endif
+	for (j=0; j<nb; j++) {
+	    p0 = t->p[idx[j]];
+	    p1 = t->p[idx[j]+1];
+	    LININV(p0, p1, u[3*(b+j)+2], s);
+	    x[b+j] = (idx[j] % t->nx + s) * dx;
+	}
+    }
+}
+
+void cdist_free(cdist_table *t)
+{
+    int j;
+
+    for (j=0; j<t->ny; j++)
+	alias_free(t->row[j]);
+    free(t->row);
+    free(t->y);
+    free(t->x);
+    free(t->p);
+    free(t);
+}
+
+
+#ifdef TESTBED
+
+#include <getparam.h>
+
+string defv[] = {
+    "n=100000\n     Number of (stratified) draws per test",
+    "ntab=1001\n    Number of table points",
+    "VERSION=1.0\n  19-oct-2026 PJT",
+    NULL,
+};
+
+string usage="testing inverse-CDF, alias and conditional sampling tables";
+
+local double powpdf(double x, double y, void *arg)
+{
+    return (1+y) * pow(x, y);		/* mean (1+y)/(2+y) */
+}
+
+void nemo_main()
+{
+    int i, k, n = getiparam("n"), ntab = getiparam("ntab"), nbad = 0;
+    double *x, *y, *z, *u, *v, sum, sum2, w[4] = { 1.0, 2.0, 0.0, 5.0 };
+    double ytab[7] = { 0.0, 0.5, 1.0, 1.5, 2.0, 2.5, 3.0 };
+    int count[4] = { 0, 0, 0, 0 };
+    icdf_table *it;
+    alias_table *at;
+    cdist_table *ct;
+
+    /* gaussian in [-6,6] from its pdf */
+    x = (double *) allocate(ntab*sizeof(double));
+    y = (double *) allocate(ntab*sizeof(double));
+    for (i=0; i<ntab; i++) {
+	x[i] = -6.0 + 12.0*i/(ntab-1);
+	y[i] = exp(-0.5*x[i]*x[i]);
+    }
+    it = icdf_create(ntab, x, y, FALSE);
+    u = (double *) allocate(3*n*sizeof(double));
+    v = (double *) allocate(n*sizeof(double));
+    for (i=0; i<n; i++)
+	u[i] = (i+0.5)/n;
+    icdf_eval_n(it, n, u, v);
+    for (i=0, sum=sum2=0.0; i<n; i++) {
+	if (v[i] != icdf_eval(it, u[i])) nbad++;
+	if (i > 0 && v[i] < v[i-1]) nbad++;
+	sum += v[i];
+	sum2 += v[i]*v[i];
+    }
+    printf("icdf gauss: mean %g sigma %g median %g\n",
+	   sum/n, sqrt(sum2/n), icdf_eval(it, 0.5));
+    if (ABS(sum/n) > 1e-6 || ABS(sqrt(sum2/n)-1) > 1e-3) nbad++;
+    icdf_free(it);
+
+    /* a gap with zero pdf inside: no draws may land in (1,2) */
+    {
+	double xg[4] = { 0.0, 1.0, 2.0, 3.0 }, pg[4] = { 1.0, 0.0, 0.0, 1.0 };
+	int ngap = 0;
+
+	it = icdf_create(4, xg, pg, FALSE);
+	icdf_eval_n(it, n, u, v);
+	for (i=0, sum=0.0; i<n; i++) {
+	    if (v[i] > 1.0 && v[i] < 2.0) ngap++;
+	    if (i > 0 && v[i] < v[i-1]) nbad++;
+	    sum += v[i];
+	}
+	printf("icdf gap: %d of %d in the gap, mean %g expected 1.5\n", ngap, n, sum/n);
+	if (ngap > 0 || ABS(sum/n - 1.5) > 1e-3) nbad++;
+	icdf_free(it);
+    }
+
+    /* a zero weight outcome must never come up */
+    at = alias_create(4, w);
+    for (i=0; i<n; i++)
+	count[alias_eval(at, (i+0.5)/n)]++;
+    printf("alias 1:2:0:5 -> %d %d %d %d\n", count[0], count[1], count[2], count[3]);
+    for (k=0; k<4; k++)
+	if (ABS(count[k] - n*w[k]/8) > 1) nbad++;
+    alias_free(at);
+
+    /* conditional: on and between the rows */
+    ct = cdist_create(7, ytab, ntab, powpdf, NULL);
+    for (k=0; k<7; k++) {
+	double yk = 0.25 + 0.5*k, m;
+	for (i=0; i<n; i++) {			/* stratified in u[2] */
+	    u[3*i]   = xrandom(0.0, 1.0);
+	    u[3*i+1] = xrandom(0.0, 1.0);
+	    u[3*i+2] = (i+0.5)/n;
+	}
+	for (i=0, sum=0.0; i<n; i++)
+	    sum += cdist_eval(ct, yk, &u[3*i]);
+	m = 0.5*((1+ytab[k])/(2+ytab[k]) + (1+ytab[MIN(k+1,6)])/(2+ytab[MIN(k+1,6)]));
+	printf("cdist y=%g: mean %g expected %g\n", yk, sum/n, m);
+	if (ABS(sum/n - m) > 0.01) nbad++;
+    }
+    for (i=0; i<n; i++) v[i] = 3.0*(i+0.5)/n;
+    z = (double *) allocate(n*sizeof(double));
+    cdist_eval_n(ct, n, v, u, z);
+    for (i=0; i<n; i++)
+	if (z[i] != cdist_eval(ct, v[i], &u[3*i])) nbad++;
+    cdist_free(ct);
+    free(x);  free(y);  free(z);  free(u);  free(v);
+
+    if (nbad) error("sampling: %d tests failed", nbad);
+    printf("all tests passed\n");
+}
+
+#endif
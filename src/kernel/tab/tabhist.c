@@ -52,6 +52,7 @@
  *      10-oct-2020 7.2   using median()                        PJT
  *      11-feb-2021 7.3   added diff mean & disp                PJT
  *      29-apr-2022 8.0   converted to use table V2             PJT
+ *      19-oct-2026 8.1   histogram with the binning library    PJT
  *                
  * 
  * TODO:
@@ -69,6 +70,7 @@
 #include <strlib.h>
 #include <getparam.h>
 #include <moment.h>
+#include <binning.h>
 #include <yapp.h>
 #include <axis.h>
 #include <mdarray.h>
@@ -113,7 +115,7 @@ string defv[] = {
     "scale=1\n                    Scale factor for data",
     "out=\n                       Optional output file to select the robust points",
     "pyplot=\n                    Template python plotting script",    
-    "VERSION=8.0d\n		  29-aug-2024 PJT",
+    "VERSION=8.1\n		  19-oct-2026 PJT",
     NULL
 };
 
@@ -188,7 +190,7 @@ local iproc  mysort, getsort();
 local real  xtrans(real), ytrans(real);
 local void  setparams(void), read_data(void), histogram(void);
 local iproc getsort(string name);
-local int   ring_index(int n, real *r, real rad);
+local int   bin_count(real *count);
 
 extern real median_torben(int n, real *x, real xmin, real xmax);
 extern void minmax(int n, real *x, real *xmin, real *xmax);
@@ -383,37 +385,16 @@ local void histogram(void)
     dprintf (0,"min and max value in range : %g  %g\n",lmin,lmax);
   } 
   
-  for (k=0; k<nsteps; k++)
-    count[k] = 0;		/* init histogram */
-  under = over = 0;
-  
   ini_moment(&m,  4, Qrobust||Qmad ? npt : 0);
   ini_moment(&md, 4, Qrobust||Qmad ? npt : 0);  
   for (i=0; i<npt; i++) {
-    if (Qbin) {
-      k=ring_index(nsteps,bins,x[i]);
-      // dprintf(0,"%d %g -> %d\n",i,x[i],k);
-    } else {
-      if (xmax != xmin)
-	k = (int) floor((x[i]-xmin)/(xmax-xmin)*nsteps);
-      else
-	k = 0;
-      dprintf(2,"%d k=%d %g\n",i,k,x[i]);
-    }
-    if (k==nsteps && x[i]==xmax) k--;     /* include upper edge */
-    if (k<0)       { under++; continue; }
-    if (k>=nsteps) { over++;  continue; }
-    count[k] = count[k] + 1;
-    dprintf (4,"%d : %f %d\n",i,x[i],k);
     accum_moment(&m,x[i],1.0);
     if (i>0) {
       accum_moment(&md,x[i]-x[i-1],1.0);
       //printf("%d %g %g\n",i,x[i],x[i]-x[i-1]);
     }
-    
   }
-  if (under > 0) error("bug: under = %d",under);
-  if (over  > 0) error("bug: over = %d",over);
+  if ((k = bin_count(count)) > 0) error("bug: %d points outside the histogram",k);
   under = Nunder;
   over  = Nover;
 
@@ -554,21 +535,7 @@ local void histogram(void)
   if (lcount > 0) {
     warning("Recompute histogram because of outlier removals");
     /* recompute histogram if we've lost some outliers */
-    for (k=0; k<nsteps; k++)
-      count[k] = 0;		/* init histogram */
-    under = over = 0;
-    for (i=0; i<npt; i++) {
-      if (xmax != xmin)
-	k = (int) floor((x[i]-xmin)/(xmax-xmin)*nsteps);
-      else
-	k = 0;
-      if (k==nsteps && x[i]==xmax) k--;     /* include upper edge */
-      if (k<0)       { under++; continue; }
-      if (k>=nsteps) { over++;  continue; }
-      count[k] = count[k] + 1;
-      dprintf (4,"%d : %f %d\n",i,x[i],k);
-    }
-    if (under > 0 || over > 0) error("under=%d over=%d in recomputed histo",under,over);
+    if ((k = bin_count(count)) > 0) error("%d points outside the recomputed histo",k);
   }
   
   dprintf (3,"Histogram values : \n");
@@ -784,22 +751,31 @@ local iproc getsort(string name)
 }
 
 
-/* index into an array --- stolen from velfit.c */
+/*
+ * BIN_COUNT: histogram of x[] in count[], in the linear bins from xmin
+ *	      to xmax or the edges bins[]; upper edge included.
+ *	      Returns the number of points outside.
+ */
 
-local int ring_index(int n, real *r, real rad)
+local int bin_count(real *count)
 {
-  int i;
-  
-  if (r[0] < r[1]) {
-    if (rad < r[0]) return -1;
-    if (rad > r[n]) return -2;
-    for (i=0;i<n;i++)
-      if (rad >= r[i] && rad < r[i+1]) return i;
-    error("ring_index: should never gotten here %g in [%g : %g]",
-	  rad,r[0],r[n-1]);
-  } else {
-    error("reverse indexing not yet implemented");
+  bin_table *b;
+  double lo = xmin, hi = xmax;
+  int k, nout;
+
+  if (!Qbin && xmax == xmin) {		/* all in the first bin */
+    for (k=0; k<nsteps; k++)
+      count[k] = 0;
+    count[0] = npt;
+    return 0;
   }
-  return -1;  /* NEVER REACHED */
+  b = bin_create(1, &nsteps, &lo, &hi, 0);
+  if (Qbin) bin_edges(b, 0, bins);
+  b->closed = TRUE;
+  bin_add_n(b, npt, x, NULL, NULL, NULL, NULL);
+  for (k=0; k<nsteps; k++)
+    count[k] = b->w[k];
+  nout = b->nout;
+  bin_free(b);
+  return nout;
 }
-
@@ -60,11 +60,17 @@
  *  27-jul-05   add dummy loader for lazy gcc4 type linkers
  *  28-jul-06   add show= options
  *  15-Aug-09   add support for Cygwin DLL by LOADOBJDLL
+ *  19-oct-26   V3.4 per-user content-hashed cache of compiled expressions,
+ *                   with flock(2) to let concurrent tools share it
+ *                   no tmp dir or lock file left behind, build log in the cache
  *
  *  Used environment variables (normally set through .cshrc/NEMORC files)
  *      NEMO        used in case NEMOOBJ was not available
  *      NEMOOBJ     normally points to $NEMO/obj/bodytrans
  *      BTRPATH     path of directories where to look for object files
+ *      NEMO_CACHE  root of the cache of compiled expressions (default
+ *                  $XDG_CACHE_HOME/nemo or ~/.cache/nemo); an empty
+ *                  value disables the cache
  *	CFLAGS      if present, used in on-the-fly C compilation (only < V3)
  *
  * TODO:
@@ -86,6 +92,14 @@
 #define LOADOBJDLL
 #endif
 
+#if defined(LOADOBJ3)
+#include <fcntl.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#endif
+
 
 /*  note: MAXNAMLEN is the Posix max filename (normally 255) */
 #define SHORT_FNAMELEN   64
@@ -93,6 +107,7 @@
 local proc   bodytrans(string,string,string);
 local void   ini_bt(void), end_bt(void), make_bt(string), show_bt(void);
 local string get_bt(string), put_bt(string,char,string);
+local bool   cache_bt(string,string,char *);
 
 void bodytrans_dummy_for_c(void);
 
@@ -200,6 +215,8 @@ local proc bodytrans(string type, string expr, string fname)
 	loadobj(file);
         sprintf(func, "%s", cp);               /* generic symbol name */
         mapsys(func);                                     /* remap it */
+    } else if ((fname==NULL || *fname==0) && cache_bt(type, expr, func)) {
+        mapsys(func);                   /* loaded from the user cache */
     } else {                                           /* make a file */
         dprintf(0, "[bodytrans_new: invoking cc");
 #if defined(SAVE_OBJ)
@@ -287,6 +304,186 @@ local proc bodytrans(string type, string expr, string fname)
     return result;
 }
 
+/*
+ * CACHE_BT: look up, or compile into, the per-user cache of expressions.
+ *	Entries are named after a 64-bit FNV-1a hash of everything that
+ *	determines the compiled code: type, expression, real and NDIM, and
+ *	the headers and makedefs used to compile it.  A miss is compiled
+ *	in a private directory while holding an exclusive flock(2) on the
+ *	entry, and then rename(2)d into place, so other processes never
+ *	see a partial file and an expression is compiled only once.
+ *	Returns FALSE if there is no usable cache, the caller then falls
+ *	back to the old way.
+ */
+
+#if defined(LOADOBJ3)
+
+#define FNV_OFFSET  14695981039346656037ULL
+#define FNV_PRIME   1099511628211ULL
+
+local char cachedir[256];
+local int  Qcache = -1;         /* -1: not checked yet, 0: none, 1: usable */
+
+local unsigned long long fnv_bt(unsigned long long h, const void *data, size_t n)
+{
+    const unsigned char *p = (const unsigned char *) data;
+
+    while (n--) {
+        h ^= *p++;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+local unsigned long long fnvfile_bt(unsigned long long h, string dir, string name)
+{
+    char path[512], buf[4096];
+    size_t n;
+    FILE *fp;
+
+    if (dir == NULL) return h;
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int) sizeof(path)) return h;
+    h = fnv_bt(h, name, strlen(name)+1);
+    if ((fp = fopen(path, "r")) == NULL) return h;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        h = fnv_bt(h, buf, n);
+    fclose(fp);
+    return h;
+}
+
+local bool mkdir_bt(string dir)         /* mkdir -p, private to the user */
+{
+    char path[256], *cp;
+
+    strcpy(path, dir);
+    for (cp = path+1; *cp; cp++) {
+        if (*cp != '/') continue;
+        *cp = 0;
+        if (mkdir(path, 0700) < 0 && errno != EEXIST) return FALSE;
+        *cp = '/';
+    }
+    if (mkdir(path, 0700) < 0 && errno != EEXIST) return FALSE;
+    return access(path, W_OK|X_OK) == 0;
+}
+
+/*
+ * PATH_BT: snprintf() into buf[len], FALSE if it did not fit
+ */
+
+local bool path_bt(char *buf, size_t len, string fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(buf, len, fmt, ap);
+    va_end(ap);
+    if (n >= 0 && (size_t) n < len) return TRUE;
+    dprintf(1,"bodytrans: name too long for the cache: %s...\n", buf);
+    return FALSE;
+}
+
+local bool cache_bt(string type, string expr, char *func)
+{
+    char file[512], lock[512], log[512], tmpdir[512], cmmd[1024], src[1024];
+    unsigned long long h;
+    int  nreal = sizeof(real), ndim = NDIM, fd, status;
+    char *cp;
+    stream cdstr;
+
+    if (Qcache < 0) {                           /* find the cache, once */
+        Qcache = 0;
+        if ((cp = getenv("NEMO_CACHE")) != NULL) {
+            if (*cp == 0) return FALSE;         /* explicitly disabled */
+            if (strlen(cp) < 200) snprintf(cachedir, sizeof(cachedir), "%s/bodytrans", cp);
+        } else if ((cp = getenv("XDG_CACHE_HOME")) != NULL && *cp) {
+            if (strlen(cp) < 200) snprintf(cachedir, sizeof(cachedir), "%s/nemo/bodytrans", cp);
+        } else if ((cp = getenv("HOME")) != NULL && *cp) {
+            if (strlen(cp) < 200) snprintf(cachedir, sizeof(cachedir), "%s/.cache/nemo/bodytrans", cp);
+        }
+        if (*cachedir && mkdir_bt(cachedir))
+            Qcache = 1;
+        else
+            dprintf(1,"bodytrans: no usable cache directory %s\n",cachedir);
+    }
+    if (Qcache == 0) return FALSE;
+
+    h = fnv_bt(FNV_OFFSET, type, strlen(type)+1);
+    h = fnv_bt(h, expr, strlen(expr)+1);
+    h = fnv_bt(h, &nreal, sizeof(int));
+    h = fnv_bt(h, &ndim, sizeof(int));
+    h = fnvfile_bt(h, getenv("NEMOINC"), "bodytrans.h");
+    h = fnvfile_bt(h, getenv("NEMOINC"), "snapshot/body.h");
+    h = fnvfile_bt(h, getenv("NEMOLIB"), "makedefs");
+    sprintf(func, "bt%c_h%016llx", type[0], h);
+    if (!path_bt(file,   sizeof(file),   "%s/%s.so",      cachedir, func) ||
+        !path_bt(lock,   sizeof(lock),   "%s/%s.lock",    cachedir, func) ||
+        !path_bt(log,    sizeof(log),    "%s/%s.log",     cachedir, func) ||
+        !path_bt(tmpdir, sizeof(tmpdir), "%s/tmp.XXXXXX", cachedir))
+        return FALSE;                           /* use the old way */
+
+    if (access(file, R_OK) != 0) {              /* miss: compile under lock */
+        if ((fd = open(lock, O_CREAT|O_RDWR, 0600)) < 0) {
+            dprintf(1,"bodytrans: cannot open %s\n",lock);
+            return FALSE;
+        }
+        if (flock(fd, LOCK_EX) < 0)
+            warning("bodytrans: flock on %s failed, proceeding unlocked",lock);
+        if (access(file, R_OK) != 0) {          /* nobody did it meanwhile */
+            dprintf(0, "[bodytrans: invoking cc, caching %s]\n", func);
+            if (mkdtemp(tmpdir) == NULL)
+                error("bodytrans: cannot create %s",tmpdir);
+            snprintf(src, sizeof(src), "%s/%s.c", tmpdir, func);
+            cdstr = fopen(src, "w");
+            if (cdstr == NULL)
+                error("bodytrans: cannot write %s",src);
+            fprintf(cdstr, "#include <bodytrans.h>\n\n");
+            fprintf(cdstr, "%s %s(Body *b,real t,int i)\n", type, func);
+            fprintf(cdstr, "{\n    return (%s);\n}\n", expr);
+            fclose(cdstr);
+            if (!path_bt(cmmd, sizeof(cmmd),
+                         "cd %s;make -f $NEMOLIB/Makefile.lib %s.so > %s 2>&1",
+                         tmpdir, func, log))
+                error("bodytrans: cache directory name %s too long", cachedir);
+            dprintf(2,"bodytrans: %s\n",cmmd);
+            status = system(cmmd);
+            if (status == 0) {
+                (void) path_bt(cmmd, sizeof(cmmd), "%s/%s.c", cachedir, func);
+                (void) rename(src, cmmd);               /* keep source too */
+                snprintf(src, sizeof(src), "%s/%s.so", tmpdir, func);
+                if (rename(src, file) < 0)
+                    status = -1;
+                else
+                    (void) unlink(log);
+            }
+            snprintf(cmmd, sizeof(cmmd), "rm -rf %s", tmpdir);
+            (void) system(cmmd);
+            (void) unlink(lock);        /* at worst a latecomer compiles too */
+            flock(fd, LOCK_UN);
+            close(fd);
+            if (status != 0)
+                error("bodytrans(): could not compile expr=%s, see %s",
+                      expr, log);
+        } else {
+            dprintf(1,"bodytrans: %s was compiled by another process\n",func);
+            flock(fd, LOCK_UN);
+            close(fd);
+        }
+    } else
+        dprintf(1,"bodytrans: cache hit %s for %s\n",file,expr);
+    loadobj(file);
+    return TRUE;
+}
+
+#else
+
+local bool cache_bt(string type, string expr, char *func)
+{
+    return FALSE;
+}
+
+#endif
+
 /*  
  * INI_BT: initialize some filenames for subsequent _BT functions
  *
@@ -560,7 +757,7 @@ string defv[] = {
     "alias=\n		Filename to save expression in (bt<TYPE>_<ALIAS>)",
     "btnames=\n		BTNAMES filename to regenerate .so files",
     "show=f\n           show all existing bodytrans in the system",
-    "VERSION=3.3a\n	23-jan-2021 PJT",
+    "VERSION=3.4\n	19-oct-2026 PJT",
     NULL,
 };
 
@@ -88,6 +88,9 @@ extern void force(bodyptr btab, int nb, real time, bool Qnew);
 extern void rotate_aux(bodyptr btab, int nb);
 extern void diffuse(body *btab, int nb, int ndim, real sigma, bool Qrotate);
 
+/* dissipate.c */
+extern void dissipate(body *btab, int nb, int ndim, real *dr, real eta, real grid, real fheat);
+
 /* code_io.c */
 
 extern void inputdata(void);
@@ -9,50 +9,63 @@
  *         25-oct-92    added fheat
  *	   10-apr-96	fixed  calloc() delcaration
  *         10-apr-01    gcc warnings
+ *         19-oct-26    sparse hashed cells instead of a dense nx*ny*nz cube,
+ *                      Key() is not used anymore; OpenMP over cells    PJT
  */
 
 #include "defs.h"
+#include <limits.h>
 #ifndef HUGE
 #define HUGE 1E20
 #endif
 
-static int *c = NULL;
+/*
+ * Only occupied cells are kept, in an open addressing hash table on the
+ * integer cell coordinates, and the bodies are counting-sorted by cell.
+ * Work and memory thus scale with nb, not with the volume of the
+ * bounding box, so a few escaping bodies cost nothing.
+ */
+
+typedef struct cell {
+    int ix, iy, iz;                 /* cell coordinates */
+    int n;                          /* number of bodies in cell */
+    int first;                      /* their offset in ord[] */
+} cell;
+
+static int  *cid = NULL;            /* [nb] cell of a body, -1 if outside */
+static int  *cxyz = NULL;           /* [nb*3] cell coordinates of a body */
+static int  *ord = NULL;            /* [nb] bodies, sorted by cell */
+static cell *cells = NULL;          /* [nb] occupied cells */
+static int  *hash = NULL;           /* [nhash] index in cells[], -1 if empty */
 static int    size = 0;
+static int    nhash = 0;
 static int    entry = 0;
 
 #define ECONS  1		/* flag energy conservation */
 #define USE_MAXGRID 1           /* fix max allowed grid */
 
+#define HASH(ix,iy,iz)  (((unsigned)(ix)*73856093u) ^ ((unsigned)(iy)*19349663u) ^ ((unsigned)(iz)*83492791u))
 
-void dissipate (btab, nb, ndim, dr, eta, grid, fheat)
-Body *btab;
-int   nb;
-int   ndim;
-real *dr;
-real  eta;
-real  grid;
-real  fheat;
+void dissipate (Body *btab, int nb, int ndim, real *dr, real eta, real grid, real fheat)
 {
-    real rmin[NDIM], rmax[NDIM], *pos;
-    int  nbin[NDIM], ndis=0;
-    Body *b, *b1;
-    int   i, k, n, ix, iy, iz, nx, ny, nz, nxyz, ind;
-    bool Qheat, Qangle, Qkappa, scanopt();
-    vector  velsum, veldif;
-    real t_before, t_after, kappa;
-    real angle, p, ss, cc, velsig, vx, vy;
-    
+    real rmin[NDIM], rmax[NDIM], xmax[NDIM], *pos;
+    int  nbin[NDIM], ndis=0, nout=0, ncell;
+    Body *b;
+    int   i, k, n, h, ix, iy, iz;
+    bool Qheat, Qangle, Qkappa;
+
     if (eta==0.0) return;          /* no work to do ... */
     Qheat = (fheat > 0) ;
     Qangle = scanopt(options,"angle");
     Qkappa = scanopt(options,"kappa");
+
     entry++;                                    /* debug counter of entries */
-    	
+
     for (i=0; i<NDIM; i++) {                    /* init min and max of cube */
         rmin[i] = HUGE;
 	rmax[i] = -HUGE;
     }
-    
+
     for (b=btab; b<btab+nb; b++) {              /* get min and max of cube */
         pos = Pos(b);
 	for (i=0; i<NDIM; i++) {
@@ -74,115 +87,135 @@ real  fheat;
             }
         }
 #endif
-    
-    for (i=0; i<NDIM; i++)                      /* get cell size */
+
+    for (i=0; i<NDIM; i++) {                    /* get cell size */
         if (dr[i] > 0)
-	    nbin[i] = (rmax[i]-rmin[i])/dr[i] + 1;
+	    xmax[i] = (rmax[i]-rmin[i])/dr[i] + 1;
 	else
-	    nbin[i] = 1;
-	    
-    nx = nbin[0];
-    ny = nbin[1];
-    nz = nbin[2];
-    nxyz = nx*ny*nz;
-    if (nxyz > size) {                      /* need more space !! */
-        if (c)
-	    free(c);                        /* allocate old one */
-        c = (int *) calloc(nxyz, sizeof(int));
-	if (c==NULL) {
-            warning("No memory for %d * %d * %d cube; no dissipation",nx,ny,nz);
-	    return;       /* error: not enough memory */
+	    xmax[i] = 1;
+        xmax[i] = MIN(xmax[i], (real) INT_MAX);
+        nbin[i] = (int) xmax[i];
+    }
+
+    if (nb > size) {                        /* need more space !! */
+        if (cid) {
+            free(cid);  free(cxyz);  free(ord);  free(cells);  free(hash);
         }
-	size = nxyz;                        /* and remember new space */
-	dprintf(1,"Allocated %d on entry # %d\n",size,entry);
-    } else
-	for (i=0; i<nxyz; i++)
-	    c[i] = 0;                     /* reset index cube */
-
-    for (b=btab, i=0; b<btab+nb; b++, i++) {    /* build interaction list */
-        ix = (Phase(b)[0][0] - rmin[0])/dr[0];  /* get cell location */
-        iy = (Phase(b)[0][1] - rmin[1])/dr[1];
-        iz = (Phase(b)[0][2] - rmin[2])/dr[2];
-        if (ix<0 || ix>=nx) continue;       /* allow particles outside grid */
-        if (iy<0 || iy>=ny) continue;
-        if (iz<0 || iz>=nz) continue;
-        ind = ix + nx*iy + nx*ny*iz;        /* index into c[] array */
-	if ((k = c[ind]) == 0) {          /* no star in cell yet */
-	    c[ind] = i+1;                 /* nonzero 1..nb index */
-	} else {                            /* already star in cell */
-            b1 = btab + k - 1;              /* this is that star */
-	    while (Key(b1))
-	        b1 = btab + (Key(b1) - 1);  /* next star */
-	    Key(b1) = i + 1;                /* point to current star */
-	}
-	Key(b) = 0;                         /* terminate list */
+        for (nhash=1024; nhash < 2*nb; nhash *= 2)
+            continue;                       /* keep the table half empty */
+        cid   = (int *)  allocate(nb * sizeof(int));
+        cxyz  = (int *)  allocate(3 * nb * sizeof(int));
+        ord   = (int *)  allocate(nb * sizeof(int));
+        cells = (cell *) allocate(nb * sizeof(cell));
+        hash  = (int *)  allocate(nhash * sizeof(int));
+	size = nb;                          /* and remember new space */
+	dprintf(1,"Allocated %d (hash %d) on entry # %d\n",size,nhash,entry);
+    }
+
+    /* cell coordinates, as before bodies outside the grid are left alone */
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(+:nout)
+#endif
+    for (i=0; i<nb; i++) {
+        int  d, *c = cxyz + 3*i;
+        real x;
+        cid[i] = 0;
+        for (d=0; d<NDIM; d++) {
+            x = dr[d] > 0 ? (Pos(btab+i)[d] - rmin[d])/dr[d] : 0.0;
+            if (x <= -1.0 || x >= nbin[d]) {   /* (int) truncates (-1,0) to 0 */
+                cid[i] = -1;
+                break;
+            }
+            c[d] = (int) x;
+        }
+        if (cid[i] < 0) nout++;
     }
 
+    for (h=0; h<nhash; h++)                 /* build the table of cells */
+        hash[h] = -1;
+    ncell = 0;
+    for (i=0; i<nb; i++) {
+        if (cid[i] < 0) continue;
+        ix = cxyz[3*i];  iy = cxyz[3*i+1];  iz = cxyz[3*i+2];
+        h = HASH(ix,iy,iz) & (nhash-1);
+        while ((k = hash[h]) >= 0 &&
+               (cells[k].ix != ix || cells[k].iy != iy || cells[k].iz != iz))
+            h = (h+1) & (nhash-1);          /* linear probing */
+        if (k < 0) {                        /* new cell */
+            k = hash[h] = ncell++;
+            cells[k].ix = ix;  cells[k].iy = iy;  cells[k].iz = iz;
+            cells[k].n = 0;
+        }
+        cells[k].n++;
+        cid[i] = k;
+    }
+    for (k=0, n=0; k<ncell; k++) {          /* counting sort of the bodies */
+        cells[k].first = n;
+        n += cells[k].n;
+        cells[k].n = 0;
+    }
+    for (i=0; i<nb; i++)                    /* bodies keep their order in a cell */
+        if ((k = cid[i]) >= 0)
+            ord[cells[k].first + cells[k].n++] = i;
 
-    for (ix=0; ix<nx; ix++)                 /* walk through cube */
-    for (iy=0; iy<ny; iy++)
-    for (iz=0; iz<nz; iz++) {
-        ind = ix+nx*iy+nx*ny*iz;            /* offset in cube */
-	k = c[ind];                         /* ask first star in cell */
-        if (!k)
-            continue;                       /* empty cell */
+    /* grandom() is not thread safe, heating is done serially */
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic,64) reduction(+:ndis) if(!Qheat)
+#endif
+    for (k=0; k<ncell; k++) {               /* walk through occupied cells */
+        int  j, nc = cells[k].n, *idx = ord + cells[k].first;
+        Body *bp;
+        vector  velsum, veldif;
+        real t_before, t_after, kappa;
+        real angle, p, ss, cc, velsig, vx, vy;
 
+        if (nc<2)
+            continue;                       /* no need to average */
 	CLRV(velsum);	                    /* reset */
         t_before = t_after = 0.0;
-	n = 0;
-	while (k) {
-	    b = btab + k - 1;               /* point to star */
-	    ADDV(velsum,velsum,Vel(b));     /* accumulate mean cell velo */
-	    t_before += dotvp(Vel(b),Vel(b));/* kinetic before */
-	    n++;                            /* number of stars in cell */
-	    k = Key(b);                     /* next star in cell ? */
+        for (j=0; j<nc; j++) {
+	    bp = btab + idx[j];
+	    ADDV(velsum,velsum,Vel(bp));    /* accumulate mean cell velo */
+	    t_before += dotvp(Vel(bp),Vel(bp));/* kinetic before */
 	}
-	if (n<2)
-	    continue;                       /* no need to average */
-        MULVS(velsum,velsum,1.0/n);         /* get average velocity in cell */
-	ndis++;				    /* count dissipative cells */	
+        MULVS(velsum,velsum,1.0/nc);        /* get average velocity in cell */
+	ndis++;				    /* count dissipative cells */
 
-	k = c[ind];                         /* start again in cell */
         velsig = 0;
-	while (k) {
-	    b = btab + k - 1;
-	    SUBV(veldif,velsum,Vel(b));     /* get difference from mean */
+        for (j=0; j<nc; j++) {
+	    bp = btab + idx[j];
+	    SUBV(veldif,velsum,Vel(bp));    /* get difference from mean */
             if(Qheat) velsig += dotvp(veldif,veldif);
 	    MULVS(veldif,veldif,eta);       /* take a fraction */
-	    ADDV(Vel(b),Vel(b),veldif);     /* add it to velocity */
-            t_after += dotvp(Vel(b),Vel(b));/* kinetic after */
-	    k = Key(b);                     /* point to next star */
+	    ADDV(Vel(bp),Vel(bp),veldif);   /* add it to velocity */
+            t_after += dotvp(Vel(bp),Vel(bp));/* kinetic after */
         }
 
         if (Qheat) {
-            angle = fheat * sqrt(velsig/n);
-            k = c[ind];
-            while(k) {
-                b=btab+k-1;
-		if (Qangle) Aux(b) = angle;
+            angle = fheat * sqrt(velsig/nc);
+            for (j=0; j<nc; j++) {
+                bp = btab + idx[j];
+		if (Qangle) Aux(bp) = angle;
                 p=grandom(0.0,angle);
                 ss=sin(p);   cc=cos(p);
-                vx = Vel(b)[0] * cc  -  Vel(b)[1] * ss;   /* rotate the vector */
-                vy = Vel(b)[0] * ss  +  Vel(b)[1] * cc;
-                Vel(b)[0] = vx;
-                Vel(b)[1] = vy;
-		k=Key(b);
+                vx = Vel(bp)[0] * cc  -  Vel(bp)[1] * ss;   /* rotate the vector */
+                vy = Vel(bp)[0] * ss  +  Vel(bp)[1] * cc;
+                Vel(bp)[0] = vx;
+                Vel(bp)[1] = vy;
             }
         }
 
         kappa = sqrt(t_before/t_after);
 /**/	kappa=1;	/**PJT**/
-        k = c[ind];                         /* final renormalization */
-	while (k) {			    /* loop again over all */
-	    b = btab + k - 1;		    /* stars in the cell */
-            if (Qkappa) Aux(b) = kappa;
-            SMULVS(Vel(b),kappa);	    /* correct amplitude */
-	    k = Key(b);                     /* point to next star */
-	    Key(b) = 0;                     /* reset Key - not needed */
+        for (j=0; j<nc; j++) {              /* final renormalization */
+	    bp = btab + idx[j];
+            if (Qkappa) Aux(bp) = kappa;
+            SMULVS(Vel(bp),kappa);	    /* correct amplitude */
         }
-    }  /* end loop cube (ix,iy,iz) */
-    dprintf(1,"Dissipating %d in %d*%d*%d=%d cells\n",ndis,nx,ny,nz,nxyz);
-    if (ndis==0) 
+    }  /* end loop cells */
+    dprintf(1,"Dissipating %d in %d occupied cells, %d bodies outside grid\n",
+            ndis,ncell,nout);
+    if (ndis==0)
         warning("No dissipation done, cell=%g or nbody=%d too small?",
-                    dr, nb);
+                    dr[0], nb);
 }
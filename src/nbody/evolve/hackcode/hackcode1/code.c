@@ -13,6 +13,7 @@
  *                plus LOTS of prototype cleanup
  *     23-jul-11  V1.5    Use log= to be able to bypass log  pjt
  *                        removed debug= to enable system key
+ *     19-oct-26  V1.6    sorted= to build the tree in Morton order  pjt
  */
 
 #define global                                  /* don't default to extern  */
@@ -39,6 +40,7 @@ string defv[] = {		/* DEFAULT PARAMETER VALUES */
     "eps=0.05\n			  usual potential softening ",
     "tol=1.0\n			  cell subdivision tolerence ",
     "fcells=1.0\n		  cell allocation parameter ",
+    "sorted=t\n		  build the tree from bodies in Morton order ",
     "options=mass,phase\n	  misc. control options ",
 
     "tstop=2.0\n		  time to stop integration ",
@@ -46,7 +48,7 @@ string defv[] = {		/* DEFAULT PARAMETER VALUES */
     "minor_freqout=32.0\n	  minor data-output frequency ",
 
     "log=-\n                      logging output",
-    "VERSION=1.5b\n		  1-apr-2023 PJT",
+    "VERSION=1.6\n		  19-oct-2026 PJT",
     NULL,
 };
 
@@ -90,6 +92,7 @@ void startrun(void)
 	tol = getdparam("tol");
 	options = getparam("options");		/*   restorestate overwrite */
 	fcells = getdparam("fcells");
+	sorted = getbparam("sorted");
 	tstop = getdparam("tstop");
 	freqout = getdparam("freqout");
 	minor_freqout = getdparam("minor_freqout");
@@ -111,6 +114,7 @@ void startrun(void)
 	eps = getdparam("eps");
 	tol = getdparam("tol");
 	fcells = getdparam("fcells");
+	sorted = getbparam("sorted");
 	tstop = getdparam("tstop");
 	freqout = getdparam("freqout");
 	minor_freqout = getdparam("minor_freqout");
@@ -160,13 +164,16 @@ void stepsystem(void)
 {
     real dthf, dt;
     register bodyptr p;
+    int i;
     vector acc1, dacc, dvel, vel1, dpos;
 
     dt = 1.0 / freq;				/* get basic time-step      */
     dthf = 0.5 * dt;				/* and basic half-step      */
     maketree(bodytab, nbody);			/* load bodies into tree    */
     nfcalc = n2bcalc = nbccalc = 0;		/* zero interaction counts  */
-    for (p = bodytab; p < bodytab+nbody; p++) { /* loop over particles      */
+    for (i = 0; i < nbody; i++) {		/* loop over particles,     */
+	p = bodyorder ? bodytab + bodyorder[i]	/*   in tree order: it is   */
+		      : bodytab + i;		/*   kinder to the caches   */
 	SETV(acc1, Acc(p));			/*   save old acceleration  */
 	hackgrav(p);				/*   compute new acc for p  */
 	nfcalc++;				/*   count force calcs      */
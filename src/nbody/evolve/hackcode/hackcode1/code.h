@@ -27,6 +27,8 @@ global real rsize;			/* side-length of int. coord. box */
  */
 
 global real fcells;			/* ratio of cells/bodies allocated */
+global bool sorted;			/* build the tree in Morton order */
+global int *bodyorder;			/* bodies in tree order, if not NULL */
 
 global real tol;                        /* accuracy parameter: 0.0 => exact */
 global real eps;                        /* potential softening parameter */
@@ -2,6 +2,13 @@
  * LOAD.C: routines to create body-tree.
  * Public routines: maketree().
  *
+ *	With sorted=t bodies are kept in Morton (octree) order in an index
+ *	array, which is re-sorted with an insertion sort, since bodies move
+ *	little per step. Each call the tree is built from this order, which
+ *	gives the same tree as loading the bodies one by one, but walks
+ *	memory in order; the moments are then done bottom-up one level at a
+ *	time. sorted=f loads the bodies one by one into a new tree, as before.
+ *
  *	4-nov-91  added decl. intcoord() for _trace_
  *	18-nov-91 malloc -> allocate
  *	21-may-92 extra forward decl for SGI
@@ -9,6 +16,7 @@
  *	 4-mar-96 removed redundant (bad prototype) floor() definition
  *      28-nov-00 fixed bad index bug in printf() - documented a leak
  *      29-mar-04 prototyped
+ *      19-oct-26 Morton order, bottom-up moments                    PJT
  */
 
 #include "code.h"
@@ -17,6 +25,17 @@ local cellptr ctab = NULL;	/* cells are allocated from here */
 local int ncell, maxcell;	/* count cells in use, max available */
 local int first = 1;            /* first time a debug output is added */
 
+/* state kept to keep the bodies in order between calls */
+local bodyptr lastbtab = NULL;	/* bodies of the last call */
+local int lastnbody = -1;
+local int nload;		/* bodies in the tree (with mass) */
+local int *order = NULL;	/* loaded bodies in Morton order, then the rest */
+local int (*ixp)[NDIM] = NULL;	/* integer coordinates of all bodies */
+local int *clevel = NULL;	/* level of each cell */
+local int *lcell = NULL;	/* cells sorted by level */
+local int lstart[8*sizeof(int)+1]; /* where each level starts in lcell */
+local int nlevel;
+
 /* local forward declarations: */
 static void expandbox(bodyptr p);
 static void loadtree(bodyptr p);
@@ -24,6 +43,14 @@ static bool intcoord(int xp[3], vector rp);
 static int subindex(int x[3], int l);
 static void hackcofm(nodeptr q);
 static cellptr makecell(void);
+static void loadall(bodyptr btab, int nbody);
+static void neworder(bodyptr btab, int nbody);
+static bool samebodies(bodyptr btab);
+static void fitbox(bodyptr btab);
+static void sortorder(void);
+static nodeptr build(int lo, int hi, int l, int lev);
+static void levelcells(void);
+static void cellcofm(cellptr q);
 
 /*
  * MAKETREE: initialize tree structure for hack force calculation.
@@ -33,7 +60,7 @@ void maketree(
   bodyptr btab,			/* array of bodies to build into tree */
   int nbody)			/* number of bodies in above array */
 {
-    register bodyptr p;
+    int i, l;
 
     if (first) {
       node x1;
@@ -51,6 +78,39 @@ void maketree(
 	ctab = (cellptr) allocate(maxcell * sizeof(cell));   /* NEVER FREED */
 						/*   allocate cell space    */
     }
+    if (!sorted) {				/* one by one: as it was    */
+	loadall(btab, nbody);
+	lastbtab = NULL;
+	bodyorder = NULL;
+	hackcofm(troot);			/* find c-of-m coordinates  */
+	return;
+    }
+    if (btab != lastbtab || nbody != lastnbody || !samebodies(btab))
+	neworder(btab, nbody);			/* new set of bodies        */
+    lastbtab = btab;
+    fitbox(btab);				/* integer coordinates      */
+    sortorder();				/* bodies in Morton order   */
+    ncell = 0;
+    troot = nload > 0 ? build(0, nload, IMAX, 0) : NULL;
+    levelcells();
+    bodyorder = order;
+    for (l = nlevel-1; l >= 0; l--) {		/* c-of-m, deepest first    */
+#if defined(_OPENMP)
+#pragma omp parallel for if (lstart[l+1] - lstart[l] > 256)
+#endif
+	for (i = lstart[l]; i < lstart[l+1]; i++)
+	    cellcofm(ctab + lcell[i]);
+    }
+}
+
+/*
+ * LOADALL: load all massive bodies into a new tree, one by one.
+ */
+
+local void loadall(bodyptr btab, int nbody)
+{
+    bodyptr p;
+
     ncell = 0;					/* reset cells in use       */
     troot = NULL;				/* deallocate current tree  */
     for (p = btab; p < btab+nbody; p++)		/* loop over all bodies     */
@@ -58,7 +118,179 @@ void maketree(
 	    expandbox(p);			/*     expand root to fit   */
 	    loadtree(p);			/*     insert into tree     */
 	}
-    hackcofm(troot);				/* find c-of-m coordinates  */
+}
+
+/*
+ * NEWORDER: start over with a new set of bodies.
+ */
+
+local void neworder(bodyptr btab, int nbody)
+{
+    bodyptr p;
+    int i;
+
+    if (order) {
+	free(order);  free(ixp);  free(clevel);
+    }
+    order = (int *) allocate(nbody * sizeof(int));
+    ixp = (int (*)[NDIM]) allocate(nbody * sizeof(*ixp));
+    clevel = (int *) allocate(maxcell * sizeof(int));
+    for (nload = 0, p = btab; p < btab+nbody; p++)
+	if (Mass(p) != 0.0)			/* only load massive ones   */
+	    order[nload++] = p - btab;
+    for (i = nload, p = btab; p < btab+nbody; p++)
+	if (Mass(p) == 0.0)			/* massless ones at the end */
+	    order[i++] = p - btab;
+    lastnbody = nbody;
+}
+
+/*
+ * SAMEBODIES: check if the bodies with mass are still the ones in the tree
+ */
+
+local bool samebodies(bodyptr btab)
+{
+    int i, n = 0;
+
+    for (i = 0; i < nload; i++)
+	if (Mass(btab + order[i]) == 0.0) return FALSE;
+    for (i = 0; i < lastnbody; i++)
+	if (Mass(btab+i) != 0.0) n++;
+    return n == nload;
+}
+
+/*
+ * FITBOX: get integer coordinates of all bodies, expanding the box as
+ *	   loadall() would if needed.
+ */
+
+local void fitbox(bodyptr btab)
+{
+    bodyptr p;
+    bool grow = FALSE;
+    int i;
+
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(||:grow) if (nload > 10000)
+#endif
+    for (i = 0; i < nload; i++)
+	if (!intcoord(ixp[order[i]], Pos(btab+order[i])))
+	    grow = TRUE;			/*   outside the box        */
+    if (grow) {
+	troot = NULL;				/* no old tree to graft     */
+	for (p = btab; p < btab+lastnbody; p++)
+	    if (Mass(p) != 0.0)
+		expandbox(p);
+#if defined(_OPENMP)
+#pragma omp parallel for if (nload > 10000)
+#endif
+	for (i = 0; i < nload; i++)
+	    intcoord(ixp[order[i]], Pos(btab+order[i]));
+    }
+}
+
+/*
+ * MORTON: compare integer coordinates in the order of the tree, with x
+ *	   the most significant bit, then y, z (as in subindex)
+ */
+
+local int morton(int *x, int *y)
+{
+    int k, kmax = 0, d, dmax = 0;
+
+    for (k = 0; k < NDIM; k++) {		/* dim with highest diff bit */
+	d = x[k] ^ y[k];
+	if (dmax < d && dmax < (dmax ^ d)) {
+	    kmax = k;
+	    dmax = d;
+	}
+    }
+    return x[kmax] < y[kmax] ? -1 : x[kmax] > y[kmax];
+}
+
+local int cmporder(const void *a, const void *b)
+{
+    return morton(ixp[*(int *)a], ixp[*(int *)b]);
+}
+
+/*
+ * SORTORDER: insertion sort of the bodies into Morton order, cheap as
+ *	      long as they were nearly sorted; else a full sort.
+ */
+
+local void sortorder(void)
+{
+    int i, j, v;
+    long moves = 0, maxmoves = 8L * nload + 1000;
+
+    for (i = 1; i < nload; i++) {
+	v = order[i];
+	for (j = i; j > 0 && morton(ixp[v], ixp[order[j-1]]) < 0; j--)
+	    order[j] = order[j-1];
+	order[j] = v;
+	moves += i - j;
+	if (moves > maxmoves) {			/* far from sorted          */
+	    dprintf(1,"sortorder: full sort after %ld moves\n", moves);
+	    qsort(order, nload, sizeof(int), cmporder);
+	    return;
+	}
+    }
+}
+
+/*
+ * BUILD: make the (sub)tree of the bodies order[lo..hi-1], which are all
+ *	  in one slot of size l; bits below l select their position in it.
+ */
+
+local nodeptr build(int lo, int hi, int l, int lev)
+{
+    int i, j, k, m, kb;
+    cellptr c;
+
+    if (hi - lo == 1)				/* single body: a leaf      */
+	return (nodeptr) (lastbtab + order[lo]);
+    l = l >> 1;					/* next bit down            */
+    if (l == 0)
+	error("maketree: bodies %d and %d at the same position", order[lo], order[lo+1]);
+    c = makecell();
+    clevel[c - ctab] = lev;
+    for (i = lo; i < hi; i = j) {		/* runs of equal subindex   */
+	kb = subindex(ixp[order[i]], l);
+	for (j = i + 1, m = hi; j < m; ) {	/*   bisect for its end     */
+	    k = (j + m) / 2;
+	    if (subindex(ixp[order[k]], l) == kb)
+		j = k + 1;
+	    else
+		m = k;
+	}
+	Subp(c)[kb] = build(i, j, l, lev + 1);
+    }
+    return (nodeptr) c;
+}
+
+/*
+ * LEVELCELLS: list the cells by level, for the bottom-up moments.
+ */
+
+local void levelcells(void)
+{
+    int i, l;
+
+    if (lcell) free(lcell);
+    lcell = (int *) allocate((ncell+1) * sizeof(int));
+    for (l = 0; l <= 8*sizeof(int); l++)
+	lstart[l] = 0;
+    for (nlevel = 0, i = 0; i < ncell; i++) {
+	lstart[clevel[i]+1]++;
+	nlevel = MAX(nlevel, clevel[i]+1);
+    }
+    for (l = 0; l < nlevel; l++)
+	lstart[l+1] += lstart[l];
+    for (i = 0; i < ncell; i++)
+	lcell[lstart[clevel[i]]++] = i;		/* shifts lstart up a level */
+    for (l = nlevel; l > 0; l--)
+	lstart[l] = lstart[l-1];
+    lstart[0] = 0;
 }
 
 /*
@@ -225,6 +457,54 @@ local void hackcofm(nodeptr q)                   /* pointer into body-tree */
     }
 }
 
+/*
+ * CELLCOFM: center-of-mass coordinates of one cell, from its subcells,
+ *	     which must be done already; as one step of hackcofm().
+ */
+
+local void cellcofm(cellptr q)
+{
+    int i;
+    nodeptr r;
+    vector tmpv;
+#ifdef QUADPOLE
+    vector dr;
+    real drsq;
+    matrix drdr, Idrsq, tmpm;
+#endif
+
+    Mass(q) = 0.0;				/* init total mass          */
+    CLRV(Pos(q));				/* and c. of m.             */
+    for (i = 0; i < NSUB; i++) {		/* loop over subcells       */
+	r = Subp(q)[i];
+	if (r != NULL) {			/*   does subcell exist?    */
+	    Mass(q) += Mass(r);			/*     sum total mass       */
+	    MULVS(tmpv, Pos(r), Mass(r));	/*     find moment          */
+	    ADDV(Pos(q), Pos(q), tmpv);		/*     sum tot. moment      */
+	}
+    }
+    DIVVS(Pos(q), Pos(q), Mass(q));		/* rescale cms position     */
+#ifdef QUADPOLE
+    CLRM(Quad(q));				/* init. quad. moment       */
+    for (i = 0; i < NSUB; i++) {		/* loop over subnodes       */
+	r = Subp(q)[i];
+	if (r != NULL) {			/*   does subnode exist?    */
+	    SUBV(dr, Pos(r), Pos(q));		/*     displacement vect.   */
+	    OUTVP(drdr, dr, dr);		/*     outer prod. of dr    */
+	    DOTVP(drsq, dr, dr);		/*     dot prod. dr * dr    */
+	    SETMI(Idrsq);			/*     init unit matrix     */
+	    MULMS(Idrsq, Idrsq, drsq);		/*     scale by dr * dr     */
+	    MULMS(tmpm, drdr, 3.0);		/*     scale drdr by 3      */
+	    SUBM(tmpm, tmpm, Idrsq);		/*     form quad. moment    */
+	    MULMS(tmpm, tmpm, Mass(r));		/*     of cm of subnode,    */
+	    if (Type(r) == CELL)		/*     if subnode is cell   */
+		ADDM(tmpm, tmpm, Quad(r));	/*       use its moment     */
+	    ADDM(Quad(q), Quad(q), tmpm);	/*     add to qm of cell    */
+	}
+    }
+#endif
+}
+
 /*
  * MAKECELL: allocation routine for cells.
  */
@@ -0,0 +1,249 @@
+/*
+ * CODE.C: direct N-body code with a 4th order Hermite integrator and
+ *	   block time steps (hermite4)
+ *
+ *	Each body has its own time step, a power of 2 fraction of dtmax,
+ *	and at each block time the bodies due are advanced together: all
+ *	bodies are predicted, the force and its time derivative (jerk) on
+ *	the active ones are summed directly, and a Hermite corrector gives
+ *	their new position and velocity (Makino & Aarseth 1992). The steps
+ *	follow Aarseth's criterion. At every multiple of dtmax all bodies
+ *	are in step, and output is done there.
+ *
+ * updates:
+ *     19-oct-2026  V1.0   cloned off directcode                PJT
+ */
+
+#define global
+#include "code.h"
+
+string defv[] = {		/* DEFAULT PARAMETER VALUES */
+
+    /* file names for structured binary input/output */
+    "in=\n			  snapshot of initial conditions ",
+    "out=\n			  stream of output snapshots ",
+
+    /* params used only if "in" not given */
+    "nbody=128\n		  number of particles to generate ",
+    "seed=123\n			  random number generator seed ",
+    "cencon=false\n		  centrally concentrated system ",
+
+    /* params to control N-body integration */
+    "eta=0.02\n			  accuracy parameter of the time steps ",
+    "eta_s=0.01\n		  accuracy parameter of the first time step ",
+    "dtmax=1/32\n		  largest time step (will be a power of 2) ",
+    "dtmin=2**-40\n		  smallest time step allowed ",
+    "eps=0.01\n			  potential softening ",
+    "options=mass,phase\n	  misc. control options ",
+
+    "tstop=2.0\n		  time to stop integration ",
+    "freqout=4.0\n		  major data-output frequency ",
+    "minor_freqout=32.0\n	  minor data-output frequency ",
+
+    "VERSION=1.0\n		  19-oct-2026 PJT",
+    NULL,
+};
+
+string usage = "direct N-body code with Hermite integrator and block time steps";
+
+string headline = "Hermite4";
+
+string cvsid="$Id$";
+
+extern  bool scanopt(string, string);
+
+local vector *anew, *jnew;		/* new force of the active bodies */
+local real *pnew;
+local long nsmall = 0;			/* steps that wanted less than dtmin */
+
+local bool insync(void)
+{
+  return fmod(tblock, dtmax) == 0.0;
+}
+
+void nemo_main(void)
+{
+  startrun();				/* set params, input data   */
+  initoutput();				/* begin system output      */
+  output();
+  while (tnow < tstop - 0.01*dtmax || !insync()) {
+    stepsystem();			/*   advance N-body system  */
+    if (insync()) output();		/*   all bodies in step     */
+  }
+  stopoutput();				/* finish up output         */
+  if (nsmall > 0)
+    warning("%ld steps were limited by dtmin=%g", nsmall, dtmin);
+}
+
+/*
+ * BLOCKSTEP: the largest power of 2 fraction of dtmax below dt
+ */
+
+local real blockstep(real dt)
+{
+  real h = dtmax;
+
+  while (h > dt && 0.5*h >= dtmin) h *= 0.5;
+  if (h > dt) nsmall++;
+  return h;
+}
+
+/*
+ * STARTRUN: read or make the bodies, and give them their first step
+ */
+
+void startrun(void)
+{
+  int i, k;
+  real a2, j2;
+
+  infile = getparam("in");		/* set I/O file names       */
+  outfile = getparam("out");
+  options = getparam("options");	/* set control options      */
+
+  if (hasvalue("in"))
+    inputdata(infile);			/*     read inital data     */
+  else {				/*   make initial conds?    */
+    init_xrandom(getparam("seed"));
+    nbody = getiparam("nbody");		/*     get nbody parameter  */
+    if (nbody < 1)			/*     is value absurd?     */
+      error("invalid nbody=%d",nbody);
+    testdata(getbparam("cencon"));	/*     make test model      */
+  }
+  eta = getdparam("eta");
+  eta_s = getdparam("eta_s");
+  dtmax = getdparam("dtmax");
+  dtmin = getdparam("dtmin");
+  if (dtmax <= 0 || dtmin <= 0 || dtmin > dtmax)
+    error("bad dtmax=%g dtmin=%g", dtmax, dtmin);
+  if (frexp(dtmax, &k) != 0.5) {
+    dtmax = ldexp(0.5, k);
+    warning("dtmax rounded down to a power of 2: %g", dtmax);
+  }
+  eps = getdparam("eps");               /*   softening length       */
+  tstop = getdparam("tstop");           /*   stop time              */
+  freqout = getdparam("freqout");       /*   output frequency       */
+  minor_freqout = getdparam("minor_freqout");
+  nstep = nsteps = 0;			/*   start counting steps   */
+  minor_tout = tout = tnow;		/*   schedule first output  */
+
+  newparticles(nbody);
+  loadparticles();
+  tbase = tnow;				/* block times start at 0   */
+  tblock = 0.0;
+  anew = (vector *) allocate(nbody * sizeof(vector));
+  jnew = (vector *) allocate(nbody * sizeof(vector));
+  pnew = (real *) allocate(nbody * sizeof(real));
+
+  for (i = 0; i < nbody; i++)
+    active[i] = i;
+  gravity(nbody, active, anew, jnew, pnew);
+  for (i = 0; i < nbody; i++) {
+    a2 = j2 = 0.0;
+    for (k = 0; k < NDIM; k++) {
+      ps.a[k][i] = anew[i][k];
+      ps.j[k][i] = jnew[i][k];
+      a2 += anew[i][k]*anew[i][k];
+      j2 += jnew[i][k]*jnew[i][k];
+    }
+    ps.phi[i] = pnew[i];
+    ps.dt[i] = blockstep(j2 > 0 ? eta_s*sqrt(a2/j2) : dtmax);
+  }
+}
+
+/*
+ * TESTDATA: generate initial conditions for test runs.
+ *           this is exactly the same code as in directcode
+ */
+
+void testdata(bool cencon)
+{
+  vector cmr, cmv;
+  bodyptr p;
+
+  headline = "Hermite4: test data";		/* supply default headline  */
+  tnow = 0.0;					/* pos, vel set at t = 0    */
+  bodytab = (bodyptr) allocate(nbody * sizeof(body));
+  CLRV(cmr);					/* init cm pos, vel         */
+  CLRV(cmv);
+  for (p = bodytab; p < bodytab+nbody; p++) {	/* loop over particles      */
+    Mass(p) = 1.0 / nbody;			/*   set masses equal       */
+    pickvec(Pos(p), cencon);		        /*   pick position          */
+    ADDV(cmr, cmr, Pos(p));
+    pickvec(Vel(p), FALSE);			/*   pick velocity          */
+    ADDV(cmv, cmv, Vel(p));
+  }
+  DIVVS(cmr, cmr, (real) nbody);		/* normalize cm coords      */
+  DIVVS(cmv, cmv, (real) nbody);
+  for (p = bodytab; p < bodytab+nbody; p++) {	/* loop over particles      */
+    SUBV(Pos(p), Pos(p), cmr);	         	/*   offset by cm coords    */
+    SUBV(Vel(p), Vel(p), cmv);
+  }
+}
+
+/*
+ * STEPSYSTEM: advance the bodies of the next block by one step
+ */
+
+void stepsystem(void)
+{
+  int i, n, nact = 0;
+  real tnext = ps.t[0] + ps.dt[0];
+
+  n = ps.n;
+#if defined(_OPENMP)
+#pragma omp simd reduction(min:tnext)
+#endif
+  for (i = 1; i < n; i++)			/* find the next block time */
+    tnext = MIN(tnext, ps.t[i] + ps.dt[i]);
+  for (i = 0; i < n; i++)			/* and who is due then      */
+    if (ps.t[i] + ps.dt[i] == tnext)
+      active[nact++] = i;
+
+  predict(tnext);				/* all bodies to tnext      */
+  gravity(nact, active, anew, jnew, pnew);	/* new force on the active  */
+
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(+:nsmall) if (nact > 1024)
+#endif
+  for (i = 0; i < nact; i++) {		/* Hermite corrector        */
+    int ia = active[i], k;
+    real h = tnext - ps.t[ia], h2 = h*h, dt;
+    real a1 = 0, j1 = 0, a2s = 0, a3s = 0, dtnew;
+    real s, c;
+
+    for (k = 0; k < NDIM; k++) {
+      real a0 = ps.a[k][ia], j0 = ps.j[k][ia];
+      real da = a0 - anew[i][k];
+      real a2 = (-6.0*da - h*(4.0*j0 + 2.0*jnew[i][k]))/h2;
+      real a3 = (12.0*da + 6.0*h*(j0 + jnew[i][k]))/(h2*h);
+      ps.x[k][ia] = ps.xp[k][ia] + h2*h2*(a2/24.0 + h*a3/120.0);
+      ps.v[k][ia] = ps.vp[k][ia] + h2*h*(a2/6.0 + h*a3/24.0);
+      ps.a[k][ia] = anew[i][k];
+      ps.j[k][ia] = jnew[i][k];
+      a2 += h*a3;				/* 2nd derivative at tnext  */
+      a1  += anew[i][k]*anew[i][k];
+      j1  += jnew[i][k]*jnew[i][k];
+      a2s += a2*a2;
+      a3s += a3*a3;
+    }
+    ps.phi[ia] = pnew[i];
+    ps.t[ia] = tnext;
+
+    s = sqrt(a1*a2s) + j1;			/* Aarseth's criterion      */
+    c = sqrt(j1*a3s) + a2s;
+    dtnew = c > 0 ? sqrt(eta*s/c) : dtmax;
+    dt = ps.dt[ia];
+    if (dtnew < dt) {
+      while (dt > dtnew && 0.5*dt >= dtmin) dt *= 0.5;
+      if (dt > dtnew) nsmall++;
+    } else if (dtnew >= 2*dt && 2*dt <= dtmax && fmod(tnext, 2*dt) == 0.0)
+      dt *= 2;				/* only when commensurate   */
+    ps.dt[ia] = dt;
+  }
+
+  nstep++;					/* count another block step */
+  nsteps += nact;
+  tblock = tnext;
+  tnow = tbase + tblock;			/* finally, advance time    */
+}
@@ -0,0 +1,65 @@
+/*
+ * CODE.H: define various global things for hermite4.
+ */
+
+#include "defs.h"
+#include <getparam.h>
+
+global string infile;			/* file name for snapshot input */
+global string outfile;			/* file name for snapshot output */
+
+global real eta;			/* accuracy parameter of the steps */
+global real eta_s;			/* same, for the first step */
+global real dtmax;			/* largest block step, a power of 2 */
+global real dtmin;			/* smallest block step allowed */
+
+global real freqout, minor_freqout;	/* major, minor output frequencies */
+
+global real tstop;			/* time to stop calculation */
+
+global string options;                 /* various option flags */
+
+extern string headline;		/* message describing calculation */
+
+global real tnow;			/* current value of time */
+
+global real tout, minor_tout;		/* time of next major, minor output */
+
+global long nstep;			/* number of block steps */
+global long nsteps;			/* number of particle steps */
+
+global int nbody;			/* number of bodies in system */
+
+global bodyptr bodytab;		/* snapshot I/O buffer */
+
+global particles ps;			/* the bodies being integrated */
+
+global int *active;			/* bodies in the current block */
+
+global real eps;                       /* grav softening length */
+
+global real tbase;			/* time at the start of the run */
+
+global real tblock;			/* block time, counted from tbase */
+
+/* code.c */
+void nemo_main(void);
+void startrun(void);
+void testdata(bool cencon);
+void stepsystem(void);
+
+/* code_io.c */
+void inputdata(string file);
+void initoutput(void);
+void stopoutput(void);
+void output(void);
+
+/* util.c */
+void pickvec(vector x, bool cf);
+void newparticles(int n);
+void loadparticles(void);
+void saveparticles(void);
+
+/* grav.c */
+void predict(real t);
+void gravity(int nact, int *act, vector *acc, vector *jerk, real *pot);
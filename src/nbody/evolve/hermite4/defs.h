@@ -0,0 +1,69 @@
+/*
+ * DEFS: include file for hermite4.
+ *
+ *	The particles are kept as a structure of arrays, so the force loop
+ *	over all bodies reads contiguous memory and can be vectorised.
+ *	The body structure below is only used for snapshot I/O.
+ */
+
+#include <stdinc.h>
+#include <vectmath.h>
+
+/*
+ * GLOBAL: pseudo-keyword for storage class.
+ */
+
+#if !defined(global)
+#  define global extern
+#endif
+
+
+/*
+ * BODY: data structure used to read and write snapshots.
+ */
+
+#define BODY 01                 /* type code for bodies */
+
+typedef struct {
+    real mass;                  /* mass of body */
+    vector pos;                 /* position of body */
+    vector vel;                 /* velocity of body */
+    vector acc;			/* acceleration of body */
+    real phi;			/* potential at body */
+} body, *bodyptr;
+
+#define Body    body
+#define Mass(x) (((bodyptr) (x))->mass)
+#define Pos(x)  (((bodyptr) (x))->pos)
+#define Vel(x)  (((bodyptr) (x))->vel)
+#define Acc(x)  (((bodyptr) (x))->acc)
+#define Phi(x)  (((bodyptr) (x))->phi)
+
+/*
+ * PHASEBODY: alternate definition introduced for I/O.
+ */
+
+typedef struct {
+    real mass;
+    vector phase[2];            /* position, velocity of body */
+    vector acc;
+    real phi;
+} phasebody;
+
+#define Phase(x)  (((phasebody *) (x))->phase)
+
+/*
+ * PARTICLES: the integrator state, one array per component.
+ *	      Everything at the time t[i] of the last step of body i,
+ *	      except xp, vp: predicted to the current block time.
+ */
+
+typedef struct {
+    int   n;			/* number of bodies */
+    real *m;			/* mass */
+    real *x[NDIM], *v[NDIM];	/* position, velocity */
+    real *a[NDIM], *j[NDIM];	/* acceleration, jerk */
+    real *xp[NDIM], *vp[NDIM];	/* predicted position, velocity */
+    real *phi;			/* potential */
+    real *t, *dt;		/* time of last step, and block step */
+} particles;
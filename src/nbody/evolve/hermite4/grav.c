@@ -0,0 +1,141 @@
+/*
+ * GRAV.C: predictor and force (acceleration, jerk) kernel for hermite4
+ *
+ *	All bodies are predicted to the block time, and the force on the
+ *	active bodies is summed directly over all bodies. The loop over the
+ *	field bodies runs over the arrays of predicted positions and
+ *	velocities, and is vectorised (omp simd). With many active bodies
+ *	the threads share them out, with few (the common case in a block
+ *	step scheme, where most blocks are small) the threads share the
+ *	field bodies of each active body instead.
+ *	With gcc on x86_64 the field loop is compiled for AVX-512, AVX2
+ *	and plain x86_64, and the best one is picked at run time. The
+ *	Makefile adds -fopenmp-simd (also without --with-openmp) and
+ *	-fno-math-errno, else sqrt() keeps the loop scalar.
+ *
+ *      19-oct-2026   created                           PJT
+ */
+
+#include "code.h"
+#include <perf.h>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define SIMD_CLONES __attribute__((target_clones("avx512f","avx2","default")))
+#else
+#define SIMD_CLONES
+#endif
+
+#define NF    7			/* acc[3], jerk[3], pot */
+#define JBLK  4096		/* field bodies per thread chunk */
+
+/*
+ * PREDICT: Taylor series of all bodies to time t, to third order in x
+ */
+
+void predict(real t)
+{
+    int i, k, n = ps.n;
+
+#if defined(_OPENMP)
+#pragma omp parallel for private(k) if (n > JBLK)
+#endif
+    for (i = 0; i < n; i++) {
+	real h = t - ps.t[i], h2 = 0.5*h, h3 = h/3.0;
+	for (k = 0; k < NDIM; k++) {
+	    ps.xp[k][i] = ps.x[k][i] + h*(ps.v[k][i] + h2*(ps.a[k][i] + h3*ps.j[k][i]));
+	    ps.vp[k][i] = ps.v[k][i] + h*(ps.a[k][i] + h2*ps.j[k][i]);
+	}
+    }
+}
+
+/*
+ * FIELD: add the force of bodies jlo..jhi-1 on body i to f[NF]
+ *	  body i itself is skipped (also when eps=0)
+ */
+
+SIMD_CLONES local void field(int i, int jlo, int jhi, real *f)
+{
+    const real *restrict X  = ps.xp[0], *restrict Y  = ps.xp[1], *restrict Z  = ps.xp[2];
+    const real *restrict VX = ps.vp[0], *restrict VY = ps.vp[1], *restrict VZ = ps.vp[2];
+    const real *restrict M  = ps.m;
+    real xi = X[i], yi = Y[i], zi = Z[i], vxi = VX[i], vyi = VY[i], vzi = VZ[i];
+    real eps2 = eps*eps;
+    real ax = 0, ay = 0, az = 0, jx = 0, jy = 0, jz = 0, pot = 0;
+    int j;
+
+#if defined(_OPENMP)
+#pragma omp simd reduction(+:ax,ay,az,jx,jy,jz,pot)
+#endif
+    for (j = jlo; j < jhi; j++) {
+	real dx = X[j]-xi, dy = Y[j]-yi, dz = Z[j]-zi;
+	real dvx = VX[j]-vxi, dvy = VY[j]-vyi, dvz = VZ[j]-vzi;
+	real r2 = dx*dx + dy*dy + dz*dz + eps2;
+	real self = (j == i);			/* no branch: keeps it simd */
+	real rinv = (1.0 - self)/sqrt(r2 + self);
+	real rinv2 = rinv*rinv;
+	real mr = M[j]*rinv;
+	real mr3 = mr*rinv2;
+	real alpha = 3.0*(dx*dvx + dy*dvy + dz*dvz)*rinv2;
+	pot -= mr;
+	ax += mr3*dx;
+	ay += mr3*dy;
+	az += mr3*dz;
+	jx += mr3*(dvx - alpha*dx);
+	jy += mr3*(dvy - alpha*dy);
+	jz += mr3*(dvz - alpha*dz);
+    }
+    f[0] += ax;  f[1] += ay;  f[2] += az;
+    f[3] += jx;  f[4] += jy;  f[5] += jz;
+    f[6] += pot;
+}
+
+local void store(real *f, real *acc, real *jerk, real *pot)
+{
+    int k;
+
+    for (k = 0; k < NDIM; k++) {
+	acc[k]  = f[k];
+	jerk[k] = f[NDIM+k];
+    }
+    *pot = f[6];
+}
+
+/*
+ * GRAVITY: acceleration, jerk and potential of the nact bodies act[],
+ *	    from the predicted positions and velocities of all bodies
+ */
+
+void gravity(int nact, int *act, vector *acc, vector *jerk, real *pot)
+{
+    static int cnt = -1;
+    int k, b, n = ps.n, nblk = (n + JBLK - 1)/JBLK, nthreads = 1;
+
+    if (cnt < 0) cnt = perf_counter("interactions");
+#if defined(_OPENMP)
+    nthreads = omp_get_max_threads();
+#endif
+    if (nact >= 4*nthreads || nblk < 2) {
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic,4) if (nthreads > 1 && (long)nact*n > 64*JBLK)
+#endif
+	for (k = 0; k < nact; k++) {
+	    real f[NF] = {0, 0, 0, 0, 0, 0, 0};
+	    field(act[k], 0, n, f);
+	    store(f, acc[k], jerk[k], &pot[k]);
+	}
+    } else {
+	for (k = 0; k < nact; k++) {
+	    real f[NF] = {0, 0, 0, 0, 0, 0, 0};
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(+:f[:NF])
+#endif
+	    for (b = 0; b < nblk; b++)
+		field(act[k], b*JBLK, MIN(n, (b+1)*JBLK), f);
+	    store(f, acc[k], jerk[k], &pot[k]);
+	}
+    }
+    PERF_ADD(cnt, (long)nact*n);
+}
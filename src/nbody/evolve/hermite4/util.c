@@ -0,0 +1,88 @@
+/*
+ * UTIL.C: various useful routines and functions for hermite4.
+ *
+ *      19-oct-2026 created, pickvec from directcode              PJT
+ */
+
+#include "code.h"
+
+/*
+ * PICKVEC: generate random coordinates within a unit sphere.
+ *  vector x;                             coord vector to generate
+ *  bool cf;                              pick from 1/r^2 profile
+ */
+
+void pickvec(vector x, bool cf)
+{
+  dprintf(1,"pickvec: cf = %d\t", cf);
+  if (cf)					/* cent. concentrated?      */
+    pickshell(x, NDIM, xrandom(0.0, 1.0));	/*   pick from M(r) = r     */
+  else
+    pickball(x, NDIM, 1.0);		/*   use uniform distr.     */
+  dprintf(1,"x = [%8.4f,%8.4f,%8.4f]\n", x[0], x[1], x[2]);
+}
+
+/*
+ * NEWPARTICLES: allocate the arrays of the integrator for n bodies
+ */
+
+void newparticles(int n)
+{
+  int k;
+
+  ps.n = n;
+  ps.m   = (real *) allocate(n * sizeof(real));
+  ps.phi = (real *) allocate(n * sizeof(real));
+  ps.t   = (real *) allocate(n * sizeof(real));
+  ps.dt  = (real *) allocate(n * sizeof(real));
+  for (k = 0; k < NDIM; k++) {
+    ps.x[k]  = (real *) allocate(n * sizeof(real));
+    ps.v[k]  = (real *) allocate(n * sizeof(real));
+    ps.a[k]  = (real *) allocate(n * sizeof(real));
+    ps.j[k]  = (real *) allocate(n * sizeof(real));
+    ps.xp[k] = (real *) allocate(n * sizeof(real));
+    ps.vp[k] = (real *) allocate(n * sizeof(real));
+  }
+  active = (int *) allocate(n * sizeof(int));
+}
+
+/*
+ * LOADPARTICLES: copy masses and phase space from the snapshot buffer
+ */
+
+void loadparticles(void)
+{
+  int i, k;
+  bodyptr p;
+
+  for (i = 0, p = bodytab; i < nbody; i++, p++) {
+    ps.m[i] = Mass(p);
+    for (k = 0; k < NDIM; k++) {
+      ps.x[k][i] = ps.xp[k][i] = Pos(p)[k];
+      ps.v[k][i] = ps.vp[k][i] = Vel(p)[k];
+      ps.a[k][i] = ps.j[k][i] = 0.0;
+    }
+    ps.t[i] = ps.dt[i] = ps.phi[i] = 0.0;
+  }
+}
+
+/*
+ * SAVEPARTICLES: copy the bodies into the snapshot buffer; at a block time
+ *		  where all bodies have been stepped, e.g. every dtmax.
+ */
+
+void saveparticles(void)
+{
+  int i, k;
+  bodyptr p;
+
+  for (i = 0, p = bodytab; i < nbody; i++, p++) {
+    Mass(p) = ps.m[i];
+    for (k = 0; k < NDIM; k++) {
+      Pos(p)[k] = ps.x[k][i];
+      Vel(p)[k] = ps.v[k][i];
+      Acc(p)[k] = ps.a[k][i];
+    }
+    Phi(p) = ps.phi[i];
+  }
+}
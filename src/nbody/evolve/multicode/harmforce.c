@@ -0,0 +1,298 @@
+/*
+ * HARMFORCE.C: spherical harmonic (multipole) force calculation to
+ *		arbitrary order lmax.
+ * Defines: harmforce().
+ * Requires: Body, Mass(), Pos(), Acc(), Phi(), radsort()
+ *
+ * The potential of body i is, with the bodies ranked by radius,
+ *
+ *   Phi_i = - sum_lm N_lm [ R_lm(x_i) . sum_{j<i} m_j R_lm(x_j) / s_i^(2l+1)
+ *                         + R_lm(x_i) . sum_{j>i} m_j R_lm(x_j) / s_j^(2l+1) ]
+ *
+ * where R_lm = r^l P_l^m(cos theta) (cos m phi, sin m phi) are the (real)
+ * regular solid harmonics, polynomials in x,y,z, and N_lm =
+ * (2-delta_m0) (l-m)!/(l+m)!.  As in quadforce() the softened radius s
+ * uses eps1 for the monopole and eps2 for all higher orders; for lmax=2
+ * the two agree, apart from how the trace term is softened.
+ *
+ * The two sums are prefix sums over the ranked bodies.  The ranking is
+ * cut in a fixed number of chunks, the chunk sums are computed in
+ * parallel and scanned, and then each chunk is walked in parallel to get
+ * the forces.  The number of chunks does not depend on the number of
+ * threads, so neither does the result.
+ *
+ *	19-oct-26	created					PJT
+ */
+
+#include "quaddefs.h"
+
+#define MAXLMAX   32		/* (2l-1)!! r^l soon gets out of hand   */
+#define MINCHUNK  256		/* minimum bodies per chunk             */
+#define MAXCHUNK  256		/* maximum number of chunks             */
+
+#define LM(l,m)   ((l)*((l)+1)/2 + (m))
+
+local int  *rankh = NULL;			/* ranking of previous call */
+local int   nrankh = 0;
+
+local void solid_harmonics(real *x, int lmax, real *C, real *S,
+			   vector *dC, vector *dS);
+
+/*
+ * HARMFORCE: add the force and potential of the expansion to Acc and Phi.
+ */
+
+void harmforce(Body *btab, int nb, int lmax, real eps1, real eps2)
+{
+    int nlm, nmom, nchunk, c, i, l, m;
+    real *rad, *norm, *tot, *beg;
+
+    if (lmax < 0 || lmax > MAXLMAX)
+	error("harmforce: lmax=%d not supported, 0..%d", lmax, MAXLMAX);
+    nlm = LM(lmax+1, 0);			/* number of (l,m) pairs    */
+    nmom = 4 * nlm;				/* int C,S and ext C,S      */
+
+    rad = (real *) allocate(nb * sizeof(real));
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (i = 0; i < nb; i++)			/* find radii to rank       */
+	rad[i] = sqrt(dotvp(Pos(btab+i), Pos(btab+i)));
+    if (nb != nrankh) {				/* no usable old ranking?   */
+	if (rankh != NULL)
+	    free(rankh);
+	rankh = (int *) allocate(nb * sizeof(int));
+    }
+    radsort(rad, nb, rankh, nb == nrankh);	/* rank bodies by radii     */
+    nrankh = nb;
+    free(rad);
+
+    norm = (real *) allocate(nlm * sizeof(real));
+    for (l = 0; l <= lmax; l++)			/* (2-d_m0) (l-m)!/(l+m)!   */
+	for (m = 0; m <= l; m++) {
+	    norm[LM(l,m)] = (m == 0 ? 1.0 : 2.0);
+	    for (i = l-m+1; i <= l+m; i++)
+		norm[LM(l,m)] /= i;
+	}
+
+    nchunk = MAX(1, MIN(MAXCHUNK, nb / MINCHUNK));
+    tot = (real *) allocate(nchunk * nmom * sizeof(real));
+    beg = (real *) allocate(nchunk * nmom * sizeof(real));
+
+    /* pass 1: the interior and exterior moments of each chunk */
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (c = 0; c < nchunk; c++) {
+	int  k, kl, ll, mm;
+	int  lo = (int) ((long) nb * c / nchunk);
+	int  hi = (int) ((long) nb * (c+1) / nchunk);
+	real *C, *S, *mc = tot + c * nmom, w, s1i, s2i2;
+	Body *b;
+
+	C = (real *) allocate(2 * nlm * sizeof(real));
+	S = C + nlm;
+	for (kl = 0; kl < nmom; kl++)
+	    mc[kl] = 0.0;
+	for (k = lo; k < hi; k++) {
+	    b = btab + rankh[k];
+	    solid_harmonics(Pos(b), lmax, C, S, NULL, NULL);
+	    s1i = 1.0 / sqrt(dotvp(Pos(b), Pos(b)) + eps1*eps1);
+	    s2i2 = 1.0 / (dotvp(Pos(b), Pos(b)) + eps2*eps2);
+	    w = Mass(b) * s1i;				/* m / s^(2l+1)     */
+	    for (ll = 0; ll <= lmax; ll++) {
+		if (ll == 1)
+		    w = Mass(b) * s2i2 * sqrt(s2i2);
+		else if (ll > 1)
+		    w *= s2i2;
+		for (mm = 0; mm <= ll; mm++) {
+		    kl = LM(ll,mm);
+		    mc[kl]         += Mass(b) * C[kl];
+		    mc[nlm+kl]     += Mass(b) * S[kl];
+		    mc[2*nlm+kl]   += w * C[kl];
+		    mc[3*nlm+kl]   += w * S[kl];
+		}
+	    }
+	}
+	free(C);
+    }
+
+    /* scan: interior moments of all chunks before, exterior of all after */
+
+    for (i = 0; i < 2*nlm; i++) {
+	beg[i] = 0.0;
+	beg[(nchunk-1)*nmom + 2*nlm + i] = 0.0;
+    }
+    for (c = 1; c < nchunk; c++)
+	for (i = 0; i < 2*nlm; i++)
+	    beg[c*nmom + i] = beg[(c-1)*nmom + i] + tot[(c-1)*nmom + i];
+    for (c = nchunk-2; c >= 0; c--)
+	for (i = 2*nlm; i < nmom; i++)
+	    beg[c*nmom + i] = beg[(c+1)*nmom + i] + tot[(c+1)*nmom + i];
+
+    /* pass 2: walk each chunk, outward for interior, inward for exterior */
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (c = 0; c < nchunk; c++) {
+	int  k, kl, ll, mm, d;
+	int  lo = (int) ((long) nb * c / nchunk);
+	int  hi = (int) ((long) nb * (c+1) / nchunk);
+	real *C, *S, *mom, w, s1i, s2i2, sl = 0.0, T;
+	vector *dC, *dS, dT;
+	Body *b;
+
+	C = (real *) allocate(2 * nlm * sizeof(real));
+	S = C + nlm;
+	dC = (vector *) allocate(2 * nlm * sizeof(vector));
+	dS = dC + nlm;
+	mom = (real *) allocate(nmom * sizeof(real));
+	for (kl = 0; kl < nmom; kl++)
+	    mom[kl] = beg[c*nmom + kl];
+	for (k = lo; k < hi; k++) {		/* interior, inside out     */
+	    b = btab + rankh[k];
+	    solid_harmonics(Pos(b), lmax, C, S, dC, dS);
+	    s1i = 1.0 / sqrt(dotvp(Pos(b), Pos(b)) + eps1*eps1);
+	    s2i2 = 1.0 / (dotvp(Pos(b), Pos(b)) + eps2*eps2);
+	    for (ll = 0; ll <= lmax; ll++) {
+		if (ll == 0)
+		    sl = s1i;				/* 1 / s^(2l+1)     */
+		else if (ll == 1)
+		    sl = s2i2 * sqrt(s2i2);
+		else
+		    sl *= s2i2;
+		T = 0.0;
+		CLRV(dT);
+		for (mm = 0; mm <= ll; mm++) {
+		    kl = LM(ll,mm);
+		    T += norm[kl] * (C[kl]*mom[kl] + S[kl]*mom[nlm+kl]);
+		    for (d = 0; d < NDIM; d++)
+			dT[d] += norm[kl] * (dC[kl][d]*mom[kl] + dS[kl][d]*mom[nlm+kl]);
+		}
+		Phi(b) -= T * sl;
+		w = (2*ll+1) * T * sl * (ll == 0 ? s1i*s1i : s2i2);
+		for (d = 0; d < NDIM; d++)
+		    Acc(b)[d] += dT[d] * sl - w * Pos(b)[d];
+	    }
+	    for (kl = 0; kl < nlm; kl++) {	/* then add this body       */
+		mom[kl]     += Mass(b) * C[kl];
+		mom[nlm+kl] += Mass(b) * S[kl];
+	    }
+	}
+	for (k = hi-1; k >= lo; k--) {		/* exterior, outside in     */
+	    b = btab + rankh[k];
+	    solid_harmonics(Pos(b), lmax, C, S, dC, dS);
+	    for (ll = 0; ll <= lmax; ll++) {
+		T = 0.0;
+		CLRV(dT);
+		for (mm = 0; mm <= ll; mm++) {
+		    kl = LM(ll,mm);
+		    T += norm[kl] * (C[kl]*mom[2*nlm+kl] + S[kl]*mom[3*nlm+kl]);
+		    for (d = 0; d < NDIM; d++)
+			dT[d] += norm[kl] * (dC[kl][d]*mom[2*nlm+kl] +
+					     dS[kl][d]*mom[3*nlm+kl]);
+		}
+		Phi(b) -= T;
+		ADDV(Acc(b), Acc(b), dT);
+	    }
+	    s1i = 1.0 / sqrt(dotvp(Pos(b), Pos(b)) + eps1*eps1);
+	    s2i2 = 1.0 / (dotvp(Pos(b), Pos(b)) + eps2*eps2);
+	    w = Mass(b) * s1i;
+	    for (ll = 0; ll <= lmax; ll++) {	/* then add this body       */
+		if (ll == 1)
+		    w = Mass(b) * s2i2 * sqrt(s2i2);
+		else if (ll > 1)
+		    w *= s2i2;
+		for (mm = 0; mm <= ll; mm++) {
+		    kl = LM(ll,mm);
+		    mom[2*nlm+kl] += w * C[kl];
+		    mom[3*nlm+kl] += w * S[kl];
+		}
+	    }
+	}
+	free(C);
+	free(dC);
+	free(mom);
+    }
+    free(norm);
+    free(tot);
+    free(beg);
+}
+
+/*
+ * SOLID_HARMONICS: regular solid harmonics r^l P_l^m (cos m phi, sin m phi),
+ * without the Condon-Shortley phase, and their gradients if dC is given.
+ * Only recursions in x,y,z are used, so there is no trouble on the z axis:
+ *	R_mm     = (2m-1) (x + i y) R_m-1,m-1
+ *	R_m+1,m  = (2m+1) z R_mm
+ *	R_lm     = ((2l-1) z R_l-1,m - (l+m-1) r^2 R_l-2,m) / (l-m)
+ */
+
+local void solid_harmonics(real *x, int lmax, real *C, real *S,
+			   vector *dC, vector *dS)
+{
+    int l, m, k, k1, k2, d;
+    real r2 = dotvp(x, x), f, g;
+
+    C[0] = 1.0;
+    S[0] = 0.0;
+    if (dC) {
+	CLRV(dC[0]);
+	CLRV(dS[0]);
+    }
+    for (m = 0; m <= lmax; m++) {
+	if (m > 0) {				/* R_mm from R_m-1,m-1      */
+	    k = LM(m,m);
+	    k1 = LM(m-1,m-1);
+	    f = 2*m - 1;
+	    C[k] = f * (x[0]*C[k1] - x[1]*S[k1]);
+	    S[k] = f * (x[0]*S[k1] + x[1]*C[k1]);
+	    if (dC) {
+		for (d = 0; d < NDIM; d++) {
+		    dC[k][d] = f * (x[0]*dC[k1][d] - x[1]*dS[k1][d]);
+		    dS[k][d] = f * (x[0]*dS[k1][d] + x[1]*dC[k1][d]);
+		}
+		dC[k][0] += f * C[k1];
+		dC[k][1] -= f * S[k1];
+		dS[k][0] += f * S[k1];
+		dS[k][1] += f * C[k1];
+	    }
+	}
+	if (m < lmax) {				/* R_m+1,m from R_mm        */
+	    k = LM(m+1,m);
+	    k1 = LM(m,m);
+	    f = 2*m + 1;
+	    C[k] = f * x[2] * C[k1];
+	    S[k] = f * x[2] * S[k1];
+	    if (dC) {
+		for (d = 0; d < NDIM; d++) {
+		    dC[k][d] = f * x[2] * dC[k1][d];
+		    dS[k][d] = f * x[2] * dS[k1][d];
+		}
+		dC[k][2] += f * C[k1];
+		dS[k][2] += f * S[k1];
+	    }
+	}
+	for (l = m+2; l <= lmax; l++) {		/* and up in l              */
+	    k = LM(l,m);
+	    k1 = LM(l-1,m);
+	    k2 = LM(l-2,m);
+	    f = (2*l - 1) / (real) (l - m);
+	    g = (l + m - 1) / (real) (l - m);
+	    C[k] = f * x[2] * C[k1] - g * r2 * C[k2];
+	    S[k] = f * x[2] * S[k1] - g * r2 * S[k2];
+	    if (dC) {
+		for (d = 0; d < NDIM; d++) {
+		    dC[k][d] = f * x[2] * dC[k1][d] -
+			       g * (r2 * dC[k2][d] + 2 * x[d] * C[k2]);
+		    dS[k][d] = f * x[2] * dS[k1][d] -
+			       g * (r2 * dS[k2][d] + 2 * x[d] * S[k2]);
+		}
+		dC[k][2] += f * C[k1];
+		dS[k][2] += f * S[k1];
+	    }
+	}
+    }
+}
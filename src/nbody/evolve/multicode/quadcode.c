@@ -5,6 +5,7 @@
  *	12-nov-91  V1.3  PJT  Nemo V2.
  *      20-may-94  V1.3a pjt  usage
  *       6-jan-22  V1.4  pjt  linux now also requiring link protection
+ *      19-oct-26  V1.5  pjt  lmax= for a general harmonic expansion
  */
 
 #define global                                  /* don't default to extern  */
@@ -17,6 +18,7 @@ string defv[] = {		/* DEFAULT INPUT PARAMETERS		    */
     "save=\n			state file name",
     "eps_r=0.05\n		radial softening parameter",
     "eps_t=0.07\n		tangential softening parameter",
+    "lmax=-1\n		order of harmonic expansion; -1: quadrupole tables",
     "freq=64.0\n		fundamental frequency (inv delta-t)",
     "mode=3\n			integrator: 1 => RK, 2 => PC, 3 => PC1",
     "tstop=2.0\n		time to stop integration",
@@ -24,7 +26,7 @@ string defv[] = {		/* DEFAULT INPUT PARAMETERS		    */
     "minor_freqout=32.0\n	minor data-output frequency",
     "options=\n			misc options",
     "headline=\n		random mumble for humans",
-    "VERSION=1.4a\n	        20-oct-2024 PJT",
+    "VERSION=1.5\n	        19-oct-2026 PJT",
     NULL,
 };
 
@@ -58,6 +60,9 @@ void setparams()
     savefile = getparam("save");
     eps1 = getdparam("eps_r");
     eps2 = getdparam("eps_t");
+    lmax = getiparam("lmax");
+    if (lmax >= 0 && *quadfile)
+	error("quad= only with the quadrupole tables, lmax=-1");
     freq = getdparam("freq");
     mode = getiparam("mode");
     tstop = getdparam("tstop");
@@ -82,6 +87,10 @@ local void force(
 	CLRV(Acc(p));				/*   zero acceleration      */
 	Phi(p) = 0.0;				/*   and potential          */
     }
+    if (lmax >= 0) {				/* harmonic expansion       */
+	harmforce(btab, nb, lmax, eps1, eps2);
+	return;
+    }
     qfld.nqtab = 0;				/* get new field points     */
     quadforce(btab, nb, eps1, eps2);		/* compute quadpole force   */
 }
@@ -29,6 +29,8 @@ global int mode;			/* integrator: RK, PC or PC1                */
 
 global real eps1, eps2;		/* radial, tangential softening             */
 
+global int lmax;			/* order of harmonic expansion, <0: quad    */
+
 global real freqout, minor_freqout;	/* major, minor output frequencies          */
 
 global real tstop;			/* time to stop integration                 */
@@ -69,5 +71,11 @@ extern void moveaccel(body *btab, int nb);
 /* quadforce.c */
 extern void quadforce(body *btab, int nb, real eps1, real eps2);
 
+/* harmforce.c */
+extern void harmforce(body *btab, int nb, int lmax, real eps1, real eps2);
+
+/* radsort.c */
+extern int radsort(real *rad, int nb, int *order, bool reuse);
+
 /* quadinter.c */
 extern void quadinter(Body *btab, int nb, real eps1, real eps2);
@@ -7,6 +7,7 @@
  *      20-may-94       pjt     remove allocate() decl. into headers
  *      25-dec-02       pjt     better ANSI C
  *      20-oct-24       pjt     gcc-14 function pointer syntax fix
+ *      19-oct-26       pjt     reuse radius ranking of previous call
  */
 
 #include "quaddefs.h"
@@ -21,7 +22,9 @@ typedef struct {
 local void init_quad_field(shadow *, int, real);
 local void int_quad_force(shadow *, int);
 local void ext_quad_force(shadow *, int);
-local int rankrad(const void *, const void *);
+
+local int  *rankq = NULL;			/* ranking of previous call */
+local int   nrankq = 0;
 
 /*
  * QUADFORCE: compute the force-field of a spheroidal distribution.
@@ -32,35 +35,34 @@ void quadforce(Body *btab, int nb, real eps1, real eps2)
     shadowptr shad;
     Body *b;
     int i;
-    real rsq;
-
+    real rsq, *rad;
+
+    rad = (real *) allocate(nb * sizeof(real));
+    for (b = btab, i = 0; i < nb; b++, i++)	/* find radii to rank       */
+	rad[i] = sqrt(dotvp(Pos(b), Pos(b)));
+    if (nb != nrankq) {				/* no usable old ranking?   */
+	if (rankq != NULL)
+	    free(rankq);
+	rankq = (int *) allocate(nb * sizeof(int));
+    }
+    radsort(rad, nb, rankq, nb == nrankq);	/* rank bodies by radii     */
+    nrankq = nb;
+    free(rad);
     shad = (shadowptr) allocate(nb * sizeof(shadow));
-    for (b = btab, i = 0; i < nb; b++, i++) {	/* init shadowing array     */
+    for (i = 0; i < nb; i++) {			/* init shadowing array     */
+	b = btab + rankq[i];
  	shad[i].link = b;			/*   make link to body      */
 	rsq = dotvp(Pos(b), Pos(b));		/*   find radius squared    */
 	shad[i].rad0 = sqrt(rsq);		/*   set exact radius       */
 	shad[i].rads1 = sqrt(rsq + eps1*eps1);	/*   set softened radii     */
 	shad[i].rads2 = sqrt(rsq + eps2*eps2);
     }
-    qsort(shad, nb, sizeof(shadow), rankrad);	/* sort shadows by radii    */
     init_quad_field(shad, nb, eps1);		/* prepare field tables     */
     int_quad_force(shad, nb);			/* compute internal force   */
     ext_quad_force(shad, nb);			/* and external force       */
     free(shad);
 }
 
-/*
- * RANKRAD: ranking function for quicksort.
- */
-
-//local int rankrad(shadowptr sp1, shadowptr sp2)
-local int rankrad(const void *p1, const void *p2)
-{
-    shadowptr sp1 = (shadowptr) p1;
-    shadowptr sp2 = (shadowptr) p2;
-    return (sp1->rad0 < sp2->rad0 ? -1 : 1);	/* compare body radii       */
-}
-
 /*
  * INIT_QUAD_FIELD: initialize quadrupole-field tables.  If qfld.nqtab
  * is non-zero, assume radii are pretabulated; otherwise use sampled
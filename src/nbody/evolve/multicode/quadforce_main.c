@@ -5,6 +5,7 @@
  *	12-nov-91  V1.1  PJT	New NEMO V2.
  *	 6-may-92      a PJT	extra warning if no output selected
  *       6-jan-22  V1.4  pjt  linux now also requiring link protection
+ *      19-oct-26  V1.5  pjt  lmax= for a general harmonic expansion
  */
 
 #define global                                  /* don't default to extern  */
@@ -22,7 +23,8 @@ string defv[] = {
     "quad=\n			output file with field tables",
     "eps_r=0.05\n		radial softening parameter",
     "eps_t=0.07\n		tangential softening parameter",
-    "VERSION=1.4a\n		20-oct-2024 PJT",
+    "lmax=-1\n			order of harmonic expansion; -1: quadrupole tables",
+    "VERSION=1.5\n		19-oct-2026 PJT",
     NULL,
 };
 
@@ -44,15 +46,22 @@ void nemo_main()
     get_history(instr);
     eps_r = getdparam("eps_r");
     eps_t = getdparam("eps_t");
+    lmax = getiparam("lmax");
+    if (lmax >= 0 && hasvalue("quad"))
+	error("quad= only with the quadrupole tables, lmax=-1");
     get_snap(instr, &btab, &nbody, &tsnap, &bits);
-    if (bits & MassBit == 0 || bits & PhaseSpaceBit == 0)
+    if ((bits & MassBit) == 0 || (bits & PhaseSpaceBit) == 0)
 	error("not enuf info: bits = 0x%x", bits);
     for (bp = btab; bp < btab+nbody; bp++) {
 	CLRV(Acc(bp));
 	Phi(bp) = 0.0;
     }
-    qfld.nqtab = 0;
-    quadforce(btab, nbody, eps_r, eps_t);
+    if (lmax >= 0)
+	harmforce(btab, nbody, lmax, eps_r, eps_t);
+    else {
+	qfld.nqtab = 0;
+	quadforce(btab, nbody, eps_r, eps_t);
+    }
     if (hasvalue("out")) {
 	outstr = stropen(getparam("out"), "w");
 	put_history(outstr);
@@ -0,0 +1,72 @@
+/*
+ * RADSORT.C: rank bodies by radius, reusing the ranking of a previous call.
+ * Defines: radsort().
+ *
+ * Between timesteps bodies hardly change rank, so an insertion sort
+ * starting from the previous order costs O(nb + moves), instead of the
+ * O(nb log nb) of a full qsort.  If the old order turns out to be too
+ * far off (or there is none) a full qsort is done.
+ *
+ *	19-oct-26	created, for quadforce and harmforce	PJT
+ */
+
+#include "quaddefs.h"
+
+#define MAXMOVES  8		/* allowed moves per body before giving up */
+
+typedef struct {
+    real r;
+    int  i;
+} rankpair;
+
+local int rankpairs(const void *p1, const void *p2)
+{
+    real r1 = ((rankpair *)p1)->r;
+    real r2 = ((rankpair *)p2)->r;
+    return r1 < r2 ? -1 : (r1 > r2 ? 1 : 0);
+}
+
+/*
+ * RADSORT: on return order[0..nb-1] are the body indices in increasing
+ * radius rad[].  If reuse is set, order[] is expected to hold the result
+ * of a previous call for the same number of bodies.
+ * Returns the number of insertion moves, or -1 if a full sort was done.
+ */
+
+int radsort(real *rad, int nb, int *order, bool reuse)
+{
+    rankpair *rp, tmp;
+    int i, j, nmove = 0;
+
+    rp = (rankpair *) allocate(nb * sizeof(rankpair));
+    if (reuse) {
+	for (i = 0; i < nb; i++) {		/* gather in old order      */
+	    rp[i].i = order[i];
+	    rp[i].r = rad[order[i]];
+	}
+	for (i = 1; i < nb && nmove >= 0; i++) {	/* insertion sort   */
+	    if (rp[i-1].r <= rp[i].r)
+		continue;
+	    tmp = rp[i];
+	    for (j = i; j > 0 && rp[j-1].r > tmp.r; j--)
+		rp[j] = rp[j-1];
+	    rp[j] = tmp;
+	    nmove += i - j;
+	    if (nmove > MAXMOVES * nb)		/* too much work, give up   */
+		nmove = -1;
+	}
+    }
+    if (!reuse || nmove < 0) {			/* full sort                */
+	for (i = 0; i < nb; i++) {
+	    rp[i].i = i;
+	    rp[i].r = rad[i];
+	}
+	qsort(rp, nb, sizeof(rankpair), rankpairs);
+	nmove = -1;
+    }
+    for (i = 0; i < nb; i++)
+	order[i] = rp[i].i;
+    free(rp);
+    dprintf(2, "radsort: nb=%d moves=%d\n", nb, nmove);
+    return nmove;
+}
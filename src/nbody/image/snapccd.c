@@ -18,6 +18,7 @@
  *      16-mar-90  V4.4 made GCC happy, made helpvec  PJT
  *	13-nov-90  V4.5 new location of <snapshot.h>	PJT
  *       4-mar-97  V4.6 NEMO V2.x, fixes for SINGLEPREC pjt
+ *	19-oct-26  V4.8 gridding with the binning library	PJT
  */
 
 #include <stdinc.h>
@@ -27,6 +28,7 @@
 #include <snapshot/snapshot.h>
 #include <image.h>
 #include <history.h>
+#include <binning.h>
 
 string defv[] = {
 	"in=???\n			input filename (a snapshot)",
@@ -36,7 +38,7 @@ string defv[] = {
 	"cell=0.0625\n			cellsize : 64 pixels if size=4",
 	"vrange=-infinity:infinity\n	range in velocity space",
 	"moment=0\n			velocity moment to weigh with",
-	"VERSION=4.7a\n			9-oct-2023 PJT",
+	"VERSION=4.8\n			19-oct-2026 PJT",
 	NULL,
 };
 
@@ -201,34 +203,27 @@ void allocate_image()
 
 void bin_data()
 {
-    real xsky, ysky, vrad;
+    real vrad, *xs, *ys, *bs;
     real m_min, m_max, brightness, inv_surden, total;
-    int  i, k, ix, iy, nx, ny, noutside, noutvel, ndata;
+    int  i, k, ix, iy, nx, ny, nb[2], noutside, noutvel, ndata, nin;
+    double bmin[2], bmax[2];
+    bin_table *bt;
     real *pptr;
     
 	/* (re)initialize CCD and some other local  variables */
     nx=Nx(iptr);
     ny=Ny(iptr);
-    for (ix=0; ix<nx; ix++)
-       for (iy=0; iy<ny; iy++)
-	  MapValue(iptr,ix,iy) = 0.0;
     m_max = -HUGE;
     m_min = HUGE;
     inv_surden = 1.0 / (cell * cell);		/* scaling factor */
-    noutside=noutvel=ndata=0;
+    noutvel=ndata=0;
     total=0.0;
-		/* walk through all particles and accumulate ccd data */
-    for (i=0, pptr=phase; i<nobj; i++) {
-        xsky = *pptr++;			/* x */
-        ysky = *pptr++;			/* y */
-        pptr += NDIM;
-        vrad = -(*pptr++);		/* v_z */
-	ix = floor((xsky-xmin)/cell+0.5+EPS);	/* integer coords in CCD */
-	iy = floor((ysky-ymin)/cell+0.5+EPS);
-	if (ix<0 || iy<0 || ix>=nx || iy>=ny) {
-	    noutside++;			/* not in CCD frame */
-	    continue;
-	}
+    xs = (real *) allocate(nobj*sizeof(real));
+    ys = (real *) allocate(nobj*sizeof(real));
+    bs = (real *) allocate(nobj*sizeof(real));
+		/* walk through all particles and collect ccd data */
+    for (i=0, nin=0, pptr=phase; i<nobj; i++, pptr += 2*NDIM) {
+        vrad = -pptr[NDIM+2];		/* v_z */
         if (vrad<vmin || vrad>vmax) {
             noutvel++;
             continue;
@@ -238,8 +233,27 @@ void bin_data()
             brightness *= exp( -0.5*sqr((vrad-vmean)/vsig) );
 	for (k=0; k<moment; k++)
 	    brightness *= vrad;
-	MapValue(iptr,ix,iy) +=   brightness;
+        xs[nin] = pptr[0];		/* x */
+        ys[nin] = pptr[1];		/* y */
+        bs[nin++] = brightness;
      }  /*-- end particles loop --*/
+		/* cell edges, with the same roundoff as floor(..+0.5+EPS) had */
+    nb[0] = nx;
+    nb[1] = ny;
+    bmin[0] = xmin - (0.5+EPS)*cell;
+    bmin[1] = ymin - (0.5+EPS)*cell;
+    bmax[0] = bmin[0] + nx*cell;
+    bmax[1] = bmin[1] + ny*cell;
+    bt = bin_create(2, nb, bmin, bmax, 0);
+    bin_add_n(bt, nin, xs, ys, NULL, bs, NULL);
+    noutside = bt->nout;
+    for (ix=0; ix<nx; ix++)
+       for (iy=0; iy<ny; iy++)
+	  MapValue(iptr,ix,iy) = bt->w[ix + nx*iy];
+    bin_free(bt);
+    free(xs);
+    free(ys);
+    free(bs);
 
 	/* determine maximum in picture */
     for (ix=0; ix<nx; ix++)
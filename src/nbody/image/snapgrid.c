@@ -30,6 +30,7 @@
  *       2-mar-11   5.3 implemented h3,h4 as moment -3 and -4
  *      18-may-12   5.4 added smoothing in VZ (szvar)
  *     13-feb-2013  6.0 units changed on a cube (now density instead of surface brightness?)
+ *     19-oct-2026  6.3 box gridding (no smoothing or depth) with the binning library
  *
  * Todo: - mean=t may not be correct for nz>1 
  *       - hermite h3 and h4 for proper kinemetry
@@ -50,6 +51,7 @@
 #include <snapshot/get_snap.c>
 
 #include <image.h>              /* images */
+#include <binning.h>
 
 string defv[] = {		/* keywords/default values/help */
 	"in=???\n			  input filename (a snapshot)",
@@ -77,7 +79,7 @@ string defv[] = {		/* keywords/default values/help */
 	"stack=f\n			  Stack all selected snapshots?",
 	"integrate=f\n                    Sum or Integrate along 'dvar'?",
 	"proj=\n                          Sky projection (SIN, TAN, ARC, NCP, GLS, CAR, MER, AIT)",
-	"VERSION=6.2\n			  22-dec-2024 PJT",
+	"VERSION=6.3\n			  19-oct-2026 PJT",
 	NULL,
 };
 
@@ -100,6 +102,7 @@ local string times;
 
 		/* IMAGE INTERFACE */
 local imageptr  iptr=NULL, iptr0=NULL, iptr1=NULL, iptr2=NULL, iptr3=NULL, iptr4=NULL;
+local bin_table *grid=NULL;		/* box gridding, instead of iptr0..4 */
 local int    nx,ny,nz;			     /* map-size */
 local real   xrange[3], yrange[3], zrange[3];      /* range of cube */
 local real   xbeam, ybeam, zbeam;                  /* >0 if convolution beams */
@@ -139,6 +142,7 @@ local int read_snap(void);
 local void allocate_image(void);
 local void clear_image(void);
 local void bin_data(int ivar);
+local void box_data(int ivar, real cell_factor);
 local void free_snap(void);
 local void los_data(void);
 local void rescale_data(int ivar);
@@ -351,7 +355,17 @@ void allocate_image()
     create_cube (&iptr,nx,ny,nz);
     if (iptr==NULL) error("No memory to allocate first image");
 
-    if (Qmean || moment <= -1) {
+    if (!Qsmooth && zsig == 0.0 && !Qdepth && !Qint) {   /* straight box gridding */
+        int nb[3];
+        double lo[3], hi[3];
+
+        if ((Qmean || moment <= -1) && moment)
+            warning("%d: mean=t requires moment=0",moment);
+        nb[0] = nx;  lo[0] = xrange[0];  hi[0] = xrange[1];
+        nb[1] = ny;  lo[1] = yrange[0];  hi[1] = yrange[1];
+        nb[2] = nz;  lo[2] = zrange[0];  hi[2] = zrange[1];
+        grid = bin_create(nz > 1 ? 3 : 2, nb, lo, hi, moment < 0 ? -moment : 0);
+    } else if (Qmean || moment <= -1) {
     	if (moment)
     	    warning("%d: mean=t requires moment=0",moment);
         create_cube(&iptr0,nx,ny,nz);
@@ -359,25 +373,25 @@ void allocate_image()
             error("No memory to allocate normalization image - try mean=f");
     }
 
-    if (moment <= -1) {
+    if (!grid && moment <= -1) {
         create_cube(&iptr1,nx,ny,nz);
         if (iptr1==NULL) 
             error("No memory to allocate 2nd image - try moment>0");
     }
 
-    if (moment <= -2) {
+    if (!grid && moment <= -2) {
         create_cube(&iptr2,nx,ny,nz);
         if (iptr2==NULL) 
             error("No memory to allocate 3rd image - try moment>0");
     }
 
-    if (moment <= -3) {
+    if (!grid && moment <= -3) {
         create_cube(&iptr3,nx,ny,nz);
         if (iptr3==NULL) 
             error("No memory to allocate 4th image - try moment>0");
     }
 
-    if (moment <= -4) {
+    if (!grid && moment <= -4) {
         create_cube(&iptr4,nx,ny,nz);
         if (iptr4==NULL) 
             error("No memory to allocate 5th image - try moment>0");
@@ -437,6 +451,7 @@ void clear_image()
 {
     int ix,iy,iz;
 
+    if (grid) bin_clear(grid);
     for (ix=0; ix<nx; ix++)		        /* initialize all cubes to 0 */
     for (iy=0; iy<ny; iy++)
     for (iz=0; iz<nz; iz++) {
@@ -501,6 +516,11 @@ void bin_data(int ivar)
         mmax = 1;
     emax = 10.0;
 
+    if (grid) {                         /* no smoothing or depth: fast path */
+        box_data(ivar, cell_factor);
+        return;
+    }
+
 		/* big loop: walk through all particles and accumulate ccd data */
     for (i=0, bp=btab; i<nobj; i++, bp++) {
         x = xfunc(bp,tnow,i);            /* transform */
@@ -618,6 +638,52 @@ void bin_data(int ivar)
 }
 
 
+/*
+ * BOX_DATA: straight box gridding of all bodies through the binning
+ *           library; moment<0 keeps the moments of zvar per cell
+ */
+
+void box_data(int ivar, real cell_factor)
+{
+    real *xs, *ys, *zs, *ws, x, y, z, flux, brightness;
+    long nout = grid->nout;
+    int  i, k, n;
+    Body *bp;
+
+    xs = (real *) allocate(nobj*sizeof(real));
+    ys = (real *) allocate(nobj*sizeof(real));
+    zs = (real *) allocate(nobj*sizeof(real));
+    ws = (real *) allocate(nobj*sizeof(real));
+    for (i=0, n=0, bp=btab; i<nobj; i++, bp++) {
+        x = xfunc(bp,tnow,i);            /* transform */
+	y = yfunc(bp,tnow,i);
+	if (Qwcs) wcs(&x,&y);
+        z = zfunc(bp,tnow,i);
+        flux = efunc[ivar](bp,tnow,i);
+        if (z<zmin || z>zmax) {         /* initial check in Z */
+            noutz++;
+            continue;
+        }
+        if (flux == 0.0) {              /* discard zero flux cases */
+            nzero++;
+            continue;
+        }
+        brightness = flux * cell_factor;
+        for (k=0; k<ABS(moment); k++) brightness *= z;  /* moments in Z */
+        if (brightness == 0.0) continue;
+        xs[n] = x;
+        ys[n] = y;
+        zs[n] = z;
+        ws[n++] = moment < 0 ? flux * cell_factor : brightness;
+    }
+    bin_add_n(grid, n, xs, ys, zs, ws, moment < 0 ? zs : NULL);
+    noutxy += grid->nout - nout;
+    free(xs);
+    free(ys);
+    free(zs);
+    free(ws);
+}
+
 void los_data(void)
 {
   real brightness, cell_factor, x, y, z, z0, t, dz, sum;
@@ -750,6 +816,27 @@ void rescale_data(int ivar)
     Unit(iptr) = evar[ivar]; /* for Qmean=t should use proper mean cell units */
     Time(iptr) = tnow;
     
+    if (grid) {                    /* box gridding: from the table */
+      for (ix=0; ix<nx; ix++)
+        for (iy=0; iy<ny; iy++)
+	  for (iz=0; iz<nz; iz++) {
+	    k = ix + nx*(iy + ny*iz);
+	    if (grid->count[k] == 0)
+	      CV(iptr) = 0.0;
+	    else if (moment == -1)
+	      CV(iptr) = grid->mean[k];
+	    else if (moment == -2)
+	      CV(iptr) = bin_sigma(grid, k);
+	    else if (moment == -3)    /* h3 and h4 as in the gauss-hermite approx below */
+	      CV(iptr) = bin_skewness(grid, k)/(4*sqrt(3));
+	    else if (moment == -4)
+	      CV(iptr) = bin_kurtosis(grid, k)/(8*sqrt(6));
+	    else if (Qmean)
+	      CV(iptr) = grid->w[k]/grid->count[k];
+	    else
+	      CV(iptr) = grid->w[k];
+	  }
+    }
     /* handle special cases when mean=t or moment=-1 or moment=-2 */
     if (iptr4) {                   /* moment = -4 : h4 */
       dprintf(1,"rescale(%d) iptr4\n",ivar);
@@ -2,6 +2,7 @@
  *  SNAPIFU:   generate spectra at a grid of points
  *
  *	 8-apr-09  V1.0 - cloned off snapgrid             PJT
+ *	19-oct-26  V1.2 - box gridding with the binning library  PJT
  *
  * Todo: - mean=t may not be correct for nz>1 
  *       - xgrid,ygrid should be from file?
@@ -19,6 +20,7 @@
 #include <snapshot/get_snap.c>
 
 #include <image.h>              /* images */
+#include <binning.h>
 
 string defv[] = {		/* keywords/default values/help */
   "in=???\n			  input filename (a snapshot)",
@@ -38,7 +40,7 @@ string defv[] = {		/* keywords/default values/help */
   "moment=0\n			  moment in zvar (-2,-1,0,1,2...)",
   "mean=f\n			  mean (moment=0) or sum per cell",
   "stack=f\n			  Stack all selected snapshots?",
-  "VERSION=1.1\n		  22-dec-2024 PJT",
+  "VERSION=1.2\n		  19-oct-2026 PJT",
   NULL,
 };
 
@@ -49,6 +51,7 @@ string usage="take spectra from a snapshot at a set of specified grid points";
 #define CUTOFF    4.0		/* cutoff of gaussian in terms of sigma */
 #define MAXVAR	  16		/* max evar's */
 #define MAXPOINTS 1024          /* max # gridpoints */
+#define NBUF      4096          /* fiber samples per bin_accum_n() call */
 
 local stream  instr, outstr;				/* file streams */
 
@@ -61,6 +64,7 @@ local string times;
 
 		/* IMAGE INTERFACE for spectra */
 local imageptr  iptr=NULL, iptr0=NULL, iptr1=NULL, iptr2=NULL;
+local bin_table *spec=NULL;		/* box gridding: fiber x Z */
 local int    nx,ny,nz;    		/* spectrum-size */
 local real   zrange[3];                 /* range of spectra */
 local real   zbeam;                     /* >0 if convolution beams */
@@ -253,7 +257,16 @@ allocate_image()
     create_cube (&iptr,nx,ny,nz);
     if (iptr==NULL) error("No memory to allocate first image");
 
-    if (Qmean) {
+    if (zsig == 0.0 && !Qdepth) {	/* straight box gridding */
+        int nb[2];
+        double lo[2], hi[2];
+
+        if (Qmean && moment)
+            warning("%d: mean=t requires moment=0",moment);
+        nb[0] = nx;  lo[0] = 0.0;  hi[0] = nx;      /* bins are given */
+        nb[1] = nz;  lo[1] = 0.0;  hi[1] = nz;
+        spec = bin_create(2, nb, lo, hi, moment == -2 ? 2 : (moment == -1 ? 1 : 0));
+    } else if (Qmean) {
     	if (moment)
     	    warning("%d: mean=t requires moment=0",moment);
         create_cube(&iptr0,nx,ny,nz);
@@ -261,13 +274,13 @@ allocate_image()
             error("No memory to allocate normalization image - try mean=f");
     }
 
-    if (moment == -1 || moment == -2) {
+    if (!spec && (moment == -1 || moment == -2)) {
         create_cube(&iptr1,nx,ny,nz);
         if (iptr1==NULL) 
             error("No memory to allocate second image - try moment>0");
     }
 
-    if (moment == -2) {
+    if (!spec && moment == -2) {
         create_cube(&iptr2,nx,ny,nz);
         if (iptr2==NULL) 
             error("No memory to allocate third image - try moment>0");
@@ -294,6 +307,8 @@ clear_image()
 {
     int ix,iy,iz;
 
+    if (spec) bin_clear(spec);
+
     for (ix=0; ix<nx; ix++)		        /* initialize all cubes to 0 */
     for (iy=0; iy<ny; iy++)
     for (iz=0; iz<nz; iz++) {
@@ -325,6 +340,9 @@ bin_data(int ivar)
     int    i, j, k, l, ix, iy, iz, n, nneg, ioff;
     Body   *bp;
     Point  *pp, *pf,*pl, **ptab;
+    long   sidx[NBUF];
+    real   sw[NBUF], sz[NBUF];
+    int    ns = 0;
 
     r2max = 0.25 * size * size;    /* size is the diameter, we need r^2 here */
     
@@ -408,13 +426,18 @@ bin_data(int ivar)
 	  }
 	} else {                            /* straight box gridding */
 	  iz = zbox(z);
-	  CV(iptr) +=   brightness;         /* moment */
-	  if(iptr0) CV(iptr0) += 1.0;       /* for mean */
-	  if(iptr1) CV(iptr1) += b;         /* moment -1,-2 */
-	  if(iptr2) CV(iptr2) += b*z;       /* moment -2 */
+	  sidx[ns] = iz < 0 || iz >= nz ? -1 : l + nx*iz;
+	  sw[ns] = moment < 0 ? b : brightness;
+	  sz[ns++] = z;
+	  if (ns == NBUF) {
+	    bin_accum_n(spec, ns, sidx, sw, sz);
+	    ns = 0;
+	  }
 	}
       } /*-- (l) end grid loop --*/
     }  /*-- (i) end particles loop --*/
+    if (ns > 0)
+      bin_accum_n(spec, ns, sidx, sw, sz);
 }
 
 
@@ -543,6 +566,24 @@ rescale_data(int ivar)
     Unit(iptr) = evar[ivar]; /* for Qmean=t should use proper mean cell units */
     Time(iptr) = tnow;
     
+    if (spec) {                     /* box gridding: from the table */
+        for (ix=0; ix<nx; ix++)
+        for (iy=0; iy<ny; iy++)
+        for (iz=0; iz<nz; iz++) {
+            k = ix + nx*iz;
+            if (spec->count[k] == 0)
+                CV(iptr) = 0.0;
+            else if (moment == -2)
+                CV(iptr) = bin_sigma(spec, k);
+            else if (moment == -1)
+                CV(iptr) = spec->mean[k];
+            else if (Qmean)
+                CV(iptr) = spec->w[k]/spec->count[k];
+            else
+                CV(iptr) = spec->w[k];
+        }
+    }
+
     /* handle special cases when mean=t or moment=-1 or moment=-2 */
     if (iptr2) {                    /* moment = -2 : dispersion output */
         dprintf(1,"rescale(%d) iptr2\n",ivar);
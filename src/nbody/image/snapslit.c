@@ -11,6 +11,7 @@
  *	22-apr-92  V2.0  NEMO V2.x; major overhaul: xvar=yvar= etc.  PJT
  *	21-jul-95  V2.0a bugfix - calling sprintf for strcpy   Dave Shone
  *	 4-mar-97      b fix for SINGLEPREC
+ *	19-oct-26  V2.2  binning library for the moments	PJT
  */
 
 #include <stdinc.h>
@@ -24,6 +25,7 @@
 
 #include <yapp.h>
 #include <axis.h>
+#include <binning.h>
 
 string defv[] = {
     "in=???\n		    input filename (snapshot)",
@@ -44,7 +46,7 @@ string defv[] = {
     "vmax=0.0\n             max mean to plot",
     "smax=0.0\n             max dispersion to plot",
     "tab=f\n                Need a table? If yes, no plot",
-    "VERSION=2.1\n          9-oct-2022 PJT",
+    "VERSION=2.2\n          19-oct-2026 PJT",
     NULL,
 };
 
@@ -192,16 +194,20 @@ int out_slit()
     real xsky, ysky, vrad, inv_surden, sigma, mass;
     real xslit, yslit, xplt, yplt, sinpa, cospa;
     real m_max, v_min, v_max, s_max;	      /* local min/max */
-    int    i, islit;
+    int    i, n, islit;
+    real  *xs, *ms, *vs;
+    double lo, hi;
+    bin_table *bt;
     Body *bp;
 
-    for (islit=0; islit<nslit; islit++)     /* reset local variables */
-	v0star[islit] = v1star[islit] = v2star[islit] = 0.0;
     m_max = v_min = v_max = s_max = 0.0;
     inv_surden = 1.0 / (slit_width*slit_cell);
     sinpa = sin(pa); cospa = cos(pa);
+    xs = (real *) allocate(nobj*sizeof(real));
+    ms = (real *) allocate(nobj*sizeof(real));
+    vs = (real *) allocate(nobj*sizeof(real));
 
-    for(bp=btab, i=0; i<nobj; bp++, i++) {      /* loop over all particles */
+    for(bp=btab, i=0, n=0; i<nobj; bp++, i++) {	/* loop over all particles */
  	xsky = xvar(bp,tsnap,i);
  	ysky = yvar(bp,tsnap,i);
  	vrad = zvar(bp,tsnap,i);
@@ -214,16 +220,24 @@ int out_slit()
 
 	if (fabs(yslit) > 0.5*slit_width) 
 	   continue;			/* not in slit */
-
-	islit =  (xslit+0.5*slit_length)/slit_cell;
-	if (islit<0 || islit>=nslit)
-	   continue;			/* not in slit */
-
-	v0star[islit] += mass;
-	v1star[islit] += vrad * mass;
-	v2star[islit] += sqr(vrad) * mass;
+	xs[n] = xslit;
+	ms[n] = mass;
+	vs[n++] = vrad;
      } /*-- end particles loop --*/
 
+    lo = -0.5*slit_length;		/* M, mean and dispersion along the slit */
+    hi = lo + nslit*slit_cell;
+    bt = bin_create(1, &nslit, &lo, &hi, 2);
+    bin_add_n(bt, n, xs, NULL, NULL, ms, vs);
+    for (islit=0; islit<nslit; islit++) {	/* back to M, MV and MV^2 */
+	v0star[islit] = bt->w[islit];
+	v1star[islit] = bt->w[islit]*bt->mean[islit];
+	v2star[islit] = bt->m2[islit] + v1star[islit]*bt->mean[islit];
+    }
+    bin_free(bt);
+    free(xs);
+    free(ms);
+    free(vs);
 
      while (nsmooth-- > 0) {            	/* convolution */
      	dprintf (0,"Convolving with %d-length beam: ",lsmooth);
@@ -240,6 +254,8 @@ int out_slit()
 	    continue;		/* no data - skip to next pixel */
 	v1star[islit] /= v0star[islit];
 	sigma = v2star[islit]/v0star[islit] - sqr(v1star[islit]);
+	if (sigma<0.0 && sigma > -1e-12*sqr(v1star[islit]))
+	    sigma = 0.0;	/* roundoff, e.g. a single particle */
 	if (sigma<0.0) {        /* should never happen */
 	    warning("islit=%d sigma^2=%e < 0 !!!\n",islit,sigma);
 	    v2star[islit] = 0.0;
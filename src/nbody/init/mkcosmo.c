@@ -5,6 +5,7 @@
  *       7-nov-06  V0.4  add rhob=, a=
  *      16-nov-06  V0.6  new fiddling for some good runs!   Alan Peel
  *      19-nov-06  V0.7  allow unequal masses based on density
+ *      19-oct-26  V0.8  power= for Zel'dovich/2LPT initial conditions  PJT
  *
  * todo:
  *  - first point is always 0,0,0
@@ -23,9 +24,12 @@
 #include <snapshot/put_snap.c>
 
 #include <image.h>
+#include <table.h>
+#include <fft.h>
+#include <crandom.h>
 
 string defv[] = {	/* DEFAULT INPUT PARAMETERS */
-  "in=???\n       Input density (fluctuation) cube",
+  "in=\n          Input density (fluctuation) cube",
   "out=???\n      Output file name",
   "z=\n           Redshift, for growth function 1/(1+x)",
   "D=\n           Growth function value, given explicitly (D<=1)",
@@ -37,8 +41,14 @@ string defv[] = {	/* DEFAULT INPUT PARAMETERS */
   "density=f\n    Use density map to make an exact lattice grid (TEST)",
   "rejection=f\n  Use rejection technique to seed the 'grid'",
   "nbody=\n       Use this instead of NX*NY*NZ if rejection is used",
+  "power=\n       Table of k [h/Mpc] and P(k) [(Mpc/h)^3] at z=0 for Zel'dovich/2LPT, instead of in=",
+  "nmesh=64\n     Grid size per dimension for power=, a power of 2",
+  "box=100\n      Box size [Mpc/h] for power=",
+  "omegam=0.3\n   Omega_matter for power=",
+  "omegal=0.7\n   Omega_lambda for power=",
+  "lpt=2\n        Order of Lagrangian perturbation theory for power=, 1 or 2",
   "headline=\n    Random verbiage",
-  "VERSION=0.7a\n 14-jul-2020 PJT",
+  "VERSION=0.8\n  19-oct-2026 PJT",
   NULL,
 };
 
@@ -53,6 +63,9 @@ local real cube_aver, cube_max;
 
 local imageptr iptr=NULL;
 
+local bool Qtime = FALSE;		/* write tsnap as well */
+local real tsnap = 0.0;
+
 extern double xrandom(double,double), grandom(double,double);
 
 void check_image(void);
@@ -62,6 +75,7 @@ void write_snap(string name, string headline);
 void mkcube(void), mkcube_reject(void);
 void fiddle_x(void),  fiddle_y(void),  fiddle_z(void), drifter(void);
 void fiddle_m(void);
+void mklpt(int seed);
 
 void nemo_main()
 {
@@ -72,6 +86,14 @@ void nemo_main()
   bool Qreject = getbparam("rejection");
   bool Qdens =  getbparam("density");
 
+  if (hasvalue("power")) {
+    mklpt(init_xrandom(getparam("seed")));
+    write_snap(getparam("out"), getparam("headline"));
+    free(btab);
+    return;
+  }
+  if (!hasvalue("in")) error("Either in= or power= is needed");
+
   instr = stropen (getparam("in"),"r");
   read_image(instr,&iptr); 
   strclose(instr);      
@@ -204,9 +226,9 @@ void rescale_image_d(real d, real a, real rhobar)
 void write_snap(string name, string headline)
 {
   stream outstr;
-  real tsnap = 0.0;
   int bits = MassBit | PhaseSpaceBit;
   
+  if (Qtime) bits |= TimeBit;
   if (! streq(headline, ""))
     set_headline(headline);
   outstr = stropen(name, "w");
@@ -468,3 +490,398 @@ void drifter(void)
 {
   warning("no drifting done yet");
 }
+
+
+/*
+ * Zel'dovich (lpt=1) or second order (lpt=2) Lagrangian perturbation theory
+ * initial conditions on a nmesh^3 lattice, from a tabulated power spectrum.
+ *
+ * The density field is white noise in real space, one crandom stream per
+ * cell so the field does not depend on the number of threads, scaled to
+ * the power spectrum in k-space. With Psi1(k) = i k/k^2 delta(k) and the
+ * second order source S = sum_{i<j} (Psi1_i,i Psi1_j,j - Psi1_i,j^2),
+ * Psi2(k) = -i k/k^2 S(k), the particles are moved from the lattice q to
+ *	x = q + D1 Psi1 + D2 Psi2,   v = a H (f1 D1 Psi1 + f2 D2 Psi2)
+ * with D2 = -3/7 D1^2 Omega_m(a)^(-1/143), f2 = 2 Omega_m(a)^(6/11).
+ * Two real fields are done with one complex inverse FFT (F1 + i F2), so
+ * 2LPT costs 9 transforms, and besides the bodies only two complex grids
+ * and one real grid are needed. The 3D transforms are done in slabs of
+ * constant x, each thread needing only one plane of scratch memory.
+ *
+ * Positions are in Mpc/h in [0,box), velocities peculiar in km/s,
+ * masses in 1e10 Msun/h, and the time is the expansion factor a.
+ */
+
+#define RHOCRIT 27.7536627	/* critical density in 1e10 Msun/h / (Mpc/h)^3 */
+
+local real omegam, omegal;
+local int  npk = 0;
+local real *pk_lk, *pk_lp;	/* log(k), log(P) */
+
+typedef struct {		/* a field to derive from delta(k) */
+  int  order;			/* 0: none  1: i k_a/k^2  2: -k_a k_b/k^2 */
+  int  a, b;
+  real scale;
+} lptfield;
+
+local void read_power(string name)
+{
+  stream instr;
+  int i, n, nmax, colnr[2];
+  real *coldat[2], *k, *p;
+
+  nmax = nemo_file_lines(name, 0);
+  if (nmax < 2) error("%s: need at least 2 lines for a power spectrum", name);
+  k = (real *) allocate(nmax*sizeof(real));
+  p = (real *) allocate(nmax*sizeof(real));
+  coldat[0] = k;  colnr[0] = 1;
+  coldat[1] = p;  colnr[1] = 2;
+  instr = stropen(name, "r");
+  n = get_atable(instr, 2, colnr, coldat, nmax);
+  strclose(instr);
+  if (n < 0) {
+    n = -n;
+    warning("Could only read %d lines from %s", n, name);
+  }
+  for (i=0; i<n; i++) {		/* keep the positive values, as logs */
+    if (k[i] <= 0 || p[i] <= 0) continue;
+    if (npk > 0 && log(k[i]) <= k[npk-1])
+      error("%s: k must be increasing (line %d)", name, i+1);
+    k[npk] = log(k[i]);
+    p[npk] = log(p[i]);
+    npk++;
+  }
+  if (npk < 2) error("%s: need at least 2 positive k,P(k) pairs", name);
+  pk_lk = k;
+  pk_lp = p;
+  dprintf(1,"P(k): %d points for k=%g..%g\n", npk, exp(k[0]), exp(k[npk-1]));
+}
+
+/* P(k), linear in log-log, 0 outside the table */
+
+local real power(real k)
+{
+  int lo = 0, hi = npk-1, mid;
+  real lk, w;
+
+  if (k <= 0) return 0.0;
+  lk = log(k);
+  if (lk < pk_lk[0] || lk > pk_lk[npk-1]) return 0.0;
+  while (hi - lo > 1) {
+    mid = (lo+hi)/2;
+    if (pk_lk[mid] > lk) hi = mid; else lo = mid;
+  }
+  w = (lk - pk_lk[lo])/(pk_lk[hi] - pk_lk[lo]);
+  return exp((1-w)*pk_lp[lo] + w*pk_lp[hi]);
+}
+
+/* H(a)/H0 */
+
+local real hubble_e(real a)
+{
+  return sqrt(omegam/(a*a*a) + (1-omegam-omegal)/(a*a) + omegal);
+}
+
+/* the integral in the linear growth D(a) = 5/2 Om E(a) int_0^a da/(aE)^3 */
+
+local real growth_int(real a)
+{
+  int i, n = 10000;
+  real x, sum = 0.0;
+
+  for (i=0; i<n; i++) {
+    x = (i+0.5)*a/n;
+    sum += 1.0/qbe(x*hubble_e(x));
+  }
+  return sum*a/n;
+}
+
+local real growth(real a)
+{
+  return 2.5*omegam*hubble_e(a)*growth_int(a);
+}
+
+/* f = dlnD/dlna */
+
+local real growth_rate(real a)
+{
+  real e = hubble_e(a);
+
+  return (-3*omegam/(a*a*a) - 2*(1-omegam-omegal)/(a*a))/(2*e*e)
+         + 1.0/(qbe(a*e)*growth_int(a)/a);
+}
+
+/*
+ * FFT3: in-place complex 3D transform of an n^3 cube, stored [ix][iy][iz].
+ *	 First the 2D transforms of the contiguous planes of constant ix,
+ *	 then for each iy the (ix,iz) plane is transposed into a per-thread
+ *	 buffer and transformed along ix.
+ */
+
+local void fft3(double *d, int n, int isign)
+{
+  int ix, iy, nn[2];
+  long nplane = (long)n*n;
+
+  nn[0] = nn[1] = n;
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+  for (ix=0; ix<n; ix++)
+    fft_ndim(d + 2*ix*nplane, 2, nn, isign);
+
+#if defined(_OPENMP)
+#pragma omp parallel private(ix,iy)
+#endif
+  {
+    double *buf = (double *) allocate(2*nplane*sizeof(double));
+    double *row;
+    int iz;
+
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+    for (iy=0; iy<n; iy++) {
+      for (ix=0; ix<n; ix++) {
+	row = d + 2*((long)ix*n + iy)*n;
+	for (iz=0; iz<n; iz++) {
+	  buf[2*((long)iz*n+ix)]   = row[2*iz];
+	  buf[2*((long)iz*n+ix)+1] = row[2*iz+1];
+	}
+      }
+      for (iz=0; iz<n; iz++)
+	fft_cplx(buf + 2*(long)iz*n, n, isign);
+      for (ix=0; ix<n; ix++) {
+	row = d + 2*((long)ix*n + iy)*n;
+	for (iz=0; iz<n; iz++) {
+	  row[2*iz]   = buf[2*((long)iz*n+ix)];
+	  row[2*iz+1] = buf[2*((long)iz*n+ix)+1];
+	}
+      }
+    }
+    free(buf);
+  }
+}
+
+/* wavenumber of index i */
+
+local real kvalue(int i, int n, real kf)
+{
+  return kf * (i <= n/2 ? i : i-n);
+}
+
+/*
+ * LPT_FILL: work = F1 + i F2, with Fm(k) = field m applied to dk;
+ *	     the mean and the Nyquist planes are left 0, so both are
+ *	     transforms of real fields.
+ */
+
+local void lpt_fill(double *dk, double *work, int n, real kf,
+		    lptfield *f1, lptfield *f2)
+{
+  long ncell = (long)n*n*n, l;
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+  for (l=0; l<ncell; l++) {
+    int ix = l/((long)n*n), iy = (l/n)%n, iz = l%n, m;
+    real kk[3], k2, cr[2], ci[2];
+    lptfield *f[2];
+
+    work[2*l] = work[2*l+1] = 0.0;
+    if (l == 0 || ix == n/2 || iy == n/2 || iz == n/2) continue;
+    kk[0] = kvalue(ix,n,kf);
+    kk[1] = kvalue(iy,n,kf);
+    kk[2] = kvalue(iz,n,kf);
+    k2 = kk[0]*kk[0] + kk[1]*kk[1] + kk[2]*kk[2];
+    f[0] = f1;
+    f[1] = f2;
+    for (m=0; m<2; m++) {		/* multiplier cr + i ci */
+      cr[m] = ci[m] = 0.0;
+      if (f[m] == NULL || f[m]->order == 0) continue;
+      if (f[m]->order == 1)
+	ci[m] =  f[m]->scale * kk[f[m]->a] / k2;
+      else
+	cr[m] = -f[m]->scale * kk[f[m]->a] * kk[f[m]->b] / k2;
+    }
+    /* F1 = (cr0 + i ci0) dk,  i F2 = (-ci1 + i cr1) dk */
+    work[2*l]   = (cr[0]-ci[1])*dk[2*l] - (ci[0]+cr[1])*dk[2*l+1];
+    work[2*l+1] = (cr[0]-ci[1])*dk[2*l+1] + (ci[0]+cr[1])*dk[2*l];
+  }
+}
+
+void mklpt(int seed)
+{
+  int n = getiparam("nmesh"), lpt = getiparam("lpt");
+  long ncell, l;
+  real boxl = getdparam("box"), z = hasvalue("z") ? getdparam("z") : 0.0;
+  real a, d1, d2, f1, f2, om_a, hub, kf, vol, mass_i, sum1, sum2;
+  double *dk, *work, *src = NULL;
+  lptfield fx, fy, fz;
+
+  omegam = getdparam("omegam");
+  omegal = getdparam("omegal");
+  if (n < 2 || (n & (n-1))) error("nmesh=%d must be a power of 2", n);
+  if (lpt < 1 || lpt > 2) error("lpt=%d must be 1 or 2", lpt);
+  if ((double)n*n*n > 2147483647.0) error("nmesh=%d too large for nbody", n);
+  read_power(getparam("power"));
+
+  ncell = (long)n*n*n;
+  nbody = ncell;
+  kf = TWO_PI/boxl;
+  vol = boxl*boxl*boxl;
+  a = 1.0/(1.0+z);
+  d1 = growth(a)/growth(1.0);
+  om_a = omegam/(a*a*a)/sqr(hubble_e(a));
+  d2 = -3.0/7.0 * d1*d1 * pow(om_a, -1.0/143.0);
+  f1 = growth_rate(a);
+  f2 = 2.0 * pow(om_a, 6.0/11.0);
+  hub = 100.0*hubble_e(a);
+  mass_i = RHOCRIT*omegam*vol/ncell;
+  dprintf(1,"a=%g D1=%g D2=%g f1=%g f2=%g H=%g mass=%g\n",
+	  a, d1, d2, f1, f2, hub, mass_i);
+
+  dk   = (double *) allocate(2*ncell*sizeof(double));
+  work = (double *) allocate(2*ncell*sizeof(double));
+  btab = (Body *) allocate(nbody*sizeof(Body));
+
+  /* white noise, scaled to the power spectrum at z=0 in k-space */
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+  for (l=0; l<ncell; l++) {
+    crandom_state cr;
+
+    init_crandom(&cr, (unsigned int) seed, l);
+    dk[2*l]   = cgrandom(&cr, 0.0, 1.0);
+    dk[2*l+1] = 0.0;
+  }
+  fft3(dk, n, -1);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+  for (l=0; l<ncell; l++) {
+    int ix = l/((long)n*n), iy = (l/n)%n, iz = l%n;
+    real k = kf*sqrt(sqr(kvalue(ix,n,1.0))+sqr(kvalue(iy,n,1.0))+sqr(kvalue(iz,n,1.0)));
+    real amp = sqrt(power(k)/(vol*ncell));
+
+    dk[2*l]   *= amp;
+    dk[2*l+1] *= amp;
+  }
+
+  /* first order: Psi1 into Pos; and Psi1_x,x for the source */
+  fx.order = fy.order = fz.order = 1;
+  fx.a = 0;  fy.a = 1;  fz.a = 2;
+  fx.scale = fy.scale = fz.scale = 1.0;
+  lpt_fill(dk, work, n, kf, &fx, &fy);
+  fft3(work, n, 1);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+  for (l=0; l<ncell; l++) {
+    Pos(btab+l)[0] = work[2*l];
+    Pos(btab+l)[1] = work[2*l+1];
+  }
+  if (lpt > 1) {
+    lptfield pxx = {2,0,0,1.0}, pyy = {2,1,1,1.0}, pzz = {2,2,2,1.0};
+    lptfield pxy = {2,0,1,1.0}, pxz = {2,0,2,1.0}, pyz = {2,1,2,1.0};
+
+    src = (double *) allocate(ncell*sizeof(double));
+    lpt_fill(dk, work, n, kf, &fz, &pxx);
+    fft3(work, n, 1);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (l=0; l<ncell; l++) {
+      Pos(btab+l)[2] = work[2*l];
+      src[l] = work[2*l+1];
+    }
+    lpt_fill(dk, work, n, kf, &pyy, &pzz);		/* diagonal terms */
+    fft3(work, n, 1);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (l=0; l<ncell; l++)
+      src[l] = src[l]*(work[2*l]+work[2*l+1]) + work[2*l]*work[2*l+1];
+    lpt_fill(dk, work, n, kf, &pxy, &pxz);		/* off-diagonal terms */
+    fft3(work, n, 1);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (l=0; l<ncell; l++)
+      src[l] -= sqr(work[2*l]) + sqr(work[2*l+1]);
+    lpt_fill(dk, work, n, kf, &pyz, NULL);
+    fft3(work, n, 1);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (l=0; l<ncell; l++) {
+      src[l] -= sqr(work[2*l]);
+      dk[2*l]   = src[l];				/* delta(k) is done */
+      dk[2*l+1] = 0.0;
+    }
+    free(src);
+    fft3(dk, n, -1);
+
+    /* second order: Psi2 = -i k/k^2 S(k), into Vel */
+    fx.scale = fy.scale = fz.scale = -1.0/ncell;
+    lpt_fill(dk, work, n, kf, &fx, &fy);
+    fft3(work, n, 1);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (l=0; l<ncell; l++) {
+      Vel(btab+l)[0] = work[2*l];
+      Vel(btab+l)[1] = work[2*l+1];
+    }
+    lpt_fill(dk, work, n, kf, &fz, NULL);
+    fft3(work, n, 1);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (l=0; l<ncell; l++)
+      Vel(btab+l)[2] = work[2*l];
+  } else {
+    lpt_fill(dk, work, n, kf, &fz, NULL);
+    fft3(work, n, 1);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (l=0; l<ncell; l++) {
+      Pos(btab+l)[2] = work[2*l];
+      CLRV(Vel(btab+l));
+    }
+  }
+  free(work);
+  free(dk);
+
+  /* move the lattice: Pos holds Psi1, Vel holds Psi2 */
+  sum1 = sum2 = 0.0;
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static) reduction(+:sum1,sum2)
+#endif
+  for (l=0; l<ncell; l++) {
+    Body *b = btab + l;
+    int k, iq[3];
+    real x, psi1, psi2;
+
+    iq[0] = l/((long)n*n);
+    iq[1] = (l/n)%n;
+    iq[2] = l%n;
+    Mass(b) = mass_i;
+    for (k=0; k<NDIM; k++) {
+      psi1 = Pos(b)[k];
+      psi2 = Vel(b)[k];
+      sum1 += sqr(d1*psi1);
+      sum2 += sqr(d2*psi2);
+      x = fmod(iq[k]*boxl/n + d1*psi1 + d2*psi2, boxl);
+      Pos(b)[k] = x < 0 ? x + boxl : x;
+      Vel(b)[k] = a*hub*(f1*d1*psi1 + f2*d2*psi2);
+    }
+  }
+  dprintf(0,"rms displacement: %g (1st order) %g (2nd order) Mpc/h, mean spacing %g\n",
+	  sqrt(sum1/nbody), sqrt(sum2/nbody), boxl/n);
+  tsnap = a;
+  Qtime = TRUE;
+}
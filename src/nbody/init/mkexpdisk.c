@@ -10,6 +10,7 @@
  *      29-may-01       Add time      PJT
  *       8-sep-01       gsl/xrandom
  *      16-apr-09       clean up Z distribution, add zmode=     pjt
+ *      19-oct-26  V1.4 crandom= for parallel, thread count independent, disks  pjt
  *
  */
 
@@ -24,6 +25,7 @@
 #include <snapshot/put_snap.c>
 
 #include <spline.h>
+#include <crandom.h>
 
 string defv[] = {	/* DEFAULT INPUT PARAMETERS */
     "out=???\n		  output file name ",
@@ -41,7 +43,8 @@ string defv[] = {	/* DEFAULT INPUT PARAMETERS */
     "tab=f\n		  table output also? ",
     "zerocm=t\n           center the snapshot?",
     "headline=\n	  text headline for output ",
-    "VERSION=1.3a\n	  9-oct-2022 PJT",
+    "crandom=f\n          counter-based random numbers, one stream per body (parallel)",
+    "VERSION=1.4\n	  19-oct-2026 PJT",
     NULL,
 };
 
@@ -59,7 +62,7 @@ local Body *disktab;
 
 local real gdisk(real);
 local void inittables(void);
-local void makedisk(void);
+local void makedisk(int seed, bool cr);
 local void centersnap(Body *btab, int nb);
 local void writesnap(string name, string headline);
 
@@ -81,7 +84,7 @@ void nemo_main()
     seed = init_xrandom(getparam("seed"));
     Qtab = getbparam("tab");
     inittables();
-    makedisk();
+    makedisk(seed, getbparam("crandom"));
     writesnap(getparam("out"), getparam("headline"));
 }
 
@@ -135,36 +138,54 @@ local real gdisk(real rad)
 	      (bessi0(x) * bessk0(x) - bessi1(x) * bessk1(x));
 }
 
-local void makedisk()
+/*
+ * with cr each body draws from its own stream of crandom(), and the bodies
+ * are made in parallel, unless a table is also needed
+ */
+
+#define XRANDOM(a,b)  (cr ? crandom(&crs,a,b) : xrandom(a,b))
+#define GRANDOM(m,s)  (cr ? cgrandom(&crs,m,s) : grandom(m,s))
+#define FRANDOM(a,b,f) (cr ? frandom_inv(crandom(&crs,0.0,1.0),a,b,f) : frandom(a,b,f))
+
+local void makedisk(int seed, bool cr)
 {
     Body *bp;
     int i, nzero=0;
     real mdsk_i, rad_i, theta_i, vcir_i, omega, Aoort, kappa;
-    real mu, sig_r, sig_t, sig_z, vrad_i, veff_i, vorb_i;
+    real mu, sig_r, sig_t, sig_z, vrad_i, veff_i, vorb_i, Q_i;
     real z1;
     static bool first = TRUE;
+    crandom_state crs;
 
     disktab = (Body *) allocate(ndisk * sizeof(Body));
-    for (bp = disktab, i = 0; i < ndisk; bp++, i++) {
+    if (cr && zmode==2) (void) frandom_inv(0.5, 0.0, 10.0, mysech2);
+    if (cr && zmode==3) (void) frandom_inv(0.5, 0.0, 10.0, myexp);
+#if defined(_OPENMP)
+#pragma omp parallel for if(cr && !Qtab) schedule(static) reduction(+:nzero) \
+    private(bp,crs,mdsk_i,rad_i,theta_i,vcir_i,omega,Aoort,kappa,mu,sig_r,sig_t,sig_z,vrad_i,veff_i,vorb_i,Q_i,z1)
+#endif
+    for (i = 0; i < ndisk; i++) {
+        bp = disktab + i;
+        if (cr) init_crandom(&crs, (unsigned int) seed, i);
 	Mass(bp) = mdsk[NTAB-1] / ndisk;
 	mdsk_i = mdsk[NTAB-1] * ((real) i + 1.0) / ndisk;
 	rad_i = seval(mdsk_i, &mdsk[0], &rdsk[0], &rdsk[NTAB], NTAB);
-	theta_i = xrandom(0.0, TWO_PI);
+	theta_i = XRANDOM(0.0, TWO_PI);
 	Pos(bp)[0] = rad_i * sin(theta_i);		/* assign positions */
 	Pos(bp)[1] = rad_i * cos(theta_i);
 	if (zmode==0) 
-	  Pos(bp)[2] = grandom(0.0, 0.5 * z0);          /* gauss */
+	  Pos(bp)[2] = GRANDOM(0.0, 0.5 * z0);          /* gauss */
 	else if (zmode==1) {
-	  z1 = xrandom(-1.0,1.0);
+	  z1 = XRANDOM(-1.0,1.0);
 	  Pos(bp)[2] = log(1-ABS(z1)) * z0;             /* exp */
 	  if (z1<0) Pos(bp)[2] = -Pos(bp)[2]; 
 	} else if (zmode==2) {
-	  z1 = frandom(0.0,10.0,mysech2) * z0;          /* sech^2 */
-	  if (xrandom(-1.0,1.0) < 0) z1 = -z1;
+	  z1 = FRANDOM(0.0,10.0,mysech2) * z0;          /* sech^2 */
+	  if (XRANDOM(-1.0,1.0) < 0) z1 = -z1;
 	  Pos(bp)[2] = z1;
 	} else if (zmode==3) {
-	  z1 = frandom(0.0,10.0,myexp) * z0;            /* exp */
-	  if (xrandom(-1.0,1.0) < 0) z1 = -z1;
+	  z1 = FRANDOM(0.0,10.0,myexp) * z0;            /* exp */
+	  if (XRANDOM(-1.0,1.0) < 0) z1 = -z1;
 	  Pos(bp)[2] = z1;
 	} else
 	  error("zmode=%d not supported yet",zmode);
@@ -177,19 +198,20 @@ local void makedisk()
 	    printf("rad_i, omega, Aoort = %f %f %f\n", rad_i, omega, Aoort);
 	kappa = 2 * sqrt(omega*omega - Aoort * omega);
 	mu = alpha*alpha * mdisk * exp(- alpha * rad_i) / TWO_PI;
+	Q_i = Qtoomre;
 	if (cmode==1) {                 /* Straight from Josh - mkbaredisk*/
-	   sig_r = 3.358 * Qtoomre * mu / kappa;
+	   sig_r = 3.358 * Q_i * mu / kappa;
 	   sig_t = 0.5 * sig_r * kappa / omega;
 	   sig_z = 0.5 * sig_r;
 	} else if (cmode==2) {
 	   sig_z = sqrt(PI * mu * z0);          /* isothermal sech sheet */
            sig_r = 2.0 * sig_z;                 /* with constant scaleheight */
-           Qtoomre = sig_r * kappa / (3.358 * mu);  /* See vdKruit/Searle */
+           Q_i = sig_r * kappa / (3.358 * mu);        /* See vdKruit/Searle */
 	   sig_t = 0.5 * sig_r * kappa / omega;
         } else
 	    error("illegal mode=%d",cmode);
 
-	vrad_i = grandom(0.0, sig_r);
+	vrad_i = GRANDOM(0.0, sig_r);
 	if (gammas > 0.0) 			/* Josh' method: averaged */
 	   veff_i = (vcir_i*vcir_i +
 			(gammas - 3*alpha*rad_i) * sig_r*sig_r);
@@ -201,12 +223,12 @@ local void makedisk()
             veff_i = 0.0;
         } else
             veff_i = sqrt(veff_i);
-	vorb_i = veff_i + grandom(0.0, sig_t);
+	vorb_i = veff_i + GRANDOM(0.0, sig_t);
 	Vel(bp)[0] =				/* assign velocities */
 	  (vrad_i * Pos(bp)[0] + vorb_i * Pos(bp)[1]) / rad_i;
 	Vel(bp)[1] =
 	  (vrad_i * Pos(bp)[1] - vorb_i * Pos(bp)[0]) / rad_i;
-	Vel(bp)[2] = grandom(0.0, sig_z);
+	Vel(bp)[2] = GRANDOM(0.0, sig_z);
 	if (Qtab) {
 	  if (first) {
 	    first = FALSE;
@@ -214,7 +236,7 @@ local void makedisk()
 	  }
 	  printf ("%g %g %g %g %g %g %g %g %g %g %g %g %g %g %g\n",
             rad_i,mdsk_i,vcir_i,omega,kappa,Aoort,mu,sig_r,sig_t,sig_z,veff_i,
-            Qtoomre,
+            Q_i,
             sig_t/sig_r,sig_z/sig_r,
             1.5-(sqr(sig_t) + 0.5*sqr(sig_z))/sqr(sig_r) );
         }
@@ -18,6 +18,7 @@
  *      9-sep-01    gsl/xrandom
  *     27-mar-03    fixed double/float usage or qromb (it never worked before)
  *     15-may-23    potentials negative now, added mfrac= and rfrac=
+ *     19-oct-26    icdf=: speeds from tables of f(E) per potential, no rejection
  *
  * MH97: For Hernquist models, we adopted a kind of 'quiet start' in which particle i is initially placed
  *       in an arbitrary position on a sphere with a radius corresponding to the Lagrangian mass (i [ 0.5)/N.
@@ -35,6 +36,7 @@
 #include <snapshot/put_snap.c>
 
 #include <nr.h>   // float qromb(float (*func)(float), float a, float b);
+#include <sampling.h>
 
 
 string  defv[] = {     
@@ -48,7 +50,8 @@ string  defv[] = {
     "rfrac=\n                 If used, radius out to which Hernquist model is sampled",
     "zerocm=t\n               Centrate snapshot (t/f)?",
     "headline=\n              Optional verbiage",
-    "VERSION=1.2\n            16-may-2023 PJT",
+    "icdf=f\n                 Speeds from tables of the distribution function instead of rejection",
+    "VERSION=1.3\n            19-oct-2026 PJT",
     NULL,
 };
 
@@ -72,6 +75,7 @@ double rad(double eta), f(double E2), drho2_d(double u), pot(double r),
        radpsi(double p), radmass(double m), rho1(double r), rho2(double r);
 void   cofm(bool Q);
 float  drho2(float u);
+void   tabvel(double *psi);
 
 
 void nemo_main()
@@ -82,6 +86,8 @@ void nemo_main()
 	double fmax, f0, f1, v2, vmax, vmax2;
         bool Qcenter = getbparam("zerocm");
         bool Qphi = getbparam("addphi");
+        bool Qicdf = getbparam("icdf");
+        double *psitab = NULL;
         stream outstr = stropen(getparam("out"),"w");
         int seed = init_xrandom(getparam("seed"));
 	double mfrac;
@@ -107,6 +113,7 @@ void nemo_main()
 	b = a - 1;
 
 	btab = (Body *) allocate(2*nobj*sizeof(Body));
+	if (Qicdf) psitab = (double *) allocate(2*nobj*sizeof(double));
 	double rmax = 0.0;
 
 	for(i=0, bp=btab; i<2*nobj; i++, bp++) {
@@ -135,6 +142,10 @@ void nemo_main()
 
 		psi0 = -pot(radius);
                 if (Qphi) Phi(bp) = -psi0;
+		if (Qicdf) {                     /* speeds later, from tables */
+		  psitab[i] = psi0;
+		  continue;
+		}
 		vmax2 = 2.0*psi0;
 		vmax = sqrt(vmax2);
 		fmax = f(psi0);
@@ -158,6 +169,10 @@ void nemo_main()
 		Vel(bp)[1] = vy;
 		Vel(bp)[2] = vz;
         } 
+	if (Qicdf) {
+	  tabvel(psitab);
+	  free(psitab);
+	}
 	mg = 1.0/nobj;
 	mh = mu/nobj;
 	for(i=0, bp=btab; i<2*nobj; i++, bp++) {
@@ -177,6 +192,54 @@ void nemo_main()
         strclose(outstr);
 }
 
+// speed distribution, with q=v/vmax, at relative potential psi: q^2 f(E)
+local double g_q(double q, double psi, void *arg)
+{
+	double e = psi*(1.0-q*q);
+
+	return e > 0.0 ? q*q*f(e) : 0.0;         /* f(0)=0, and qromb fails there */
+}
+
+#define NPSI 100     /* potential rows of the speed tables, log spaced in radius */
+#define NSPD 129     /* speeds per row */
+
+// speeds for both components from tables, given the relative potential psi of each body
+void tabvel(double *psi)
+{
+	cdist_table *vt;
+	double y[NPSI], r, rmin, rmax, *u, *q, vmax, phi, cth, sth;
+	int i, c;
+
+	rmin = 1e-4 * MIN(1.0, a);
+	rmax = 1e4 * MAX(1.0, a);
+	for (i=0; i<NPSI; i++) {                 /* psi increasing: from rmax in */
+		r = rmax * pow(rmin/rmax, (double)i/(NPSI-1));
+		y[i] = -pot(r);
+	}
+	u = (double *) allocate(3*nobj*sizeof(double));
+	q = (double *) allocate(nobj*sizeof(double));
+	for (c=0; c<2; c++) {                    /* galaxy, then halo */
+		if (c == 1 && mu == 0.0) break;
+		galaxy = (c == 0);
+		vt = cdist_create(NPSI, y, NSPD, g_q, NULL);
+		for (i=0; i<3*nobj; i++)
+			u[i] = xrandom(0.0,1.0);
+		cdist_eval_n(vt, nobj, psi + c*nobj, u, q);
+		for (i=0, bp=btab+c*nobj; i<nobj; i++, bp++) {
+			vmax = sqrt(2.0*psi[c*nobj+i]);
+			phi = xrandom(0.0,2*M_PI);
+			cth = xrandom(-1.0,1.0);
+			sth = sqrt(1.0 - cth*cth);
+			Vel(bp)[0] = (real) (q[i]*vmax*sth*cos(phi));
+			Vel(bp)[1] = (real) (q[i]*vmax*sth*sin(phi));
+			Vel(bp)[2] = (real) (q[i]*vmax*cth);
+		}
+		cdist_free(vt);
+	}
+	free(u);
+	free(q);
+}
+
 // radius belonging to a mass fraction
 double rad(double eta)
 {
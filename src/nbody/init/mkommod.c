@@ -14,6 +14,7 @@
  *	21-jul-97       a MXTB is now 1024, from 512	  pjt
  *       1-apr-01       b fixed some compiler warnings    pjt 
  *       9-sep-01       c gsl/xrandom
+ *      19-oct-26   V2.1  icdf=: sample r(M) and speeds from tables  PJT
  */
 
 #include <stdinc.h>
@@ -27,6 +28,7 @@
 #include <snapshot/put_snap.c>
 
 #include <spline.h>
+#include <sampling.h>
 
 string defv[] = {
     "in=???\n			  file with tables of mass, ... vs radius",
@@ -38,7 +40,8 @@ string defv[] = {
     "nmodel=1\n			  number of copies to generate",
     "headline=\n		  random verbiage for output file",
     "epsilon=1.0e-10\n		  roundoff control parameter",
-    "VERSION=2.0c\n		  9-feb-2024 PJT",
+    "icdf=f\n			  sample from inverse-CDF/alias tables instead of rejection",
+    "VERSION=2.1\n		  19-oct-2026 PJT",
     NULL,
 };
 
@@ -68,6 +71,7 @@ local Body *btab = NULL;		/* pointer to array of bodies        */
 
 local int count1=0, count2=0;		/* counters fo vnpick 		     */
 local real epsilon;			/* roundoff controll		     */
+local bool Qicdf;			/* sample from tables		     */
 
 extern double xrandom(double,double);
 
@@ -75,6 +79,8 @@ local real rad_m(real), phi_r(real), pickspeed(void);
 local real g_v(real), f_e(real), vnpick(rproc, real, real, real, string);
 local void readmodel(string);
 local void anisomod(void);
+local void tabpick(real);
+local void squeeze(Body *, real);
 local void initgmax(void);
 local void snapcenter(void);
 local void snapwrite(stream);
@@ -90,6 +96,7 @@ void nemo_main()
     nbody = getiparam("nbody");
     if (nbody < 1) error("nbody=%d is absurd",nbody);
     epsilon = getdparam("epsilon");
+    Qicdf = getbparam("icdf");
 	
     btab = (Body *) allocate(nbody * sizeof(Body));
     						/* allocate body array      */
@@ -108,7 +115,8 @@ void nemo_main()
 	snapwrite(outstr);
     }
     strclose(outstr);
-    dprintf(1,"vnpick: von Neumann rejection %d/%d = %g\n",
+    if (count1 > 0)
+	dprintf(1,"vnpick: von Neumann rejection %d/%d = %g\n",
 		count2,count1, (real)count2/(real)count1);
 }
 
@@ -154,14 +162,19 @@ local real phix;		/* for pickspeed and g_v */
 
 local void anisomod(void)
 {
-    real ftrun, x, rx, vx, svt, vr;
-    vector vrad;
+    real ftrun, x, rx, vx;
     Body *bp;
 
     ftrun = getdparam("ftrun");			/* get trunc. mass fraction */
     spline(rcof, mtab, rtab, ntab);		/* set up r = r(M)          */
     spline(pcof, rtab, ptab, ntab);		/* set up phi = phi(r)      */
     spline(fcof, ptab, ftab, ntab);		/* set up f = f(Q)          */
+    if (Qicdf) {				/* no rejection needed?     */
+	tabpick(ftrun);
+	if (getbparam("zerocm"))
+	    snapcenter();
+	return;
+    }
     initgmax();					/* initialize gmax(phix)    */
     for (bp = btab; bp < btab + nbody; bp++) {	/* loop over body array     */
 	x = xrandom(mtab[0],ftrun * mtab[ntab-1]); /*   pick mass enclosed  */	
@@ -170,20 +183,98 @@ local void anisomod(void)
 	phix = phi_r(rx);			/*   find potential  at rx  */
 	vx = pickspeed();			/*   pick speed from g(v)   */
 	pickshell(Vel(bp), NDIM, vx);		/*   pick rand velocity vec */
-	if (anisorad > 0.0) {			/*   sqeeze vel distrib?    */
-	    svt = 1.0 / sqrt(1 + sqr(rx / anisorad));
-	    					/*     find trans v. scale  */
-	    vr = dotvp(Vel(bp), Pos(bp)) / rx;	/*     and radial vel comp  */
-	    MULVS(vrad, Pos(bp), vr/rx);	/*     and radial proj of v */
-	    MULVS(Vel(bp), Vel(bp), svt);	/*     scale transverse vel */
-	    MULVS(vrad, vrad, 1.0 - svt);	/*     and radial vel       */
-	    ADDV(Vel(bp), Vel(bp), vrad);	/*     put parts together   */
-	}
+	squeeze(bp, rx);			/*   make anisotropic       */
 	Mass(bp) = mtab[ntab-1] / nbody;	/*   assign equal masses    */
     }
     if (getbparam("zerocm"))			/* zero center of mass?     */
 	snapcenter();
 }
+
+/*
+ * SQUEEZE: make the (isotropic) velocity of a body at radius rx
+ * anisotropic, if an anisotropy radius was given.
+ */
+
+local void squeeze(Body *bp, real rx)
+{
+    real svt, vr;
+    vector vrad;
+
+    if (anisorad > 0.0) {			/* sqeeze vel distrib?      */
+	svt = 1.0 / sqrt(1 + sqr(rx / anisorad));
+						/*   find trans v. scale    */
+	vr = dotvp(Vel(bp), Pos(bp)) / rx;	/*   and radial vel comp    */
+	MULVS(vrad, Pos(bp), vr/rx);		/*   and radial proj of v   */
+	MULVS(Vel(bp), Vel(bp), svt);		/*   scale transverse vel   */
+	MULVS(vrad, vrad, 1.0 - svt);		/*   and radial vel         */
+	ADDV(Vel(bp), Vel(bp), vrad);		/*   put parts together     */
+    }
+}
+
+/*
+ * TABPICK: as the loop in anisomod, but without rejection: the radius
+ * from the inverse of the tabulated M(r), and the speed, in units of the
+ * local escape speed, from tables of g(v) over the potential. Draws are
+ * done in batches over all bodies.
+ */
+
+#define NPHI  128	/* potential rows of the speed tables */
+#define NSPD  257	/* speeds per row */
+
+local double g_q(double q, double phi, void *arg)
+{
+    return q*q * f_e(phi + q*q * (ptab[ntab-1] - phi));
+}
+
+local void tabpick(real ftrun)
+{
+    permanent icdf_table *rtable = NULL;
+    permanent cdist_table *vtable = NULL;
+    double *x, *y, *u, *v, m0, m1;
+    double ygrid[NPHI];
+    int i;
+    Body *bp;
+
+    if (rtable == NULL) {			/* tables once per model    */
+	x = (double *) allocate(ntab*sizeof(double));
+	y = (double *) allocate(ntab*sizeof(double));
+	for (i=0; i<ntab; i++) {
+	    x[i] = rtab[i];
+	    y[i] = mtab[i];
+	}
+	rtable = icdf_create(ntab, x, y, TRUE);	/*   r(M), as is	    */
+	free(x);
+	free(y);
+	for (i=0; i<NPHI; i++)			/*   g(v/vesc) per phi	    */
+	    ygrid[i] = ptab[0] + (i+0.5)*(ptab[ntab-1]-ptab[0])/NPHI;
+	vtable = cdist_create(NPHI, ygrid, NSPD, g_q, NULL);
+    }
+    x = (double *) allocate(nbody*sizeof(double));
+    y = (double *) allocate(nbody*sizeof(double));
+    u = (double *) allocate(3*nbody*sizeof(double));
+    v = (double *) allocate(nbody*sizeof(double));
+    m0 = mtab[0];
+    m1 = mtab[ntab-1];
+    for (i=0; i<nbody; i++)			/* mass fraction enclosed   */
+	u[i] = (xrandom(m0, ftrun*m1) - m0) / (m1 - m0);
+    icdf_eval_n(rtable, nbody, u, x);		/* and its radius           */
+    for (i=0, bp=btab; i<nbody; i++, bp++) {
+	pickshell(Pos(bp), NDIM, x[i]);
+	y[i] = phi_r(x[i]);
+    }
+    for (i=0; i<3*nbody; i++)
+	u[i] = xrandom(0.0, 1.0);
+    cdist_eval_n(vtable, nbody, y, u, v);	/* speed / escape speed     */
+    for (i=0, bp=btab; i<nbody; i++, bp++) {
+	pickshell(Vel(bp), NDIM, v[i] * sqrt(2.0*(ptab[ntab-1] - y[i])));
+	squeeze(bp, x[i]);
+	Mass(bp) = mtab[ntab-1] / nbody;
+    }
+    free(x);
+    free(y);
+    free(u);
+    free(v);
+}
 
 /*
  * INITGMAX: initalize the table used to find gmax(phi).
@@ -20,6 +20,8 @@
  *      22-mar-04       V2.7  merged version with a hole      ncm+pjt
  *      31-mar-05       V2.8  added nmodel=                       pjt
  *      30-may-07       V2.8b allocate() with size_t
+ *      19-oct-26       V3.1  added crandom= for parallel, thread count independent, models  PJT
+ *      19-oct-26       V3.2  added icdf= to pick speeds from a table instead of rejection  PJT
  */
 
 
@@ -34,14 +36,18 @@
 #include <snapshot/body.h>
 #include <snapshot/put_snap.c>
 #include <bodytransc.h>
+#include <crandom.h>
+#include <sampling.h>
 
 #include <moment.h>
 #include <grid.h>
 
 extern rproc  getrfunc();
 Body    *mkplummer();
+local icdf_table *mkqtable(void);
 
 local string headline;		/* random text message */
+local icdf_table *qtable = NULL; /* if used, speed/escape speed table */
 
 #define MAXNGR2 100
 
@@ -66,7 +72,9 @@ string  defv[] = {                        /* DEFAULT INPUT PARAMETERS */
     "headline=\n	      Verbiage for output",
     "nmodel=1\n               number of models to produce",
     "mode=1\n                 0=no data,  1=data, no analysis 2=data, analysis",
-    "VERSION=3.0c\n           6-jun-2024 PJT",
+    "crandom=f\n              Counter-based random numbers, one stream per body (parallel)",
+    "icdf=f\n                 Speeds from an inverse-CDF table instead of rejection",
+    "VERSION=3.2\n            19-oct-2026 PJT",
     NULL,
 };
 
@@ -79,7 +87,7 @@ string usage="construct a Plummer model";
  */
 void nemo_main(void)
 {
-    bool    zerocm;
+    bool    zerocm, Qcr;
     int     nbody, seed, bits, quiet, i, j, n, nmodel, mode;
     real    snap_time, rfrac, mfrac, mlow, mrange[2], scale;
     Body    **btab, *bp;
@@ -108,6 +116,9 @@ void nemo_main(void)
     massname = getparam("massname");
     nmodel = getiparam("nmodel");
     mode = getiparam("mode");
+    Qcr = getbparam("crandom");
+    if (getbparam("icdf"))
+        qtable = mkqtable();
 
     if (nbody < 1) error("Illegal number of bodies: %d",nbody);
     if (mfrac < 0 || mfrac > 1) error("Illegal mfrac=%g",mfrac);
@@ -136,7 +147,7 @@ void nemo_main(void)
 	init_xrandom(sseed);
       }
       btab[i] = mkplummer(nbody, mlow, mfrac, rfrac, seed, snap_time, zerocm, scale,
-			  quiet,mrange,mfunc);
+			  quiet,mrange,mfunc,Qcr);
     }
     
     if (mode > 0) {
@@ -244,6 +255,9 @@ void nemo_main(void)
  *                          snap_time: the time at which the snapshot applies.
  *                          zerocm: logical determining if to center snapshot
  *                          quiet: integer how quiet model should be (0=noisy)
+ *                          cr: if TRUE, body i uses stream i of crandom(),
+ *                              and the bodies are made in parallel; the
+ *                              model is the same for any number of threads
  *                 returns: snap: a pointer to the new snapshot, containing
  *			          a Plummer model in which all particles have
  *			          equal masses.
@@ -254,7 +268,7 @@ void nemo_main(void)
  *-----------------------------------------------------------------------------
  */
 
-Body *mkplummer(nbody, mlow, mfrac, rfrac, seed, snap_time,zerocm,scale,quiet,mr,mf)
+Body *mkplummer(nbody, mlow, mfrac, rfrac, seed, snap_time,zerocm,scale,quiet,mr,mf,cr)
 int   nbody;
 real  mfrac;
 real  mlow;
@@ -266,6 +280,7 @@ real  scale;
 int   quiet;
 real  mr[2];
 rproc mf;
+bool  cr;
 {
     register int  i;
     real  mtot;
@@ -283,6 +298,7 @@ rproc mf;
     vector w_pos, w_vel;        /* temporary storage for c.o.m. calc      */
     Body  *btab;                /* pointer to the snapshot                */
     Body  *bp;                  /* pointer to one particle                */
+    crandom_state crs;          /* stream of one particle if cr           */
 
     if (NDIM != 3)
         error("mkplummer: NDIM = %d but should be 3", NDIM);
@@ -326,33 +342,41 @@ rproc mf;
       warning("New feature: mfrac=%g\n",mfrac);
       
 /*
- *  now we construct the individual particles:
+ *  now we construct the individual particles; with cr each body draws
+ *  from its own stream, and the frandom table is set up before.
  */
-    mtot = 0.0;
-    for (i = 0, bp=btab; i < nbody; i++, bp++) {
+#define XRANDOM(a,b)  (cr ? crandom(&crs,a,b) : xrandom(a,b))
+    if (cr && mf)
+        (void) frandom_inv(0.5, mr[0], mr[1], mf);
+#if defined(_OPENMP)
+#pragma omp parallel for if(cr) schedule(static) private(bp,crs,velocity,theta,phi,x,y,m_min,m_max,m_med) firstprivate(radius)
+#endif
+    for (i = 0; i < nbody; i++) {
+        bp = btab + i;
+        if (cr) init_crandom(&crs, (unsigned int) seed, i);
 	if (mf)     /* if mass spectrum given: */
-	    Mass(bp) = frandom( mr[0], mr[1], mf );
+	    Mass(bp) = cr ? frandom_inv( crandom(&crs,0.0,1.0), mr[0], mr[1], mf )
+	                  : frandom( mr[0], mr[1], mf );
         else        /* else all stars equal mass */
             Mass(bp) = 1.0/ (real) nbody;
-	mtot += Mass(bp);
 /*
  *  the position coordinates are determined by inverting the cumulative
  *  mass-radius relation, with the cumulative mass drawn randomly from
  *  [0, mfrac]; cf. Aarseth et al. (1974), eq. (A2).
  */
         if (quiet==0)
-	    radius = 1.0 / sqrt( pow (xrandom(mlow,mfrac), -2.0/3.0) - 1.0);
+	    radius = 1.0 / sqrt( pow (XRANDOM(mlow,mfrac), -2.0/3.0) - 1.0);
         else if (quiet==1) {
             m_min = (i * mfrac)/nbody;
             m_max = ((i+1) * mfrac)/nbody;
-            radius = 1.0 / sqrt( pow (xrandom(m_min,m_max), -2.0/3.0) - 1.0);
+            radius = 1.0 / sqrt( pow (XRANDOM(m_min,m_max), -2.0/3.0) - 1.0);
         } else if (quiet==2) {
             m_med = ((i+0.5) * mfrac)/nbody;
             radius = 1.0 / sqrt( pow (m_med, -2.0/3.0) - 1.0);
 	} else	
 	    error("Illegal quiet=%d parameter\n",quiet);
-	theta = acos(xrandom(-1.0, 1.0));
-	phi = xrandom(0.0, TWO_PI);
+	theta = acos(XRANDOM(-1.0, 1.0));
+	phi = XRANDOM(0.0, TWO_PI);
 	Pos(bp)[0] = radius * sin( theta ) * cos( phi );
 	Pos(bp)[1] = radius * sin( theta ) * sin( phi );
         Pos(bp)[2] = radius * cos( theta );
@@ -365,6 +389,14 @@ rproc mf;
  */
 	x = 0.0;
 	y = 0.1;
+/*
+ *  With a table for the inverse of the cumulative distribution of g(x)
+ *  one number does it:
+ */
+	if (qtable) {
+	    x = icdf_eval(qtable, XRANDOM(0.0,1.0));
+	    y = 0.0;			/* and skip the loop below */
+	}
 /*
  *  Then we keep spinning the random number generator until we find a pair
  *  of values (x,y), so that y < g(x) = x*x*pow( 1.0 - x*x, 3.5) . Whenever
@@ -373,19 +405,23 @@ rproc mf;
  *  g(x) in [0,1] : 0.1 > max g(x) = 0.092 for 0 < x < 1.
  */
 	while (y > x*x*pow( 1.0 - x*x, 3.5)) {
-	    x = xrandom(0.0,1.0);
-	    y = xrandom(0.0,0.1);
+	    x = XRANDOM(0.0,1.0);
+	    y = XRANDOM(0.0,0.1);
         }
 /*
  *  If y < g(x), proceed to calculate the velocity components:
  */
 	velocity = x * sqrt(2.0) * pow( 1.0 + radius*radius, -0.25);
-	theta = acos(xrandom(-1.0, 1.0));
-	phi = xrandom(0.0,TWO_PI);
+	theta = acos(XRANDOM(-1.0, 1.0));
+	phi = XRANDOM(0.0,TWO_PI);
 	Vel(bp)[0] = velocity * sin( theta ) * cos( phi );
 	Vel(bp)[1] = velocity * sin( theta ) * sin( phi );
 	Vel(bp)[2] = velocity * cos( theta );
     }
+#undef XRANDOM
+    mtot = 0.0;
+    for (i = 0, bp=btab; i < nbody; i++, bp++)
+	mtot += Mass(bp);
     dprintf(1,"Total mass (before scaling) = %g\n",mtot);
 /*
  * Now transform to the VIRIAL coordinates by applying
@@ -419,6 +455,26 @@ rproc mf;
     return btab;               /* snap out of it altogether */
 }
 
+/*
+ *  MKQTABLE: the distribution g(x) = x*x*pow( 1.0 - x*x, 3.5) of the ratio
+ *  of velocity and escape velocity does not depend on radius, so one table
+ *  of its inverse cumulative distribution serves all bodies.
+ */
+
+#define NQTAB 1025
+
+local icdf_table *mkqtable(void)
+{
+    double x[NQTAB], g[NQTAB];
+    int i;
+
+    for (i = 0; i < NQTAB; i++) {
+        x[i] = (double) i / (NQTAB-1);
+        g[i] = x[i]*x[i]*pow( 1.0 - x[i]*x[i], 3.5);
+    }
+    return icdf_create(NQTAB, x, g, FALSE);
+}
+
 /* end of: mkplummer.c */
 
 
@@ -0,0 +1,390 @@
+/*
+ * SNAPCOL.C: columnar (structure of arrays) snapshot I/O
+ *
+ *	get_snap() reads each item into a scratch buffer and scatters it
+ *	into the Body array, put_snap() gathers it back. Here every quantity
+ *	stays in its own contiguous column, only for the columns present in
+ *	the file (and asked for), and most items are read straight into their
+ *	column. A PhaseSpace item is split into the pos and vel columns
+ *	in modest blocks, so no full size scratch buffer is needed either.
+ *	Bodytrans functions can still be evaluated over the columns.
+ *
+ *	19-oct-2026	V1.0 created					PJT
+ */
+
+#include <stdinc.h>
+#include <filestruct.h>
+#include <vectmath.h>
+#include <snapshot/snapcol.h>
+
+#define SC_CHUNK  4096			/* bodies per block of PhaseSpace */
+
+/*
+ * SNAPCOL_INIT: initialize an empty snapshot; must be called once before use
+ */
+
+void snapcol_init(snapcolptr sc)
+{
+    sc->nbody = sc->maxbody = sc->bits = 0;
+    sc->time = 0.0;
+    sc->_mass = sc->_pos = sc->_vel = sc->_phi = sc->_acc = NULL;
+    sc->_aux = sc->_dens = sc->_eps = NULL;
+    sc->_key = NULL;
+}
+
+/*
+ * SNAPCOL_FREE: free all columns, the snapshot can be reused after this
+ */
+
+void snapcol_free(snapcolptr sc)
+{
+    if (sc->_mass) free(sc->_mass);
+    if (sc->_pos)  free(sc->_pos);
+    if (sc->_vel)  free(sc->_vel);
+    if (sc->_phi)  free(sc->_phi);
+    if (sc->_acc)  free(sc->_acc);
+    if (sc->_aux)  free(sc->_aux);
+    if (sc->_key)  free(sc->_key);
+    if (sc->_dens) free(sc->_dens);
+    if (sc->_eps)  free(sc->_eps);
+    snapcol_init(sc);
+}
+
+local void *col_grow(void *col, size_t nbytes)
+{
+    return col ? reallocate(col, nbytes) : NULL;
+}
+
+local void *col_need(void *col, size_t nbytes)
+{
+    return col ? col : allocate(nbytes);
+}
+
+/*
+ * SNAPCOL_ALLOC: set the number of bodies, and make sure the columns
+ *		  given by bits (PosBit, VelBit, ...) are allocated.
+ *		  Existing columns are grown if needed, never shrunk.
+ */
+
+void snapcol_alloc(snapcolptr sc, int nbody, int bits)
+{
+    size_t n;
+
+    if (bits & PhaseSpaceBit) bits |= (PosBit | VelBit);
+    if (nbody > sc->maxbody) {
+        n = nbody;
+        sc->_mass = (real *) col_grow(sc->_mass, n*sizeof(real));
+        sc->_pos  = (real *) col_grow(sc->_pos,  n*NDIM*sizeof(real));
+        sc->_vel  = (real *) col_grow(sc->_vel,  n*NDIM*sizeof(real));
+        sc->_phi  = (real *) col_grow(sc->_phi,  n*sizeof(real));
+        sc->_acc  = (real *) col_grow(sc->_acc,  n*NDIM*sizeof(real));
+        sc->_aux  = (real *) col_grow(sc->_aux,  n*sizeof(real));
+        sc->_key  = (int *)  col_grow(sc->_key,  n*sizeof(int));
+        sc->_dens = (real *) col_grow(sc->_dens, n*sizeof(real));
+        sc->_eps  = (real *) col_grow(sc->_eps,  n*sizeof(real));
+        sc->maxbody = nbody;
+    }
+    n = sc->maxbody;
+    if (bits & MassBit)         sc->_mass = (real *) col_need(sc->_mass, n*sizeof(real));
+    if (bits & PosBit)          sc->_pos  = (real *) col_need(sc->_pos,  n*NDIM*sizeof(real));
+    if (bits & VelBit)          sc->_vel  = (real *) col_need(sc->_vel,  n*NDIM*sizeof(real));
+    if (bits & PotentialBit)    sc->_phi  = (real *) col_need(sc->_phi,  n*sizeof(real));
+    if (bits & AccelerationBit) sc->_acc  = (real *) col_need(sc->_acc,  n*NDIM*sizeof(real));
+    if (bits & AuxBit)          sc->_aux  = (real *) col_need(sc->_aux,  n*sizeof(real));
+    if (bits & KeyBit)          sc->_key  = (int *)  col_need(sc->_key,  n*sizeof(int));
+    if (bits & DensBit)         sc->_dens = (real *) col_need(sc->_dens, n*sizeof(real));
+    if (bits & EpsBit)          sc->_eps  = (real *) col_need(sc->_eps,  n*sizeof(real));
+    sc->nbody = nbody;
+}
+
+/*
+ * worker: read a scalar (ndim=0) or vector (ndim=NDIM) real column
+ */
+
+local void get_col(stream instr, snapcolptr sc, string tag, int bit, int want,
+                   real **col, int ndim)
+{
+    if ((want & bit) == 0 || !get_tag_ok(instr, tag))
+        return;
+    snapcol_alloc(sc, sc->nbody, bit);
+    if (ndim)
+        get_data_coerced(instr, tag, RealType, *col, sc->nbody, ndim, 0);
+    else
+        get_data_coerced(instr, tag, RealType, *col, sc->nbody, 0);
+    sc->bits |= bit;
+}
+
+/*
+ * worker: split PhaseSpace[nbody][2][NDIM] into the pos and vel columns
+ */
+
+local void get_phase(stream instr, snapcolptr sc, int want)
+{
+    int i, j, nc, nbody = sc->nbody;
+    real *buf, *bp;
+    string type;
+    bool Qpos = (want & PosBit) != 0, Qvel = (want & VelBit) != 0;
+
+    snapcol_alloc(sc, nbody, want & (PosBit|VelBit));
+    type = get_type(instr, PhaseSpaceTag);
+    if (streq(type, RealType)) {            /* blocked read, no coercion needed */
+        nc = MIN(SC_CHUNK, nbody);
+        buf = (real *) allocate((size_t)nc*2*NDIM*sizeof(real));
+        get_data_set(instr, PhaseSpaceTag, RealType, nbody, 2, NDIM, 0);
+        for (i=0; i<nbody; i+=nc) {
+            nc = MIN(SC_CHUNK, nbody-i);
+            get_data_blocked(instr, PhaseSpaceTag, buf, nc*2*NDIM);
+            for (j=0, bp=buf; j<nc; j++, bp+=2*NDIM) {
+                if (Qpos) SETV(SCPos(sc,i+j), bp);
+                if (Qvel) SETV(SCVel(sc,i+j), bp+NDIM);
+            }
+        }
+        get_data_tes(instr, PhaseSpaceTag);
+    } else {                                /* float <-> double needs it all */
+        dprintf(1,"get_snapcol: coercing %s from %s\n",PhaseSpaceTag,type);
+        buf = (real *) allocate((size_t)nbody*2*NDIM*sizeof(real));
+        get_data_coerced(instr, PhaseSpaceTag, RealType, buf, nbody, 2, NDIM, 0);
+        for (j=0, bp=buf; j<nbody; j++, bp+=2*NDIM) {
+            if (Qpos) SETV(SCPos(sc,j), bp);
+            if (Qvel) SETV(SCVel(sc,j), bp+NDIM);
+        }
+    }
+    free(buf);
+    free(type);
+    if (Qpos) sc->bits |= PosBit;
+    if (Qvel) sc->bits |= VelBit;
+}
+
+/*
+ * GET_SNAPCOL: read the next snapshot into columns. Only the columns
+ *		in want are read (0 means all), PhaseSpaceBit in want
+ *		means both PosBit and VelBit. Returns 0 at EOF.
+ *		sc->bits reports which columns were read; PhaseSpaceBit
+ *		is also set if both positions and velocities were read.
+ */
+
+int get_snapcol(stream instr, snapcolptr sc, int want)
+{
+    int nbody = 0, cs;
+
+    if (want == 0) want = ~0;
+    if (want & PhaseSpaceBit) want |= (PosBit | VelBit);
+    if (!get_tag_ok(instr, SnapShotTag))
+        return 0;
+
+    sc->bits = 0;
+    get_set(instr, SnapShotTag);
+    if (get_tag_ok(instr, ParametersTag)) {
+        get_set(instr, ParametersTag);
+        if (get_tag_ok(instr, NobjTag))
+            get_data(instr, NobjTag, IntType, &nbody, 0);
+        else if (get_tag_ok(instr, NBodyTag))
+            get_data(instr, NBodyTag, IntType, &nbody, 0);
+        else
+            error("get_snapcol: Cannot find Nobj or NBody in snapshot");
+        if (get_tag_ok(instr, TimeTag)) {
+            get_data_coerced(instr, TimeTag, RealType, &sc->time, 0);
+            sc->bits |= TimeBit;
+        }
+        get_tes(instr, ParametersTag);
+    }
+    snapcol_alloc(sc, nbody, 0);
+    if (get_tag_ok(instr, ParticlesTag)) {
+        get_set(instr, ParticlesTag);
+        if (get_tag_ok(instr, CoordSystemTag)) {
+            get_data(instr, CoordSystemTag, IntType, &cs, 0);
+            if (cs != CSCode(Cartesian, NDIM, 2))
+                error("get_snapcol: cant handle %s = %#o", CoordSystemTag, cs);
+        }
+        get_col(instr, sc, MassTag, MassBit, want, &sc->_mass, 0);
+        if ((want & (PosBit|VelBit)) && get_tag_ok(instr, PhaseSpaceTag))
+            get_phase(instr, sc, want);
+        else {
+            get_col(instr, sc, PosTag, PosBit, want, &sc->_pos, NDIM);
+            get_col(instr, sc, VelTag, VelBit, want, &sc->_vel, NDIM);
+        }
+        get_col(instr, sc, PotentialTag,    PotentialBit,    want, &sc->_phi,  0);
+        get_col(instr, sc, AccelerationTag, AccelerationBit, want, &sc->_acc,  NDIM);
+        get_col(instr, sc, AuxTag,          AuxBit,          want, &sc->_aux,  0);
+        if ((want & KeyBit) && get_tag_ok(instr, KeyTag)) {
+            snapcol_alloc(sc, nbody, KeyBit);
+            get_data(instr, KeyTag, IntType, sc->_key, nbody, 0);
+            sc->bits |= KeyBit;
+        }
+        get_col(instr, sc, DensityTag,      DensBit,         want, &sc->_dens, 0);
+        get_col(instr, sc, EpsTag,          EpsBit,          want, &sc->_eps,  0);
+        get_tes(instr, ParticlesTag);
+    }
+    get_tes(instr, SnapShotTag);
+    if ((sc->bits & PosBit) && (sc->bits & VelBit))
+        sc->bits |= PhaseSpaceBit;
+    return 1;
+}
+
+/*
+ * PUT_SNAPCOL: write the columns given in sc->bits as a snapshot.
+ *		With both pos and vel a regular PhaseSpace item is written
+ *		(in blocks), otherwise Position and/or Velocity.
+ */
+
+void put_snapcol(stream outstr, snapcolptr sc)
+{
+    int i, j, nc, nbody = sc->nbody, bits = sc->bits, cs = CSCode(Cartesian, NDIM, 2);
+    real *buf, *bp;
+
+    put_set(outstr, SnapShotTag);
+    put_set(outstr, ParametersTag);
+    put_data(outstr, NobjTag, IntType, &nbody, 0);
+    if (bits & TimeBit)
+        put_data(outstr, TimeTag, RealType, &sc->time, 0);
+    put_tes(outstr, ParametersTag);
+
+    put_set(outstr, ParticlesTag);
+    put_data(outstr, CoordSystemTag, IntType, &cs, 0);
+    if (bits & MassBit)
+        put_data(outstr, MassTag, RealType, sc->_mass, nbody, 0);
+    if ((bits & PosBit) && (bits & VelBit)) {
+        nc = MIN(SC_CHUNK, nbody);
+        buf = (real *) allocate((size_t)nc*2*NDIM*sizeof(real));
+        put_data_set(outstr, PhaseSpaceTag, RealType, nbody, 2, NDIM, 0);
+        for (i=0; i<nbody; i+=nc) {
+            nc = MIN(SC_CHUNK, nbody-i);
+            for (j=0, bp=buf; j<nc; j++, bp+=2*NDIM) {
+                SETV(bp,      SCPos(sc,i+j));
+                SETV(bp+NDIM, SCVel(sc,i+j));
+            }
+            put_data_blocked(outstr, PhaseSpaceTag, buf, nc*2*NDIM);
+        }
+        put_data_tes(outstr, PhaseSpaceTag);
+        free(buf);
+    } else {
+        if (bits & PosBit)
+            put_data(outstr, PosTag, RealType, sc->_pos, nbody, NDIM, 0);
+        if (bits & VelBit)
+            put_data(outstr, VelTag, RealType, sc->_vel, nbody, NDIM, 0);
+    }
+    if (bits & PotentialBit)
+        put_data(outstr, PotentialTag, RealType, sc->_phi, nbody, 0);
+    if (bits & AccelerationBit)
+        put_data(outstr, AccelerationTag, RealType, sc->_acc, nbody, NDIM, 0);
+    if (bits & AuxBit)
+        put_data(outstr, AuxTag, RealType, sc->_aux, nbody, 0);
+    if (bits & KeyBit)
+        put_data(outstr, KeyTag, IntType, sc->_key, nbody, 0);
+    if (bits & DensBit)
+        put_data(outstr, DensityTag, RealType, sc->_dens, nbody, 0);
+    if (bits & EpsBit)
+        put_data(outstr, EpsTag, RealType, sc->_eps, nbody, 0);
+    put_tes(outstr, ParticlesTag);
+    put_tes(outstr, SnapShotTag);
+}
+
+/*
+ * SNAPCOL_BODY: gather body i into a (scratch) Body;
+ *		 absent columns are returned as 0
+ */
+
+void snapcol_body(snapcolptr sc, int i, Body *bp)
+{
+    int bits = sc->bits;
+
+    Mass(bp) = (bits & MassBit) ? SCMass(sc,i) : 0.0;
+    if (bits & PosBit) {
+        SETV(Pos(bp), SCPos(sc,i));
+    } else
+        CLRV(Pos(bp));
+    if (bits & VelBit) {
+        SETV(Vel(bp), SCVel(sc,i));
+    } else
+        CLRV(Vel(bp));
+    Phi(bp)  = (bits & PotentialBit) ? SCPhi(sc,i) : 0.0;
+    if (bits & AccelerationBit) {
+        SETV(Acc(bp), SCAcc(sc,i));
+    } else
+        CLRV(Acc(bp));
+    Aux(bp)  = (bits & AuxBit)  ? SCAux(sc,i)  : 0.0;
+    Key(bp)  = (bits & KeyBit)  ? SCKey(sc,i)  : 0;
+    Dens(bp) = (bits & DensBit) ? SCDens(sc,i) : 0.0;
+    Eps(bp)  = (bits & EpsBit)  ? SCEps(sc,i)  : 0.0;
+}
+
+/*
+ * SNAPCOL_BODYTRANS: evaluate a bodytrans function for all bodies,
+ *		      out[] needs to hold sc->nbody values.
+ *		      Bodies are gathered one at a time in a scratch Body,
+ *		      and done in parallel if compiled with OpenMP.
+ */
+
+void snapcol_bodytrans(snapcolptr sc, btrproc f, real *out)
+{
+    int i;
+    Body b;
+
+#if defined(_OPENMP)
+#pragma omp parallel for private(b) schedule(static)
+#endif
+    for (i=0; i<sc->nbody; i++) {
+        snapcol_body(sc, i, &b);
+        out[i] = (*f)(&b, sc->time, i);
+    }
+}
+
+void snapcol_bodytrans_int(snapcolptr sc, btiproc f, int *out)
+{
+    int i;
+    Body b;
+
+#if defined(_OPENMP)
+#pragma omp parallel for private(b) schedule(static)
+#endif
+    for (i=0; i<sc->nbody; i++) {
+        snapcol_body(sc, i, &b);
+        out[i] = (*f)(&b, sc->time, i);
+    }
+}
+
+
+#ifdef TESTBED
+
+#include <getparam.h>
+#include <history.h>
+#include <bodytrans.h>
+
+string defv[] = {
+    "in=???\n       Input snapshot",
+    "out=\n         Optional output snapshot",
+    "want=0\n       Bits of the columns to read (0=all)",
+    "expr=r\n       Bodytrans expression to evaluate",
+    "VERSION=1.0\n  19-oct-2026 PJT",
+    NULL,
+};
+
+string usage="testing snapcol routines";
+
+void nemo_main(void)
+{
+    stream instr, outstr = NULL;
+    snapcol sc;
+    rproc_body f = btrtrans(getparam("expr"));
+    real *val = NULL;
+    int nsnap = 0, want = getiparam("want");
+
+    instr = stropen(getparam("in"),"r");
+    if (hasvalue("out")) outstr = stropen(getparam("out"),"w");
+    get_history(instr);
+    if (outstr) put_history(outstr);
+    snapcol_init(&sc);
+    while (get_snapcol(instr, &sc, want)) {
+        val = (real *) reallocate(val, sc.maxbody*sizeof(real));
+        snapcol_bodytrans(&sc, f, val);
+        printf("snap %d: nbody=%d time=%g bits=0x%x  %s[0]=%g %s[n-1]=%g\n",
+               nsnap++, sc.nbody, sc.time, sc.bits,
+               getparam("expr"), val[0], getparam("expr"), val[sc.nbody-1]);
+        if (outstr) put_snapcol(outstr, &sc);
+        get_history(instr);
+    }
+    snapcol_free(&sc);
+    strclose(instr);
+    if (outstr) strclose(outstr);
+}
+#endif
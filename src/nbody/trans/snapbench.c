@@ -7,11 +7,13 @@
  *                   (what comment?)
  *     25-feb-2024  ansi cleanup + documented odd behavior            PJT
  *     27-feb-2024  overhaul, just using mode=0,1,2,3                 PJT
+ *     19-oct-2026  mode=4 for columnar snapcol                       PJT
  *
  * mode=0     snapshot I/O but keeping linear arrays
  *      1     body with a bodytrans function
  *      2     body with a Mass(bp)
  *      3     body copy to mass[], and scaling that
+ *      4     columnar snapcol with a bodytrans function
  *
  *  0 and 3 are same speed, super fast;   0 saves on I/O
  *  1 is slowest 
@@ -31,14 +33,15 @@
 #include <bodytrans.h>
 
 #include <snapshot/get_snapshot.c>
+#include <snapshot/snapcol.h>
 
 string defv[] = {
     "in=???\n		      Input (snapshot) file",
     "mass=1\n	              Expression for new masses",
     "iter=10\n                Number of iterations to test",
-    "mode=1\n                 reading input mode (1=body 2=arrays)",
+    "mode=1\n                 reading input mode (0=arrays 1,2,3=body 4=columns)",
     "out=\n                   output (snapshot) file, if needed",
-    "VERSION=2.0a\n           10-mar-2024 PJT",
+    "VERSION=2.1\n            19-oct-2026 PJT",
     NULL,
 };
 
@@ -63,6 +66,7 @@ void nemo_main()
     stream instr, outstr;
     real   tsnap, mscale, *mass = NULL;
     Body  *btab = NULL, *bp;
+    snapcol sc;
     int i, j, nbody, bits;
     rproc  bfunc;
     int mode = getiparam("mode");
@@ -74,6 +78,7 @@ void nemo_main()
     outstr = hasvalue("out") ? stropen(getparam("out"),"w") : NULL;
     get_history(instr);
 
+    snapcol_init(&sc);
     init_timers2(niter,1);
     stamp_timers(0);
     if (mode==0) {
@@ -88,6 +93,16 @@ void nemo_main()
 	for (i=0; i<nbody; i++)
 	  ss.mass[i] += mscale;
       dprintf(2,"final mass: %g\n",ss.mass[0]);
+    } else if (mode==4) {
+      if (get_snapcol(instr, &sc, 0) == 0) return;
+      dprintf(0,"bodytrans scaling on columns, iter=%d\n",niter);
+      bfunc = btrtrans(getparam("mass"));
+      snapcol_alloc(&sc, sc.nbody, MassBit);
+      sc.bits |= MassBit;
+      stamp_timers(1);
+      for (j=0; j<niter; j++)
+	snapcol_bodytrans(&sc, bfunc, SCMassCol(&sc));
+      dprintf(2,"final mass:  %g\n", SCMass(&sc,0));
     } else {
       get_snap(instr, &btab, &nbody, &tsnap, &bits);
       if (mode == 1) {
@@ -126,7 +141,10 @@ void nemo_main()
 
     if (outstr) { 
       put_history(outstr);
-      put_snap(outstr, &btab, &nbody, &tsnap, &bits);
+      if (mode==4)
+	put_snapcol(outstr, &sc);
+      else
+	put_snap(outstr, &btab, &nbody, &tsnap, &bits);
       strclose(outstr);
     }
     stamp_timers(3);
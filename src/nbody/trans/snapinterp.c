@@ -0,0 +1,80 @@
+/*
+ * SNAPINTERP: snapshots at arbitrary times, Hermite interpolated
+ *	       between the snapshots of a run
+ *
+ *	19-oct-26  1.0  created, using get_snap_interp()	PJT
+ */
+
+#include <stdinc.h>
+#include <getparam.h>
+#include <vectmath.h>
+#include <filestruct.h>
+
+#include <snapshot/snapshot.h>
+#include <snapshot/body.h>
+#include <snapshot/get_snap.c>
+#include <snapshot/get_snap_interp.c>
+#include <snapshot/put_snap.c>
+
+string defv[] = {
+    "in=???\n       Input snapshots, in increasing time",
+    "out=???\n      Output snapshots",
+    "times=???\n    Output times, e.g. 0:10:0.1",
+    "maxtimes=100000\n  Maximum number of output times",
+    "VERSION=1.0\n  19-oct-2026 PJT",
+    NULL,
+};
+
+string usage="Hermite interpolate snapshots to arbitrary times";
+
+
+local int cmp_real(const void *a, const void *b)
+{
+    real ra = *(real *)a, rb = *(real *)b;
+
+    return ra < rb ? -1 : (ra > rb ? 1 : 0);
+}
+
+void nemo_main()
+{
+    stream instr, outstr;
+    real   *times, tsnap;
+    int    i, ntimes, maxtimes, nbody, bits, nout = 0, nskip = 0, ret;
+    Body   *btab = NULL;
+
+    maxtimes = getiparam("maxtimes");
+    times = (real *) allocate(maxtimes * sizeof(real));
+    ntimes = nemoinpr(getparam("times"), times, maxtimes);
+    if (ntimes < 0) error("Error %d parsing times=, or more than maxtimes=%d",
+			  ntimes, maxtimes);
+    for (i=1; i<ntimes; i++)
+	if (times[i] < times[i-1]) {
+	    warning("times= not increasing, sorting them");
+	    qsort(times, ntimes, sizeof(real), cmp_real);
+	    break;
+	}
+
+    instr = stropen(getparam("in"), "r");
+    get_history(instr);
+    outstr = stropen(getparam("out"), "w");
+    put_history(outstr);
+
+    for (i=0; i<ntimes; i++) {
+	ret = get_snap_interp(instr, &btab, &nbody, times[i], &bits);
+	if (ret == 0) break;
+	if (ret < 0) {
+	    nskip++;
+	    continue;
+	}
+	tsnap = times[i];
+	put_snap(outstr, &btab, &nbody, &tsnap, &bits);
+	nout++;
+    }
+    if (nskip)
+	warning("%d times before the first snapshot skipped", nskip);
+    if (nout < ntimes-nskip)
+	warning("%d times beyond the last snapshot skipped", ntimes-nskip-nout);
+    dprintf(1,"Wrote %d snapshots\n", nout);
+    strclose(outstr);
+    strclose(instr);
+}
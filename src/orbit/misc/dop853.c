@@ -28,7 +28,7 @@ long nstepRead8 (void)
 } /* stepRead */
 
 
-long naccptRead (void)
+long naccptRead8 (void)
 {
   return naccpt;
 
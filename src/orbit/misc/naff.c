@@ -0,0 +1,238 @@
+/*
+ * NAFF.C: Numerical Analysis of Fundamental Frequencies (Laskar 1990, 1993)
+ *
+ *   Given a complex time series f(t) = x(t) + i y(t), sampled at n equidistant
+ *   times t_j = j*dt, find the quasi-periodic decomposition
+ *
+ *		f(t) = sum_k  a_k exp(i w_k t)
+ *
+ *   Each frequency is found by locating the peak of the Hanning windowed
+ *   FFT, refining it by maximizing |<f,exp(iwt)>| with a golden section
+ *   search within one bin, after which the new term is orthogonalized
+ *   against the previous ones (Gram-Schmidt) and subtracted from f.
+ *   Amplitudes are the projections back onto the (non-orthogonal) basis
+ *   exp(i w_k t).
+ *
+ *   All work space is local, so naff() can be called from multiple
+ *   threads at the same time (see orbnaff).
+ *
+ *   19-oct-2026   V1.0  created for orbnaff                            PJT
+ */
+
+#include <stdinc.h>
+#include <fft.h>
+#include <naff.h>
+
+#define NGOLDEN 64
+
+/* weighted inner product <f,g> = sum w f conj(g) / sum w */
+
+local void naff_dot(int n, double *w, double *f, double *g, double *pr, double *pi)
+{
+    int j;
+    double sr = 0.0, si = 0.0;
+
+    for (j=0; j<n; j++) {
+        sr += w[j]*(f[2*j]*g[2*j]   + f[2*j+1]*g[2*j+1]);
+        si += w[j]*(f[2*j+1]*g[2*j] - f[2*j]*g[2*j+1]);
+    }
+    *pr = sr;
+    *pi = si;
+}
+
+/* |<f,exp(i omega t)>|^2, with the exponential done by recurrence */
+
+local double naff_power(int n, double *w, double *f, double omega, double dt)
+{
+    int j;
+    double c = 1.0, s = 0.0, cd = cos(omega*dt), sd = sin(omega*dt), tmp;
+    double sr = 0.0, si = 0.0;
+
+    for (j=0; j<n; j++) {
+        sr += w[j]*(f[2*j]*c   + f[2*j+1]*s);
+        si += w[j]*(f[2*j+1]*c - f[2*j]*s);
+        tmp = c*cd - s*sd;
+        s   = s*cd + c*sd;
+        c   = tmp;
+    }
+    return sr*sr + si*si;
+}
+
+/*
+ * NAFF: returns the number of frequencies found (<= nfreq)
+ *	int n              number of samples
+ *	double dt          sampling interval
+ *	double re[n],im[n] real and imaginary part of the signal (not modified)
+ *	int nfreq          max number of frequencies to find
+ *	double freq[]      angular frequencies found (output)
+ *	double ampr[]      real part of the complex amplitudes (output, or NULL)
+ *	double ampi[]      imaginary part of the complex amplitudes (output, or NULL)
+ */
+
+int naff(int n, double dt, double *re, double *im,
+         int nfreq, double *freq, double *ampr, double *ampi)
+{
+    int i, j, k, l, npad, jmax, nfound = 0;
+    double *w, *f, *fpad, *u, *ar, *ai, *cr, *ci;
+    double wsum, p, pmax, p0, omega, domega, a, b, x1, x2, p1, p2, pr, pi, norm, tmp;
+    const double gr = 0.5*(sqrt(5.0)-1.0);
+
+    if (n < 4 || nfreq < 1) return 0;
+    npad = fft_next2(n);
+    w    = (double *) allocate(n*sizeof(double));
+    f    = (double *) allocate(2*n*sizeof(double));
+    fpad = (double *) allocate(2*npad*sizeof(double));
+    u    = (double *) allocate(2*n*nfreq*sizeof(double));   /* orthonormal basis */
+    ar   = (double *) allocate(nfreq*nfreq*sizeof(double)); /* u_k = sum A_kl e_l */
+    ai   = (double *) allocate(nfreq*nfreq*sizeof(double));
+    cr   = (double *) allocate(nfreq*sizeof(double));       /* <f,u_k> */
+    ci   = (double *) allocate(nfreq*sizeof(double));
+
+    for (j=0, wsum=0.0; j<n; j++) {             /* Hanning window, 1+cos(pi tau) */
+        w[j] = 1.0 + cos(PI*(2.0*j/(n-1) - 1.0));
+        wsum += w[j];
+    }
+    for (j=0; j<n; j++) {
+        w[j] /= wsum;
+        f[2*j]   = re[j];
+        f[2*j+1] = im ? im[j] : 0.0;
+    }
+    domega = TWO_PI/(npad*dt);
+    for (j=0, p0=0.0; j<n; j++)
+        p0 += w[j]*(sqr(f[2*j]) + sqr(f[2*j+1]));
+
+    for (k=0; k<nfreq && p0>0; k++) {           /* p0=0: no signal, e.g. z in a planar orbit */
+        for (j=0; j<n; j++) {                   /* coarse peak from the FFT */
+            fpad[2*j]   = w[j]*f[2*j];
+            fpad[2*j+1] = w[j]*f[2*j+1];
+        }
+        for (j=2*n; j<2*npad; j++)
+            fpad[j] = 0.0;
+        fft_cplx(fpad, npad, -1);
+        for (j=0, jmax=0, pmax=-1.0; j<npad; j++) {
+            p = sqr(fpad[2*j]) + sqr(fpad[2*j+1]);
+            if (p > pmax) { pmax = p; jmax = j; }
+        }
+        omega = (jmax < npad/2 ? jmax : jmax-npad) * domega;
+
+        a = omega - domega;                     /* golden section refinement */
+        b = omega + domega;
+        x1 = b - gr*(b-a);
+        x2 = a + gr*(b-a);
+        p1 = naff_power(n, w, f, x1, dt);
+        p2 = naff_power(n, w, f, x2, dt);
+        for (i=0; i<NGOLDEN; i++) {
+            if (p1 > p2) {
+                b = x2;  x2 = x1;  p2 = p1;
+                x1 = b - gr*(b-a);
+                p1 = naff_power(n, w, f, x1, dt);
+            } else {
+                a = x1;  x1 = x2;  p1 = p2;
+                x2 = a + gr*(b-a);
+                p2 = naff_power(n, w, f, x2, dt);
+            }
+        }
+        omega = 0.5*(a+b);
+        p = naff_power(n, w, f, omega, dt);
+        if (p < 1e-28*p0)                       /* nothing left in the signal */
+            break;
+
+        for (j=0; j<n; j++) {                   /* e_k = exp(i omega t) */
+            u[2*(k*n+j)]   = cos(omega*j*dt);
+            u[2*(k*n+j)+1] = sin(omega*j*dt);
+        }
+        for (l=0; l<k; l++)
+            ar[k*nfreq+l] = ai[k*nfreq+l] = 0.0;
+        ar[k*nfreq+k] = 1.0;
+        ai[k*nfreq+k] = 0.0;
+        for (i=0; i<k; i++) {                   /* Gram-Schmidt: e_k - sum <e_k,u_i> u_i */
+            naff_dot(n, w, &u[2*k*n], &u[2*i*n], &pr, &pi);
+            for (j=0; j<n; j++) {
+                u[2*(k*n+j)]   -= pr*u[2*(i*n+j)]   - pi*u[2*(i*n+j)+1];
+                u[2*(k*n+j)+1] -= pr*u[2*(i*n+j)+1] + pi*u[2*(i*n+j)];
+            }
+            for (l=0; l<=i; l++) {
+                ar[k*nfreq+l] -= pr*ar[i*nfreq+l] - pi*ai[i*nfreq+l];
+                ai[k*nfreq+l] -= pr*ai[i*nfreq+l] + pi*ar[i*nfreq+l];
+            }
+        }
+        naff_dot(n, w, &u[2*k*n], &u[2*k*n], &norm, &tmp);
+        if (norm < 1e-20) {                     /* degenerate with an earlier term */
+            dprintf(1,"naff: frequency %d (%g) degenerate\n",k,omega);
+            break;
+        }
+        norm = 1.0/sqrt(norm);
+        for (j=0; j<2*n; j++)
+            u[2*k*n+j] *= norm;
+        for (l=0; l<=k; l++) {
+            ar[k*nfreq+l] *= norm;
+            ai[k*nfreq+l] *= norm;
+        }
+
+        naff_dot(n, w, f, &u[2*k*n], &cr[k], &ci[k]);
+        for (j=0; j<n; j++) {                   /* subtract this term */
+            f[2*j]   -= cr[k]*u[2*(k*n+j)]   - ci[k]*u[2*(k*n+j)+1];
+            f[2*j+1] -= cr[k]*u[2*(k*n+j)+1] + ci[k]*u[2*(k*n+j)];
+        }
+        freq[k] = omega;
+        nfound = k+1;
+    }
+
+    for (l=0; l<nfound; l++) {                  /* a_l = sum_k c_k A_kl */
+        pr = pi = 0.0;
+        for (k=l; k<nfound; k++) {
+            pr += cr[k]*ar[k*nfreq+l] - ci[k]*ai[k*nfreq+l];
+            pi += cr[k]*ai[k*nfreq+l] + ci[k]*ar[k*nfreq+l];
+        }
+        if (ampr) ampr[l] = pr;
+        if (ampi) ampi[l] = pi;
+    }
+
+    free(w);  free(f);  free(fpad);  free(u);
+    free(ar); free(ai); free(cr);    free(ci);
+    return nfound;
+}
+
+
+#ifdef TESTBED
+
+#include <getparam.h>
+
+string defv[] = {
+    "n=1000\n       Number of samples",
+    "dt=0.1\n       Sampling interval",
+    "nfreq=3\n      Number of frequencies to find",
+    "VERSION=1.0\n  19-oct-2026 PJT",
+    NULL,
+};
+
+string usage="testing naff";
+
+void nemo_main(void)
+{
+    int j, k, n = getiparam("n"), nfreq = getiparam("nfreq"), nf;
+    double dt = getdparam("dt"), t;
+    double *x, *y, *freq, *ampr, *ampi;
+    double w0[3] = {  1.2345, -0.3210, 2.7182 };
+    double a0[3] = {  1.0,     0.3,    0.05   };
+    double ph[3] = {  0.3,     1.2,   -0.7    };
+
+    x    = (double *) allocate(n*sizeof(double));
+    y    = (double *) allocate(n*sizeof(double));
+    freq = (double *) allocate(nfreq*sizeof(double));
+    ampr = (double *) allocate(nfreq*sizeof(double));
+    ampi = (double *) allocate(nfreq*sizeof(double));
+    for (j=0; j<n; j++) {
+        t = j*dt;
+        x[j] = y[j] = 0.0;
+        for (k=0; k<3; k++) {
+            x[j] += a0[k]*cos(w0[k]*t+ph[k]);
+            y[j] += a0[k]*sin(w0[k]*t+ph[k]);
+        }
+    }
+    nf = naff(n, dt, x, y, nfreq, freq, ampr, ampi);
+    for (k=0; k<nf; k++)
+        printf("%d  freq %.12f  amp %.12f  phase %.9f\n",
+               k, freq[k], sqrt(sqr(ampr[k])+sqr(ampi[k])), atan2(ampi[k],ampr[k]));
+}
+#endif
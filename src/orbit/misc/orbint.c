@@ -36,6 +36,8 @@
  *      10-dec-2019     V4.2 Add optional Phi/Acc to output     PJT
  *                           but not implemented for all cases - also fixed pattern speed bug
  *      21-mar-2021     V4.3 optional tstop which override nsteps  PJT
+ *      19-oct-2026     V5.0 adaptive dopri5/dop853 with dense output, and
+ *                           symplectic fr4/y6 modes                 PJT
  *                           
  *
  */
@@ -45,6 +47,9 @@
 #include <vectmath.h>	/* careful: dangerous with potentials */
 #include <orbit.h>
 
+#include <dopri5.h>
+#include <dop853.h>
+
 string defv[] = {
     "in=???\n		  input filename (an orbit) ",
     "out=???\n		  output filename (an orbit) ",
@@ -55,11 +60,12 @@ string defv[] = {
     "potname=\n	  	  potential name (default from orbit)",
     "potpars=\n	          parameters of potential ",
     "potfile=\n		  extra data-file for potential ",
-    "mode=rk4\n           integration method (euler,leapfrog,rk2,rk4)",
+    "mode=rk4\n           integration method (euler,leapfrog,rk2,rk4,me,fr4,y6,dopri5,dop853)",
     "eta=\n               if used, stop if abs(de/e) > eta",
     "variable=f\n         Use variable timesteps (needs eta=)",
     "tstop=\n             If given, this overrides nsteps=",
-    "VERSION=4.3\n        21-mar-2021 PJT",
+    "tol=-7\n             tolerance for dopri5/dop853 (<0 means 10**tol)",
+    "VERSION=5.0\n        19-oct-2026 PJT",
     NULL,
 };
 
@@ -83,6 +89,7 @@ real   dt, dt2;				/* stepping */
 real   omega, omega2, tomega;  		/* pattern speed */
 real   tdum=0.0;                        /* time used in potential() */
 real   eta = -1.0;                      /* stop criterion parameter */
+real   tol;                             /* tolerance for adaptive modes */
 bool   Qstop = FALSE;                   /* global flag to stop intgr. */
 bool   Qvar;
 
@@ -97,7 +104,8 @@ real print_diag();                      /* returns total energy/hamiltonian */
 void setparams(), prepare();
 void integrate_euler1(), integrate_euler2(), 
      integrate_leapfrog1(), integrate_leapfrog2(),
-     integrate_rk2(), integrate_rk4();
+     integrate_rk2(), integrate_rk4(),
+     integrate_symplectic(int), integrate_dopri(int);
 void set_rk(double *ko, double *pos, double *vel, double *acc, 
 	    int n, double dt, double *ki);
 
@@ -137,7 +145,7 @@ void nemo_main ()
 
     outstr = stropen (outfile,"w");
     prepare();
-    match(getparam("mode"),"euler leapfrog test rk2 rk4 me end",&imode);
+    match(getparam("mode"),"euler leapfrog test rk2 rk4 me fr4 y6 dopri5 dop853 end",&imode);
     if (imode==0x01)           // euler
         integrate_euler1();
     else if (imode==0x02)      // leapfrog
@@ -150,6 +158,14 @@ void nemo_main ()
         integrate_rk4();
     else if (imode==0x20)      // me
         integrate_euler2();
+    else if (imode==0x40)      // fr4
+        integrate_symplectic(4);
+    else if (imode==0x80)      // y6
+        integrate_symplectic(6);
+    else if (imode==0x100)     // dopri5
+        integrate_dopri(5);
+    else if (imode==0x200)     // dop853
+        integrate_dopri(8);
     else
         error("imode=0x%x; Illegal integration mode=",imode);
 
@@ -181,7 +197,9 @@ void setparams()
       eta = getdparam("eta");
     else if (Qvar)
       error("Variable timesteps choosen, it needs a control parameter eta=");
-    
+    tol = getdparam("tol");
+    if (tol < 0)
+      tol = pow(10.0,tol);
 }
 
 void prepare()
@@ -767,6 +785,237 @@ void integrate_rk4()
     dprintf(0,"Energy conservation: %g\n", ABS((e_last-I1(o_out))/I1(o_out)));
 }
 
+/* 
+ * Symplectic integrators: compositions of the (kick-drift-kick) leapfrog
+ *   order=4:  Forest & Ruth (1990) / Yoshida (1990) triple jump
+ *   order=6:  Yoshida (1990) solution A, 7 substeps
+ */
+
+void integrate_symplectic(int order)
+{
+    int i, k, ns = 0, ndim, kdiag, ksave, isave;
+    double time,epot,e_last,h;
+    double pos[3],vel[3],acc[3];
+    double w[7], w0, w1, w2, w3;
+
+    if (order == 4) {
+      dprintf (1,"FR4 integration\n");
+      w1 = 1.0/(2.0-pow(2.0,1.0/3.0));
+      w[0] = w[2] = w1;
+      w[1] = 1.0-2.0*w1;
+      ns = 3;
+    } else if (order == 6) {
+      dprintf (1,"Y6 integration\n");
+      w1 = -1.17767998417887;
+      w2 =  0.235573213359357;
+      w3 =  0.784513610477560;
+      w0 = 1.0-2.0*(w1+w2+w3);
+      w[0] = w[6] = w3;
+      w[1] = w[5] = w2;
+      w[2] = w[4] = w1;
+      w[3] = w0;
+      ns = 7;
+    } else
+      error("integrate_symplectic: order %d not supported",order);
+    if (omega != 0.0) 
+      error("mode=%s cannot handle a rotating frame (omega=%g)",getparam("mode"),omega);
+
+    /* take last step of input file and set first step for outfile */
+    time = Torb(o_out,0) = Torb(o_in,Nsteps(o_in)-1);
+    pos[0] = Xorb(o_out,0) = Xorb(o_in,Nsteps(o_in)-1);
+    pos[1] = Yorb(o_out,0) = Yorb(o_in,Nsteps(o_in)-1);
+    pos[2] = Zorb(o_out,0) = Zorb(o_in,Nsteps(o_in)-1);
+    vel[0] = Uorb(o_out,0) = Uorb(o_in,Nsteps(o_in)-1);
+    vel[1] = Vorb(o_out,0) = Vorb(o_in,Nsteps(o_in)-1);
+    vel[2] = Worb(o_out,0) = Worb(o_in,Nsteps(o_in)-1);
+#ifdef ORBIT_PHI
+    Porb(o_out,0)  = Porb(o_in,Nsteps(o_in)-1);
+    AXorb(o_out,0) = AXorb(o_in,Nsteps(o_in)-1);
+    AYorb(o_out,0) = AYorb(o_in,Nsteps(o_in)-1);
+    AZorb(o_out,0) = AZorb(o_in,Nsteps(o_in)-1);
+#endif    
+
+    ndim=Ndim(o_in);		/* number of dimensions (2 or 3) */
+    kdiag=0;			/* counter for diagnostics output */
+    ksave=0;
+    isave=0;
+    i=0;				/* counter of timesteps */
+    (*pot)(&ndim,pos,acc,&epot,&time);
+    e_last = I1(o_out) = print_diag(time,pos,vel,epot);
+    for(;;) {
+        if (Qstop) break;
+	if (i>=nsteps) break;           /* see if need to quit looping */
+
+	for (k=0; k<ns; k++) {          /* composition of KDK leapfrogs */
+	  h = w[k]*dt;
+	  vel[0] += 0.5*h*acc[0];
+	  vel[1] += 0.5*h*acc[1];
+	  vel[2] += 0.5*h*acc[2];
+	  pos[0] += h*vel[0];
+	  pos[1] += h*vel[1];
+	  pos[2] += h*vel[2];
+	  time += h;
+	  (*pot)(&ndim,pos,acc,&epot,&time);
+	  vel[0] += 0.5*h*acc[0];
+	  vel[1] += 0.5*h*acc[1];
+	  vel[2] += 0.5*h*acc[2];
+	}
+	i++;
+
+	if (ndiag && ++kdiag == ndiag) {	/* see if output needed */
+	    e_last = print_diag(time,pos,vel,epot);
+	    kdiag=0;
+	}
+	if (++ksave == nsave) {		/* see if need to store particle */
+	    ksave=0;
+	    isave++;
+	    dprintf(2,"writing isave=%d for i=%d\n",isave,i);
+            if (isave>=Nsteps(o_out)) error("Storage error symplectic");
+	    Torb(o_out,isave) = time;
+	    Xorb(o_out,isave) = pos[0];
+	    Yorb(o_out,isave) = pos[1];
+	    Zorb(o_out,isave) = pos[2];
+	    Uorb(o_out,isave) = vel[0];
+	    Vorb(o_out,isave) = vel[1];
+	    Worb(o_out,isave) = vel[2];
+#ifdef ORBIT_PHI
+	    Porb(o_out,isave) = epot;
+	    AXorb(o_out,isave)= acc[0];
+	    AYorb(o_out,isave)= acc[1];
+	    AZorb(o_out,isave)= acc[2];
+#endif	    
+	}
+    } /* for(;;) */
+    if (ndiag)
+    dprintf(0,"Energy conservation: %g\n", ABS((e_last-I1(o_out))/I1(o_out)));
+}
+
+/*
+ * Adaptive embedded Runge-Kutta (Hairer & Wanner's dopri5 and dop853)
+ * the orbit is saved every nsave*dt using their dense output
+ */
+
+#define DOP_NMAX 1000000000L     /* max number of dopri steps */
+
+local double dop_epot;           /* potential at the last rhs() call */
+local double dop_tsave;          /* next time to save */
+local int    dop_isave;          /* last saved index */
+local int    dop_order;          /* 5 or 8 */
+local double dop_e0;             /* initial energy */
+
+local void dop_rhs(unsigned n, double x, double *y, double *f)
+{
+    double acc[3];
+    int ndim = 3;
+
+    (*pot)(&ndim,y,acc,&dop_epot,&x);
+    f[0] = y[3];
+    f[1] = y[4];
+    f[2] = y[5];
+    f[3] = acc[0] + omega2*y[0] + tomega*y[4];    /* rotating frame */
+    f[4] = acc[1] + omega2*y[1] - tomega*y[3];    /* corrections    */
+    f[5] = acc[2];
+}
+
+local void dop_solout(long nr, double xold, double x, double *y, unsigned n, int *irtrn)
+{
+    int i;
+    double pv[6], f[6], e;
+
+    while (dop_isave < Nsteps(o_out)-1 && dop_tsave <= x) {
+      for (i=0; i<6; i++)
+	pv[i] = (dop_order == 5) ? contd5(i,dop_tsave) : contd8(i,dop_tsave);
+      dop_isave++;
+      Torb(o_out,dop_isave) = dop_tsave;
+      Xorb(o_out,dop_isave) = pv[0];
+      Yorb(o_out,dop_isave) = pv[1];
+      Zorb(o_out,dop_isave) = pv[2];
+      Uorb(o_out,dop_isave) = pv[3];
+      Vorb(o_out,dop_isave) = pv[4];
+      Worb(o_out,dop_isave) = pv[5];
+      dop_rhs(6,dop_tsave,pv,f);
+#ifdef ORBIT_PHI
+      Porb(o_out,dop_isave) = dop_epot - 0.5*omega2*(pv[0]*pv[0]+pv[1]*pv[1]);
+      AXorb(o_out,dop_isave)= f[3];
+      AYorb(o_out,dop_isave)= f[4];
+      AZorb(o_out,dop_isave)= f[5];
+#endif
+      if (ndiag && dop_isave % ndiag == 0) 
+	e = print_diag(dop_tsave,pv,pv+3,dop_epot);
+      else if (eta > 0) {
+	e = 0.5*(sqr(pv[3])+sqr(pv[4])+sqr(pv[5])) + dop_epot 
+	  - 0.5*omega2*(sqr(pv[0])+sqr(pv[1]));
+	if (ABS((e-dop_e0)/(dop_e0==0 ? 1.0 : dop_e0)) > eta) {
+	  warning("STOPPING: Time=%g E=%g E_0=%g Eta=%g",dop_tsave,e,dop_e0,eta);
+	  Qstop = TRUE;
+	}
+      }
+      if (Qstop) {
+	*irtrn = -1;
+	break;
+      }
+      dop_tsave = Torb(o_out,0) + (dop_isave+1)*nsave*dt;
+    }
+}
+
+void integrate_dopri(int order)
+{
+    int res;
+    double y[6], t0, tend, f[6];
+
+    dprintf (1,"%s integration, tol=%g\n", order==5 ? "DOPRI5" : "DOP853", tol);
+    /* take last step of input file and set first step for outfile */
+    t0 = Torb(o_out,0) = Torb(o_in,Nsteps(o_in)-1);
+    y[0] = Xorb(o_out,0) = Xorb(o_in,Nsteps(o_in)-1);
+    y[1] = Yorb(o_out,0) = Yorb(o_in,Nsteps(o_in)-1);
+    y[2] = Zorb(o_out,0) = Zorb(o_in,Nsteps(o_in)-1);
+    y[3] = Uorb(o_out,0) = Uorb(o_in,Nsteps(o_in)-1);
+    y[4] = Vorb(o_out,0) = Vorb(o_in,Nsteps(o_in)-1);
+    y[5] = Worb(o_out,0) = Worb(o_in,Nsteps(o_in)-1);
+#ifdef ORBIT_PHI
+    Porb(o_out,0)  = Porb(o_in,Nsteps(o_in)-1);
+    AXorb(o_out,0) = AXorb(o_in,Nsteps(o_in)-1);
+    AYorb(o_out,0) = AYorb(o_in,Nsteps(o_in)-1);
+    AZorb(o_out,0) = AZorb(o_in,Nsteps(o_in)-1);
+#endif    
+
+    dop_rhs(6,t0,y,f);
+    I1(o_out) = dop_e0 = print_diag(t0,y,y+3,dop_epot);
+    dop_order = order;
+    dop_isave = 0;
+    dop_tsave = t0 + nsave*dt;
+    tend = t0 + nsteps*dt;
+
+    /* dt is only used as the initial step, the integrator picks its own;
+     * the default limit of 1e5 steps is too small for long tight orbits */
+    if (order == 5)
+      res = dopri5(6, dop_rhs, t0, y, tend, &tol, &tol, 0, dop_solout, 2,
+		   stderr, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, dt, DOP_NMAX, 0, 0, 6, NULL, 0);
+    else
+      res = dop853(6, dop_rhs, t0, y, tend, &tol, &tol, 0, dop_solout, 2,
+		   stderr, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, dt, DOP_NMAX, 0, 0, 6, NULL, 0);
+    if (res < 0 && !Qstop) 
+      warning("%s returned %d at t=%g", order==5 ? "dopri5" : "dop853", res,
+	      order==5 ? xRead5() : xRead8());
+    if (order == 5)
+      dprintf(1,"nfcn=%ld nstep=%ld naccpt=%ld nrejct=%ld\n",
+	      nfcnRead5(),nstepRead5(),naccptRead5(),nrejctRead5());
+    else
+      dprintf(1,"nfcn=%ld nstep=%ld naccpt=%ld nrejct=%ld\n",
+	      nfcnRead8(),nstepRead8(),naccptRead8(),nrejctRead8());
+    if (dop_isave < Nsteps(o_out)-1) {
+      dprintf(1,"Only %d/%d orbit steps saved\n",dop_isave+1,Nsteps(o_out));
+      Nsteps(o_out) = dop_isave+1;
+    }
+    if (ndiag) {
+      y[0] = Xorb(o_out,dop_isave);  y[1] = Yorb(o_out,dop_isave);  y[2] = Zorb(o_out,dop_isave);
+      y[3] = Uorb(o_out,dop_isave);  y[4] = Vorb(o_out,dop_isave);  y[5] = Worb(o_out,dop_isave);
+      dop_rhs(6,Torb(o_out,dop_isave),y,f);
+      dprintf(0,"Energy conservation: %g\n",
+	      ABS((print_diag(Torb(o_out,dop_isave),y,y+3,dop_epot)-I1(o_out))/I1(o_out)));
+    }
+}
+
 void set_rk(double *ko, double *pos, double *vel, double *acc, 
 	    int n, double dt, double *ki)
 {
@@ -0,0 +1,232 @@
+/*
+ * ORBNAFF:	NAFF frequency analysis of orbits
+ *
+ *	For each orbit the fundamental frequencies of x+i.vx, y+i.vy (and z+i.vz)
+ *	are computed with Laskar's NAFF method, a resonance label is
+ *	searched for, and the frequency diffusion rate is estimated from
+ *	the change in frequencies between the first and second half of the
+ *	orbit. Orbits are read in batches, and each batch is analysed
+ *	in parallel (if compiled with OpenMP).
+ *
+ *	19-oct-2026 V1.0   created                                    PJT
+ */
+
+#include <stdinc.h>
+#include <getparam.h>
+#include <orbit.h>
+#include <naff.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+string defv[] = {
+    "in=???\n           Input orbit(s), e.g. from orbint or stoo",
+    "nfreq=4\n          Number of frequencies to extract per coordinate",
+    "diffusion=t\n      Compute frequency diffusion rate from the two orbit halves?",
+    "maxres=6\n         Maximum order |l|+|m|+|n| of resonance search",
+    "restol=1e-3\n      Resonance tolerance, relative to the largest frequency",
+    "batch=1000\n       Number of orbits read and analysed in parallel",
+    "VERSION=1.0\n      19-oct-2026 PJT",
+    NULL,
+};
+
+string usage="NAFF frequency analysis of orbits";
+
+string cvsid="$Id$";
+
+#define MAXDIM 3
+
+typedef struct {
+    int    ndim;
+    int    nsteps;
+    double omega[MAXDIM];          /* leading frequency, full orbit */
+    double diff;                   /* log10 |dOmega|/|Omega|, or 0 */
+    int    res[MAXDIM];            /* resonance vector, all 0 if none */
+} naffres;
+
+local int nfreq, maxres;
+local bool Qdiff;
+local real restol;
+
+local bool orbit_freqs(orbitptr o, int i0, int n, double dt, double *omega);
+local void find_resonance(int ndim, double *omega, int *res);
+local void naff_orbit(orbitptr o, naffres *r);
+local void report(int iorb, orbitptr o, naffres *r);
+
+
+void nemo_main(void)
+{
+    stream instr;
+    orbitptr *optr;
+    naffres *res;
+    int i, nread, batch, iorb = 0;
+
+    instr  = stropen(getparam("in"),"r");
+    nfreq  = getiparam("nfreq");
+    Qdiff  = getbparam("diffusion");
+    maxres = getiparam("maxres");
+    restol = getrparam("restol");
+    batch  = getiparam("batch");
+    if (nfreq < 1) error("nfreq=%d must be positive",nfreq);
+    if (batch < 1) error("batch=%d must be positive",batch);
+
+    optr = (orbitptr *) allocate(batch*sizeof(orbitptr));
+    res  = (naffres *)  allocate(batch*sizeof(naffres));
+    for (i=0; i<batch; i++)
+        optr[i] = NULL;
+#ifdef _OPENMP
+    dprintf(1,"Using %d threads\n",omp_get_max_threads());
+#endif
+
+    printf("# iorb key Omega_x Omega_y [Omega_z] log10(diffusion) resonance\n");
+    for (;;) {
+        for (nread=0; nread<batch; nread++)     /* I/O is serial ... */
+            if (!read_orbit(instr,&optr[nread])) break;
+        if (nread == 0) break;
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (i=0; i<nread; i++)                 /* ... the analysis is not */
+            naff_orbit(optr[i], &res[i]);
+        for (i=0; i<nread; i++)
+            report(iorb++, optr[i], &res[i]);
+        if (nread < batch) break;
+    }
+    dprintf(1,"Analysed %d orbits\n",iorb);
+    strclose(instr);
+}
+
+/*
+ * leading frequencies of a stretch of n steps of an orbit starting at i0
+ */
+
+local bool orbit_freqs(orbitptr o, int i0, int n, double dt, double *omega)
+{
+    int i, k, nf, ndim = Ndim(o);
+    double *x, *u, *freq, *ampr, *ampi, amax, a, s2;
+    bool ok = TRUE;
+
+    x    = (double *) allocate(n*sizeof(double));
+    u    = (double *) allocate(n*sizeof(double));
+    freq = (double *) allocate(nfreq*sizeof(double));
+    ampr = (double *) allocate(nfreq*sizeof(double));
+    ampi = (double *) allocate(nfreq*sizeof(double));
+    for (k=0; k<ndim; k++) {
+        for (i=0, s2=0.0; i<n; i++) {
+            x[i] = Posorb(o,i0+i,k);
+            u[i] = Velorb(o,i0+i,k);
+            s2 += sqr(x[i]) + sqr(u[i]);
+        }
+        omega[k] = 0.0;
+        if (s2 == 0.0) continue;                /* e.g. z in a planar orbit */
+        nf = naff(n, dt, x, u, nfreq, freq, ampr, ampi);
+        if (nf == 0) {
+            ok = FALSE;
+            continue;
+        }
+        for (i=0, amax=-1.0; i<nf; i++) {       /* take the strongest line */
+            a = sqr(ampr[i]) + sqr(ampi[i]);
+            if (a > amax) {
+                amax = a;
+                omega[k] = ABS(freq[i]);
+            }
+        }
+    }
+    free(x); free(u); free(freq); free(ampr); free(ampi);
+    return ok;
+}
+
+/*
+ * find the lowest order integer vector l with |l.omega| < restol*max|omega|
+ */
+
+local void find_resonance(int ndim, double *omega, int *res)
+{
+    int order, l, m, n, k, nmax;
+    double wmax = 0.0;
+
+    for (k=0; k<MAXDIM; k++)
+        res[k] = 0;
+    for (k=0; k<ndim; k++)
+        wmax = MAX(wmax, omega[k]);
+    if (wmax == 0.0) return;
+
+    for (order=1; order<=maxres; order++) {
+        for (l=order; l>=0; l--)                /* first non-zero index positive */
+            for (m=-(order-l); m<=order-l; m++) {
+                nmax = ndim==3 ? order-ABS(l)-ABS(m) : 0;
+                for (n=-nmax; n<=nmax; n++) {
+                    if (ABS(l)+ABS(m)+ABS(n) != order) continue;
+                    if (l==0 && (m<0 || (m==0 && n<0))) continue;
+                    if ((l && omega[0]==0) || (m && omega[1]==0) || (n && omega[2]==0))
+                        continue;                   /* e.g. z in a planar orbit */
+                    if (ABS(l*omega[0] + m*omega[1] + (ndim==3 ? n*omega[2] : 0.0))
+                        < restol*wmax) {
+                        res[0] = l;
+                        res[1] = m;
+                        res[2] = n;
+                        return;
+                    }
+                }
+            }
+    }
+}
+
+local void naff_orbit(orbitptr o, naffres *r)
+{
+    int k, n = Nsteps(o), nh;
+    double dt, om1[MAXDIM], om2[MAXDIM], d2, w2;
+
+    r->ndim = Ndim(o);
+    r->nsteps = n;
+    r->diff = 0.0;
+    for (k=0; k<MAXDIM; k++) {
+        r->omega[k] = 0.0;
+        r->res[k] = 0;
+    }
+    if (r->ndim > MAXDIM || n < 8) return;
+    dt = (Torb(o,n-1)-Torb(o,0))/(n-1);
+    if (dt == 0.0) return;
+
+    if (!orbit_freqs(o, 0, n, dt, r->omega))
+        dprintf(1,"orbit %d: no frequencies found\n",Key(o));
+    find_resonance(r->ndim, r->omega, r->res);
+
+    if (Qdiff) {
+        nh = n/2;
+        if (orbit_freqs(o, 0, nh, dt, om1) && orbit_freqs(o, n-nh, nh, dt, om2)) {
+            for (k=0, d2=w2=0.0; k<r->ndim; k++) {
+                d2 += sqr(om2[k]-om1[k]);
+                w2 += sqr(om1[k]);
+            }
+            if (d2 > 0 && w2 > 0)
+                r->diff = 0.5*log10(d2/w2);
+            else
+                r->diff = -99.0;
+        }
+    }
+}
+
+local void report(int iorb, orbitptr o, naffres *r)
+{
+    char label[64];
+
+    if (r->ndim > MAXDIM) {
+        warning("orbit %d: ndim=%d not supported",iorb,r->ndim);
+        return;
+    }
+    if (r->nsteps < 8)
+        warning("orbit %d: only %d steps, skipped",iorb,r->nsteps);
+    if (r->res[0]==0 && r->res[1]==0 && r->res[2]==0)
+        strcpy(label,"-");
+    else if (r->ndim == 3)
+        sprintf(label,"%d:%d:%d",r->res[0],r->res[1],r->res[2]);
+    else
+        sprintf(label,"%d:%d",r->res[0],r->res[1]);
+
+    printf("%d %d %.9g %.9g", iorb, Key(o), r->omega[0], r->omega[1]);
+    if (r->ndim == 3)
+        printf(" %.9g", r->omega[2]);
+    printf(" %.4f %s\n", r->diff, label);
+}
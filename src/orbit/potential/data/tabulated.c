@@ -0,0 +1,515 @@
+/*
+ * tabulated.c:  table driven (interpolated) version of any other potential(5NEMO)
+ *
+ *	The wrapped potential is sampled once in inipotential, on an adaptive
+ *	radial grid (spherical) or a refined (R,z) grid (axisymmetric), and
+ *	afterwards evaluated by cubic Hermite interpolation. Tables can be
+ *	cached in $POTCACHE, keyed by the wrapped potential name/pars/file
+ *	and the grid parameters.
+ *
+ *	19-oct-2026	V1.0 created					PJT
+ *	19-oct-2026	V1.1 test force where its error peaks, safer cache	PJT
+ */
+
+/*CTEX
+ *	{\bf potname=tabulated
+ *       potpars={\it $\Omega,mode,r_{min},r_{max},tol,n_{max}$}
+ *       potfile={\it name:pars[:file]}}
+ *
+ *  Table driven version of another potential, given in {\it potfile}
+ *  as {\tt name:pars:file}, e.g. {\tt potfile=dehnen:0,1,1,1.5}.
+ *  For {\it mode=0} the potential is assumed spherical, and $\Phi(r)$ is
+ *  sampled on an adaptive grid in $\ln r$ between $r_{min}$ and $r_{max}$,
+ *  until the cubic Hermite interpolant reproduces potential and radial force
+ *  inside each interval, where its force error peaks, to a relative accuracy {\it tol}.
+ *  For {\it mode=1} the potential is assumed axisymmetric, and $\Phi(R,z)$ is
+ *  sampled on a grid uniform in ${\rm asinh}(R/r_{min})$ and ${\rm asinh}(z/r_{min})$,
+ *  doubled in resolution until all cell centers are accurate to {\it tol}, or
+ *  $n_{max}$ nodes per axis are reached.
+ *  In both modes the accuracy is only controlled outside $r_{min}$.
+ *  Inside $r_{min}$ (mode=0) a constant density core is assumed,
+ *  outside $r_{max}$ a point mass.
+ *  If the environment variable {\bf POTCACHE} points to a directory, tables are
+ *  saved there and reused by later programs using the same potential.
+ *  Time dependent potentials are sampled at $t=0$.
+ */
+
+#include <stdinc.h>
+#include <filestruct.h>
+#include <potential.h>
+
+#define TAB_VERSION "tabulated V1.1 19-oct-2026"
+
+#define MINDEPTH   8         /* bisections before a stalled error is accepted */
+#define MAXDEPTH  40
+
+local double omega = 0.0;
+local int    mode = 0;           /* 0=spherical  1=axisymmetric */
+local double rmin = 1e-4;
+local double rmax = 1e4;
+local double tol  = 1e-6;
+local int    nmax = 1025;
+
+local potproc_double pot_in = NULL;
+
+/* mode=0:  nodes in x=ln(r), with phi and dphi/dx */
+local int     nr = 0, maxr = 0, nfloor = 0;
+local double *xr = NULL, *pr = NULL, *dr = NULL;
+
+/* mode=1:  nodes in u=asinh(R/rmin), v=asinh(z/rmin); phi, phi_u, phi_v, phi_uv */
+local int     nu = 0, nv = 0;
+local double  umax, vmax, hu, hv;
+local double *pg = NULL, *pgu = NULL, *pgv = NULL, *pguv = NULL;
+
+local void sample_r(double x, double *phi, double *dphi);
+local void sample_rz(double R, double z, double *phi, double *fR, double *fz);
+local void build_r(void);
+local void build_rz(void);
+local void eval_r(double r, double *phi, double *dphidr);
+local void eval_rz(double R, double z, double *phi, double *dphidR, double *dphidz);
+local bool read_cache(string fname, string key);
+local void write_cache(string fname, string key);
+
+void inipotential (int *npar, double *par, string name)
+{
+    int n = *npar;
+    char key[512], iname[128], *ipars, *ifile, *cp, *cache;
+    char cname[256];
+    unsigned long long h;
+
+    if (n>0) omega = par[0];
+    if (n>1) mode  = (int) par[1];
+    if (n>2) rmin  = par[2];
+    if (n>3) rmax  = par[3];
+    if (n>4) tol   = par[4];
+    if (n>5) nmax  = (int) par[5];
+    if (n>6) warning("tabulated: npar=%d only 6 parameters accepted",n);
+
+    if (name==NULL || *name==0)
+      error("tabulated: potfile=name:pars[:file] needed to select a potential");
+    if (mode<0 || mode>1) error("tabulated: mode=%d not supported (0,1)",mode);
+    if (rmin<=0 || rmax<=rmin) error("tabulated: bad rmin,rmax=%g,%g",rmin,rmax);
+    if (nmax<5) nmax = 5;
+
+    /* split name:pars:file */
+    strncpy(iname,name,127);
+    iname[127] = 0;
+    ipars = ifile = NULL;
+    if ((cp = strchr(iname,':')) != NULL) {
+      *cp++ = 0;
+      ipars = cp;
+      if ((cp = strchr(ipars,':')) != NULL) {
+	*cp++ = 0;
+	ifile = cp;
+      }
+    }
+    /* note: this re-enters get_potential(), which re-uses the par[] array */
+    snprintf(key,sizeof(key),"%s:%s:%s mode=%d rmin=%.15g rmax=%.15g tol=%.15g nmax=%d %s",
+	    iname, ipars ? ipars : "", ifile ? ifile : "", mode, rmin, rmax, tol, nmax, TAB_VERSION);
+    pot_in = get_potential_double(iname, ipars, ifile);
+    if (pot_in == NULL) error("tabulated: could not load potential %s",iname);
+
+    dprintf(1,"INIPOTENTIAL: %s\n",TAB_VERSION);
+    dprintf(1,"  Parameters : Pattern Speed = %f\n",omega);
+    dprintf(1,"  mode=%d rmin=%g rmax=%g tol=%g nmax=%d\n",mode,rmin,rmax,tol,nmax);
+    dprintf(1,"  key: %s\n",key);
+
+    cache = getenv("POTCACHE");
+    cname[0] = 0;
+    if (cache != NULL && *cache) {
+      for (h = 14695981039346656037ULL, cp = key; *cp; cp++)    /* FNV-1a */
+	h = (h ^ (unsigned char) *cp) * 1099511628211ULL;
+      if (snprintf(cname,sizeof(cname),"%s/tabulated_%016llx.dat",cache,h) >= sizeof(cname)) {
+	warning("tabulated: POTCACHE=%s too long, table not cached",cache);
+	cname[0] = 0;
+      }
+    }
+    if (cname[0] && read_cache(cname,key)) {
+      dprintf(1,"  table read from %s\n",cname);
+    } else {
+      if (mode==0)
+	build_r();
+      else
+	build_rz();
+      if (cname[0]) write_cache(cname,key);
+    }
+    if (mode==0)
+      dprintf(1,"  %d radial nodes\n",nr);
+    else
+      dprintf(1,"  %d x %d (R,z) nodes\n",nu,nv);
+
+    par[0] = omega;
+}
+
+/*  the wrapped potential, spherical: phi and dphi/dln(r) at x=ln(r) */
+
+local void sample_r(double x, double *phi, double *dphi)
+{
+    int ndim = 3;
+    double pos[3], acc[3], t = 0.0, r = exp(x);
+
+    pos[0] = r;  pos[1] = pos[2] = 0.0;
+    (*pot_in)(&ndim, pos, acc, phi, &t);
+    *dphi = -acc[0] * r;
+}
+
+/*  the wrapped potential, axisymmetric: phi and the (R,z) forces */
+
+local void sample_rz(double R, double z, double *phi, double *fR, double *fz)
+{
+    int ndim = 3;
+    double pos[3], acc[3], t = 0.0;
+
+    pos[0] = R;  pos[1] = 0.0;  pos[2] = z;
+    (*pot_in)(&ndim, pos, acc, phi, &t);
+    *fR = acc[0];
+    *fz = acc[2];
+}
+
+/*  cubic hermite basis on [0,1] with function values and (scaled) derivatives */
+
+#define H00(t) ((1+2*(t))*(1-(t))*(1-(t)))
+#define H10(t) ((t)*(1-(t))*(1-(t)))
+#define H01(t) ((t)*(t)*(3-2*(t)))
+#define H11(t) ((t)*(t)*((t)-1))
+#define D00(t) (6*(t)*((t)-1))
+#define D10(t) ((1-(t))*(1-3*(t)))
+#define D01(t) (6*(t)*(1-(t)))
+#define D11(t) ((t)*(3*(t)-2))
+
+local void add_node(double x, double p, double d)
+{
+    if (nr == maxr) {
+      maxr = maxr ? 2*maxr : 256;
+      xr = (double *) reallocate(xr, maxr*sizeof(double));
+      pr = (double *) reallocate(pr, maxr*sizeof(double));
+      dr = (double *) reallocate(dr, maxr*sizeof(double));
+    }
+    xr[nr] = x;
+    pr[nr] = p;
+    dr[nr] = d;
+    nr++;
+}
+
+/*
+ *  relative error, in units of tol, of the hermite interpolant on [xa,xb]
+ *  at x=xa+t*h. At t=1/2 the leading error term of its derivative vanishes;
+ *  that term, t(1-t)(1-2t), peaks at t = 1/2 -+ sqrt(3)/6, where the force
+ *  is tested.
+ */
+
+#define TLO  0.21132486540518713       /* 1/2 - sqrt(3)/6 */
+#define THI  0.78867513459481287       /* 1/2 + sqrt(3)/6 */
+
+local double err_r(double xa, double pa, double da, double xb, double pb, double db, double t)
+{
+    double h = xb-xa, p, d, pi, di;
+
+    sample_r(xa+t*h, &p, &d);
+    pi = H00(t)*pa + H10(t)*h*da + H01(t)*pb + H11(t)*h*db;
+    di = D00(t)*pa/h + D10(t)*da + D01(t)*pb/h + D11(t)*db;
+    return MAX(ABS(pi-p)/ABS(p), ABS(di-d)/ABS(d)) / tol;
+}
+
+/*
+ *  add nodes in (xa,xb], bisecting until TLO and THI are accurate to tol.
+ *  Each bisection should cut the error by about 8; once it does not, the
+ *  wrapped potential itself is too noisy (roundoff) to get any better.
+ */
+
+local void refine_r(double xa, double pa, double da, double xb, double pb, double db,
+		    int depth, double eprev)
+{
+    double xm, pm, dm, err;
+
+    err = MAX(err_r(xa,pa,da,xb,pb,db,TLO), err_r(xa,pa,da,xb,pb,db,THI));
+    if (err > 1 && depth >= MINDEPTH && (err > 0.5*eprev || depth == MAXDEPTH)) {
+      nfloor++;
+      err = 1;
+    }
+    if (err > 1) {
+      xm = 0.5*(xa+xb);
+      sample_r(xm, &pm, &dm);
+      refine_r(xa,pa,da,xm,pm,dm,depth+1,err);
+      refine_r(xm,pm,dm,xb,pb,db,depth+1,err);
+    } else
+      add_node(xb,pb,db);
+}
+
+local void build_r(void)
+{
+    int i, n0 = 17;
+    double xa, pa, da, xb, pb, db, x0 = log(rmin), x1 = log(rmax);
+
+    nr = nfloor = 0;
+    sample_r(x0, &pa, &da);
+    add_node(x0, pa, da);
+    for (i=1, xa=x0; i<n0; i++, xa=xb, pa=pb, da=db) {
+      xb = x0 + (x1-x0)*i/(n0-1);
+      sample_r(xb, &pb, &db);
+      refine_r(xa,pa,da,xb,pb,db,0,HUGE_VAL);
+    }
+    if (nfloor)
+      warning("tabulated: tol=%g not reached in %d intervals, limited by roundoff",tol,nfloor);
+}
+
+local void eval_r(double r, double *phi, double *dphidr)
+{
+    int lo, hi, mid;
+    double x, t, h;
+
+    if (r <= rmin) {                     /* constant density core */
+      *dphidr = dr[0]/rmin * r/rmin;
+      *phi = pr[0] - 0.5*dr[0]*(1-sqr(r/rmin));
+      return;
+    }
+    if (r >= rmax) {                     /* point mass */
+      *dphidr = dr[nr-1]/r * rmax/r;
+      *phi = pr[nr-1] + dr[nr-1]*(1-rmax/r);
+      return;
+    }
+    x = log(r);
+    lo = 0;  hi = nr-1;
+    while (hi-lo > 1) {
+      mid = (lo+hi)/2;
+      if (xr[mid] > x) hi = mid; else lo = mid;
+    }
+    h = xr[hi]-xr[lo];
+    t = (x-xr[lo])/h;
+    *phi = H00(t)*pr[lo] + H10(t)*h*dr[lo] + H01(t)*pr[hi] + H11(t)*h*dr[hi];
+    *dphidr = (D00(t)*pr[lo]/h + D10(t)*dr[lo] + D01(t)*pr[hi]/h + D11(t)*dr[hi]) / r;
+}
+
+/*  fill an nu x nv grid, with v spanning [-vmax,vmax] */
+
+local void fill_rz(int n)
+{
+    int i, j, k;
+    double R, z, phi, fR, fz, u, v;
+
+    nu = n;
+    nv = 2*n-1;
+    umax = vmax = asinh(rmax/rmin);
+    hu = umax/(nu-1);
+    hv = 2*vmax/(nv-1);
+    if (pg) {
+      free(pg);  free(pgu);  free(pgv);  free(pguv);
+    }
+    pg   = (double *) allocate(nu*nv*sizeof(double));
+    pgu  = (double *) allocate(nu*nv*sizeof(double));
+    pgv  = (double *) allocate(nu*nv*sizeof(double));
+    pguv = (double *) allocate(nu*nv*sizeof(double));
+    for (j=0; j<nv; j++) {
+      v = -vmax + j*hv;
+      z = rmin*sinh(v);
+      for (i=0; i<nu; i++) {
+	u = i*hu;
+	R = rmin*sinh(u);
+	sample_rz(R, z, &phi, &fR, &fz);
+	k = j*nu+i;
+	pg[k]  = phi;
+	pgu[k] = -fR * rmin*cosh(u);          /* dphi/du */
+	pgv[k] = -fz * rmin*cosh(v);          /* dphi/dv */
+      }
+    }
+    /* cross derivative from finite differences of phi_u along v */
+    for (j=0; j<nv; j++)
+      for (i=0; i<nu; i++) {
+	k = j*nu+i;
+	if (j==0)
+	  pguv[k] = (pgu[k+nu]-pgu[k])/hv;
+	else if (j==nv-1)
+	  pguv[k] = (pgu[k]-pgu[k-nu])/hv;
+	else
+	  pguv[k] = 0.5*(pgu[k+nu]-pgu[k-nu])/hv;
+      }
+}
+
+local void build_rz(void)
+{
+    int n, i, j;
+    double R, z, phi, fR, fz, ephi, dpR, dpz, err, fmax;
+
+    for (n=17; ; n = 2*n-1) {
+      fill_rz(n);
+      err = 0.0;
+      for (j=0; j<nv-1; j++)
+	for (i=0; i<nu-1; i++) {
+	  R = rmin*sinh((i+0.5)*hu);
+	  z = rmin*sinh(-vmax+(j+0.5)*hv);
+	  if (R*R+z*z < rmin*rmin) continue;   /* cusps are not resolved inside rmin */
+	  sample_rz(R, z, &phi, &fR, &fz);
+	  eval_rz(R, z, &ephi, &dpR, &dpz);
+	  fmax = sqrt(fR*fR+fz*fz);
+	  err = MAX(err, ABS(ephi-phi)/ABS(phi));
+	  if (fmax > 0) err = MAX(err, sqrt(sqr(dpR+fR)+sqr(dpz+fz))/fmax);
+	}
+      dprintf(1,"  tabulated: n=%d max relative error %g\n",n,err);
+      if (err < tol) break;
+      if (2*n-1 > nmax) {
+	warning("tabulated: tol=%g not reached with n=%d, error=%g",tol,n,err);
+	break;
+      }
+    }
+}
+
+local void eval_rz(double R, double z, double *phi, double *dphidR, double *dphidz)
+{
+    int i, j, k;
+    double u, v, t, s, f0, f1, d0, d1, fu0, fu1, du0, du1;
+
+    u = asinh(R/rmin);
+    v = asinh(z/rmin);
+    if (u >= umax || ABS(v) >= vmax) {     /* outside the grid: point mass */
+      double r = sqrt(R*R+z*z), rm = rmax, g0;
+      k = (nv/2)*nu + nu-1;                 /* (rmax,0) node */
+      g0 = pgu[k]/(rmin*cosh(umax));
+      *phi = pg[k] + g0*rm*(1-rm/r);
+      *dphidR = g0*sqr(rm/r)*R/r;
+      *dphidz = g0*sqr(rm/r)*z/r;
+      return;
+    }
+    i = (int) (u/hu);
+    j = (int) ((v+vmax)/hv);
+    if (i > nu-2) i = nu-2;
+    if (j > nv-2) j = nv-2;
+    t = u/hu - i;
+    s = (v+vmax)/hv - j;
+    k = j*nu+i;
+
+    /* hermite in u along the two v-edges, for phi and phi_v */
+#define HU(a,b,c)   (H00(t)*a[c] + H10(t)*hu*b[c] + H01(t)*a[c+1] + H11(t)*hu*b[c+1])
+#define DU(a,b,c)  ((D00(t)*a[c] + D10(t)*hu*b[c] + D01(t)*a[c+1] + D11(t)*hu*b[c+1])/hu)
+    f0  = HU(pg,pgu,k);       f1  = HU(pg,pgu,k+nu);
+    d0  = HU(pgv,pguv,k);     d1  = HU(pgv,pguv,k+nu);
+    fu0 = DU(pg,pgu,k);       fu1 = DU(pg,pgu,k+nu);
+    du0 = DU(pgv,pguv,k);     du1 = DU(pgv,pguv,k+nu);
+#undef HU
+#undef DU
+    *phi    = H00(s)*f0 + H10(s)*hv*d0 + H01(s)*f1 + H11(s)*hv*d1;
+    *dphidz = (D00(s)*f0 + D10(s)*hv*d0 + D01(s)*f1 + D11(s)*hv*d1)/hv;
+    *dphidR = H00(s)*fu0 + H10(s)*hv*du0 + H01(s)*fu1 + H11(s)*hv*du1;
+    *dphidR /= sqrt(R*R+rmin*rmin);       /* du/dR */
+    *dphidz /= sqrt(z*z+rmin*rmin);       /* dv/dz */
+}
+
+/*  cache I/O, as a small structured file */
+
+local bool read_cache(string fname, string key)
+{
+    stream str;
+    string okey;
+    int n[2], cmode;
+
+    if ((str = fopen(fname,"r")) == NULL) return FALSE;
+    fclose(str);
+    str = stropen(fname,"r");
+    if (!get_tag_ok(str,"TabPotential")) {
+      strclose(str);
+      return FALSE;
+    }
+    get_set(str,"TabPotential");
+    okey = get_string(str,"Key");
+    if (!streq(okey,key)) {
+      dprintf(1,"tabulated: key mismatch in %s\n",fname);
+      free(okey);
+      strclose(str);
+      return FALSE;
+    }
+    free(okey);
+    get_data(str,"Mode",IntType,&cmode,0);
+    get_data(str,"N",IntType,n,2,0);
+    if (cmode == 0) {
+      nr = maxr = n[0];
+      xr = (double *) allocate(nr*sizeof(double));
+      pr = (double *) allocate(nr*sizeof(double));
+      dr = (double *) allocate(nr*sizeof(double));
+      get_data(str,"X",DoubleType,xr,nr,0);
+      get_data(str,"Phi",DoubleType,pr,nr,0);
+      get_data(str,"DPhi",DoubleType,dr,nr,0);
+    } else {
+      nu = n[0];
+      nv = n[1];
+      umax = vmax = asinh(rmax/rmin);
+      hu = umax/(nu-1);
+      hv = 2*vmax/(nv-1);
+      pg   = (double *) allocate(nu*nv*sizeof(double));
+      pgu  = (double *) allocate(nu*nv*sizeof(double));
+      pgv  = (double *) allocate(nu*nv*sizeof(double));
+      pguv = (double *) allocate(nu*nv*sizeof(double));
+      get_data(str,"Phi",DoubleType,pg,nv,nu,0);
+      get_data(str,"PhiU",DoubleType,pgu,nv,nu,0);
+      get_data(str,"PhiV",DoubleType,pgv,nv,nu,0);
+      get_data(str,"PhiUV",DoubleType,pguv,nv,nu,0);
+    }
+    get_tes(str,"TabPotential");
+    strclose(str);
+    return TRUE;
+}
+
+local void write_cache(string fname, string key)
+{
+    stream str;
+    int n[2];
+    char tname[280];
+
+    /* write a private file, and only then rename() it into place */
+    if (snprintf(tname,sizeof(tname),"%s.%d",fname,(int)getpid()) >= sizeof(tname))
+      return;
+    str = stropen(tname,"w!");
+    put_set(str,"TabPotential");
+    put_string(str,"Key",key);
+    put_data(str,"Mode",IntType,&mode,0);
+    if (mode == 0) {
+      n[0] = nr;  n[1] = 1;
+      put_data(str,"N",IntType,n,2,0);
+      put_data(str,"X",DoubleType,xr,nr,0);
+      put_data(str,"Phi",DoubleType,pr,nr,0);
+      put_data(str,"DPhi",DoubleType,dr,nr,0);
+    } else {
+      n[0] = nu;  n[1] = nv;
+      put_data(str,"N",IntType,n,2,0);
+      put_data(str,"Phi",DoubleType,pg,nv,nu,0);
+      put_data(str,"PhiU",DoubleType,pgu,nv,nu,0);
+      put_data(str,"PhiV",DoubleType,pgv,nv,nu,0);
+      put_data(str,"PhiUV",DoubleType,pguv,nv,nu,0);
+    }
+    put_tes(str,"TabPotential");
+    strclose(str);
+    if (rename(tname,fname) < 0) {
+      warning("tabulated: could not rename %s to %s",tname,fname);
+      unlink(tname);
+      return;
+    }
+    dprintf(1,"  table written to %s\n",fname);
+}
+
+#define TABULATED_POT(TYPE)						\
+void potential_##TYPE(int *ndim, TYPE *pos, TYPE *acc, TYPE *pot, TYPE *time) \
+{									\
+    double r, R, z, phi, dR, dz;					\
+									\
+    z = (*ndim > 2) ? pos[2] : 0.0;					\
+    if (mode == 0) {							\
+      r = sqrt(pos[0]*pos[0] + pos[1]*pos[1] + z*z);			\
+      eval_r(r, &phi, &dR);						\
+      *pot = phi;							\
+      dR = (r > 0) ? -dR/r : 0.0;					\
+      acc[0] = dR*pos[0];						\
+      acc[1] = dR*pos[1];						\
+      if (*ndim > 2) acc[2] = dR*z;					\
+    } else {								\
+      R = sqrt(pos[0]*pos[0] + pos[1]*pos[1]);				\
+      eval_rz(R, z, &phi, &dR, &dz);					\
+      *pot = phi;							\
+      dR = (R > 0) ? -dR/R : 0.0;					\
+      acc[0] = dR*pos[0];						\
+      acc[1] = dR*pos[1];						\
+      if (*ndim > 2) acc[2] = -dz;					\
+    }									\
+}
+
+TABULATED_POT(double)
+TABULATED_POT(float)
+
+#undef TABULATED_POT
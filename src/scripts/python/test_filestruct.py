@@ -0,0 +1,34 @@
+#! /usr/bin/env python
+#
+import os, sys
+
+try:
+    from nemopy import getparam
+    from nemopy import filestruct
+except:
+    print("Failed loading nemopy")
+    sys.exit(1)
+
+
+keydef = [
+    "in=???\n      input (snapshot) file",
+    "list=f\n      list the items, tsf style",
+    "VERSION=1\n   19-oct-2026 PJT",
+    ]
+
+usage = """
+  this is a test program for nemopy.filestruct
+
+  For each snapshot the time, number of bodies, total mass and
+  center of mass are printed; the arrays are views of the file.
+  """
+
+p = getparam.Param(keydef,usage)
+
+if p.get("list") in ["t", "true", "1"]:
+    filestruct.StructFile(p.get("in")).list()
+
+for s in filestruct.snapshots(p.get("in")):
+    m = s.mass
+    x = s.pos
+    print(s.time, s.nbody, m.sum(), (m[:,None]*x).sum(axis=0)/m.sum())